@@ -0,0 +1,17 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ *
+ * This is the *internal* interface for the scaled bitmap cache.
+ */
+
+#ifndef BITMAPCACHE_H
+#define BITMAPCACHE_H 1
+
+typedef struct nsfb_bitmap_cache_s nsfb_bitmap_cache_t;
+
+/** Destroy a scaled bitmap cache and all the results held in it. */
+void nsfb_bitmap_cache_destroy(nsfb_bitmap_cache_t *cache);
+
+#endif /* BITMAPCACHE_H */
@@ -0,0 +1,32 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ *
+ * This is the *internal* interface for the anti-aliased fill rasterizer.
+ */
+
+#ifndef COVERAGE_H
+#define COVERAGE_H 1
+
+#include <stdbool.h>
+
+/** Fill closed contours with anti-aliased edges.
+ *
+ * The coverage of each pixel is accumulated exactly from the area the
+ * contours enclose within it. Fully covered runs are filled as spans and
+ * only the partially covered pixels along the edges are blended.
+ *
+ * @param nsfb The context to plot on.
+ * @param point The vertices of every contour in turn, in 1/256ths of a
+ *              pixel (::NSFB_PLOT_SUBPIXEL_SHIFT fractional bits).
+ * @param contour The number of vertices in each contour, each is closed
+ *                back to its first vertex.
+ * @param contourc The number of contours.
+ * @param c The fill colour, its alpha scales the coverage.
+ * @param rule The fill rule.
+ * @return true on success or false on allocation failure.
+ */
+bool nsfb_coverage_fill(nsfb_t *nsfb, const nsfb_point_t *point, const int *contour, int contourc, nsfb_colour_t c, nsfb_plot_fill_rule_t rule);
+
+#endif /* COVERAGE_H */
@@ -0,0 +1,36 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ *
+ * This is the *internal* interface for the damage accumulator.
+ */
+
+#ifndef DAMAGE_H
+#define DAMAGE_H 1
+
+typedef struct nsfb_damage_s nsfb_damage_t;
+
+/** Destroy a damage accumulator. */
+void nsfb_damage_destroy(nsfb_damage_t *damage);
+
+/** Discard all the damage held. */
+void nsfb_damage_clear(nsfb_damage_t *damage);
+
+/** Add the area an operation plots to the damage of a context.
+ *
+ * @param nsfb The context, which must be tracking damage.
+ * @param extent The area plotted, which is clipped to the clipping region.
+ */
+void nsfb_damage_add(nsfb_t *nsfb, const nsfb_bbox_t *extent);
+
+/** Add the area an operation plots to the damage of a context if it is
+ * tracking damage.
+ */
+static inline void nsfb_damage_mark(nsfb_t *nsfb, const nsfb_bbox_t *extent)
+{
+    if (nsfb->damage != NULL)
+	nsfb_damage_add(nsfb, extent);
+}
+
+#endif /* DAMAGE_H */
@@ -0,0 +1,65 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ *
+ * This is the *internal* interface for the display list recorded between
+ * nsfb_frame_begin() and nsfb_frame_end().
+ *
+ * Each recording function is called by the public plotter with the same
+ * parameters before it plots anything. It returns true if the operation
+ * was recorded, or was entirely clipped away, in which case the plotter
+ * returns without plotting. Otherwise the list has been replayed and the
+ * plotter plots immediately as it would outside a frame.
+ */
+
+#ifndef DLIST_H
+#define DLIST_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct nsfb_dlist_s nsfb_dlist_t;
+
+/** Destroy a display list without plotting it. */
+void nsfb_dlist_destroy(nsfb_dlist_t *dlist);
+
+/** Plot and empty the display list of a context.
+ *
+ * @return true if every recorded operation succeeded.
+ */
+bool nsfb_dlist_flush(nsfb_t *nsfb);
+
+/** Plot the display list, if one is being recorded, before an operation
+ * which is not recorded reads or writes the framebuffer.
+ */
+static inline void nsfb_dlist_sync(nsfb_t *nsfb)
+{
+    if (nsfb->dlist != NULL)
+	nsfb_dlist_flush(nsfb);
+}
+
+bool nsfb_dlist_clg(nsfb_t *nsfb, nsfb_colour_t c);
+bool nsfb_dlist_fill(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c, nsfb_plot_op_t op);
+bool nsfb_dlist_fill_rects(nsfb_t *nsfb, int rectc, const nsfb_bbox_t *rect, const nsfb_colour_t *colour);
+bool nsfb_dlist_rectangle(nsfb_t *nsfb, nsfb_bbox_t *rect, int line_width, nsfb_colour_t c, bool dotted, bool dashed);
+bool nsfb_dlist_spans(nsfb_t *nsfb, int spanc, const nsfb_plot_span_t *span, nsfb_colour_t c);
+bool nsfb_dlist_lines(nsfb_t *nsfb, int linec, const nsfb_bbox_t *line, nsfb_plot_pen_t *pen);
+bool nsfb_dlist_polylines(nsfb_t *nsfb, int pointc, const nsfb_point_t *points, nsfb_plot_pen_t *pen);
+bool nsfb_dlist_polygon(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t fill, nsfb_plot_fill_rule_t rule);
+bool nsfb_dlist_arc(nsfb_t *nsfb, int x, int y, int radius, int angle1, int angle2, nsfb_colour_t c);
+bool nsfb_dlist_point(nsfb_t *nsfb, int x, int y, nsfb_colour_t c);
+
+/** Record an ellipse plotted by \a fn, one of the four ellipse plotters. */
+bool nsfb_dlist_ellipse(nsfb_t *nsfb, nsfb_plotfn_ellipse_t *fn, nsfb_bbox_t *ellipse, nsfb_colour_t c);
+
+/** Record a bitmap, whose pixels are not copied and must stay unchanged
+ * until the frame ends.
+ */
+bool nsfb_dlist_bitmap(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, unsigned int flags, nsfb_plot_op_t op);
+
+/** Record a glyph, copying its bitmap. */
+bool nsfb_dlist_glyph(nsfb_t *nsfb, nsfb_plot_glyph_format_t format, nsfb_bbox_t *loc, const uint8_t *pixel, int pitch, nsfb_colour_t c);
+bool nsfb_dlist_glyph_run(nsfb_t *nsfb, nsfb_plot_glyph_format_t format, const nsfb_plot_glyph_t *glyphs, int glyphc, nsfb_colour_t c);
+
+#endif /* DLIST_H */
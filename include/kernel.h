@@ -0,0 +1,154 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ *
+ * This is the *internal* interface for the row kernels used by the plotters.
+ */
+
+#ifndef KERNEL_H
+#define KERNEL_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* x86 SIMD kernels are built with per function target attributes so the
+ * library as a whole does not need to be compiled for a newer cpu.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NSFB_KERNEL_X86 1
+#endif
+
+/** Fill a rectangle of 32bpp pixels with a single value.
+ *
+ * @param pvid The first pixel of the first row.
+ * @param llen The length of a row in pixels.
+ * @param width The number of pixels to fill on each row.
+ * @param height The number of rows to fill.
+ * @param ent The pixel value to store.
+ */
+typedef void (nsfb_kernfn_fill32_t)(uint32_t *pvid, int llen, int width, int height, uint32_t ent);
+
+/** Fill a rectangle of 16bpp pixels with a single value.
+ *
+ * Parameters as ::nsfb_kernfn_fill32_t
+ */
+typedef void (nsfb_kernfn_fill16_t)(uint16_t *pvid, int llen, int width, int height, uint16_t ent);
+
+/** How a 32bpp row kernel maps ::nsfb_colour_t values to pixels.
+ *
+ * The blending kernels must match the scalar conversions of the plotters
+ * exactly, including what ends up in the unused top byte.
+ */
+enum nsfb_kernel_fmt32_e {
+    NSFB_KERNEL_XBGR8888, /**< pixel is the colour, opaque alpha kept */
+    NSFB_KERNEL_XRGB8888, /**< red and blue swapped, top byte cleared */
+};
+
+/** Alpha blend a row of colours onto 32bpp pixels.
+ *
+ * Transparent source pixels leave the destination untouched, opaque ones
+ * are converted and stored, the rest are blended as nsfb_plot_ablend().
+ *
+ * @param pvid The first destination pixel.
+ * @param pixel The source colours.
+ * @param width The number of pixels in the row.
+ * @param fmt The destination pixel layout.
+ */
+typedef void (nsfb_kernfn_blend32_t)(uint32_t *pvid, const uint32_t *pixel, int width, enum nsfb_kernel_fmt32_e fmt);
+
+/** Blend a row of 8 bit coverage values of a colour onto 32bpp pixels.
+ *
+ * Each coverage value is used as the alpha of the colour and the result
+ * matches ::nsfb_kernfn_blend32_t for the same source pixels.
+ *
+ * @param pvid The first destination pixel.
+ * @param cov The coverage values.
+ * @param width The number of pixels in the row.
+ * @param c The colour, its alpha is ignored.
+ * @param fmt The destination pixel layout.
+ */
+typedef void (nsfb_kernfn_glyph32_t)(uint32_t *pvid, const uint8_t *cov, int width, uint32_t c, enum nsfb_kernel_fmt32_e fmt);
+
+/** Blend a row of 8 bit coverage values of a colour onto RGB565 pixels.
+ *
+ * Parameters as ::nsfb_kernfn_glyph32_t
+ */
+typedef void (nsfb_kernfn_glyph16_t)(uint16_t *pvid, const uint8_t *cov, int width, uint32_t c);
+
+/** Interpolate between two rows of 32bpp pixels.
+ *
+ * Each 8 bit channel of the result is (a * (256 - w) + b * w + 128) >> 8
+ * of the corresponding channels of the two sources.
+ *
+ * @param out The destination row.
+ * @param a The first source row.
+ * @param b The second source row.
+ * @param width The number of pixels in the rows.
+ * @param w The weight of the second row, 0 to 256.
+ */
+typedef void (nsfb_kernfn_lerp32_t)(uint32_t *out, const uint32_t *a, const uint32_t *b, int width, unsigned int w);
+
+/** Interpolate between neighbouring 32bpp pixels of a row.
+ *
+ * Each destination pixel is src[x[n]] and src[x[n] + 1] interpolated as
+ * ::nsfb_kernfn_lerp32_t with the weight w[n].
+ *
+ * @param out The destination row.
+ * @param src The source row.
+ * @param x The index of the left pixel of each pair.
+ * @param w The weight of the right pixel of each pair, 0 to 256.
+ * @param width The number of destination pixels.
+ */
+typedef void (nsfb_kernfn_hlerp32_t)(uint32_t *out, const uint32_t *src, const int *x, const uint16_t *w, int width);
+
+/** Compare two rows of bytes.
+ *
+ * @param a The first row.
+ * @param b The second row.
+ * @param len The number of bytes in the rows.
+ * @return true if the rows are identical.
+ */
+typedef bool (nsfb_kernfn_equal_t)(const uint8_t *a, const uint8_t *b, int len);
+
+/** row kernel function table.
+ *
+ * The fill, interpolation and compare kernels are always present, the
+ * others may be NULL in which case the plotters use their own scalar loops.
+ */
+typedef struct nsfb_kernel_fns_s {
+    const char *name; /**< name of the instruction set used */
+    nsfb_kernfn_fill32_t *fill32;
+    nsfb_kernfn_fill16_t *fill16;
+    nsfb_kernfn_blend32_t *blend32;
+    nsfb_kernfn_glyph32_t *glyph32;
+    nsfb_kernfn_glyph16_t *glyph16;
+    nsfb_kernfn_lerp32_t *lerp32;
+    nsfb_kernfn_hlerp32_t *hlerp32;
+    nsfb_kernfn_equal_t *equal;
+} nsfb_kernel_fns_t;
+
+/** Per pixel write masks for a byte of a 1bpp glyph.
+ *
+ * Entry n holds eight values, one for each bit of n from the most
+ * significant down, which are -1 if the bit is set and 0 if not.
+ */
+extern const int8_t nsfb_kernel_glyph1_mask[256][8];
+
+/** portable scalar kernels. */
+extern const nsfb_kernel_fns_t _nsfb_kernel_generic;
+
+#ifdef NSFB_KERNEL_X86
+extern const nsfb_kernel_fns_t _nsfb_kernel_sse2;
+extern const nsfb_kernel_fns_t _nsfb_kernel_avx2;
+#endif
+
+/** Select the kernel table for a requested SIMD level.
+ *
+ * @param simd The level requested, NSFB_PLOT_SIMD_AUTO picks the best the
+ *             running cpu supports.
+ * @return The kernel table or NULL if the requested level is not available.
+ */
+const nsfb_kernel_fns_t *nsfb_kernel_select(enum nsfb_plot_simd_e simd);
+
+#endif /* KERNEL_H */
@@ -113,6 +113,74 @@ int nsfb_claim(nsfb_t *nsfb, nsfb_bbox_t *box);
  */
 int nsfb_update(nsfb_t *nsfb, nsfb_bbox_t *box);
 
+/** Set whether a context tracks the area plotted.
+ *
+ * While tracking, the area each plot may alter, clipped to the clipping
+ * region, is added to the damage of the context. The damage is held as a
+ * short list of rectangles, nearby areas being merged where little
+ * unaltered area is added. Changes made directly to the buffer are not
+ * tracked. Stopping tracking discards the damage.
+ *
+ * @param nsfb The context to alter.
+ * @param track Whether to track damage.
+ * @return 0 on success or -1 if memory could not be allocated.
+ */
+int nsfb_set_damage_tracking(nsfb_t *nsfb, bool track);
+
+/** Get the damage of a context.
+ *
+ * @param nsfb The context to read.
+ * @param box Array to store the damaged rectangles in.
+ * @param boxc The number of entries in \a box.
+ * @return The number of damaged rectangles, which may exceed \a boxc.
+ */
+int nsfb_get_damage(nsfb_t *nsfb, nsfb_bbox_t *box, int boxc);
+
+/** Update the damaged area of the screen.
+ *
+ * Each damaged rectangle is passed to the surface as by ::nsfb_update,
+ * after which the context has no damage.
+ *
+ * @param nsfb The context to update.
+ * @return 0 on success or -1 if the context is not tracking damage or
+ *         the surface failed to update.
+ */
+int nsfb_update_damage(nsfb_t *nsfb);
+
+/** Shadow frame comparison counters.
+ *
+ * Each tile of the screen within an updated area is counted as compared
+ * and then as either changed or skipped.
+ */
+typedef struct nsfb_shadow_stats_s {
+    unsigned long compared; /**< tiles compared with the shadow frame */
+    unsigned long changed; /**< tiles which differed and were updated */
+    unsigned long skipped; /**< tiles which were unchanged */
+} nsfb_shadow_stats_t;
+
+/** Set whether a context compares updates with the previous frame.
+ *
+ * While comparing, a copy is kept of the frame as last passed to the
+ * surface. ::nsfb_update and ::nsfb_update_damage divide the area into
+ * 64 pixel square tiles and pass on only those which differ from the
+ * copy, so a program which redraws everything each frame updates only
+ * what actually changed. The first update of each tile is always passed
+ * on. Stopping comparing frees the copy.
+ *
+ * @param nsfb The context to alter.
+ * @param compare Whether to compare updates.
+ * @return 0 on success or -1 if memory could not be allocated.
+ */
+int nsfb_set_shadow_compare(nsfb_t *nsfb, bool compare);
+
+/** Get the shadow frame comparison counters of a context.
+ *
+ * @param nsfb The context to read.
+ * @param stats Where to store the counters.
+ * @return 0 on success or -1 if the context is not comparing updates.
+ */
+int nsfb_get_shadow_stats(nsfb_t *nsfb, nsfb_shadow_stats_t *stats);
+
 /** Obtain the geometry of a nsfb context.
  *
  * @param width a variable to store the framebuffer width in or NULL
@@ -11,6 +11,8 @@
 #ifndef _LIBNSFB_PLOT_H
 #define _LIBNSFB_PLOT_H 1
 
+#include <stddef.h>
+
 /** representation of a colour.
  *
  * The colour value comprises of four components arranged in the order ABGR:
@@ -33,16 +35,63 @@ typedef enum nsfb_plot_optype_e {
 	NFSB_PLOT_OPTYPE_NONE = 0, /**< No operation */
 	NFSB_PLOT_OPTYPE_SOLID, /**< Solid colour */
 	NFSB_PLOT_OPTYPE_PATTERN, /**< Pattern plot */
+	NFSB_PLOT_OPTYPE_SOLID_AA, /**< Solid colour with anti-aliased edges */
 } nsfb_plot_optype_t;
 
-/** pen colour and raster operation for plotting primatives. */
+/** Rule deciding which areas of a shape are inside it. */
+typedef enum nsfb_plot_fill_rule_e {
+	NSFB_PLOT_FILL_EVENODD = 0, /**< Inside where crossed an odd number of times */
+	NSFB_PLOT_FILL_NONZERO, /**< Inside where the winding number is not zero */
+} nsfb_plot_fill_rule_t;
+
+/** Operators combining a source colour with the destination.
+ *
+ * The destination has no alpha, so each operator weights its result
+ * against the destination pixel by the source alpha and a transparent
+ * source leaves the destination untouched, except for
+ * NSFB_PLOT_OP_SRC which ignores alpha.
+ */
+typedef enum nsfb_plot_op_e {
+	NSFB_PLOT_OP_SRC = 0, /**< Store the source colour */
+	NSFB_PLOT_OP_OVER, /**< Blend the source over the destination */
+	NSFB_PLOT_OP_ADD, /**< Add the source, saturating each channel */
+	NSFB_PLOT_OP_MULTIPLY, /**< Multiply the destination by the source */
+	NSFB_PLOT_OP_XOR, /**< Exclusive or the source colour into the destination */
+} nsfb_plot_op_t;
+
+/** Shape of the ends of wide strokes and their dashes. */
+typedef enum nsfb_plot_cap_e {
+	NSFB_PLOT_CAP_BUTT = 0, /**< Ends square at the end point */
+	NSFB_PLOT_CAP_SQUARE, /**< Ends square half the width past the end point */
+	NSFB_PLOT_CAP_ROUND, /**< Ends in a semicircle around the end point */
+} nsfb_plot_cap_t;
+
+/** Shape of the corners of wide strokes. */
+typedef enum nsfb_plot_join_e {
+	NSFB_PLOT_JOIN_MITRE = 0, /**< Sharp corners, bevelled when very long */
+	NSFB_PLOT_JOIN_ROUND, /**< Rounded corners */
+	NSFB_PLOT_JOIN_BEVEL, /**< Corners cut off square */
+} nsfb_plot_join_t;
+
+/** pen colour and raster operation for plotting primatives.
+ *
+ * Strokes wider than one pixel are plotted with the cap and join styles
+ * of the pen. Strokes of type NFSB_PLOT_OPTYPE_PATTERN are dashed by
+ * stroke_pattern, starting from its least significant bit; each bit
+ * covers the width of the stroke, or one pixel for thin strokes, and set
+ * bits are plotted. Strokes of type NFSB_PLOT_OPTYPE_SOLID_AA are
+ * anti-aliased and blended with the alpha of stroke_colour.
+ */
 typedef struct nsfb_plot_pen_s {
 	nsfb_plot_optype_t stroke_type; /**< Stroke plot type */
 	int stroke_width; /**< Width of stroke, in pixels */
 	nsfb_colour_t stroke_colour; /**< Colour of stroke */
-	uint32_t stroke_pattern;
+	uint32_t stroke_pattern; /**< Dash pattern of stroke */
 	nsfb_plot_optype_t fill_type; /**< Fill plot type */
 	nsfb_colour_t fill_colour; /**< Colour of fill */
+	nsfb_plot_fill_rule_t fill_rule; /**< Rule for filling paths */
+	nsfb_plot_cap_t stroke_cap; /**< Ends of wide strokes */
+	nsfb_plot_join_t stroke_join; /**< Corners of wide strokes */
 } nsfb_plot_pen_t;
 
 /** path operation type. */
@@ -59,6 +108,72 @@ typedef struct nsfb_plot_pathop_s {
 	nsfb_point_t point;
 } nsfb_plot_pathop_t;
 
+/** SIMD kernel selection for the software plotters. */
+enum nsfb_plot_simd_e {
+	NSFB_PLOT_SIMD_AUTO = 0, /**< Best kernels the cpu supports */
+	NSFB_PLOT_SIMD_NONE, /**< Portable scalar kernels only */
+	NSFB_PLOT_SIMD_SSE2, /**< x86 SSE2 kernels */
+	NSFB_PLOT_SIMD_AVX2, /**< x86 AVX2 kernels */
+};
+
+/** Select the SIMD kernels used by the plotters.
+ *
+ * The kernels are chosen once per context from the features of the cpu,
+ * this allows the choice to be overridden, for example to force the scalar
+ * reference path. The selection persists across geometry changes.
+ *
+ * @param nsfb The context to alter.
+ * @param simd The kernel set to use.
+ * @return true on success or false if the cpu does not support the
+ *         requested kernels in which case the selection is unchanged.
+ */
+bool nsfb_plot_set_simd(nsfb_t *nsfb, enum nsfb_plot_simd_e simd);
+
+/** Set the number of threads the plotters may use.
+ *
+ * Contexts plot on the calling thread alone until this is used. With more
+ * than one thread, large screen clears, rectangle fills, polygons and
+ * bitmaps are cut into horizontal bands which are plotted in parallel,
+ * and the plot returns once every band is done. Small plots, and all
+ * plots on paletted formats, stay on the calling thread.
+ *
+ * @param nsfb The context to alter.
+ * @param threads The number of threads to plot with, including the
+ *                caller. One or less stops the extra threads.
+ * @return true on success or false if the threads could not be started,
+ *         in which case the context plots on the calling thread alone.
+ */
+bool nsfb_plot_set_threads(nsfb_t *nsfb, int threads);
+
+/** Start recording a frame.
+ *
+ * Until ::nsfb_frame_end the clears, fills, rectangles, spans, lines,
+ * polylines, polygons, arcs, points, ellipses, bitmaps and glyphs plotted
+ * on the context are recorded in a display list rather than plotted, each
+ * with the clipping region set when it was made. Line, span and glyph data
+ * is copied but bitmap pixels are not, and must remain unchanged until the
+ * frame ends. Any other plot, copy, read or update of the context first
+ * plots the list recorded so far.
+ *
+ * @param nsfb The context to record.
+ * @return true on success or false if a frame is already being recorded
+ *         or memory could not be allocated.
+ */
+bool nsfb_frame_begin(nsfb_t *nsfb);
+
+/** Plot a recorded frame and stop recording.
+ *
+ * With threads set by ::nsfb_plot_set_threads the screen is cut into tiles
+ * which are plotted in parallel, each plotting the recorded operations
+ * touching it in the order they were made. Otherwise the operations are
+ * plotted in order on the calling thread.
+ *
+ * @param nsfb The context being recorded.
+ * @return true on success or false if no frame was being recorded or a
+ *         recorded operation failed.
+ */
+bool nsfb_frame_end(nsfb_t *nsfb);
+
 /** Sets a clip rectangle for subsequent plots.
  *
  * Sets a clipping area which constrains all subsequent plotting operations.
@@ -68,9 +183,76 @@ typedef struct nsfb_plot_pathop_s {
 bool nsfb_plot_set_clip(nsfb_t *nsfb, nsfb_bbox_t *clip);
 
 /** Get the previously set clipping region.
+ *
+ * For a region of several rectangles this is their bounding box.
  */
 bool nsfb_plot_get_clip(nsfb_t *nsfb, nsfb_bbox_t *clip);
 
+/** Set a clipping region made of several rectangles.
+ *
+ * Subsequent plots are constrained to the union of the rectangles, which
+ * may overlap and are clipped to the screen. Each plot is run once for
+ * every rectangle of the region meeting its area, so a region of a few
+ * large rectangles is cheapest. Thin lines are clipped only to the
+ * bounding box of the region, so they keep the pixels they have without
+ * it. Setting a clip rectangle replaces the region.
+ *
+ * @param nsfb The context to alter.
+ * @param rectc The number of rectangles, which may be zero to clip
+ *              everything away.
+ * @param rect The rectangles.
+ * @return true on success or false if memory could not be allocated, in
+ *         which case the clipping region is unchanged.
+ */
+bool nsfb_plot_set_clip_region(nsfb_t *nsfb, int rectc, const nsfb_bbox_t *rect);
+
+/** Get the rectangles of the clipping region.
+ *
+ * The rectangles are disjoint and sorted from the top of the screen down,
+ * then from left to right.
+ *
+ * @param nsfb The context to read.
+ * @param rect Array to store the rectangles in or NULL.
+ * @param rectc The number of entries in \a rect.
+ * @return The number of rectangles in the region, which may exceed
+ *         \a rectc.
+ */
+int nsfb_plot_get_clip_region(nsfb_t *nsfb, nsfb_bbox_t *rect, int rectc);
+
+/** Narrow the clipping region to a rectangle.
+ *
+ * @return true on success or false if memory could not be allocated.
+ */
+bool nsfb_plot_intersect_clip(nsfb_t *nsfb, const nsfb_bbox_t *clip);
+
+/** Remove a rectangle from the clipping region.
+ *
+ * For example the areas of windows above the one being drawn can be
+ * excluded so nothing occluded is plotted.
+ *
+ * @return true on success or false if memory could not be allocated.
+ */
+bool nsfb_plot_exclude_clip(nsfb_t *nsfb, const nsfb_bbox_t *exclude);
+
+/** Save the clipping region and narrow it to a rectangle.
+ *
+ * The region is restored by the matching ::nsfb_plot_pop_clip, whatever
+ * clip is set in between.
+ *
+ * @param nsfb The context to alter.
+ * @param clip The rectangle to narrow the region to or NULL to only save
+ *             it.
+ * @return true on success or false if memory could not be allocated, in
+ *         which case nothing is saved.
+ */
+bool nsfb_plot_push_clip(nsfb_t *nsfb, const nsfb_bbox_t *clip);
+
+/** Restore the clipping region saved by ::nsfb_plot_push_clip.
+ *
+ * @return true on success or false if no region was saved.
+ */
+bool nsfb_plot_pop_clip(nsfb_t *nsfb);
+
 /** Clears plotting area to a flat colour.
  */
 bool nsfb_plot_clg(nsfb_t *nsfb, nsfb_colour_t c);
@@ -85,9 +267,56 @@ bool nsfb_plot_rectangle(nsfb_t *nsfb, nsfb_bbox_t *rect, int line_width, nsfb_c
 /** Plots a filled rectangle. Top left corner at (x0,y0), bottom
  *		  right corner at (x1,y1). Note: (x0,y0) is inside filled area,
  *		  but (x1,y1) is below and to the right. See diagram below.
+ *
+ * The colour is blended over the rectangle by its alpha, as
+ * ::nsfb_plot_rectangle_fill_op with NSFB_PLOT_OP_OVER.
  */
 bool nsfb_plot_rectangle_fill(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c);
 
+/** Plots a filled rectangle with a compositing operator.
+ *
+ * As ::nsfb_plot_rectangle_fill but the colour is combined with each pixel
+ * by \a op.
+ */
+bool nsfb_plot_rectangle_fill_op(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c, nsfb_plot_op_t op);
+
+/** Plots many filled rectangles.
+ *
+ * Each rectangle is filled as ::nsfb_plot_rectangle_fill would, in the
+ * order given so later rectangles cover earlier ones, but the rectangles
+ * are clipped together and filled a row of the screen at a time.
+ *
+ * @param nsfb The context to plot on.
+ * @param rectc The number of rectangles.
+ * @param rect The rectangles, which are not altered.
+ * @param colour The colour of each rectangle.
+ * @return true on success or false on allocation failure.
+ */
+bool nsfb_plot_fill_rects(nsfb_t *nsfb, int rectc, const nsfb_bbox_t *rect, const nsfb_colour_t *colour);
+
+/** A run of pixels along a row, as produced by a scanline rasteriser. */
+typedef struct nsfb_plot_span_s {
+	int y; /**< Row of the span */
+	int x0; /**< First column of the span */
+	int x1; /**< Column after the last of the span */
+	uint8_t alpha; /**< Opacity of the whole span, 0xFF for opaque */
+	const uint8_t *cov; /**< Coverage of each column from x0, or NULL */
+} nsfb_plot_span_t;
+
+/** Plots a list of spans in a colour.
+ *
+ * Each span is clipped to the clipping region and blended onto its row,
+ * with the alpha of each pixel the product of the colour's alpha, the
+ * span's alpha and, if the span has one, the pixel's coverage. Spans
+ * which are fully opaque are stored without blending.
+ *
+ * @param nsfb The context to plot on.
+ * @param spanc The number of spans.
+ * @param span The spans, in any order.
+ * @param c The colour to plot the spans in.
+ */
+bool nsfb_plot_spans(nsfb_t *nsfb, int spanc, const nsfb_plot_span_t *span, nsfb_colour_t c);
+
 /** Plots a line.
  *
  * Draw a line from (x0,y0) to (x1,y1). Coordinates are at centre of line
@@ -97,41 +326,79 @@ bool nsfb_plot_line(nsfb_t *nsfb, nsfb_bbox_t *line, nsfb_plot_pen_t *pen);
 
 /** Plots a number of lines.
  *
- * Draw a series of lines.
+ * Draw a series of lines. Wide lines are each capped at both ends.
  */
 bool nsfb_plot_lines(nsfb_t *nsfb, int linec, nsfb_bbox_t *line, nsfb_plot_pen_t *pen);
 
 /** Plots a number of connected lines.
  *
- * Draw a series of connected lines.
+ * Draw a series of connected lines. Wide lines are joined at each point
+ * and their dash pattern continues from one line to the next.
  */
 bool nsfb_plot_polylines(nsfb_t *nsfb, int pointc, const nsfb_point_t *points, nsfb_plot_pen_t *pen);
 
 /** Plots a filled polygon. 
  *
  * Plots a filled polygon with straight lines between points. The lines around
- * the edge of the ploygon are not plotted. The polygon is filled with a
- * non-zero winding rule.
- *
- *
+ * the edge of the ploygon are not plotted. The polygon is filled with the
+ * even-odd rule.
  */
 bool nsfb_plot_polygon(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t fill);
 
+/** Plots a filled polygon with a choice of fill rule.
+ *
+ * As ::nsfb_plot_polygon but self intersecting polygons may also be
+ * filled with the non-zero winding rule.
+ */
+bool nsfb_plot_polygon_rule(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t fill, nsfb_plot_fill_rule_t rule);
+
 /** Plot an ellipse.
+ *
+ * The ellipse is centred on the pixel half way across the bounding box and
+ * spans half its width and height either side of it. Each pixel of the
+ * outline is plotted once.
  */
 bool nsfb_plot_ellipse(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c);
 
 /** Plot a filled ellipse.
+ *
+ * Fills the pixels whose centres lie within the ellipse of
+ * ::nsfb_plot_ellipse, extended by half a pixel, one span per row.
  */
 bool nsfb_plot_ellipse_fill(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c);
 
+/** Plot an anti-aliased ellipse.
+ *
+ * As ::nsfb_plot_ellipse but the outline is a ring a pixel wide blended by
+ * the area of each pixel it covers and the alpha of the colour.
+ */
+bool nsfb_plot_ellipse_aa(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c);
+
+/** Plot a filled anti-aliased ellipse.
+ *
+ * As ::nsfb_plot_ellipse_fill but pixels on the edge are blended by the
+ * area of them the ellipse covers and the alpha of the colour.
+ */
+bool nsfb_plot_ellipse_fill_aa(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c);
+
 /** Plots an arc.
  *
  * around (x,y), from anticlockwise from angle1 to angle2. Angles are measured
- * anticlockwise from horizontal, in degrees.
+ * anticlockwise from horizontal, in degrees. Angles a whole turn or more
+ * apart plot a circle and equal angles plot nothing. Each pixel of the arc
+ * is blended with the colour once.
  */
 bool nsfb_plot_arc(nsfb_t *nsfb, int x, int y, int radius, int angle1, int angle2, nsfb_colour_t c);
 
+/** Plots an arc with a pen.
+ *
+ * The arc is as ::nsfb_plot_arc. If the pen has a fill the sector between
+ * the arc and (x,y), or the whole circle, is filled first. The arc is then
+ * stroked with the width, caps, joins and type of the pen, so
+ * NFSB_PLOT_OPTYPE_SOLID_AA gives anti-aliased arcs and sectors.
+ */
+bool nsfb_plot_arc_pen(nsfb_t *nsfb, int x, int y, int radius, int angle1, int angle2, nsfb_plot_pen_t *pen);
+
 /** Plots an alpha blended pixel.
  *
  * plots an alpha blended pixel.
@@ -142,17 +409,176 @@ bool nsfb_plot_cubic_bezier(nsfb_t *nsfb, nsfb_bbox_t *curve, nsfb_point_t *ctrl
 
 bool nsfb_plot_quadratic_bezier(nsfb_t *nsfb, nsfb_bbox_t *curve, nsfb_point_t *ctrla, nsfb_plot_pen_t *pen);
 
+/** Plots a path.
+ *
+ * Move operations start a new subpath. With a fill type of
+ * NFSB_PLOT_OPTYPE_SOLID_AA each subpath is closed and the enclosed area
+ * filled with anti-aliased edges using the pen's fill rule.
+ */
 bool nsfb_plot_path(nsfb_t *nsfb, int pathc, nsfb_plot_pathop_t *pathop, nsfb_plot_pen_t *pen);
 
+/** Number of fractional bits in subpixel path coordinates. */
+#define NSFB_PLOT_SUBPIXEL_SHIFT 8
+
+/** Plots a path with subpixel coordinates.
+ *
+ * As ::nsfb_plot_path but the coordinates of the path operations are fixed
+ * point with ::NSFB_PLOT_SUBPIXEL_SHIFT fractional bits. Anti-aliased
+ * fills use the full precision, other fills and strokes are plotted from
+ * the nearest pixels.
+ */
+bool nsfb_plot_path_subpixel(nsfb_t *nsfb, int pathc, nsfb_plot_pathop_t *pathop, nsfb_plot_pen_t *pen);
+
 /** copy an area of screen 
  *
  * Copy an area of the display.
  */
 bool nsfb_plot_copy(nsfb_t *srcfb, nsfb_bbox_t *srcbox, nsfb_t *dstfb, nsfb_bbox_t *dstbox);
 
+/** Bitmap plotting flags.
+ *
+ * One of the filters may be combined with ::NSFB_PLOT_BITMAP_ALPHA. The
+ * values are chosen so passing true or false, as older callers do, asks
+ * for an alpha blended or opaque bitmap scaled with nearest neighbour
+ * sampling.
+ */
+enum nsfb_plot_bitmap_flags_e {
+	NSFB_PLOT_BITMAP_ALPHA = 1, /**< Blend the bitmap using its alpha */
+	NSFB_PLOT_BITMAP_NEAREST = 0, /**< Scale by nearest neighbour */
+	NSFB_PLOT_BITMAP_BILINEAR = 2, /**< Scale by bilinear interpolation */
+	NSFB_PLOT_BITMAP_BOX = 4, /**< Scale by averaging the covered area */
+	NSFB_PLOT_BITMAP_FILTER = 6, /**< Mask of the filter flags */
+};
+
 /** Plot bitmap.
+ *
+ * The bitmap is scaled to the size of \a loc with the filter selected in
+ * \a flags. Filtering with alpha interpolates premultiplied colours so
+ * transparent pixels do not bleed their colour into their neighbours.
+ *
+ * @param flags A combination of ::nsfb_plot_bitmap_flags_e values.
+ */
+bool nsfb_plot_bitmap(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, unsigned int flags);
+
+/** Plot bitmap with a compositing operator.
+ *
+ * As ::nsfb_plot_bitmap but each pixel is combined with the destination
+ * by \a op instead of as NSFB_PLOT_BITMAP_ALPHA in \a flags asks.
+ */
+bool nsfb_plot_bitmap_op(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, unsigned int flags, nsfb_plot_op_t op);
+
+/** Scaled bitmap cache usage counters. */
+typedef struct nsfb_bitmap_cache_stats_s {
+	unsigned long hits; /**< plots from a cached scaled bitmap */
+	unsigned long misses; /**< plots which had to scale the bitmap */
+	unsigned long evictions; /**< results discarded to stay within budget */
+	unsigned int count; /**< scaled bitmaps currently held */
+	size_t used; /**< bytes currently held */
+	size_t budget; /**< maximum bytes held */
+} nsfb_bitmap_cache_stats_t;
+
+/** Set the memory budget of a context's scaled bitmap cache.
+ *
+ * The cache is off until a budget is set. Least recently used results
+ * are discarded to fit a reduced budget and a budget of zero turns the
+ * cache off again, freeing it.
+ *
+ * @param nsfb The context.
+ * @param budget The maximum number of bytes of scaled bitmaps to hold.
+ * @return true on success or false on allocation failure.
+ */
+bool nsfb_plot_bitmap_cache_set_budget(nsfb_t *nsfb, size_t budget);
+
+/** Discard cached scaled bitmaps.
+ *
+ * @param nsfb The context.
+ * @param pixel The source bitmap whose results are discarded or NULL to
+ *              discard them all.
+ */
+void nsfb_plot_bitmap_cache_invalidate(nsfb_t *nsfb, const nsfb_colour_t *pixel);
+
+/** Get the usage counters of a context's scaled bitmap cache.
+ *
+ * @return true on success or false if the cache is off.
+ */
+bool nsfb_plot_bitmap_cache_stats(nsfb_t *nsfb, nsfb_bitmap_cache_stats_t *stats);
+
+/** Plot a bitmap, reusing a cached scaled result.
+ *
+ * Plots as ::nsfb_plot_bitmap but keeps the result of scaling in the
+ * cache, keyed on the source pointer, \a generation, the source and
+ * destination sizes and the filter. Later plots of the same key copy rows
+ * of the cached result, which is held in the pixel format of the context
+ * unless it is translucent in which case it is held as colours and
+ * blended. Callers change \a generation whenever the source pixels
+ * change. Unscaled bitmaps, or any bitmap when the cache is off, are
+ * simply plotted.
+ */
+bool nsfb_plot_bitmap_cached(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, unsigned int flags, uint32_t generation);
+
+/** A bitmap converted to the pixel format of a context. */
+typedef struct nsfb_pixmap_s nsfb_pixmap_t;
+
+/** Create a pixmap.
+ *
+ * Converts a bitmap once to the pixel format of a context so it can be
+ * plotted repeatedly without converting each pixel again. The rows are
+ * classified into runs of opaque and translucent pixels, transparent
+ * pixels are never plotted.
+ *
+ * @param nsfb The context the pixmap will be plotted on, or one of the
+ *             same format.
+ * @param pixel The bitmap to convert.
+ * @param width The width of the bitmap.
+ * @param height The height of the bitmap.
+ * @param stride The bitmap's row stride in pixels.
+ * @return The new pixmap or NULL on error.
+ */
+nsfb_pixmap_t *nsfb_pixmap_create(nsfb_t *nsfb, const nsfb_colour_t *pixel, int width, int height, int stride);
+
+/** Destroy a pixmap. */
+void nsfb_pixmap_destroy(nsfb_pixmap_t *pixmap);
+
+/** Plot a pixmap.
+ *
+ * The pixmap is plotted unscaled with its top left at (x,y). Opaque runs
+ * are copied and translucent runs alpha blended.
+ *
+ * @return true on success or false if the context format differs from the
+ *         one the pixmap was created for.
+ */
+bool nsfb_plot_pixmap(nsfb_t *nsfb, const nsfb_pixmap_t *pixmap, int x, int y);
+
+/** A bitmap encoded as runs of opaque and translucent pixels. */
+typedef struct nsfb_rle_bitmap_s nsfb_rle_bitmap_t;
+
+/** Run encode a bitmap.
+ *
+ * Classifies each row of a bitmap into runs of transparent, opaque and
+ * translucent pixels once so it can be plotted repeatedly without testing
+ * the alpha of every pixel. Transparent runs are skipped, opaque runs are
+ * converted without blending and only translucent runs are blended. The
+ * encoding holds colours so it may be plotted on any context.
+ *
+ * @param pixel The bitmap to encode.
+ * @param width The width of the bitmap.
+ * @param height The height of the bitmap.
+ * @param stride The bitmap's row stride in pixels.
+ * @return The new run encoded bitmap or NULL on error.
+ */
+nsfb_rle_bitmap_t *nsfb_rle_bitmap_create(const nsfb_colour_t *pixel, int width, int height, int stride);
+
+/** Destroy a run encoded bitmap. */
+void nsfb_rle_bitmap_destroy(nsfb_rle_bitmap_t *rle);
+
+/** Plot a run encoded bitmap.
+ *
+ * The bitmap is plotted unscaled with its top left at (x,y), the result
+ * is the same as plotting the original bitmap with alpha.
+ *
+ * @return true on success or false if the context format is not supported.
  */
-bool nsfb_plot_bitmap(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, bool alpha);
+bool nsfb_plot_rle_bitmap(nsfb_t *nsfb, const nsfb_rle_bitmap_t *rle, int x, int y);
 
 /** Plot bitmap.
  */
@@ -164,9 +590,117 @@ bool nsfb_plot_glyph8(nsfb_t *nsfb, nsfb_bbox_t *loc, const uint8_t *pixel, int
 
 
 /** Plot an 1 bit glyph.
+ *
+ * Each row of the glyph starts \a pitch bits after the previous one and
+ * holds one bit per pixel with the leftmost pixel in the most significant
+ * bit. Rows may be any number of bytes wide and the pitch need not be a
+ * multiple of eight.
  */
 bool nsfb_plot_glyph1(nsfb_t *nsfb, nsfb_bbox_t *loc, const uint8_t *pixel, int pitch, nsfb_colour_t c);
 
+/** Format of the glyph bitmaps in a glyph run. */
+typedef enum nsfb_plot_glyph_format_e {
+	NSFB_PLOT_GLYPH_1BPP, /**< 1 bit per pixel as ::nsfb_plot_glyph1 */
+	NSFB_PLOT_GLYPH_8BPP, /**< 8 bit coverage as ::nsfb_plot_glyph8 */
+} nsfb_plot_glyph_format_t;
+
+/** A glyph within a glyph run. */
+typedef struct nsfb_plot_glyph_s {
+	nsfb_bbox_t loc; /**< Location and size of the glyph */
+	const uint8_t *pixel; /**< Glyph bitmap */
+	int pitch; /**< Row pitch, in bits for 1bpp and bytes for 8bpp */
+} nsfb_plot_glyph_t;
+
+/** Plot a run of glyphs in a single colour.
+ *
+ * Plots each glyph as ::nsfb_plot_glyph1 or ::nsfb_plot_glyph8 would but
+ * the colour is converted and the run tested against the clipping region
+ * once for the whole run, which is rejected without looking at the glyphs
+ * if it lies outside.
+ *
+ * @param nsfb The context to plot on.
+ * @param format The format of all the glyph bitmaps in the run.
+ * @param glyphs The glyphs to plot.
+ * @param glyphc The number of glyphs.
+ * @param c The colour to plot the glyphs in.
+ */
+bool nsfb_plot_glyph_run(nsfb_t *nsfb, nsfb_plot_glyph_format_t format, const nsfb_plot_glyph_t *glyphs, int glyphc, nsfb_colour_t c);
+
+/** A cache of rendered glyphs.
+ *
+ * Glyph bitmaps are copied into the cache once, keyed by a client chosen
+ * glyph id and size, and may then be plotted by key on any context. The
+ * bitmaps are packed together into shared atlas pages and the least
+ * recently used page is discarded as a whole when the budget is exceeded.
+ */
+typedef struct nsfb_glyph_cache_s nsfb_glyph_cache_t;
+
+/** Glyph cache usage counters. */
+typedef struct nsfb_glyph_cache_stats_s {
+	unsigned long hits; /**< plots of a cached glyph */
+	unsigned long misses; /**< plots of a glyph not in the cache */
+	unsigned long evictions; /**< glyphs discarded to stay within budget */
+	unsigned int count; /**< glyphs currently held */
+	size_t used; /**< bytes of atlas pages currently held */
+	size_t budget; /**< maximum bytes held */
+} nsfb_glyph_cache_stats_t;
+
+/** Create a glyph cache.
+ *
+ * @param budget The maximum number of bytes the cached glyphs may use.
+ * @return The new cache or NULL on allocation failure.
+ */
+nsfb_glyph_cache_t *nsfb_glyph_cache_create(size_t budget);
+
+/** Destroy a glyph cache and all the glyphs held in it. */
+void nsfb_glyph_cache_destroy(nsfb_glyph_cache_t *cache);
+
+/** Change the memory budget of a glyph cache.
+ *
+ * Least recently used atlas pages are discarded until the cache fits.
+ */
+void nsfb_glyph_cache_set_budget(nsfb_glyph_cache_t *cache, size_t budget);
+
+/** Discard all the glyphs in a glyph cache.
+ *
+ * The counters are left alone.
+ */
+void nsfb_glyph_cache_flush(nsfb_glyph_cache_t *cache);
+
+/** Get the usage counters of a glyph cache. */
+void nsfb_glyph_cache_stats(nsfb_glyph_cache_t *cache, nsfb_glyph_cache_stats_t *stats);
+
+/** Add a glyph to a glyph cache.
+ *
+ * The bitmap is copied so the caller may free it once this returns. Any
+ * glyph already cached with the same id and size is replaced and the
+ * glyphs in least recently used atlas pages are discarded to make room.
+ *
+ * @param cache The cache to add to.
+ * @param id The client glyph id.
+ * @param size The client glyph size.
+ * @param format The format of the bitmap.
+ * @param pixel The glyph bitmap as ::nsfb_plot_glyph1 or ::nsfb_plot_glyph8.
+ * @param width The width of the bitmap.
+ * @param height The height of the bitmap.
+ * @param pitch The row pitch, in bits for 1bpp and bytes for 8bpp.
+ * @param x Offset of the bitmap from the plot position.
+ * @param y Offset of the bitmap from the plot position.
+ * @return true on success, false if the glyph is larger than the budget
+ *         or on allocation failure.
+ */
+bool nsfb_glyph_cache_add(nsfb_glyph_cache_t *cache, uint32_t id, int size, nsfb_plot_glyph_format_t format, const uint8_t *pixel, int width, int height, int pitch, int x, int y);
+
+/** Plot a cached glyph.
+ *
+ * The glyph is plotted at its offset from (x,y) and becomes the most
+ * recently used. A glyph that is not cached counts as a miss and nothing
+ * is plotted, allowing the caller to render and add it.
+ *
+ * @return true if the glyph was cached, false if not.
+ */
+bool nsfb_plot_glyph_cached(nsfb_t *nsfb, nsfb_glyph_cache_t *cache, uint32_t id, int size, int x, int y, nsfb_colour_t c);
+
 /* read rectangle into buffer */
 bool nsfb_plot_readrect(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t *buffer);
 
@@ -36,6 +36,16 @@ struct nsfb_s {
 
     nsfb_bbox_t clip; /**< current clipping rectangle for plotters */
     struct nsfb_plotter_fns_s *plotter_fns; /**< Plotter methods */
+
+    enum nsfb_plot_simd_e simd; /**< requested plotter SIMD level */
+    const struct nsfb_kernel_fns_s *kernel_fns; /**< Plotter row kernels */
+
+    struct nsfb_bitmap_cache_s *bitmap_cache; /**< scaled bitmap cache */
+    struct nsfb_workers_s *workers; /**< band parallel plotting threads */
+    struct nsfb_dlist_s *dlist; /**< display list while recording a frame */
+    struct nsfb_damage_s *damage; /**< area plotted since the last update */
+    struct nsfb_shadow_s *shadow; /**< frame as last passed to the surface */
+    struct nsfb_region_s *region; /**< clipping region and saved clips */
 };
 
 
@@ -16,9 +16,9 @@ typedef bool (nsfb_plotfn_line_t)(nsfb_t *nsfb, int linec, nsfb_bbox_t *line, ns
 
 /** Plots a filled polygon with straight lines between points.
  *		  The lines around the edge of the ploygon are not plotted. The
- *		  polygon is filled with the non-zero winding rule.
+ *		  polygon is filled with the given rule.
  */
-typedef	bool (nsfb_plotfn_polygon_t)(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t fill);
+typedef	bool (nsfb_plotfn_polygon_t)(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t fill, nsfb_plot_fill_rule_t rule);
 
 /** Plots a filled rectangle. Top left corner at (x0,y0), bottom
  *		  right corner at (x1,y1). Note: (x0,y0) is inside filled area,
@@ -26,6 +26,15 @@ typedef	bool (nsfb_plotfn_polygon_t)(nsfb_t *nsfb, const int *p, unsigned int n,
  */
 typedef	bool (nsfb_plotfn_fill_t)(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c);
 
+/** Plots a filled rectangle combining the colour with each pixel by a
+ *		  compositing operator.
+ */
+typedef	bool (nsfb_plotfn_fill_op_t)(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c, nsfb_plot_op_t op);
+
+/** Plots many filled rectangles, each in its own colour.
+ */
+typedef	bool (nsfb_plotfn_fill_rects_t)(nsfb_t *nsfb, int rectc, const nsfb_bbox_t *rect, const nsfb_colour_t *colour);
+
 /** Clipping operations.
  */
 typedef	bool (nsfb_plotfn_clip_t)(nsfb_t *nsfb, nsfb_bbox_t *clip);
@@ -36,6 +45,11 @@ typedef	bool (nsfb_plotfn_clip_t)(nsfb_t *nsfb, nsfb_bbox_t *clip);
  */
 typedef	bool (nsfb_plotfn_arc_t)(nsfb_t *nsfb, int x, int y, int radius, int angle1, int angle2, nsfb_colour_t c);
 
+/** Plots an arc with a pen, filling the sector it encloses with the pen's
+ *		  fill and stroking the arc with its stroke.
+ */
+typedef	bool (nsfb_plotfn_arc_pen_t)(nsfb_t *nsfb, int x, int y, int radius, int angle1, int angle2, nsfb_plot_pen_t *pen);
+
 /** Plots a point.
  *
  * Plot a single alpha blended pixel.
@@ -59,7 +73,12 @@ typedef	bool (nsfb_plotfn_ellipse_fill_t)(nsfb_t *nsfb, nsfb_bbox_t *ellipse, ns
 
 /** Plot bitmap
  */
-typedef bool (nsfb_plotfn_bitmap_t)(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, bool alpha);
+typedef bool (nsfb_plotfn_bitmap_t)(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, unsigned int flags);
+
+/** Plot bitmap combining each pixel with the destination by a compositing
+ * operator.
+ */
+typedef bool (nsfb_plotfn_bitmap_op_t)(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, unsigned int flags, nsfb_plot_op_t op);
 
 /** Plot tiled bitmap
  */
@@ -82,6 +101,10 @@ typedef bool (nsfb_plotfn_glyph8_t)(nsfb_t *nsfb, nsfb_bbox_t *loc, const uint8_
  */
 typedef bool (nsfb_plotfn_glyph1_t)(nsfb_t *nsfb, nsfb_bbox_t *loc, const uint8_t *pixel, int pitch, nsfb_colour_t c);
 
+/** Plot a run of glyphs.
+ */
+typedef bool (nsfb_plotfn_glyph_run_t)(nsfb_t *nsfb, nsfb_plot_glyph_format_t format, const nsfb_plot_glyph_t *glyphs, int glyphc, nsfb_colour_t c);
+
 /** Read rectangle of screen into buffer
  */
 typedef	bool (nsfb_plotfn_readrect_t)(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t *buffer);
@@ -96,8 +119,41 @@ typedef bool (nsfb_plotfn_cubic_bezier_t)(nsfb_t *nsfb, nsfb_bbox_t *curve, nsfb
 
 typedef bool (nsfb_plotfn_polylines_t)(nsfb_t *nsfb, int pointc, const nsfb_point_t *points, nsfb_plot_pen_t *pen);
 
-/** plot path */
-typedef bool (nsfb_plotfn_path_t)(nsfb_t *nsfb, int pathc, nsfb_plot_pathop_t *pathop, nsfb_plot_pen_t *pen);
+/** plot path, subpixel selects coordinates with NSFB_PLOT_SUBPIXEL_SHIFT
+ * fractional bits */
+typedef bool (nsfb_plotfn_path_t)(nsfb_t *nsfb, int pathc, nsfb_plot_pathop_t *pathop, nsfb_plot_pen_t *pen, bool subpixel);
+
+/** Convert a row of colours to pixels in the format of the context.
+ *
+ * The pixels are written packed at the context's bits per pixel.
+ */
+typedef bool (nsfb_plotfn_convert_t)(nsfb_t *nsfb, const nsfb_colour_t *colour, void *pixel, int width);
+
+/** Alpha blend a row of colours onto a context.
+ *
+ * The row is not clipped, the caller must ensure it lies within the
+ * clipping region.
+ */
+typedef bool (nsfb_plotfn_blend_t)(nsfb_t *nsfb, int x, int y, const nsfb_colour_t *colour, int width);
+
+/** Fill spans of a row with a solid colour.
+ *
+ * The spans are given as pairs of the first column and the column after
+ * the last. They are not clipped, the caller must ensure they lie within
+ * the clipping region.
+ */
+typedef bool (nsfb_plotfn_spans_t)(nsfb_t *nsfb, int y, const int *x, int spanc, nsfb_colour_t c);
+
+/** Blend a row of coverage values of a solid colour.
+ *
+ * Each coverage value is used as the alpha of the colour. The row is not
+ * clipped, the caller must ensure it lies within the clipping region.
+ */
+typedef bool (nsfb_plotfn_coverage_t)(nsfb_t *nsfb, int x, int y, const uint8_t *cov, int width, nsfb_colour_t c);
+
+/** Plot a list of spans, clipping them.
+ */
+typedef bool (nsfb_plotfn_span_list_t)(nsfb_t *nsfb, int spanc, const nsfb_plot_span_t *span, nsfb_colour_t c);
 
 /** plotter function table. */
 typedef struct nsfb_plotter_fns_s {
@@ -106,24 +162,56 @@ typedef struct nsfb_plotter_fns_s {
     nsfb_plotfn_line_t *line;
     nsfb_plotfn_polygon_t *polygon;
     nsfb_plotfn_fill_t *fill;
+    nsfb_plotfn_fill_op_t *fill_op;
+    nsfb_plotfn_fill_rects_t *fill_rects;
     nsfb_plotfn_clip_t *get_clip;
     nsfb_plotfn_clip_t *set_clip;
     nsfb_plotfn_ellipse_t *ellipse;
     nsfb_plotfn_ellipse_fill_t *ellipse_fill;
+    nsfb_plotfn_ellipse_t *ellipse_aa;
+    nsfb_plotfn_ellipse_fill_t *ellipse_fill_aa;
     nsfb_plotfn_arc_t *arc;
+    nsfb_plotfn_arc_pen_t *arc_pen;
     nsfb_plotfn_bitmap_t *bitmap;
+    nsfb_plotfn_bitmap_op_t *bitmap_op;
     nsfb_plotfn_bitmap_tiles_t *bitmap_tiles;
     nsfb_plotfn_point_t *point;
     nsfb_plotfn_copy_t *copy;
     nsfb_plotfn_glyph8_t *glyph8;
     nsfb_plotfn_glyph1_t *glyph1;
+    nsfb_plotfn_glyph_run_t *glyph_run;
     nsfb_plotfn_readrect_t *readrect;
     nsfb_plotfn_quadratic_bezier_t *quadratic;
     nsfb_plotfn_cubic_bezier_t *cubic;
     nsfb_plotfn_path_t *path;
     nsfb_plotfn_polylines_t *polylines;
+    nsfb_plotfn_convert_t *convert;
+    nsfb_plotfn_blend_t *blend;
+    nsfb_plotfn_spans_t *spans;
+    nsfb_plotfn_coverage_t *coverage;
+    nsfb_plotfn_span_list_t *span_list;
 } nsfb_plotter_fns_t;
 
 
 bool select_plotters(nsfb_t *nsfb);
 
+/** Integer square root, rounded down. */
+unsigned int nsfb_plot_isqrt(uint64_t v);
+
+/** Number of fractional bits of the components of unit vectors. */
+#define NSFB_PLOT_UNIT_SHIFT 14
+
+/** Unit vector of an angle in whole degrees, anticlockwise from the
+ * horizontal with y increasing upwards.
+ */
+void nsfb_plot_unit_angle(int angle, int *cosine, int *sine);
+
+/** Normalise the angles of an arc.
+ *
+ * @param angle1 The start angle in degrees, updated to lie in [0, 360).
+ * @param angle2 The end angle in degrees.
+ * @return The anticlockwise sweep from angle1 to angle2 in degrees, 360 if
+ *         they are a whole turn or more apart or 0 if they are equal.
+ */
+int nsfb_plot_arc_sweep(int *angle1, int angle2);
+
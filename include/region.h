@@ -0,0 +1,84 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ *
+ * This is the *internal* interface for clipping regions made of several
+ * rectangles and the stack of saved clips.
+ *
+ * The plotters only clip to the rectangle in the context, which is the
+ * bounding box of the region. When the region has more than one rectangle
+ * each public plotter runs itself once for every rectangle of the region
+ * meeting the area it plots, with the clipping rectangle set to it:
+ *
+ *     if (nsfb_region_active(nsfb)) {
+ *         nsfb_region_start(nsfb, &extent);
+ *         while (nsfb_region_next(nsfb))
+ *             ret = nsfb_plot_xxx(nsfb, ...) && ret;
+ *         return ret;
+ *     }
+ *
+ * Plotters alter some parameters in place while clipping them, so those
+ * must be copied afresh for each rectangle.
+ */
+
+#ifndef REGION_H
+#define REGION_H 1
+
+#include <stdbool.h>
+
+typedef struct nsfb_region_s nsfb_region_t;
+
+/** Destroy a clipping region and any saved clips. */
+void nsfb_region_destroy(nsfb_region_t *region);
+
+/** Make the clipping rectangle of a context the whole clip again.
+ *
+ * Called when the rectangle is set directly, the saved clips are kept.
+ */
+void nsfb_region_reset(nsfb_t *nsfb);
+
+/** Find whether a plot must be run for each rectangle of the region.
+ *
+ * @return true if the clip is a region of other than one rectangle and no
+ *         plot is already being run for each of them.
+ */
+bool nsfb_region_multiple(nsfb_t *nsfb);
+
+static inline bool nsfb_region_active(nsfb_t *nsfb)
+{
+    return (nsfb->region != NULL) && nsfb_region_multiple(nsfb);
+}
+
+/** Start running a plot for each rectangle of the region.
+ *
+ * Only the bands of the region the extent crosses are visited, and none
+ * if it misses the bounding box of the region.
+ *
+ * @param nsfb The context, whose region must be active.
+ * @param extent The area the plot may alter, which need not be clipped.
+ */
+void nsfb_region_start(nsfb_t *nsfb, const nsfb_bbox_t *extent);
+
+/** Start running a plot once over an area lying inside the region.
+ *
+ * The plot is visited a single time with the clipping rectangle left as
+ * the bounding box of the region, so it is clipped just as it would be
+ * without the region. Plotters whose output depends on where they are
+ * clipped use this for the parts the region wholly covers.
+ *
+ * @param nsfb The context, whose region must be active.
+ * @param area The area the plot alters, which must be exact.
+ * @return true if the plot is to be run, or false if the region does not
+ *         cover the whole area and nothing was started.
+ */
+bool nsfb_region_start_inside(nsfb_t *nsfb, const nsfb_bbox_t *area);
+
+/** Set the clipping rectangle to the next rectangle of the region.
+ *
+ * @return true if there is another rectangle meeting the extent, or
+ *         false once they are done and the clipping rectangle is restored.
+ */
+bool nsfb_region_next(nsfb_t *nsfb);
+
+#endif /* REGION_H */
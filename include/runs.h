@@ -0,0 +1,67 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ *
+ * This is the *internal* interface for bitmaps split into alpha runs.
+ */
+
+#ifndef RUNS_H
+#define RUNS_H 1
+
+#include <stdbool.h>
+
+/** A run of pixels within a bitmap row. */
+typedef struct nsfb_run_s {
+    int x; /**< first pixel of the run */
+    int len; /**< number of pixels in the run */
+    int colour; /**< index of the first colour of the run, -1 if not kept */
+    bool opaque; /**< every pixel of the run is opaque */
+} nsfb_run_t;
+
+/** A bitmap split into runs of opaque and translucent pixels.
+ *
+ * Transparent pixels belong to no run. Translucent runs may contain some
+ * opaque and transparent pixels when they are too short to be worth
+ * plotting separately.
+ */
+typedef struct nsfb_runs_s {
+    int width; /**< width of the bitmap */
+    int height; /**< height of the bitmap */
+    int *row; /**< index of the first run of each row, and the end */
+    nsfb_run_t *run; /**< runs of every row */
+    nsfb_colour_t *colour; /**< colours of the runs kept */
+} nsfb_runs_t;
+
+/** Split a bitmap into runs.
+ *
+ * @param runs The runs to initialise.
+ * @param pixel The bitmap.
+ * @param width The width of the bitmap.
+ * @param height The height of the bitmap.
+ * @param stride The bitmap's row stride in pixels.
+ * @param opaque_colours Keep the colours of opaque runs as well as those of
+ *                       translucent ones.
+ * @return true on success or false on allocation failure.
+ */
+bool nsfb_runs_init(nsfb_runs_t *runs, const nsfb_colour_t *pixel, int width, int height, int stride, bool opaque_colours);
+
+/** Release the resources of a split bitmap. */
+void nsfb_runs_fini(nsfb_runs_t *runs);
+
+/** Plot a split bitmap.
+ *
+ * Translucent runs are blended from their colours. Opaque runs are copied
+ * from \a pixel when it is given, otherwise they are converted from their
+ * colours without any alpha tests.
+ *
+ * @param nsfb The context to plot on.
+ * @param runs The split bitmap.
+ * @param x The left of the bitmap.
+ * @param y The top of the bitmap.
+ * @param pixel The bitmap already converted to the context format with
+ *              rows packed at the context's bytes per pixel, or NULL.
+ */
+bool nsfb_runs_plot(nsfb_t *nsfb, const nsfb_runs_t *runs, int x, int y, const uint8_t *pixel);
+
+#endif /* RUNS_H */
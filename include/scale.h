@@ -0,0 +1,75 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ *
+ * This is the *internal* interface for the bitmap scaling engine.
+ */
+
+#ifndef SCALE_H
+#define SCALE_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** A scaling plan.
+ *
+ * Built once per scaled bitmap plot, it holds the source columns and
+ * weights used by each destination column of the clipped output so the
+ * rows can be produced without any per pixel position arithmetic.
+ */
+typedef struct nsfb_scale_s {
+    const struct nsfb_kernel_fns_s *kernel_fns; /**< interpolation kernels */
+    unsigned int filter; /**< NSFB_PLOT_BITMAP_ filter flag */
+    bool alpha; /**< filter premultiplied colours */
+
+    const nsfb_colour_t *pixel; /**< first source column used */
+    int bmp_height; /**< source height */
+    int bmp_stride; /**< source row stride in pixels */
+    int height; /**< unclipped destination height */
+    int span; /**< number of source columns used */
+    int cols; /**< number of those columns inside the bitmap */
+
+    int width; /**< number of destination columns */
+    int *x; /**< source column of each destination column */
+    int *xend; /**< end of the source columns averaged, box filter only */
+    uint16_t *xw; /**< weight of the right column, bilinear filter only */
+
+    uint32_t *row[2]; /**< cached source rows, bilinear filter only */
+    int rowy[2]; /**< source row held in each cache */
+    uint32_t *vrow; /**< vertically filtered source row */
+    uint64_t *acc; /**< column sums, box filter only */
+    nsfb_colour_t *out; /**< destination row */
+} nsfb_scale_t;
+
+/** Build a scaling plan.
+ *
+ * @param scale The plan to initialise.
+ * @param kernel_fns The row kernels to filter with.
+ * @param flags The bitmap plot flags selecting the filter and alpha.
+ * @param pixel The source bitmap.
+ * @param bmp_width The source width.
+ * @param bmp_height The source height.
+ * @param bmp_stride The source row stride in pixels.
+ * @param width The unclipped destination width.
+ * @param height The unclipped destination height.
+ * @param x0 The first destination column to produce.
+ * @param x1 The destination column after the last to produce.
+ * @return true on success, false if either size is empty or inverted,
+ *         the columns lie outside the destination or on allocation failure.
+ */
+bool nsfb_scale_init(nsfb_scale_t *scale, const struct nsfb_kernel_fns_s *kernel_fns, unsigned int flags, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, int width, int height, int x0, int x1);
+
+/** Produce a destination row.
+ *
+ * @param scale The plan.
+ * @param y The destination row, from the top of the unclipped destination.
+ * @return The colours of the planned destination columns, valid until the
+ *         next call.
+ */
+const nsfb_colour_t *nsfb_scale_row(nsfb_scale_t *scale, int y);
+
+/** Release the resources of a scaling plan. */
+void nsfb_scale_fini(nsfb_scale_t *scale);
+
+#endif /* SCALE_H */
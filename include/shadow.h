@@ -0,0 +1,26 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ *
+ * This is the *internal* interface for the shadow frame compared against on
+ * update.
+ */
+
+#ifndef SHADOW_H
+#define SHADOW_H 1
+
+typedef struct nsfb_shadow_s nsfb_shadow_t;
+
+/** Destroy a shadow frame. */
+void nsfb_shadow_destroy(nsfb_shadow_t *shadow);
+
+/** Update an area of screen, passing only altered tiles to the surface.
+ *
+ * @param nsfb The context, which must have a shadow frame.
+ * @param box The area which has been altered.
+ * @return 0 on success or -1 if the surface failed to update.
+ */
+int nsfb_shadow_update(nsfb_t *nsfb, nsfb_bbox_t *box);
+
+#endif /* SHADOW_H */
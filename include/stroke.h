@@ -0,0 +1,49 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ *
+ * This is the *internal* interface for the wide line stroker.
+ */
+
+#ifndef STROKE_H
+#define STROKE_H 1
+
+#include <stdbool.h>
+
+/** Stroke a polyline with the width, caps, joins and pattern of a pen.
+ *
+ * The outline of the stroke is built from pieces which are filled
+ * together, so overlapping pieces are plotted once. Each pixel whose
+ * centre lies within the outline is plotted, or for pens of type
+ * NFSB_PLOT_OPTYPE_SOLID_AA each pixel is blended by the area of it the
+ * outline covers.
+ *
+ * @param nsfb The context to plot on.
+ * @param point The vertices of the polyline, in pixels.
+ * @param pointc The number of vertices.
+ * @param closed true to join the last vertex back to the first.
+ * @param pen The pen to stroke with.
+ * @return true on success or false on allocation failure.
+ */
+bool nsfb_stroke_polyline(nsfb_t *nsfb, const nsfb_point_t *point, int pointc, bool closed, const nsfb_plot_pen_t *pen);
+
+/** Stroke a polyline given in subpixels.
+ *
+ * As ::nsfb_stroke_polyline but the vertices have
+ * ::NSFB_PLOT_SUBPIXEL_SHIFT fractional bits, with the centre of the pixel
+ * (x, y) at half a pixel past (x, y) scaled up.
+ */
+bool nsfb_stroke_polyline_subpixel(nsfb_t *nsfb, const nsfb_point_t *point, int pointc, bool closed, const nsfb_plot_pen_t *pen);
+
+/** Stroke separate lines with the width, caps and pattern of a pen.
+ *
+ * @param nsfb The context to plot on.
+ * @param line The lines, each from (x0, y0) to (x1, y1) in pixels.
+ * @param linec The number of lines.
+ * @param pen The pen to stroke with.
+ * @return true on success or false on allocation failure.
+ */
+bool nsfb_stroke_lines(nsfb_t *nsfb, const nsfb_bbox_t *line, int linec, const nsfb_plot_pen_t *pen);
+
+#endif /* STROKE_H */
@@ -0,0 +1,60 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ *
+ * This is the *internal* interface for the band parallel worker pool.
+ */
+
+#ifndef WORKERS_H
+#define WORKERS_H 1
+
+#include <stdbool.h>
+
+typedef struct nsfb_workers_s nsfb_workers_t;
+
+/** Plot one band of an operation.
+ *
+ * @param band A copy of the context whose clipping region is the band.
+ * @param ctx The operation's parameters.
+ * @return true on success or false on failure.
+ */
+typedef bool (nsfb_workers_fn_t)(nsfb_t *band, void *ctx);
+
+/** Destroy a worker pool, joining its threads. */
+void nsfb_workers_destroy(nsfb_workers_t *workers);
+
+/** Find whether an operation is worth splitting into bands.
+ *
+ * @param nsfb The context the operation plots on.
+ * @param extent The area the operation plots, which need not be clipped.
+ * @return true if the context has workers, a format they can share and
+ *         the clipped extent is large enough.
+ */
+bool nsfb_workers_want(nsfb_t *nsfb, const nsfb_bbox_t *extent);
+
+/** Run an operation in bands across the worker pool.
+ *
+ * The clipped extent is cut into horizontal bands which the calling
+ * thread and the workers take in turn until none are left. Each band is
+ * plotted on its own copy of the context, so \a fn must not alter the
+ * context or anything shared through \a ctx. Returns once every band is
+ * plotted.
+ *
+ * @param nsfb The context to plot on.
+ * @param extent The area the operation plots.
+ * @param fn The function plotting a band.
+ * @param ctx The operation's parameters.
+ * @return true if every band succeeded.
+ */
+bool nsfb_workers_run(nsfb_t *nsfb, const nsfb_bbox_t *extent, nsfb_workers_fn_t *fn, void *ctx);
+
+/** Run an operation in square tiles across the worker pool.
+ *
+ * As ::nsfb_workers_run but \a extent is not clipped and is cut into
+ * tiles of \a size pixels from its top left corner, each plotted on a copy
+ * of the context whose clipping region is the tile.
+ */
+bool nsfb_workers_run_tiles(nsfb_t *nsfb, const nsfb_bbox_t *extent, int size, nsfb_workers_fn_t *fn, void *ctx);
+
+#endif /* WORKERS_H */
@@ -20,6 +20,7 @@
 #include "nsfb.h"
 #include "cursor.h"
 #include "plot.h"
+#include "dlist.h"
 #include "surface.h"
 
 bool nsfb_cursor_init(nsfb_t *nsfb)
@@ -83,6 +84,8 @@ bool nsfb_cursor_plot(nsfb_t *nsfb, struct nsfb_cursor_s *cursor)
     int sav_size;
     nsfb_bbox_t sclip; /* saved clipping area */
 
+    nsfb_dlist_sync(nsfb);
+
     nsfb->plotter_fns->get_clip(nsfb, &sclip);
     nsfb->plotter_fns->set_clip(nsfb, NULL);
 
@@ -133,6 +136,8 @@ bool nsfb_cursor_clear(nsfb_t *nsfb, struct nsfb_cursor_s *cursor)
 {
 	nsfb_bbox_t sclip; /* saved clipping area */
 
+	nsfb_dlist_sync(nsfb);
+
 	nsfb->plotter_fns->get_clip(nsfb, &sclip);
 	nsfb->plotter_fns->set_clip(nsfb, NULL);
 
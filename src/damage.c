@@ -0,0 +1,215 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Damage accumulator (implementation).
+ *
+ * The area each plot may alter is clipped and added to a short list of
+ * rectangles. A new rectangle inside one already listed is dropped, and
+ * listed rectangles inside the new one are removed. Otherwise it is merged
+ * with the listed rectangle wasting the least area, the part of their
+ * bounding box neither covers, if that is small against the area they do
+ * cover, and the result merged again until no merge is cheap. A full list
+ * takes the merge wasting the least however large, so the list stays
+ * bounded at the cost of updating some unaltered pixels.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+#include "libnsfb_plot_util.h"
+
+#include "nsfb.h"
+#include "plot.h"
+#include "dlist.h"
+#include "damage.h"
+#include "shadow.h"
+#include "surface.h"
+
+/* most rectangles held, each costing a surface update */
+#define DAMAGE_RECTS 16
+
+/* merges wasting fewer pixels than this are always taken, as the update of
+ * a small area costs more than its pixels
+ */
+#define DAMAGE_MIN_WASTE (32 * 32)
+
+struct nsfb_damage_s {
+    nsfb_bbox_t rect[DAMAGE_RECTS];
+    int rectc;
+};
+
+static inline int64_t damage_area(const nsfb_bbox_t *box)
+{
+    return (int64_t)(box->x1 - box->x0) * (box->y1 - box->y0);
+}
+
+static inline void
+damage_union(const nsfb_bbox_t *a, const nsfb_bbox_t *b, nsfb_bbox_t *result)
+{
+    result->x0 = (a->x0 < b->x0) ? a->x0 : b->x0;
+    result->y0 = (a->y0 < b->y0) ? a->y0 : b->y0;
+    result->x1 = (a->x1 > b->x1) ? a->x1 : b->x1;
+    result->y1 = (a->y1 > b->y1) ? a->y1 : b->y1;
+}
+
+static inline bool damage_contains(const nsfb_bbox_t *outer, const nsfb_bbox_t *inner)
+{
+    return (inner->x0 >= outer->x0) && (inner->y0 >= outer->y0) &&
+	(inner->x1 <= outer->x1) && (inner->y1 <= outer->y1);
+}
+
+/* area of the bounding box of two rectangles covered by neither */
+static int64_t damage_waste(const nsfb_bbox_t *a, const nsfb_bbox_t *b)
+{
+    nsfb_bbox_t both;
+    int64_t waste;
+
+    damage_union(a, b, &both);
+    waste = damage_area(&both) - damage_area(a) - damage_area(b);
+
+    /* overlapping rectangles count their overlap once */
+    both.x0 = (a->x0 > b->x0) ? a->x0 : b->x0;
+    both.y0 = (a->y0 > b->y0) ? a->y0 : b->y0;
+    both.x1 = (a->x1 < b->x1) ? a->x1 : b->x1;
+    both.y1 = (a->y1 < b->y1) ? a->y1 : b->y1;
+    if ((both.x0 < both.x1) && (both.y0 < both.y1))
+	waste += damage_area(&both);
+
+    return waste;
+}
+
+/* exported interface documented in damage.h */
+void nsfb_damage_destroy(nsfb_damage_t *damage)
+{
+    free(damage);
+}
+
+/* exported interface documented in damage.h */
+void nsfb_damage_clear(nsfb_damage_t *damage)
+{
+    damage->rectc = 0;
+}
+
+/* exported interface documented in damage.h */
+void nsfb_damage_add(nsfb_t *nsfb, const nsfb_bbox_t *extent)
+{
+    nsfb_damage_t *damage = nsfb->damage;
+    nsfb_bbox_t box = *extent;
+    int64_t waste;
+    int64_t best_waste;
+    int best;
+    int loop;
+
+    if (!nsfb_plot_clip_ctx(nsfb, &box) ||
+	(box.x0 >= box.x1) || (box.y0 >= box.y1))
+	return;
+
+    for (;;) {
+	best = -1;
+	best_waste = INT64_MAX;
+
+	for (loop = 0; loop < damage->rectc; loop++) {
+	    if (damage_contains(&damage->rect[loop], &box))
+		return;
+
+	    if (damage_contains(&box, &damage->rect[loop])) {
+		damage->rect[loop--] = damage->rect[--damage->rectc];
+		continue;
+	    }
+
+	    waste = damage_waste(&damage->rect[loop], &box);
+	    if (waste < best_waste) {
+		best_waste = waste;
+		best = loop;
+	    }
+	}
+
+	if (best < 0)
+	    break;
+
+	/* cheap merges are taken, and any merge when the list is full */
+	if ((best_waste > DAMAGE_MIN_WASTE) &&
+	    (4 * best_waste > damage_area(&box) + damage_area(&damage->rect[best])) &&
+	    (damage->rectc < DAMAGE_RECTS))
+	    break;
+
+	damage_union(&damage->rect[best], &box, &box);
+	damage->rect[best] = damage->rect[--damage->rectc];
+    }
+
+    damage->rect[damage->rectc++] = box;
+}
+
+/* exported interface documented in libnsfb.h */
+int nsfb_set_damage_tracking(nsfb_t *nsfb, bool track)
+{
+    if (!track) {
+	if (nsfb->damage != NULL) {
+	    nsfb_damage_destroy(nsfb->damage);
+	    nsfb->damage = NULL;
+	}
+	return 0;
+    }
+
+    if (nsfb->damage != NULL)
+	return 0;
+
+    nsfb->damage = calloc(1, sizeof(nsfb_damage_t));
+    if (nsfb->damage == NULL)
+	return -1;
+
+    return 0;
+}
+
+/* exported interface documented in libnsfb.h */
+int nsfb_get_damage(nsfb_t *nsfb, nsfb_bbox_t *box, int boxc)
+{
+    int loop;
+
+    if (nsfb->damage == NULL)
+	return 0;
+
+    for (loop = 0; (loop < boxc) && (loop < nsfb->damage->rectc); loop++)
+	box[loop] = nsfb->damage->rect[loop];
+
+    return nsfb->damage->rectc;
+}
+
+/* exported interface documented in libnsfb.h */
+int nsfb_update_damage(nsfb_t *nsfb)
+{
+    nsfb_damage_t *damage = nsfb->damage;
+    int ret = 0;
+    int loop;
+
+    if (damage == NULL)
+	return -1;
+
+    nsfb_dlist_sync(nsfb);
+
+    for (loop = 0; loop < damage->rectc; loop++) {
+	if (nsfb->shadow != NULL) {
+	    if (nsfb_shadow_update(nsfb, &damage->rect[loop]) != 0)
+		ret = -1;
+	} else if (nsfb->surface_rtns->update(nsfb, &damage->rect[loop]) != 0) {
+	    ret = -1;
+	}
+    }
+    nsfb_damage_clear(damage);
+
+    return ret;
+}
+
+/*
+ * Local variables:
+ *  c-basic-offset: 4
+ *  tab-width: 8
+ * End:
+ */
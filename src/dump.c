@@ -15,6 +15,8 @@
 #include "libnsfb_plot.h"
 #include "libnsfb_event.h"
 #include "nsfb.h"
+#include "plot.h"
+#include "dlist.h"
 #include "surface.h"
 
 /* exported interface documented in libnsfb.h */
@@ -25,6 +27,8 @@ nsfb_dump(nsfb_t *nsfb, int fd)
     int x;
     int y;
 
+    nsfb_dlist_sync(nsfb);
+
     outf = fdopen(dup(fd), "w");
     if (outf == NULL) {
 	    return false;
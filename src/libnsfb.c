@@ -15,7 +15,14 @@
 #include "libnsfb_plot.h"
 #include "libnsfb_event.h"
 #include "nsfb.h"
+#include "plot.h"
 #include "cursor.h"
+#include "bitmapcache.h"
+#include "workers.h"
+#include "dlist.h"
+#include "damage.h"
+#include "shadow.h"
+#include "region.h"
 #include "palette.h"
 #include "surface.h"
 
@@ -62,6 +69,25 @@ nsfb_free(nsfb_t *nsfb)
     if (nsfb->cursor != NULL)
 	nsfb_cursor_destroy(nsfb->cursor);
 
+    if (nsfb->bitmap_cache != NULL)
+	nsfb_bitmap_cache_destroy(nsfb->bitmap_cache);
+
+    /* a frame still being recorded is abandoned */
+    if (nsfb->dlist != NULL)
+	nsfb_dlist_destroy(nsfb->dlist);
+
+    if (nsfb->workers != NULL)
+	nsfb_workers_destroy(nsfb->workers);
+
+    if (nsfb->damage != NULL)
+	nsfb_damage_destroy(nsfb->damage);
+
+    if (nsfb->shadow != NULL)
+	nsfb_shadow_destroy(nsfb->shadow);
+
+    if (nsfb->region != NULL)
+	nsfb_region_destroy(nsfb->region);
+
     ret = nsfb->surface_rtns->finalise(nsfb);
 
     free(nsfb->surface_rtns);
@@ -81,6 +107,8 @@ nsfb_event(nsfb_t *nsfb, nsfb_event_t *event, int timeout)
 int 
 nsfb_claim(nsfb_t *nsfb, nsfb_bbox_t *box)
 {
+    nsfb_dlist_sync(nsfb);
+
     return nsfb->surface_rtns->claim(nsfb, box);
 }
 
@@ -88,6 +116,11 @@ nsfb_claim(nsfb_t *nsfb, nsfb_bbox_t *box)
 int 
 nsfb_update(nsfb_t *nsfb, nsfb_bbox_t *box)
 {
+    nsfb_dlist_sync(nsfb);
+
+    if (nsfb->shadow != NULL)
+	return nsfb_shadow_update(nsfb, box);
+
     return nsfb->surface_rtns->update(nsfb, box);
 }
 
@@ -95,6 +128,9 @@ nsfb_update(nsfb_t *nsfb, nsfb_bbox_t *box)
 int 
 nsfb_set_geometry(nsfb_t *nsfb, int width, int height, enum nsfb_format_e format) 
 {
+    nsfb_bbox_t screen;
+    int ret;
+
     if (width <= 0)
         width = nsfb->width;        
 
@@ -104,7 +140,20 @@ nsfb_set_geometry(nsfb_t *nsfb, int width, int height, enum nsfb_format_e format
     if (format == NSFB_FMT_ANY)
 	    format = nsfb->format; 
 
-    return nsfb->surface_rtns->geometry(nsfb, width, height, format);
+    nsfb_dlist_sync(nsfb);
+
+    ret = nsfb->surface_rtns->geometry(nsfb, width, height, format);
+
+    /* the whole of the new screen is damaged */
+    if ((ret == 0) && (nsfb->damage != NULL)) {
+	nsfb_damage_clear(nsfb->damage);
+	screen.x0 = screen.y0 = 0;
+	screen.x1 = nsfb->width;
+	screen.y1 = nsfb->height;
+	nsfb_damage_mark(nsfb, &screen);
+    }
+
+    return ret;
 }
 
 /* exported interface documented in libnsfb.h */
@@ -143,6 +192,9 @@ nsfb_get_geometry(nsfb_t *nsfb, int *width, int *height, enum nsfb_format_e *for
 int 
 nsfb_get_buffer(nsfb_t *nsfb, uint8_t **ptr, int *linelen) 
 {
+    /* the caller may read or write the buffer directly */
+    nsfb_dlist_sync(nsfb);
+
     if (ptr != NULL) {
 	*ptr = nsfb->ptr;
     }
@@ -17,6 +17,7 @@
 
 #include "nsfb.h"
 #include "plot.h"
+#include "kernel.h"
 
 #define UNUSED __attribute__((unused)) 
 
@@ -38,6 +39,9 @@ static inline uint16_t colour_to_pixel(UNUSED nsfb_t *nsfb, nsfb_colour_t c)
         return ((c & 0xF8) << 8) | ((c & 0xFC00 ) >> 5) | ((c & 0xF80000) >> 19);
 }
 
+/* row kernels for this pixel layout */
+#define PLOT_KERNEL_RGB565 1
+
 #define PLOT_TYPE uint16_t
 #define PLOT_LINELEN(ll) ((ll) >> 1)
 
@@ -46,77 +50,36 @@ static inline uint16_t colour_to_pixel(UNUSED nsfb_t *nsfb, nsfb_colour_t c)
 
 static bool fill(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c)
 {
-        int w;
-        uint16_t *pvid16;
-        uint16_t ent16;
-        uint32_t *pvid32;
-        uint32_t ent32;
-        uint32_t llen;
-        uint32_t width;
-        uint32_t height;
-
         if (!nsfb_plot_clip_ctx(nsfb, rect))
                 return true; /* fill lies outside current clipping region */
 
-        ent16 = colour_to_pixel(nsfb, c);
-        width = rect->x1 - rect->x0;
-        height = rect->y1 - rect->y0;
-
-        pvid16 = get_xy_loc(nsfb, rect->x0, rect->y0);
-
-        if (((rect->x0 & 1) == 0) && ((width & 1) == 0)) {
-                /* aligned to 32bit value and width is even */
-                width = width >> 1;
-                llen = (nsfb->linelen >> 2) - width;
-                ent32 = ent16 | (ent16 << 16);
-                pvid32 = (void *)pvid16;
-
-                while (height-- > 0) {
-                        w = width;
-                        while (w >= 16) {
-                                *pvid32++ = ent32; *pvid32++ = ent32;
-                                *pvid32++ = ent32; *pvid32++ = ent32;
-                                *pvid32++ = ent32; *pvid32++ = ent32;
-                                *pvid32++ = ent32; *pvid32++ = ent32;
-                                *pvid32++ = ent32; *pvid32++ = ent32;
-                                *pvid32++ = ent32; *pvid32++ = ent32;
-                                *pvid32++ = ent32; *pvid32++ = ent32;
-                                *pvid32++ = ent32; *pvid32++ = ent32;
-                                w-=16;
-                        }
-                        while (w >= 4) {
-                                *pvid32++ = ent32; *pvid32++ = ent32;
-                                *pvid32++ = ent32; *pvid32++ = ent32;
-                                w-=4;
-                        }
-                        while (w > 0) {
-                                *pvid32++ = ent32;
-                                w--;
-                        }
-                        // for (w = width; w > 0; w--) *pvid32++ = ent32;
-                        pvid32 += llen;
-                }
-
-        } else {
-                llen = (nsfb->linelen >> 1) - width;
-
-
-                while (height-- > 0) {
-                        for (w = width; w > 0; w--) *pvid16++ = ent16;
-                        pvid16 += llen;
-                }
-        }
+        nsfb->kernel_fns->fill16(get_xy_loc(nsfb, rect->x0, rect->y0),
+                                 nsfb->linelen >> 1,
+                                 rect->x1 - rect->x0,
+                                 rect->y1 - rect->y0,
+                                 colour_to_pixel(nsfb, c));
+
         return true;
 }
 
 const nsfb_plotter_fns_t _nsfb_16bpp_plotters = {
         .line = line,
         .fill = fill,
+        .fill_op = fill_op,
+        .fill_rects = fill_rects,
         .point = point,
+        .arc = arc,
         .bitmap = bitmap,
+        .bitmap_op = bitmap_op,
         .bitmap_tiles = bitmap_tiles,
         .glyph8 = glyph8,
         .glyph1 = glyph1,
+        .glyph_run = glyph_run,
+        .convert = convert,
+        .blend = blend,
+        .spans = spans,
+        .coverage = coverage,
+        .span_list = span_list,
         .readrect = readrect,
 };
 
@@ -17,6 +17,7 @@
 
 #include "nsfb.h"
 #include "plot.h"
+#include "kernel.h"
 
 
 #define UNUSED __attribute__((unused)) 
@@ -50,6 +51,9 @@ static inline uint32_t colour_to_pixel(UNUSED nsfb_t *nsfb, nsfb_colour_t c)
 {
         return ((c & 0xff0000) >> 16) | (c & 0xff00) | ((c & 0xff) << 16);
 }
+
+/* row kernels for this pixel layout */
+#define PLOT_KERNEL_FMT32 NSFB_KERNEL_XRGB8888
 #endif
 
 #define PLOT_TYPE uint32_t
@@ -60,11 +64,21 @@ static inline uint32_t colour_to_pixel(UNUSED nsfb_t *nsfb, nsfb_colour_t c)
 const nsfb_plotter_fns_t _nsfb_32bpp_xrgb8888_plotters = {
         .line = line,
         .fill = fill,
+        .fill_op = fill_op,
+        .fill_rects = fill_rects,
         .point = point,
+        .arc = arc,
         .bitmap = bitmap,
+        .bitmap_op = bitmap_op,
         .bitmap_tiles = bitmap_tiles,
         .glyph8 = glyph8,
         .glyph1 = glyph1,
+        .glyph_run = glyph_run,
+        .convert = convert,
+        .blend = blend,
+        .spans = spans,
+        .coverage = coverage,
+        .span_list = span_list,
         .readrect = readrect,
 };
 
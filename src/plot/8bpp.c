@@ -19,6 +19,7 @@
 #include "nsfb.h"
 #include "palette.h"
 #include "plot.h"
+#include "kernel.h"
 
 static inline uint8_t *get_xy_loc(nsfb_t *nsfb, int x, int y)
 {
@@ -71,11 +72,21 @@ static bool fill(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c)
 const nsfb_plotter_fns_t _nsfb_8bpp_plotters = {
         .line = line,
         .fill = fill,
+        .fill_op = fill_op,
+        .fill_rects = fill_rects,
         .point = point,
+        .arc = arc,
         .bitmap = bitmap,
+        .bitmap_op = bitmap_op,
         .bitmap_tiles = bitmap_tiles,
         .glyph8 = glyph8,
         .glyph1 = glyph1,
+        .glyph_run = glyph_run,
+        .convert = convert,
+        .blend = blend,
+        .spans = spans,
+        .coverage = coverage,
+        .span_list = span_list,
         .readrect = readrect,
 };
 
@@ -1,12 +1,601 @@
 /* public plotter interface */
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 
 #include "libnsfb.h"
 #include "libnsfb_plot.h"
+#include "libnsfb_plot_util.h"
 
 #include "nsfb.h"
 #include "plot.h"
+#include "kernel.h"
+#include "workers.h"
+#include "dlist.h"
+#include "damage.h"
+#include "region.h"
+
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define SIGN(x)  ((x<0) ?  -1  :  ((x>0) ? 1 : 0))
+
+/* the row segments of thin lines are gathered this many at a time for
+ * each rectangle of a clipping region, and copied to the stack as the line
+ * plotter clips them in place
+ */
+#define REGION_LINE_CHUNK 64
+
+/* row segments of thin lines to be plotted under a clipping region */
+struct region_runs {
+    nsfb_plot_pen_t pen; /* solid pen the segments are plotted with */
+    nsfb_bbox_t run[REGION_LINE_CHUNK];
+    int runc;
+    bool ret;
+};
+
+/* parameters of the operations split into bands by the workers */
+struct fill_job {
+    nsfb_bbox_t rect;
+    nsfb_colour_t c;
+    nsfb_plot_op_t op;
+};
+
+struct fill_rects_job {
+    int rectc;
+    const nsfb_bbox_t *rect;
+    const nsfb_colour_t *colour;
+};
+
+struct polygon_job {
+    const int *p;
+    unsigned int n;
+    nsfb_colour_t fill;
+    nsfb_plot_fill_rule_t rule;
+};
+
+struct bitmap_job {
+    nsfb_bbox_t loc;
+    const nsfb_colour_t *pixel;
+    int bmp_width;
+    int bmp_height;
+    int bmp_stride;
+    unsigned int flags;
+    nsfb_plot_op_t op;
+};
+
+/* area covered by a list of points, the last row and column inclusive */
+static void
+points_extent(const nsfb_point_t *point, int pointc, nsfb_bbox_t *extent)
+{
+    int loop;
+
+    extent->x0 = extent->x1 = point[0].x;
+    extent->y0 = extent->y1 = point[0].y;
+    for (loop = 1; loop < pointc; loop++) {
+	extent->x0 = MIN(extent->x0, point[loop].x);
+	extent->y0 = MIN(extent->y0, point[loop].y);
+	extent->x1 = MAX(extent->x1, point[loop].x);
+	extent->y1 = MAX(extent->y1, point[loop].y);
+    }
+    extent->x1++;
+    extent->y1++;
+}
+
+/* grow an area by a margin on every side */
+static inline void extent_grow(nsfb_bbox_t *extent, int margin)
+{
+    extent->x0 -= margin;
+    extent->y0 -= margin;
+    extent->x1 += margin;
+    extent->y1 += margin;
+}
+
+/* area of a rectangle given with its corners either way round */
+static inline void box_extent(const nsfb_bbox_t *box, nsfb_bbox_t *extent)
+{
+    extent->x0 = MIN(box->x0, box->x1);
+    extent->y0 = MIN(box->y0, box->y1);
+    extent->x1 = MAX(box->x0, box->x1);
+    extent->y1 = MAX(box->y0, box->y1);
+}
+
+/* area a stroke through points may reach.
+ *
+ * Wide strokes reach half their width beyond the points, and mitred
+ * corners up to twice the width.
+ */
+static void
+stroke_extent(const nsfb_point_t *point, int pointc, const nsfb_plot_pen_t *pen, nsfb_bbox_t *extent)
+{
+    points_extent(point, pointc, extent);
+    extent_grow(extent, (pen->stroke_width > 1) ? 2 * pen->stroke_width : 1);
+}
+
+/* area a path, filled or stroked, may reach */
+static void
+path_extent(int pathc, const nsfb_plot_pathop_t *pathop, const nsfb_plot_pen_t *pen, int shift, nsfb_bbox_t *extent)
+{
+    int loop;
+
+    extent->x0 = extent->x1 = pathop[0].point.x;
+    extent->y0 = extent->y1 = pathop[0].point.y;
+    for (loop = 1; loop < pathc; loop++) {
+	extent->x0 = MIN(extent->x0, pathop[loop].point.x);
+	extent->y0 = MIN(extent->y0, pathop[loop].point.y);
+	extent->x1 = MAX(extent->x1, pathop[loop].point.x);
+	extent->y1 = MAX(extent->y1, pathop[loop].point.y);
+    }
+    extent->x0 >>= shift;
+    extent->y0 >>= shift;
+    extent->x1 = (extent->x1 >> shift) + 1;
+    extent->y1 = (extent->y1 >> shift) + 1;
+    extent_grow(extent, (pen->stroke_width > 1) ? 2 * pen->stroke_width : 1);
+}
+
+/* area around a circle */
+static void
+circle_extent(int x, int y, int radius, int margin, nsfb_bbox_t *extent)
+{
+    extent->x0 = x - radius;
+    extent->y0 = y - radius;
+    extent->x1 = x + radius + 1;
+    extent->y1 = y + radius + 1;
+    extent_grow(extent, margin);
+}
+
+/* area around an ellipse's bounding box */
+static void ellipse_extent(const nsfb_bbox_t *ellipse, nsfb_bbox_t *extent)
+{
+    box_extent(ellipse, extent);
+    extent_grow(extent, 2);
+}
+
+/* area of a rectangle outline */
+static void
+rectangle_extent(const nsfb_bbox_t *rect, int line_width, nsfb_bbox_t *extent)
+{
+    box_extent(rect, extent);
+    extent->x1++;
+    extent->y1++;
+    extent_grow(extent, MAX(line_width, 1));
+}
+
+/* area of a list of spans */
+static bool
+spans_extent(int spanc, const nsfb_plot_span_t *span, nsfb_bbox_t *extent)
+{
+    int loop;
+
+    extent->x0 = extent->y0 = INT_MAX;
+    extent->x1 = extent->y1 = INT_MIN;
+    for (loop = 0; loop < spanc; loop++) {
+	if (span[loop].x0 >= span[loop].x1)
+	    continue;
+	extent->x0 = MIN(extent->x0, span[loop].x0);
+	extent->y0 = MIN(extent->y0, span[loop].y);
+	extent->x1 = MAX(extent->x1, span[loop].x1);
+	extent->y1 = MAX(extent->y1, span[loop].y + 1);
+    }
+
+    return extent->x0 < extent->x1;
+}
+
+/* area of a run of glyphs */
+static void
+glyph_run_extent(const nsfb_plot_glyph_t *glyphs, int glyphc, nsfb_bbox_t *extent)
+{
+    int loop;
+
+    extent->x0 = extent->y0 = INT_MAX;
+    extent->x1 = extent->y1 = INT_MIN;
+    for (loop = 0; loop < glyphc; loop++) {
+	extent->x0 = MIN(extent->x0, glyphs[loop].loc.x0);
+	extent->y0 = MIN(extent->y0, glyphs[loop].loc.y0);
+	extent->x1 = MAX(extent->x1, glyphs[loop].loc.x1);
+	extent->y1 = MAX(extent->y1, glyphs[loop].loc.y1);
+    }
+}
+
+/* mark the area a stroke through points may reach as damaged */
+static void
+stroke_damage(nsfb_t *nsfb, const nsfb_point_t *point, int pointc, const nsfb_plot_pen_t *pen)
+{
+    nsfb_bbox_t extent;
+
+    if ((nsfb->damage == NULL) || (pointc <= 0))
+	return;
+
+    stroke_extent(point, pointc, pen, &extent);
+    nsfb_damage_add(nsfb, &extent);
+}
+
+/* mark the area a path, filled or stroked, may reach as damaged */
+static void
+path_damage(nsfb_t *nsfb, int pathc, const nsfb_plot_pathop_t *pathop, const nsfb_plot_pen_t *pen, int shift)
+{
+    nsfb_bbox_t extent;
+
+    if ((nsfb->damage == NULL) || (pathc <= 0))
+	return;
+
+    path_extent(pathc, pathop, pen, shift, &extent);
+    nsfb_damage_add(nsfb, &extent);
+}
+
+/* mark the area around a circle as damaged */
+static void circle_damage(nsfb_t *nsfb, int x, int y, int radius, int margin)
+{
+    nsfb_bbox_t extent;
+
+    circle_extent(x, y, radius, margin, &extent);
+    nsfb_damage_mark(nsfb, &extent);
+}
+
+/* mark the area around an ellipse's bounding box as damaged */
+static void ellipse_damage(nsfb_t *nsfb, const nsfb_bbox_t *ellipse)
+{
+    nsfb_bbox_t extent;
+
+    if (nsfb->damage == NULL)
+	return;
+
+    ellipse_extent(ellipse, &extent);
+    nsfb_damage_add(nsfb, &extent);
+}
+
+/* plot the gathered row segments once for each rectangle of the region.
+ *
+ * The segments are horizontal, so each rectangle only limits the rows and
+ * columns written.
+ */
+static void region_runs_flush(nsfb_t *nsfb, struct region_runs *runs)
+{
+    nsfb_bbox_t chunk[REGION_LINE_CHUNK];
+    nsfb_bbox_t extent;
+    int loop;
+
+    if (runs->runc == 0)
+	return;
+
+    extent = runs->run[0];
+    for (loop = 1; loop < runs->runc; loop++) {
+	extent.x0 = MIN(extent.x0, runs->run[loop].x0);
+	extent.y0 = MIN(extent.y0, runs->run[loop].y0);
+	extent.x1 = MAX(extent.x1, runs->run[loop].x1);
+	extent.y1 = MAX(extent.y1, runs->run[loop].y1);
+    }
+    extent.y1++;
+
+    nsfb_region_start(nsfb, &extent);
+    while (nsfb_region_next(nsfb)) {
+	memcpy(chunk, runs->run, runs->runc * sizeof(nsfb_bbox_t));
+	runs->ret = nsfb_plot_lines(nsfb, runs->runc, chunk, &runs->pen) && runs->ret;
+    }
+    runs->runc = 0;
+}
+
+/* add a pixel to the row segments, joining it to the last if it follows */
+static void
+region_runs_pixel(nsfb_t *nsfb, struct region_runs *runs, int x, int y)
+{
+    nsfb_bbox_t *run;
+
+    if (runs->runc > 0) {
+	run = &runs->run[runs->runc - 1];
+	if ((run->y0 == y) && (run->x1 == x)) {
+	    run->x1++;
+	    return;
+	}
+    }
+
+    if (runs->runc == REGION_LINE_CHUNK)
+	region_runs_flush(nsfb, runs);
+
+    run = &runs->run[runs->runc++];
+    run->x0 = x;
+    run->y0 = run->y1 = y;
+    run->x1 = x + 1;
+}
+
+/* gather the pixels the line plotter stores for a thin line.
+ *
+ * The line is clipped once to the bounding box of the region, as it would
+ * be without the region, and stepped just as the plotter steps it so the
+ * pixels are the same whichever rectangles they fall in.
+ */
+static void
+region_line_runs(nsfb_t *nsfb, struct region_runs *runs, const nsfb_bbox_t *unclipped, uint32_t pattern)
+{
+    nsfb_bbox_t line = *unclipped;
+    int x, y, i;
+    int px, py;
+    int dx, dy, sdy;
+    int dxabs, dyabs;
+    int phase;
+
+    if (line.y0 == line.y1) {
+	if (!nsfb_plot_clip_ctx(nsfb, &line))
+	    return;
+
+	phase = line.x0 - unclipped->x0;
+	for (i = 0; i < line.x1 - line.x0; i++) {
+	    if (pattern & (1u << ((phase + i) & 31)))
+		region_runs_pixel(nsfb, runs, line.x0 + i, line.y0);
+	}
+	return;
+    }
+
+    if (!nsfb_plot_clip_line_ctx(nsfb, &line))
+	return;
+
+    dx = line.x1 - line.x0;
+    dxabs = abs(dx);
+    dy = line.y1 - line.y0;
+    dyabs = abs(dy);
+    sdy = dx ? SIGN(dy) * SIGN(dx) : SIGN(dy);
+
+    if (dx >= 0) {
+	px = line.x0;
+	py = line.y0;
+	phase = (dxabs >= dyabs) ?
+	    line.x0 - unclipped->x0 : line.y0 - unclipped->y0;
+    } else {
+	px = line.x1;
+	py = line.y1;
+	phase = (dxabs >= dyabs) ?
+	    line.x1 - unclipped->x1 : line.y1 - unclipped->y1;
+    }
+    phase = abs(phase);
+
+    x = dyabs >> 1;
+    y = dxabs >> 1;
+
+    if (dxabs >= dyabs) {
+	for (i = 0; i < dxabs; i++) {
+	    if (pattern & (1u << ((phase + i) & 31)))
+		region_runs_pixel(nsfb, runs, px, py);
+
+	    px++;
+	    y += dyabs;
+	    if (y >= dxabs) {
+		y -= dxabs;
+		py += sdy;
+	    }
+	}
+    } else {
+	for (i = 0; i < dyabs; i++) {
+	    if (pattern & (1u << ((phase + i) & 31)))
+		region_runs_pixel(nsfb, runs, px, py);
+
+	    py += sdy;
+	    x += dxabs;
+	    if (x >= dyabs) {
+		x -= dyabs;
+		px++;
+	    }
+	}
+    }
+}
+
+/* plot lines under a clipping region of more than one rectangle */
+static bool
+region_lines(nsfb_t *nsfb, int linec, nsfb_bbox_t *line, nsfb_plot_pen_t *pen)
+{
+    struct region_runs runs;
+    nsfb_bbox_t extent;
+    nsfb_bbox_t copy;
+    bool ret = true;
+    int loop;
+
+    if (linec <= 0)
+	return true;
+
+    /* wide and anti-aliased lines are left alone, and are plotted
+     * together as overlaps must not be blended twice
+     */
+    if ((pen->stroke_width > 1) ||
+	(pen->stroke_type == NFSB_PLOT_OPTYPE_SOLID_AA)) {
+	/* the ends of a line are a pair of points */
+	stroke_extent((const nsfb_point_t *)(const void *)line, 2 * linec, pen, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb))
+	    ret = nsfb_plot_lines(nsfb, linec, line, pen) && ret;
+	return ret;
+    }
+
+    /* clipping a thin line to each rectangle would move its ends and so
+     * the pixels between them. A line inside the region is plotted whole,
+     * others are broken into the row segments the plotter would store.
+     */
+    runs.pen = *pen;
+    runs.pen.stroke_type = NFSB_PLOT_OPTYPE_SOLID;
+    runs.runc = 0;
+    runs.ret = true;
+
+    for (loop = 0; loop < linec; loop++) {
+	extent.x0 = MIN(line[loop].x0, line[loop].x1);
+	extent.y0 = MIN(line[loop].y0, line[loop].y1);
+	extent.x1 = MAX(line[loop].x0, line[loop].x1) + 1;
+	extent.y1 = MAX(line[loop].y0, line[loop].y1) + 1;
+
+	if (nsfb_region_start_inside(nsfb, &extent)) {
+	    while (nsfb_region_next(nsfb)) {
+		copy = line[loop];
+		ret = nsfb_plot_lines(nsfb, 1, &copy, pen) && ret;
+	    }
+	    continue;
+	}
+
+	region_line_runs(nsfb, &runs, &line[loop],
+			 (pen->stroke_type == NFSB_PLOT_OPTYPE_PATTERN) ?
+			 pen->stroke_pattern : 0xFFFFFFFF);
+    }
+    region_runs_flush(nsfb, &runs);
+
+    return runs.ret && ret;
+}
+
+static bool clg_band(nsfb_t *band, void *ctx)
+{
+    return band->plotter_fns->clg(band, *(nsfb_colour_t *)ctx);
+}
+
+static bool fill_band(nsfb_t *band, void *ctx)
+{
+    struct fill_job *job = ctx;
+    nsfb_bbox_t rect = job->rect;
+
+    return band->plotter_fns->fill_op(band, &rect, job->c, job->op);
+}
+
+static bool fill_rects_band(nsfb_t *band, void *ctx)
+{
+    struct fill_rects_job *job = ctx;
+
+    return band->plotter_fns->fill_rects(band, job->rectc, job->rect, job->colour);
+}
+
+static bool polygon_band(nsfb_t *band, void *ctx)
+{
+    struct polygon_job *job = ctx;
+
+    return band->plotter_fns->polygon(band, job->p, job->n, job->fill, job->rule);
+}
+
+static bool bitmap_band(nsfb_t *band, void *ctx)
+{
+    struct bitmap_job *job = ctx;
+
+    return band->plotter_fns->bitmap_op(band, &job->loc, job->pixel,
+					job->bmp_width, job->bmp_height,
+					job->bmp_stride, job->flags, job->op);
+}
+
+/* plot a rectangle fill, in bands when it is large enough */
+static bool
+fill_op(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c, nsfb_plot_op_t op)
+{
+    struct fill_job job;
+    nsfb_bbox_t extent;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	box_extent(rect, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb)) {
+	    /* the rectangle is clipped in place */
+	    job.rect = *rect;
+	    ret = fill_op(nsfb, &job.rect, c, op) && ret;
+	}
+	return ret;
+    }
+
+    nsfb_damage_mark(nsfb, rect);
+
+    if ((nsfb->dlist != NULL) && nsfb_dlist_fill(nsfb, rect, c, op))
+	return true;
+
+    if (!nsfb_workers_want(nsfb, rect))
+	return nsfb->plotter_fns->fill_op(nsfb, rect, c, op);
+
+    job.rect = *rect;
+    job.c = c;
+    job.op = op;
+
+    /* the rectangle is clipped in place as the plotter would */
+    nsfb_plot_clip_ctx(nsfb, rect);
+
+    return nsfb_workers_run(nsfb, &job.rect, fill_band, &job);
+}
+
+/* plot a polygon, in bands when it is large enough */
+static bool
+polygon(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t fill, nsfb_plot_fill_rule_t rule)
+{
+    struct polygon_job job;
+    nsfb_bbox_t extent;
+    bool ret = true;
+
+    if (n == 0)
+	return nsfb->plotter_fns->polygon(nsfb, p, n, fill, rule);
+
+    /* the vertices are pairs of coordinates as points are */
+    points_extent((const nsfb_point_t *)(const void *)p, n, &extent);
+
+    if (nsfb_region_active(nsfb)) {
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb))
+	    ret = polygon(nsfb, p, n, fill, rule) && ret;
+	return ret;
+    }
+
+    nsfb_damage_mark(nsfb, &extent);
+
+    if ((nsfb->dlist != NULL) && nsfb_dlist_polygon(nsfb, p, n, fill, rule))
+	return true;
+
+    if (!nsfb_workers_want(nsfb, &extent))
+	return nsfb->plotter_fns->polygon(nsfb, p, n, fill, rule);
+
+    job.p = p;
+    job.n = n;
+    job.fill = fill;
+    job.rule = rule;
+
+    return nsfb_workers_run(nsfb, &extent, polygon_band, &job);
+}
+
+/* plot a bitmap, in bands when it is large enough */
+static bool
+bitmap(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, unsigned int flags, nsfb_plot_op_t op)
+{
+    struct bitmap_job job;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	nsfb_region_start(nsfb, loc);
+	while (nsfb_region_next(nsfb))
+	    ret = bitmap(nsfb, loc, pixel, bmp_width, bmp_height, bmp_stride, flags, op) && ret;
+	return ret;
+    }
+
+    nsfb_damage_mark(nsfb, loc);
+
+    if ((nsfb->dlist != NULL) &&
+	nsfb_dlist_bitmap(nsfb, loc, pixel, bmp_width, bmp_height, bmp_stride, flags, op))
+	return true;
+
+    if (!nsfb_workers_want(nsfb, loc))
+	return nsfb->plotter_fns->bitmap_op(nsfb, loc, pixel, bmp_width, bmp_height, bmp_stride, flags, op);
+
+    job.loc = *loc;
+    job.pixel = pixel;
+    job.bmp_width = bmp_width;
+    job.bmp_height = bmp_height;
+    job.bmp_stride = bmp_stride;
+    job.flags = flags;
+    job.op = op;
+
+    return nsfb_workers_run(nsfb, loc, bitmap_band, &job);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_set_simd(nsfb_t *nsfb, enum nsfb_plot_simd_e simd)
+{
+    const nsfb_kernel_fns_t *kernel_fns;
+
+    kernel_fns = nsfb_kernel_select(simd);
+    if (kernel_fns == NULL)
+	return false;
+
+    nsfb->simd = simd;
+    nsfb->kernel_fns = kernel_fns;
+
+    return true;
+}
 
 /** Sets a clip rectangle for subsequent plots.
  *
@@ -16,10 +605,19 @@
  */
 bool nsfb_plot_set_clip(nsfb_t *nsfb, nsfb_bbox_t *clip)
 {
-    return nsfb->plotter_fns->set_clip(nsfb, clip);
+    if (!nsfb->plotter_fns->set_clip(nsfb, clip))
+	return false;
+
+    /* a rectangle replaces any clipping region */
+    if (nsfb->region != NULL)
+	nsfb_region_reset(nsfb);
+
+    return true;
 }
 
 /** Get the previously set clipping region.
+ *
+ * For a region of several rectangles this is their bounding box.
  */
 bool nsfb_plot_get_clip(nsfb_t *nsfb, nsfb_bbox_t *clip)
 {
@@ -30,6 +628,23 @@ bool nsfb_plot_get_clip(nsfb_t *nsfb, nsfb_bbox_t *clip)
  */
 bool nsfb_plot_clg(nsfb_t *nsfb, nsfb_colour_t c)
 {
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	nsfb_region_start(nsfb, &nsfb->clip);
+	while (nsfb_region_next(nsfb))
+	    ret = nsfb_plot_clg(nsfb, c) && ret;
+	return ret;
+    }
+
+    nsfb_damage_mark(nsfb, &nsfb->clip);
+
+    if ((nsfb->dlist != NULL) && nsfb_dlist_clg(nsfb, c))
+	return true;
+
+    if (nsfb_workers_want(nsfb, &nsfb->clip))
+	return nsfb_workers_run(nsfb, &nsfb->clip, clg_band, &c);
+
     return nsfb->plotter_fns->clg(nsfb, c);
 }
 
@@ -46,6 +661,29 @@ nsfb_plot_rectangle(nsfb_t *nsfb,
                     bool dotted, 
                     bool dashed)
 {
+    nsfb_bbox_t extent;
+    nsfb_bbox_t copy;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	rectangle_extent(rect, line_width, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb)) {
+	    copy = *rect;
+	    ret = nsfb_plot_rectangle(nsfb, &copy, line_width, c, dotted, dashed) && ret;
+	}
+	return ret;
+    }
+
+    if (nsfb->damage != NULL) {
+	rectangle_extent(rect, line_width, &extent);
+	nsfb_damage_add(nsfb, &extent);
+    }
+
+    if ((nsfb->dlist != NULL) &&
+	nsfb_dlist_rectangle(nsfb, rect, line_width, c, dotted, dashed))
+	return true;
+
     return nsfb->plotter_fns->rectangle(nsfb, rect, line_width, c, dotted, dashed);
 
 }
@@ -56,7 +694,92 @@ nsfb_plot_rectangle(nsfb_t *nsfb,
  */
 bool nsfb_plot_rectangle_fill(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c)
 {
-    return nsfb->plotter_fns->fill(nsfb, rect, c);
+    return fill_op(nsfb, rect, c, NSFB_PLOT_OP_OVER);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_rectangle_fill_op(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c, nsfb_plot_op_t op)
+{
+    return fill_op(nsfb, rect, c, op);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_fill_rects(nsfb_t *nsfb, int rectc, const nsfb_bbox_t *rect, const nsfb_colour_t *colour)
+{
+    struct fill_rects_job job;
+    nsfb_bbox_t extent;
+    bool ret = true;
+    int loop;
+
+    if (((nsfb->workers == NULL) && (nsfb->damage == NULL) &&
+	 !nsfb_region_active(nsfb)) || (rectc <= 0)) {
+	if ((nsfb->dlist != NULL) && nsfb_dlist_fill_rects(nsfb, rectc, rect, colour))
+	    return true;
+	return nsfb->plotter_fns->fill_rects(nsfb, rectc, rect, colour);
+    }
+
+    extent.x0 = extent.y0 = INT_MAX;
+    extent.x1 = extent.y1 = INT_MIN;
+    for (loop = 0; loop < rectc; loop++) {
+	extent.x0 = MIN(extent.x0, MIN(rect[loop].x0, rect[loop].x1));
+	extent.y0 = MIN(extent.y0, MIN(rect[loop].y0, rect[loop].y1));
+	extent.x1 = MAX(extent.x1, MAX(rect[loop].x0, rect[loop].x1));
+	extent.y1 = MAX(extent.y1, MAX(rect[loop].y0, rect[loop].y1));
+    }
+
+    if (nsfb_region_active(nsfb)) {
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb))
+	    ret = nsfb_plot_fill_rects(nsfb, rectc, rect, colour) && ret;
+	return ret;
+    }
+
+    nsfb_damage_mark(nsfb, &extent);
+
+    if ((nsfb->dlist != NULL) && nsfb_dlist_fill_rects(nsfb, rectc, rect, colour))
+	return true;
+
+    if (!nsfb_workers_want(nsfb, &extent))
+	return nsfb->plotter_fns->fill_rects(nsfb, rectc, rect, colour);
+
+    job.rectc = rectc;
+    job.rect = rect;
+    job.colour = colour;
+
+    return nsfb_workers_run(nsfb, &extent, fill_rects_band, &job);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_spans(nsfb_t *nsfb, int spanc, const nsfb_plot_span_t *span, nsfb_colour_t c)
+{
+    nsfb_bbox_t extent;
+    bool ret = true;
+    int loop;
+
+    if (nsfb_region_active(nsfb)) {
+	if (!spans_extent(spanc, span, &extent))
+	    return true;
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb))
+	    ret = nsfb_plot_spans(nsfb, spanc, span, c) && ret;
+	return ret;
+    }
+
+    if (nsfb->damage != NULL) {
+	for (loop = 0; loop < spanc; loop++) {
+	    extent.x0 = span[loop].x0;
+	    extent.y0 = span[loop].y;
+	    extent.x1 = span[loop].x1;
+	    extent.y1 = span[loop].y + 1;
+	    if (extent.x0 < extent.x1)
+		nsfb_damage_add(nsfb, &extent);
+	}
+    }
+
+    if ((nsfb->dlist != NULL) && nsfb_dlist_spans(nsfb, spanc, span, c))
+	return true;
+
+    return nsfb->plotter_fns->span_list(nsfb, spanc, span, c);
 }
 
 /** Plots a line.
@@ -66,6 +789,15 @@ bool nsfb_plot_rectangle_fill(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c)
  */
 bool nsfb_plot_line(nsfb_t *nsfb, nsfb_bbox_t *line, nsfb_plot_pen_t *pen)
 {
+	if (nsfb_region_active(nsfb))
+		return region_lines(nsfb, 1, line, pen);
+
+	/* the ends of a line are a pair of points */
+	stroke_damage(nsfb, (const nsfb_point_t *)(void *)line, 2, pen);
+
+	if ((nsfb->dlist != NULL) && nsfb_dlist_lines(nsfb, 1, line, pen))
+		return true;
+
 	return nsfb->plotter_fns->line(nsfb, 1, line, pen);
 }
 
@@ -76,25 +808,53 @@ bool nsfb_plot_line(nsfb_t *nsfb, nsfb_bbox_t *line, nsfb_plot_pen_t *pen)
  */
 bool nsfb_plot_lines(nsfb_t *nsfb, int linec, nsfb_bbox_t *line, nsfb_plot_pen_t *pen)
 {
+	if (nsfb_region_active(nsfb))
+		return region_lines(nsfb, linec, line, pen);
+
+	stroke_damage(nsfb, (const nsfb_point_t *)(void *)line, 2 * linec, pen);
+
+	if ((nsfb->dlist != NULL) && nsfb_dlist_lines(nsfb, linec, line, pen))
+		return true;
+
 	return nsfb->plotter_fns->line(nsfb, linec, line, pen);
 }
 
 bool nsfb_plot_polylines(nsfb_t *nsfb, int pointc, const nsfb_point_t *points, nsfb_plot_pen_t *pen)
 {
+	nsfb_bbox_t extent;
+	bool ret = true;
+
+	if (nsfb_region_active(nsfb) && (pointc > 0)) {
+		stroke_extent(points, pointc, pen, &extent);
+		nsfb_region_start(nsfb, &extent);
+		while (nsfb_region_next(nsfb))
+			ret = nsfb_plot_polylines(nsfb, pointc, points, pen) && ret;
+		return ret;
+	}
+
+	stroke_damage(nsfb, points, pointc, pen);
+
+	if ((nsfb->dlist != NULL) && nsfb_dlist_polylines(nsfb, pointc, points, pen))
+		return true;
+
 	return nsfb->plotter_fns->polylines(nsfb, pointc, points, pen);
 }
 
 /** Plots a filled polygon. 
  *
  * Plots a filled polygon with straight lines between points. The lines around
- * the edge of the ploygon are not plotted. The polygon is filled with a
- * non-zero winding rule.
- *
- *
+ * the edge of the ploygon are not plotted. The polygon is filled with the
+ * even-odd rule.
  */
 bool nsfb_plot_polygon(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t fill)
 {
-    return nsfb->plotter_fns->polygon(nsfb, p, n, fill);
+    return polygon(nsfb, p, n, fill, NSFB_PLOT_FILL_EVENODD);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_polygon_rule(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t fill, nsfb_plot_fill_rule_t rule)
+{
+    return polygon(nsfb, p, n, fill, rule);
 }
 
 /** Plots an arc.
@@ -104,28 +864,176 @@ bool nsfb_plot_polygon(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t
  */
 bool nsfb_plot_arc(nsfb_t *nsfb, int x, int y, int radius, int angle1, int angle2, nsfb_colour_t c)
 {
+    nsfb_bbox_t extent;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	circle_extent(x, y, radius, 1, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb))
+	    ret = nsfb_plot_arc(nsfb, x, y, radius, angle1, angle2, c) && ret;
+	return ret;
+    }
+
+    circle_damage(nsfb, x, y, radius, 1);
+
+    if ((nsfb->dlist != NULL) &&
+	nsfb_dlist_arc(nsfb, x, y, radius, angle1, angle2, c))
+	return true;
+
     return nsfb->plotter_fns->arc(nsfb, x, y, radius, angle1, angle2, c);
 }
 
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_arc_pen(nsfb_t *nsfb, int x, int y, int radius, int angle1, int angle2, nsfb_plot_pen_t *pen)
+{
+    nsfb_bbox_t extent;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	circle_extent(x, y, radius,
+		      (pen->stroke_width > 1) ? 2 * pen->stroke_width : 1, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb))
+	    ret = nsfb_plot_arc_pen(nsfb, x, y, radius, angle1, angle2, pen) && ret;
+	return ret;
+    }
+
+    circle_damage(nsfb, x, y, radius,
+		  (pen->stroke_width > 1) ? 2 * pen->stroke_width : 1);
+
+    nsfb_dlist_sync(nsfb);
+
+    return nsfb->plotter_fns->arc_pen(nsfb, x, y, radius, angle1, angle2, pen);
+}
+
 /** Plots an alpha blended pixel.
  *
  * plots an alpha blended pixel.
  */
 bool nsfb_plot_point(nsfb_t *nsfb, int x, int y, nsfb_colour_t c)
 {
+    nsfb_bbox_t extent;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	circle_extent(x, y, 0, 0, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb))
+	    ret = nsfb_plot_point(nsfb, x, y, c) && ret;
+	return ret;
+    }
+
+    circle_damage(nsfb, x, y, 0, 0);
+
+    if ((nsfb->dlist != NULL) && nsfb_dlist_point(nsfb, x, y, c))
+	return true;
+
     return nsfb->plotter_fns->point(nsfb, x, y, c);
 }
 
 bool nsfb_plot_ellipse(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c)
 {
+    nsfb_bbox_t extent;
+    nsfb_bbox_t copy;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	ellipse_extent(ellipse, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb)) {
+	    copy = *ellipse;
+	    ret = nsfb_plot_ellipse(nsfb, &copy, c) && ret;
+	}
+	return ret;
+    }
+
+    ellipse_damage(nsfb, ellipse);
+
+    if ((nsfb->dlist != NULL) &&
+	nsfb_dlist_ellipse(nsfb, nsfb->plotter_fns->ellipse, ellipse, c))
+	return true;
+
     return nsfb->plotter_fns->ellipse(nsfb, ellipse, c);
 }
 
 bool nsfb_plot_ellipse_fill(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c)
 {
+    nsfb_bbox_t extent;
+    nsfb_bbox_t copy;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	ellipse_extent(ellipse, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb)) {
+	    copy = *ellipse;
+	    ret = nsfb_plot_ellipse_fill(nsfb, &copy, c) && ret;
+	}
+	return ret;
+    }
+
+    ellipse_damage(nsfb, ellipse);
+
+    if ((nsfb->dlist != NULL) &&
+	nsfb_dlist_ellipse(nsfb, nsfb->plotter_fns->ellipse_fill, ellipse, c))
+	return true;
+
     return nsfb->plotter_fns->ellipse_fill(nsfb, ellipse, c);
 }
 
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_ellipse_aa(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c)
+{
+    nsfb_bbox_t extent;
+    nsfb_bbox_t copy;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	ellipse_extent(ellipse, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb)) {
+	    copy = *ellipse;
+	    ret = nsfb_plot_ellipse_aa(nsfb, &copy, c) && ret;
+	}
+	return ret;
+    }
+
+    ellipse_damage(nsfb, ellipse);
+
+    if ((nsfb->dlist != NULL) &&
+	nsfb_dlist_ellipse(nsfb, nsfb->plotter_fns->ellipse_aa, ellipse, c))
+	return true;
+
+    return nsfb->plotter_fns->ellipse_aa(nsfb, ellipse, c);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_ellipse_fill_aa(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c)
+{
+    nsfb_bbox_t extent;
+    nsfb_bbox_t copy;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	ellipse_extent(ellipse, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb)) {
+	    copy = *ellipse;
+	    ret = nsfb_plot_ellipse_fill_aa(nsfb, &copy, c) && ret;
+	}
+	return ret;
+    }
+
+    ellipse_damage(nsfb, ellipse);
+
+    if ((nsfb->dlist != NULL) &&
+	nsfb_dlist_ellipse(nsfb, nsfb->plotter_fns->ellipse_fill_aa, ellipse, c))
+	return true;
+
+    return nsfb->plotter_fns->ellipse_fill_aa(nsfb, ellipse, c);
+}
+
 /* copy an area of surface from one location to another.
  *
  * @warning This implementation is woefully incomplete!
@@ -138,6 +1046,25 @@ nsfb_plot_copy(nsfb_t *srcfb,
 {
     bool trans = false;
     nsfb_colour_t srccol;
+    nsfb_bbox_t extent;
+    nsfb_bbox_t copy;
+    bool ret = true;
+
+    nsfb_dlist_sync(srcfb);
+    nsfb_dlist_sync(dstfb);
+
+    /* copies within a context move the area whole and are not clipped */
+    if ((srcfb != dstfb) && nsfb_region_active(dstfb)) {
+	box_extent(dstbox, &extent);
+	nsfb_region_start(dstfb, &extent);
+	while (nsfb_region_next(dstfb)) {
+	    copy = *dstbox;
+	    ret = nsfb_plot_copy(srcfb, srcbox, dstfb, &copy) && ret;
+	}
+	return ret;
+    }
+
+    nsfb_damage_mark(dstfb, dstbox);
 
     if (srcfb == dstfb) {
 	return dstfb->plotter_fns->copy(srcfb, srcbox, dstbox);
@@ -163,13 +1090,41 @@ nsfb_plot_copy(nsfb_t *srcfb,
     
 }
 
-bool nsfb_plot_bitmap(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, bool alpha)
+bool nsfb_plot_bitmap(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, unsigned int flags)
 {
-    return nsfb->plotter_fns->bitmap(nsfb, loc, pixel, bmp_width, bmp_height, bmp_stride, alpha);
+    return bitmap(nsfb, loc, pixel, bmp_width, bmp_height, bmp_stride, flags,
+		  (flags & NSFB_PLOT_BITMAP_ALPHA) ? NSFB_PLOT_OP_OVER : NSFB_PLOT_OP_SRC);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_bitmap_op(nsfb_t *nsfb, const nsfb_bbox_t *loc, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, unsigned int flags, nsfb_plot_op_t op)
+{
+    return bitmap(nsfb, loc, pixel, bmp_width, bmp_height, bmp_stride, flags, op);
 }
 
 bool nsfb_plot_bitmap_tiles(nsfb_t *nsfb, const nsfb_bbox_t *loc, int tiles_x, int tiles_y, const nsfb_colour_t *pixel, int bmp_width, int bmp_height, int bmp_stride, bool alpha)
 {
+    nsfb_bbox_t extent;
+    bool ret = true;
+
+    if ((tiles_x > 0) && (tiles_y > 0)) {
+	extent.x0 = loc->x0;
+	extent.y0 = loc->y0;
+	extent.x1 = loc->x0 + (loc->x1 - loc->x0) * tiles_x;
+	extent.y1 = loc->y0 + (loc->y1 - loc->y0) * tiles_y;
+
+	if (nsfb_region_active(nsfb)) {
+	    nsfb_region_start(nsfb, &extent);
+	    while (nsfb_region_next(nsfb))
+		ret = nsfb_plot_bitmap_tiles(nsfb, loc, tiles_x, tiles_y, pixel, bmp_width, bmp_height, bmp_stride, alpha) && ret;
+	    return ret;
+	}
+
+	nsfb_damage_mark(nsfb, &extent);
+    }
+
+    nsfb_dlist_sync(nsfb);
+
     return nsfb->plotter_fns->bitmap_tiles(nsfb, loc, tiles_x, tiles_y, pixel, bmp_width, bmp_height, bmp_stride, alpha);
 }
 
@@ -177,6 +1132,24 @@ bool nsfb_plot_bitmap_tiles(nsfb_t *nsfb, const nsfb_bbox_t *loc, int tiles_x, i
  */
 bool nsfb_plot_glyph8(nsfb_t *nsfb, nsfb_bbox_t *loc, const uint8_t *pixel, int pitch, nsfb_colour_t c)
 {
+    nsfb_bbox_t copy;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	nsfb_region_start(nsfb, loc);
+	while (nsfb_region_next(nsfb)) {
+	    copy = *loc;
+	    ret = nsfb_plot_glyph8(nsfb, &copy, pixel, pitch, c) && ret;
+	}
+	return ret;
+    }
+
+    nsfb_damage_mark(nsfb, loc);
+
+    if ((nsfb->dlist != NULL) &&
+	nsfb_dlist_glyph(nsfb, NSFB_PLOT_GLYPH_8BPP, loc, pixel, pitch, c))
+	return true;
+
     return nsfb->plotter_fns->glyph8(nsfb, loc, pixel, pitch, c);
 }
 
@@ -185,29 +1158,171 @@ bool nsfb_plot_glyph8(nsfb_t *nsfb, nsfb_bbox_t *loc, const uint8_t *pixel, int
  */
 bool nsfb_plot_glyph1(nsfb_t *nsfb, nsfb_bbox_t *loc, const uint8_t *pixel, int pitch, nsfb_colour_t c)
 {
+    nsfb_bbox_t copy;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb)) {
+	nsfb_region_start(nsfb, loc);
+	while (nsfb_region_next(nsfb)) {
+	    copy = *loc;
+	    ret = nsfb_plot_glyph1(nsfb, &copy, pixel, pitch, c) && ret;
+	}
+	return ret;
+    }
+
+    nsfb_damage_mark(nsfb, loc);
+
+    if ((nsfb->dlist != NULL) &&
+	nsfb_dlist_glyph(nsfb, NSFB_PLOT_GLYPH_1BPP, loc, pixel, pitch, c))
+	return true;
+
     return nsfb->plotter_fns->glyph1(nsfb, loc, pixel, pitch, c);
 }
 
+/** Plot a run of glyphs.
+ */
+bool nsfb_plot_glyph_run(nsfb_t *nsfb, nsfb_plot_glyph_format_t format, const nsfb_plot_glyph_t *glyphs, int glyphc, nsfb_colour_t c)
+{
+    nsfb_bbox_t extent;
+    bool ret = true;
+    int loop;
+
+    if (nsfb_region_active(nsfb) && (glyphc > 0)) {
+	glyph_run_extent(glyphs, glyphc, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb))
+	    ret = nsfb_plot_glyph_run(nsfb, format, glyphs, glyphc, c) && ret;
+	return ret;
+    }
+
+    if (nsfb->damage != NULL) {
+	for (loop = 0; loop < glyphc; loop++)
+	    nsfb_damage_add(nsfb, &glyphs[loop].loc);
+    }
+
+    if ((nsfb->dlist != NULL) &&
+	nsfb_dlist_glyph_run(nsfb, format, glyphs, glyphc, c))
+	return true;
+
+    return nsfb->plotter_fns->glyph_run(nsfb, format, glyphs, glyphc, c);
+}
+
 /* read a rectangle from screen into buffer */
 bool nsfb_plot_readrect(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t *buffer)
 {
+    nsfb_dlist_sync(nsfb);
+
     return nsfb->plotter_fns->readrect(nsfb, rect, buffer);
 }
 
 
 bool nsfb_plot_cubic_bezier(nsfb_t *nsfb, nsfb_bbox_t *curve, nsfb_point_t *ctrla, nsfb_point_t *ctrlb, nsfb_plot_pen_t *pen)
 {
+    nsfb_point_t point[4];
+    nsfb_bbox_t extent;
+    nsfb_bbox_t copy;
+    nsfb_point_t copya;
+    nsfb_point_t copyb;
+    bool ret = true;
+
+    /* the curve lies within its end and control points */
+    point[0].x = curve->x0;
+    point[0].y = curve->y0;
+    point[1].x = curve->x1;
+    point[1].y = curve->y1;
+    point[2] = *ctrla;
+    point[3] = *ctrlb;
+
+    if (nsfb_region_active(nsfb)) {
+	stroke_extent(point, 4, pen, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb)) {
+	    copy = *curve;
+	    copya = *ctrla;
+	    copyb = *ctrlb;
+	    ret = nsfb_plot_cubic_bezier(nsfb, &copy, &copya, &copyb, pen) && ret;
+	}
+	return ret;
+    }
+
+    stroke_damage(nsfb, point, 4, pen);
+
+    nsfb_dlist_sync(nsfb);
+
     return nsfb->plotter_fns->cubic(nsfb, curve, ctrla, ctrlb, pen);
 }
 
 bool nsfb_plot_quadratic_bezier(nsfb_t *nsfb, nsfb_bbox_t *curve, nsfb_point_t *ctrla, nsfb_plot_pen_t *pen)
 {
+    nsfb_point_t point[3];
+    nsfb_bbox_t extent;
+    nsfb_bbox_t copy;
+    nsfb_point_t copya;
+    bool ret = true;
+
+    point[0].x = curve->x0;
+    point[0].y = curve->y0;
+    point[1].x = curve->x1;
+    point[1].y = curve->y1;
+    point[2] = *ctrla;
+
+    if (nsfb_region_active(nsfb)) {
+	stroke_extent(point, 3, pen, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb)) {
+	    copy = *curve;
+	    copya = *ctrla;
+	    ret = nsfb_plot_quadratic_bezier(nsfb, &copy, &copya, pen) && ret;
+	}
+	return ret;
+    }
+
+    stroke_damage(nsfb, point, 3, pen);
+
+    nsfb_dlist_sync(nsfb);
+
     return nsfb->plotter_fns->quadratic(nsfb, curve, ctrla, pen);
 }
 
 bool nsfb_plot_path(nsfb_t *nsfb, int pathc, nsfb_plot_pathop_t *pathop, nsfb_plot_pen_t *pen)
 {
-    return nsfb->plotter_fns->path(nsfb, pathc, pathop, pen);
+    nsfb_bbox_t extent;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb) && (pathc > 0)) {
+	path_extent(pathc, pathop, pen, 0, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb))
+	    ret = nsfb_plot_path(nsfb, pathc, pathop, pen) && ret;
+	return ret;
+    }
+
+    path_damage(nsfb, pathc, pathop, pen, 0);
+
+    nsfb_dlist_sync(nsfb);
+
+    return nsfb->plotter_fns->path(nsfb, pathc, pathop, pen, false);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_path_subpixel(nsfb_t *nsfb, int pathc, nsfb_plot_pathop_t *pathop, nsfb_plot_pen_t *pen)
+{
+    nsfb_bbox_t extent;
+    bool ret = true;
+
+    if (nsfb_region_active(nsfb) && (pathc > 0)) {
+	path_extent(pathc, pathop, pen, NSFB_PLOT_SUBPIXEL_SHIFT, &extent);
+	nsfb_region_start(nsfb, &extent);
+	while (nsfb_region_next(nsfb))
+	    ret = nsfb_plot_path_subpixel(nsfb, pathc, pathop, pen) && ret;
+	return ret;
+    }
+
+    path_damage(nsfb, pathc, pathop, pen, NSFB_PLOT_SUBPIXEL_SHIFT);
+
+    nsfb_dlist_sync(nsfb);
+
+    return nsfb->plotter_fns->path(nsfb, pathc, pathop, pen, true);
 }
 
 /*
@@ -0,0 +1,542 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Scaled bitmap cache (implementation).
+ *
+ * Each result is held in a single allocation with the scaled image packed
+ * behind the entry header. Results with no translucent pixels are held in
+ * the pixel format of the context and plotted by copying rows, the rest
+ * are held as colours and plotted as an unscaled alpha bitmap. As with the
+ * glyph cache entries are found through a hash of the key and kept on a
+ * list in order of use for eviction.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+#include "libnsfb_plot_util.h"
+
+#include "nsfb.h"
+#include "plot.h"
+#include "palette.h"
+#include "scale.h"
+#include "bitmapcache.h"
+#include "dlist.h"
+#include "damage.h"
+#include "region.h"
+
+/* initial number of hash buckets, must be a power of two */
+#define BITMAP_CACHE_BUCKETS 64
+
+struct bitmap_entry {
+        struct bitmap_entry *next; /**< next entry in hash bucket */
+        struct bitmap_entry *prev_used; /**< more recently used entry */
+        struct bitmap_entry *next_used; /**< less recently used entry */
+
+        /* key */
+        const nsfb_colour_t *pixel;
+        uint32_t generation;
+        int bmp_width;
+        int bmp_height;
+        int width;
+        int height;
+        unsigned int flags;
+
+        bool native; /**< held in the context format rather than colours */
+        size_t bytes; /**< total size of the entry */
+
+        uint32_t data[];
+};
+
+struct nsfb_bitmap_cache_s {
+        struct bitmap_entry **bucket;
+        unsigned int bucketc; /**< number of buckets, a power of two */
+
+        struct bitmap_entry *mru; /**< most recently used entry */
+        struct bitmap_entry *lru; /**< least recently used entry */
+
+        enum nsfb_format_e format; /**< format the native results are in */
+
+        nsfb_bitmap_cache_stats_t stats;
+};
+
+static inline unsigned int
+bitmap_hash(const nsfb_colour_t *pixel,
+            uint32_t generation,
+            int width,
+            int height)
+{
+        uint32_t h = (uint32_t)(uintptr_t)pixel;
+
+        h = (h ^ (h >> 16)) * 2654435761u;
+        h ^= generation * 40503u;
+        h ^= ((uint32_t)width << 16) ^ (uint32_t)height;
+
+        return h;
+}
+
+static struct bitmap_entry **
+bitmap_find(nsfb_bitmap_cache_t *cache,
+            const nsfb_colour_t *pixel,
+            uint32_t generation,
+            int bmp_width,
+            int bmp_height,
+            int width,
+            int height,
+            unsigned int flags)
+{
+        struct bitmap_entry **link;
+        struct bitmap_entry *entry;
+
+        link = &cache->bucket[bitmap_hash(pixel, generation, width, height) &
+                              (cache->bucketc - 1)];
+        while ((entry = *link) != NULL) {
+                if ((entry->pixel == pixel) &&
+                    (entry->generation == generation) &&
+                    (entry->bmp_width == bmp_width) &&
+                    (entry->bmp_height == bmp_height) &&
+                    (entry->width == width) &&
+                    (entry->height == height) &&
+                    (entry->flags == flags))
+                        break;
+                link = &entry->next;
+        }
+        return link;
+}
+
+static void
+bitmap_unuse(nsfb_bitmap_cache_t *cache, struct bitmap_entry *entry)
+{
+        if (entry->prev_used != NULL)
+                entry->prev_used->next_used = entry->next_used;
+        else
+                cache->mru = entry->next_used;
+
+        if (entry->next_used != NULL)
+                entry->next_used->prev_used = entry->prev_used;
+        else
+                cache->lru = entry->prev_used;
+}
+
+static void
+bitmap_use(nsfb_bitmap_cache_t *cache, struct bitmap_entry *entry)
+{
+        entry->prev_used = NULL;
+        entry->next_used = cache->mru;
+        if (cache->mru != NULL)
+                cache->mru->prev_used = entry;
+        else
+                cache->lru = entry;
+        cache->mru = entry;
+}
+
+/* remove an entry from the cache and free it */
+static void
+bitmap_discard(nsfb_bitmap_cache_t *cache, struct bitmap_entry *entry)
+{
+        struct bitmap_entry **link;
+
+        link = bitmap_find(cache, entry->pixel, entry->generation,
+                           entry->bmp_width, entry->bmp_height,
+                           entry->width, entry->height, entry->flags);
+        *link = entry->next;
+
+        bitmap_unuse(cache, entry);
+
+        cache->stats.used -= entry->bytes;
+        cache->stats.count--;
+        free(entry);
+}
+
+/* discard least recently used entries until there is room for bytes */
+static void
+bitmap_evict(nsfb_bitmap_cache_t *cache, size_t bytes)
+{
+        while ((cache->lru != NULL) &&
+               (cache->stats.used + bytes > cache->stats.budget)) {
+                bitmap_discard(cache, cache->lru);
+                cache->stats.evictions++;
+        }
+}
+
+/* double the number of hash buckets, failure just leaves longer chains */
+static void
+bitmap_rehash(nsfb_bitmap_cache_t *cache)
+{
+        struct bitmap_entry **bucket;
+        struct bitmap_entry *entry;
+        unsigned int bucketc = cache->bucketc * 2;
+        unsigned int h;
+
+        bucket = calloc(bucketc, sizeof(struct bitmap_entry *));
+        if (bucket == NULL)
+                return;
+
+        for (entry = cache->mru; entry != NULL; entry = entry->next_used) {
+                h = bitmap_hash(entry->pixel, entry->generation,
+                                entry->width, entry->height) & (bucketc - 1);
+                entry->next = bucket[h];
+                bucket[h] = entry;
+        }
+
+        free(cache->bucket);
+        cache->bucket = bucket;
+        cache->bucketc = bucketc;
+}
+
+static void
+bitmap_flush(nsfb_bitmap_cache_t *cache)
+{
+        struct bitmap_entry *entry;
+        struct bitmap_entry *next;
+
+        for (entry = cache->mru; entry != NULL; entry = next) {
+                next = entry->next_used;
+                free(entry);
+        }
+
+        memset(cache->bucket, 0, cache->bucketc * sizeof(struct bitmap_entry *));
+        cache->mru = cache->lru = NULL;
+        cache->stats.count = 0;
+        cache->stats.used = 0;
+}
+
+/* scale a bitmap into a new entry, returns NULL if the result would not
+ * fit the budget or memory is exhausted
+ */
+static struct bitmap_entry *
+bitmap_entry_create(nsfb_t *nsfb,
+                    nsfb_bitmap_cache_t *cache,
+                    const nsfb_colour_t *pixel,
+                    int bmp_width,
+                    int bmp_height,
+                    int bmp_stride,
+                    int width,
+                    int height,
+                    unsigned int flags)
+{
+        struct bitmap_entry *entry;
+        struct bitmap_entry *native;
+        nsfb_scale_t scale;
+        nsfb_colour_t *colour;
+        size_t bytes;
+        size_t pitch;
+        bool opaque = true;
+        bool set_dither = false;
+        int xloop, yloop;
+
+        bytes = sizeof(struct bitmap_entry) +
+                (size_t)width * height * sizeof(nsfb_colour_t);
+        if (bytes > cache->stats.budget)
+                return NULL;
+
+        entry = malloc(bytes);
+        if (entry == NULL)
+                return NULL;
+
+        if (!nsfb_scale_init(&scale, nsfb->kernel_fns, flags, pixel,
+                             bmp_width, bmp_height, bmp_stride,
+                             width, height, 0, width)) {
+                free(entry);
+                return NULL;
+        }
+
+        colour = entry->data;
+        for (yloop = 0; yloop < height; yloop++) {
+                memcpy(colour, nsfb_scale_row(&scale, yloop),
+                       width * sizeof(nsfb_colour_t));
+                if ((flags & NSFB_PLOT_BITMAP_ALPHA) && opaque) {
+                        for (xloop = 0; xloop < width; xloop++) {
+                                if ((colour[xloop] & 0xFF000000) !=
+                                    0xFF000000) {
+                                        opaque = false;
+                                        break;
+                                }
+                        }
+                }
+                colour += width;
+        }
+
+        nsfb_scale_fini(&scale);
+
+        entry->pixel = pixel;
+        entry->bmp_width = bmp_width;
+        entry->bmp_height = bmp_height;
+        entry->width = width;
+        entry->height = height;
+        entry->flags = flags;
+        entry->native = false;
+        entry->bytes = bytes;
+
+        if (!opaque)
+                return entry;
+
+        /* every pixel is simply stored so convert the result once */
+        pitch = (size_t)width * (nsfb->bpp / 8);
+        bytes = sizeof(struct bitmap_entry) + pitch * height;
+        native = malloc(bytes);
+        if (native == NULL)
+                return entry;
+
+        *native = *entry;
+        native->native = true;
+        native->bytes = bytes;
+
+        /* Enable error diffusion for paletted screens, if not already on */
+        if (nsfb->palette != NULL &&
+            nsfb_palette_dithering_on(nsfb->palette) == false) {
+                nsfb_palette_dither_init(nsfb->palette, width);
+                set_dither = true;
+        }
+
+        for (yloop = 0; yloop < height; yloop++) {
+                nsfb->plotter_fns->convert(nsfb,
+                                entry->data + (size_t)yloop * width,
+                                (uint8_t *)native->data + pitch * yloop,
+                                width);
+        }
+
+        if (set_dither) {
+                nsfb_palette_dither_fini(nsfb->palette);
+        }
+
+        free(entry);
+
+        return native;
+}
+
+static bool
+bitmap_entry_plot(nsfb_t *nsfb,
+                  struct bitmap_entry *entry,
+                  const nsfb_bbox_t *loc)
+{
+        nsfb_bbox_t clipped;
+        const uint8_t *src;
+        uint8_t *dst;
+        size_t pitch;
+        int bytes;
+        int yloop;
+        bool ret = true;
+
+        if (nsfb_region_active(nsfb)) {
+                nsfb_region_start(nsfb, loc);
+                while (nsfb_region_next(nsfb))
+                        ret = bitmap_entry_plot(nsfb, entry, loc) && ret;
+                return ret;
+        }
+
+        if (!entry->native) {
+                return nsfb->plotter_fns->bitmap(nsfb, loc, entry->data,
+                                entry->width, entry->height, entry->width,
+                                NSFB_PLOT_BITMAP_ALPHA);
+        }
+
+        clipped = *loc;
+        if (!nsfb_plot_clip_ctx(nsfb, &clipped))
+                return true;
+
+        bytes = nsfb->bpp / 8;
+        pitch = (size_t)entry->width * bytes;
+        src = (const uint8_t *)entry->data +
+                (clipped.y0 - loc->y0) * pitch + (clipped.x0 - loc->x0) * bytes;
+        dst = nsfb->ptr + clipped.y0 * nsfb->linelen + clipped.x0 * bytes;
+
+        for (yloop = clipped.y0; yloop < clipped.y1; yloop++) {
+                memcpy(dst, src, (clipped.x1 - clipped.x0) * bytes);
+                src += pitch;
+                dst += nsfb->linelen;
+        }
+
+        return true;
+}
+
+/* plot a bitmap which is not cached */
+static bool
+bitmap_plot(nsfb_t *nsfb,
+            const nsfb_bbox_t *loc,
+            const nsfb_colour_t *pixel,
+            int bmp_width,
+            int bmp_height,
+            int bmp_stride,
+            unsigned int flags)
+{
+        bool ret = true;
+
+        if (nsfb_region_active(nsfb)) {
+                nsfb_region_start(nsfb, loc);
+                while (nsfb_region_next(nsfb))
+                        ret = nsfb->plotter_fns->bitmap(nsfb, loc, pixel,
+                                        bmp_width, bmp_height, bmp_stride,
+                                        flags) && ret;
+                return ret;
+        }
+
+        return nsfb->plotter_fns->bitmap(nsfb, loc, pixel,
+                        bmp_width, bmp_height, bmp_stride, flags);
+}
+
+/* exported interface documented in bitmapcache.h */
+void nsfb_bitmap_cache_destroy(nsfb_bitmap_cache_t *cache)
+{
+        bitmap_flush(cache);
+        free(cache->bucket);
+        free(cache);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_bitmap_cache_set_budget(nsfb_t *nsfb, size_t budget)
+{
+        nsfb_bitmap_cache_t *cache = nsfb->bitmap_cache;
+
+        if (budget == 0) {
+                if (cache != NULL) {
+                        nsfb_bitmap_cache_destroy(cache);
+                        nsfb->bitmap_cache = NULL;
+                }
+                return true;
+        }
+
+        if (cache == NULL) {
+                cache = calloc(1, sizeof(nsfb_bitmap_cache_t));
+                if (cache == NULL)
+                        return false;
+
+                cache->bucketc = BITMAP_CACHE_BUCKETS;
+                cache->bucket = calloc(cache->bucketc,
+                                       sizeof(struct bitmap_entry *));
+                if (cache->bucket == NULL) {
+                        free(cache);
+                        return false;
+                }
+                cache->format = nsfb->format;
+                nsfb->bitmap_cache = cache;
+        }
+
+        cache->stats.budget = budget;
+        bitmap_evict(cache, 0);
+
+        return true;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+void nsfb_plot_bitmap_cache_invalidate(nsfb_t *nsfb, const nsfb_colour_t *pixel)
+{
+        nsfb_bitmap_cache_t *cache = nsfb->bitmap_cache;
+        struct bitmap_entry *entry;
+        struct bitmap_entry *next;
+
+        if (cache == NULL)
+                return;
+
+        if (pixel == NULL) {
+                bitmap_flush(cache);
+                return;
+        }
+
+        for (entry = cache->mru; entry != NULL; entry = next) {
+                next = entry->next_used;
+                if (entry->pixel == pixel)
+                        bitmap_discard(cache, entry);
+        }
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_bitmap_cache_stats(nsfb_t *nsfb, nsfb_bitmap_cache_stats_t *stats)
+{
+        if (nsfb->bitmap_cache == NULL)
+                return false;
+
+        *stats = nsfb->bitmap_cache->stats;
+        return true;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_bitmap_cached(nsfb_t *nsfb,
+                             const nsfb_bbox_t *loc,
+                             const nsfb_colour_t *pixel,
+                             int bmp_width,
+                             int bmp_height,
+                             int bmp_stride,
+                             unsigned int flags,
+                             uint32_t generation)
+{
+        nsfb_bitmap_cache_t *cache = nsfb->bitmap_cache;
+        struct bitmap_entry **link;
+        struct bitmap_entry *entry;
+        int width = loc->x1 - loc->x0;
+        int height = loc->y1 - loc->y0;
+
+        flags &= NSFB_PLOT_BITMAP_ALPHA | NSFB_PLOT_BITMAP_FILTER;
+
+        /* results may be evicted before a recorded frame is plotted */
+        nsfb_dlist_sync(nsfb);
+
+        nsfb_damage_mark(nsfb, loc);
+
+        if ((cache == NULL) ||
+            (nsfb->bpp < 8) ||
+            (width <= 0) || (height <= 0) ||
+            (bmp_width <= 0) || (bmp_height <= 0) ||
+            ((width == bmp_width) && (height == bmp_height))) {
+                return bitmap_plot(nsfb, loc, pixel,
+                                bmp_width, bmp_height, bmp_stride, flags);
+        }
+
+        /* native results are useless once the context format changes */
+        if (cache->format != nsfb->format) {
+                bitmap_flush(cache);
+                cache->format = nsfb->format;
+        }
+
+        link = bitmap_find(cache, pixel, generation, bmp_width, bmp_height,
+                           width, height, flags);
+        entry = *link;
+        if (entry != NULL) {
+                cache->stats.hits++;
+                if (entry != cache->mru) {
+                        bitmap_unuse(cache, entry);
+                        bitmap_use(cache, entry);
+                }
+                return bitmap_entry_plot(nsfb, entry, loc);
+        }
+
+        cache->stats.misses++;
+
+        entry = bitmap_entry_create(nsfb, cache, pixel, bmp_width, bmp_height,
+                                    bmp_stride, width, height, flags);
+        if (entry == NULL) {
+                return bitmap_plot(nsfb, loc, pixel,
+                                bmp_width, bmp_height, bmp_stride, flags);
+        }
+        entry->generation = generation;
+
+        bitmap_evict(cache, entry->bytes);
+
+        if (cache->stats.count >= cache->bucketc * 2)
+                bitmap_rehash(cache);
+
+        link = bitmap_find(cache, pixel, generation, bmp_width, bmp_height,
+                           width, height, flags);
+        entry->next = NULL;
+        *link = entry;
+        bitmap_use(cache, entry);
+
+        cache->stats.used += entry->bytes;
+        cache->stats.count++;
+
+        return bitmap_entry_plot(nsfb, entry, loc);
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
@@ -16,10 +16,266 @@
 #error PLOT_LINELEN must be a macro to increment a line length
 #endif
 
+#include <string.h>
+
 #include "palette.h"
+#include "scale.h"
+#include "stroke.h"
 
 #define SIGN(x)  ((x<0) ?  -1  :  ((x>0) ? 1 : 0))
 
+/* Formats with a SIMD row kernel layout define PLOT_KERNEL_FMT32 or
+ * PLOT_KERNEL_RGB565, the scalar loops below remain the reference
+ * implementation for them.
+ */
+#define KERNEL_UNUSED __attribute__((unused))
+
+static inline bool blend_kernel(KERNEL_UNUSED nsfb_t *nsfb)
+{
+#ifdef PLOT_KERNEL_FMT32
+        return nsfb->kernel_fns->blend32 != NULL;
+#else
+        return false;
+#endif
+}
+
+static inline void
+blend_row(KERNEL_UNUSED nsfb_t *nsfb,
+          KERNEL_UNUSED PLOT_TYPE *pvideo,
+          KERNEL_UNUSED const nsfb_colour_t *pixel,
+          KERNEL_UNUSED int width)
+{
+#ifdef PLOT_KERNEL_FMT32
+        nsfb->kernel_fns->blend32(pvideo, pixel, width, PLOT_KERNEL_FMT32);
+#endif
+}
+
+static inline bool glyph_kernel(KERNEL_UNUSED nsfb_t *nsfb)
+{
+#if defined(PLOT_KERNEL_FMT32)
+        return nsfb->kernel_fns->glyph32 != NULL;
+#elif defined(PLOT_KERNEL_RGB565)
+        return nsfb->kernel_fns->glyph16 != NULL;
+#else
+        return false;
+#endif
+}
+
+static inline void
+glyph_row(KERNEL_UNUSED nsfb_t *nsfb,
+          KERNEL_UNUSED PLOT_TYPE *pvideo,
+          KERNEL_UNUSED const uint8_t *cov,
+          KERNEL_UNUSED int width,
+          KERNEL_UNUSED nsfb_colour_t c)
+{
+#if defined(PLOT_KERNEL_FMT32)
+        nsfb->kernel_fns->glyph32(pvideo, cov, width, c, PLOT_KERNEL_FMT32);
+#elif defined(PLOT_KERNEL_RGB565)
+        nsfb->kernel_fns->glyph16(pvideo, cov, width, c);
+#endif
+}
+
+/* store a pixel value along part of a row */
+static inline void
+fill_row(nsfb_t *nsfb, PLOT_TYPE *pvideo, int width, PLOT_TYPE ent)
+{
+        switch (sizeof(PLOT_TYPE)) {
+        case 4:
+                nsfb->kernel_fns->fill32((void *)pvideo, width, width, 1, ent);
+                break;
+
+        case 2:
+                nsfb->kernel_fns->fill16((void *)pvideo, width, width, 1, ent);
+                break;
+
+        default:
+                memset(pvideo, ent, width);
+                break;
+        }
+}
+
+/* store a pixel value over part of several rows */
+static inline void
+fill_area(nsfb_t *nsfb, PLOT_TYPE *pvideo, int width, int height, PLOT_TYPE ent)
+{
+        switch (sizeof(PLOT_TYPE)) {
+        case 4:
+                nsfb->kernel_fns->fill32((void *)pvideo, nsfb->linelen >> 2,
+                                         width, height, ent);
+                break;
+
+        case 2:
+                nsfb->kernel_fns->fill16((void *)pvideo, nsfb->linelen >> 1,
+                                         width, height, ent);
+                break;
+
+        default:
+                for (; height > 0; height--) {
+                        memset(pvideo, ent, width);
+                        pvideo += PLOT_LINELEN(nsfb->linelen);
+                }
+                break;
+        }
+}
+
+/* combine a colour with a destination colour by a compositing operator.
+ *
+ * The result of each operator is weighted against the destination by the
+ * source alpha as nsfb_plot_ablend() does, the source must not be
+ * transparent unless the operator is NSFB_PLOT_OP_SRC.
+ */
+static inline nsfb_colour_t
+compose_colour(nsfb_colour_t s, nsfb_colour_t d, nsfb_plot_op_t op)
+{
+        unsigned int a = s >> 24;
+        unsigned int sc, dc, r;
+        nsfb_colour_t res = 0;
+        int shift;
+
+        switch (op) {
+        case NSFB_PLOT_OP_SRC:
+                return s;
+
+        case NSFB_PLOT_OP_OVER:
+                return (a == 0xFF) ? s : nsfb_plot_ablend(s, d);
+
+        default:
+                break;
+        }
+
+        for (shift = 0; shift < 24; shift += 8) {
+                sc = (s >> shift) & 0xFF;
+                dc = (d >> shift) & 0xFF;
+
+                switch (op) {
+                case NSFB_PLOT_OP_ADD:
+                        r = dc + sc;
+                        if (r > 0xFF)
+                                r = 0xFF;
+                        break;
+
+                case NSFB_PLOT_OP_MULTIPLY:
+                        r = (dc * sc + 127) / 255;
+                        break;
+
+                default:
+                        r = dc ^ sc;
+                        break;
+                }
+
+                if (a != 0xFF)
+                        r = (r * a + dc * (0x100 - a)) >> 8;
+
+                res |= r << shift;
+        }
+
+        return res;
+}
+
+/* blend one pixel of an anti-aliased line, cov is its coverage of 255 */
+static inline void
+line_aa_pixel(nsfb_t *nsfb, int x, int y, nsfb_colour_t c, unsigned int cov)
+{
+        PLOT_TYPE *pvideo;
+        unsigned int alpha;
+
+        if ((x < nsfb->clip.x0) ||
+            (x >= nsfb->clip.x1) ||
+            (y < nsfb->clip.y0) ||
+            (y >= nsfb->clip.y1))
+                return;
+
+        alpha = ((c >> 24) * cov + 127) / 255;
+        if (alpha == 0)
+                return;
+
+        pvideo = get_xy_loc(nsfb, x, y);
+
+        c = (c & 0xFFFFFF) | (alpha << 24);
+        if (alpha != 0xFF)
+                c = nsfb_plot_ablend(c, pixel_to_colour(nsfb, *pvideo));
+
+        *pvideo = colour_to_pixel(nsfb, c);
+}
+
+/* Wu's anti-aliased line.
+ *
+ * The major axis is stepped from the left, or top, end and like the
+ * bresenham line stops a pixel short of the other end. The minor
+ * coordinate is accumulated in 16.16 fixed point and split between the two
+ * pixels it falls between by its fraction. Only the steps within the
+ * clipping region are walked.
+ */
+static void
+line_aa(nsfb_t *nsfb, const nsfb_bbox_t *line, nsfb_colour_t c)
+{
+        int dx, dy;
+        int x0, y0, x1, y1;
+        int i, i0, i1;
+        int32_t step;
+        int64_t minor;
+        unsigned int frac;
+
+        dx = line->x1 - line->x0;
+        dy = line->y1 - line->y0;
+
+        if (abs(dx) >= abs(dy)) {
+                /* the line is more horizontal than vertical */
+                if (dx >= 0) {
+                        x0 = line->x0; y0 = line->y0;
+                        x1 = line->x1; y1 = line->y1;
+                } else {
+                        x0 = line->x1; y0 = line->y1;
+                        x1 = line->x0; y1 = line->y0;
+                }
+                if (x1 == x0)
+                        return;
+
+                step = (int32_t)(((int64_t)(y1 - y0) * 65536) / (x1 - x0));
+
+                i0 = nsfb->clip.x0 - x0;
+                if (i0 < 0)
+                        i0 = 0;
+                i1 = nsfb->clip.x1 - x0;
+                if (i1 > x1 - x0)
+                        i1 = x1 - x0;
+
+                minor = (int64_t)y0 * 65536 + (int64_t)step * i0;
+                for (i = i0; i < i1; i++, minor += step) {
+                        frac = (minor >> 8) & 0xFF;
+                        line_aa_pixel(nsfb, x0 + i, minor >> 16, c, 255 - frac);
+                        if (frac != 0)
+                                line_aa_pixel(nsfb, x0 + i, (minor >> 16) + 1, c, frac);
+                }
+        } else {
+                /* the line is more vertical than horizontal */
+                if (dy >= 0) {
+                        x0 = line->x0; y0 = line->y0;
+                        x1 = line->x1; y1 = line->y1;
+                } else {
+                        x0 = line->x1; y0 = line->y1;
+                        x1 = line->x0; y1 = line->y0;
+                }
+
+                step = (int32_t)(((int64_t)(x1 - x0) * 65536) / (y1 - y0));
+
+                i0 = nsfb->clip.y0 - y0;
+                if (i0 < 0)
+                        i0 = 0;
+                i1 = nsfb->clip.y1 - y0;
+                if (i1 > y1 - y0)
+                        i1 = y1 - y0;
+
+                minor = (int64_t)x0 * 65536 + (int64_t)step * i0;
+                for (i = i0; i < i1; i++, minor += step) {
+                        frac = (minor >> 8) & 0xFF;
+                        line_aa_pixel(nsfb, minor >> 16, y0 + i, c, 255 - frac);
+                        if (frac != 0)
+                                line_aa_pixel(nsfb, (minor >> 16) + 1, y0 + i, c, frac);
+                }
+        }
+}
+
 static bool
 line(nsfb_t *nsfb, int linec, nsfb_bbox_t *line, nsfb_plot_pen_t *pen)
 {
@@ -29,10 +285,26 @@ line(nsfb_t *nsfb, int linec, nsfb_bbox_t *line, nsfb_plot_pen_t *pen)
         int x, y, i;
         int dx, dy, sdy;
         int dxabs, dyabs;
+        uint32_t pattern = 0xFFFFFFFF;
+        int phase;
+        nsfb_bbox_t unclipped;
+
+        if (pen->stroke_width > 1)
+                return nsfb_stroke_lines(nsfb, line, linec, pen);
+
+        if (pen->stroke_type == NFSB_PLOT_OPTYPE_SOLID_AA) {
+                for (; linec > 0; linec--, line++)
+                        line_aa(nsfb, line, pen->stroke_colour);
+                return true;
+        }
+
+        if (pen->stroke_type == NFSB_PLOT_OPTYPE_PATTERN)
+                pattern = pen->stroke_pattern;
 
         ent = colour_to_pixel(nsfb, pen->stroke_colour);
 
         for (;linec > 0; linec--) {
+                unclipped = *line;
 
                 if (line->y0 == line->y1) {
                         /* horizontal line special cased */
@@ -46,8 +318,17 @@ line(nsfb_t *nsfb, int linec, nsfb_bbox_t *line, nsfb_plot_pen_t *pen)
                         pvideo = get_xy_loc(nsfb, line->x0, line->y0);
 
                         w = line->x1 - line->x0;
-                        while (w-- > 0)
-                                *(pvideo + w) = ent;
+                        if (pattern == 0xFFFFFFFF) {
+                                while (w-- > 0)
+                                        *(pvideo + w) = ent;
+                        } else {
+                                /* pattern continues from the unclipped start */
+                                phase = line->x0 - unclipped.x0;
+                                for (i = 0; i < w; i++) {
+                                        if (pattern & (1u << ((phase + i) & 31)))
+                                                *(pvideo + i) = ent;
+                                }
+                        }
 
                 } else {
                         /* standard bresenham line */
@@ -68,10 +349,18 @@ line(nsfb_t *nsfb, int linec, nsfb_bbox_t *line, nsfb_plot_pen_t *pen)
 
                         sdy = dx ? SIGN(dy) * SIGN(dx) : SIGN(dy);
 
-                        if (dx >= 0)
+                        if (dx >= 0) {
                                 pvideo = get_xy_loc(nsfb, line->x0, line->y0);
-                        else
+                                phase = (dxabs >= dyabs) ?
+                                        line->x0 - unclipped.x0 :
+                                        line->y0 - unclipped.y0;
+                        } else {
                                 pvideo = get_xy_loc(nsfb, line->x1, line->y1);
+                                phase = (dxabs >= dyabs) ?
+                                        line->x1 - unclipped.x1 :
+                                        line->y1 - unclipped.y1;
+                        }
+                        phase = abs(phase);
 
                         x = dyabs >> 1;
                         y = dxabs >> 1;
@@ -79,7 +368,8 @@ line(nsfb_t *nsfb, int linec, nsfb_bbox_t *line, nsfb_plot_pen_t *pen)
                         if (dxabs >= dyabs) {
                                 /* the line is more horizontal than vertical */
                                 for (i = 0; i < dxabs; i++) {
-                                        *pvideo = ent;
+                                        if (pattern & (1u << ((phase + i) & 31)))
+                                                *pvideo = ent;
 
                                         pvideo++;
                                         y += dyabs;
@@ -91,7 +381,8 @@ line(nsfb_t *nsfb, int linec, nsfb_bbox_t *line, nsfb_plot_pen_t *pen)
                         } else {
                                 /* the line is more vertical than horizontal */
                                 for (i = 0; i < dyabs; i++) {
-                                        *pvideo = ent;
+                                        if (pattern & (1u << ((phase + i) & 31)))
+                                                *pvideo = ent;
                                         pvideo += sdy * PLOT_LINELEN(nsfb->linelen);
 
                                         x += dxabs;
@@ -132,6 +423,184 @@ static bool point(nsfb_t *nsfb, int x, int y, nsfb_colour_t c)
         return true;
 }
 
+/* Signs of the offsets of the points of a midpoint circle octant from its
+ * walk (x, y), where 0 <= x <= y. The eighths of the circle are in order
+ * anticlockwise from the right, each as the x offset from x and y then the
+ * y offset from x and y.
+ */
+static const signed char arc_octant[8][4] = {
+        {  0,  1, -1,  0 },
+        {  1,  0,  0, -1 },
+        { -1,  0,  0, -1 },
+        {  0, -1, -1,  0 },
+        {  0, -1,  1,  0 },
+        { -1,  0,  0,  1 },
+        {  1,  0,  0,  1 },
+        {  0,  1,  1,  0 },
+};
+
+/* whether an offset, with y increasing upwards, lies within the sweep
+ * anticlockwise from (ax, ay) to (bx, by)
+ */
+static inline bool
+arc_inside(int sweep, int ax, int ay, int bx, int by, int x, int y)
+{
+        bool after_a = ((int64_t)ax * y - (int64_t)ay * x) >= 0;
+        bool before_b = ((int64_t)x * by - (int64_t)y * bx) >= 0;
+
+        if (sweep <= 180)
+                return after_a && before_b;
+        return after_a || before_b;
+}
+
+/* Midpoint circle arc.
+ *
+ * Only the eighths of the circle the sweep reaches are walked and only the
+ * points of those it partly covers are tested against its ends. The points
+ * on the boundary between two eighths belong to one of them so each pixel
+ * is plotted once.
+ */
+static bool
+arc(nsfb_t *nsfb, int x, int y, int radius, int angle1, int angle2, nsfb_colour_t c)
+{
+        const signed char *oct;
+        int sweep;
+        int ax, ay, bx, by;
+        int octant, start;
+        bool whole;
+        int px, py, p;
+        int dx, dy;
+
+        if (radius < 0)
+                return true;
+
+        sweep = nsfb_plot_arc_sweep(&angle1, angle2);
+        if (sweep == 0)
+                return true;
+
+        if ((x + radius < nsfb->clip.x0) ||
+            (x - radius >= nsfb->clip.x1) ||
+            (y + radius < nsfb->clip.y0) ||
+            (y - radius >= nsfb->clip.y1))
+                return true;
+
+        if (radius == 0)
+                return point(nsfb, x, y, c);
+
+        nsfb_plot_unit_angle(angle1, &ax, &ay);
+        nsfb_plot_unit_angle(angle1 + sweep, &bx, &by);
+
+        for (octant = 0; octant < 8; octant++) {
+                /* where the eighth starts along the sweep */
+                start = (octant * 45 - angle1 + 360) % 360;
+                if ((start > sweep) && (start + 45 <= 360))
+                        continue;
+                whole = (sweep == 360) || (start + 45 <= sweep);
+
+                oct = arc_octant[octant];
+                px = 0;
+                py = radius;
+                p = 1 - radius;
+                while (px <= py) {
+                        /* even eighths leave the diagonal to the next */
+                        if ((octant & 1) ? (px != 0) : (px != py)) {
+                                dx = oct[0] * px + oct[1] * py;
+                                dy = oct[2] * px + oct[3] * py;
+                                if (whole ||
+                                    arc_inside(sweep, ax, ay, bx, by, dx, -dy))
+                                        point(nsfb, x + dx, y + dy, c);
+                        }
+
+                        px++;
+                        if (p < 0) {
+                                p += 2 * px + 1;
+                        } else {
+                                py--;
+                                p += 2 * (px - py) + 1;
+                        }
+                }
+        }
+
+        return true;
+}
+
+/* fetch up to eight bits of a 1bpp glyph starting at an arbitrary bit.
+ *
+ * Only the first n bits are returned, in the most significant end of the
+ * byte, and no memory beyond them is read.
+ */
+static inline unsigned int
+glyph1_bits(const uint8_t *pixel, unsigned int bit, int n)
+{
+        const uint8_t *src = pixel + (bit >> 3);
+        unsigned int shift = bit & 7;
+        unsigned int bits = *src << shift;
+
+        if (shift + n > 8)
+                bits |= src[1] >> (8 - shift);
+
+        return bits & (0xFF00 >> n) & 0xFF;
+}
+
+/* plot the clipped area of a 1bpp glyph.
+ *
+ * loc is the area to plot which must already lie within the clipping
+ * region, xoff and yoff are its offset into the glyph.
+ */
+static void
+glyph1_area(nsfb_t *nsfb,
+            const nsfb_bbox_t *loc,
+            int xoff,
+            int yoff,
+            const uint8_t *pixel,
+            int pitch,
+            PLOT_TYPE fgcol)
+{
+        PLOT_TYPE *pvideo;
+        PLOT_TYPE *pv;
+        const int8_t *mask;
+        unsigned int bits;
+        unsigned int bit;
+        int xloop, yloop;
+        int width = loc->x1 - loc->x0;
+        int height = loc->y1 - loc->y0;
+        int n;
+        int i;
+
+        pvideo = get_xy_loc(nsfb, loc->x0, loc->y0);
+
+        /* rows are pitch bits apart with the leftmost pixel in the most
+         * significant bit, they are expanded a byte at a time
+         */
+        for (yloop = 0; yloop < height; yloop++) {
+                bit = (yoff + yloop) * pitch + xoff;
+                pv = pvideo;
+
+                for (xloop = 0; xloop < width; xloop += 8, bit += 8, pv += 8) {
+                        n = width - xloop;
+                        if (n > 8)
+                                n = 8;
+
+                        bits = glyph1_bits(pixel, bit, n);
+                        if (bits == 0)
+                                continue;
+
+                        if (bits == 0xFF) {
+                                pv[0] = fgcol; pv[1] = fgcol;
+                                pv[2] = fgcol; pv[3] = fgcol;
+                                pv[4] = fgcol; pv[5] = fgcol;
+                                pv[6] = fgcol; pv[7] = fgcol;
+                                continue;
+                        }
+
+                        mask = nsfb_kernel_glyph1_mask[bits];
+                        for (i = 0; i < n; i++)
+                                pv[i] ^= (pv[i] ^ fgcol) & (PLOT_TYPE)mask[i];
+                }
+                pvideo += PLOT_LINELEN(nsfb->linelen);
+        }
+}
+
 static bool
 glyph1(nsfb_t *nsfb,
        nsfb_bbox_t *loc,
@@ -139,47 +608,65 @@ glyph1(nsfb_t *nsfb,
        int pitch,
        nsfb_colour_t c)
 {
-        PLOT_TYPE *pvideo;
-        PLOT_TYPE const *pvideo_limit;
-        PLOT_TYPE fgcol;
-        int xloop;
-        int xoff, yoff; /* x and y offset into image */
         int x = loc->x0;
         int y = loc->y0;
-        int width;
-        int height;
-        const size_t line_len = PLOT_LINELEN(nsfb->linelen);
-        const int first_col = 1 << (loc->x1 - loc->x0 - 1);
-        const uint8_t *row;
 
         if (!nsfb_plot_clip_ctx(nsfb, loc))
                 return true;
 
-        height = loc->y1 - y;
-        width = loc->x1 - x;
+        glyph1_area(nsfb, loc, loc->x0 - x, loc->y0 - y, pixel, pitch,
+                    colour_to_pixel(nsfb, c));
 
-        xoff = loc->x0 - x;
-        yoff = loc->y0 - y;
+        return true;
+}
 
-        fgcol = colour_to_pixel(nsfb, c);
+/* plot the clipped area of an 8bpp glyph.
+ *
+ * Parameters as glyph1_area() except the colour is not converted as each
+ * pixel is blended.
+ */
+static void
+glyph8_area(nsfb_t *nsfb,
+            const nsfb_bbox_t *loc,
+            int xoff,
+            int yoff,
+            const uint8_t *pixel,
+            int pitch,
+            nsfb_colour_t fgcol)
+{
+        PLOT_TYPE *pvideo;
+        nsfb_colour_t abpixel; /* alphablended pixel */
+        int xloop, yloop;
+        int width = loc->x1 - loc->x0;
+        int height = loc->y1 - loc->y0;
 
-        pitch >>= 3; /* bits to bytes */
+        pvideo = get_xy_loc(nsfb, loc->x0, loc->y0);
 
-        pvideo = get_xy_loc(nsfb, x, loc->y0);
-        pvideo_limit = pvideo + line_len * (height - yoff);
-        row = pixel + yoff * pitch;
+        if (glyph_kernel(nsfb)) {
+                for (yloop = 0; yloop < height; yloop++) {
+                        glyph_row(nsfb, pvideo,
+                                  pixel + ((yoff + yloop) * pitch) + xoff,
+                                  width, fgcol);
+                        pvideo += PLOT_LINELEN(nsfb->linelen);
+                }
+                return;
+        }
 
-        for (; pvideo < pvideo_limit; pvideo += line_len) {
-                for (xloop = xoff; xloop < width; xloop++) {
+        for (yloop = 0; yloop < height; yloop++) {
+                for (xloop = 0; xloop < width; xloop++) {
+                        abpixel = (pixel[((yoff + yloop) * pitch) + xloop + xoff] << 24) | fgcol;
+                        if ((abpixel & 0xFF000000) != 0) {
+                                /* pixel is not transparent */
+                                if ((abpixel & 0xFF000000) != 0xFF000000) {
+                                        abpixel = nsfb_plot_ablend(abpixel,
+                                                                   pixel_to_colour(nsfb, *(pvideo + xloop)));
+                                }
 
-                        if ((*row & (first_col >> xloop)) != 0) {
-                                *(pvideo + xloop) = fgcol;
+                                *(pvideo + xloop) = colour_to_pixel(nsfb, abpixel);
                         }
                 }
-                row += pitch;
+                pvideo += PLOT_LINELEN(nsfb->linelen);
         }
-
-        return true;
 }
 
 static bool
@@ -189,68 +676,400 @@ glyph8(nsfb_t *nsfb,
        int pitch,
        nsfb_colour_t c)
 {
-        PLOT_TYPE *pvideo;
-        nsfb_colour_t fgcol;
-        nsfb_colour_t abpixel; /* alphablended pixel */
-        int xloop, yloop;
-        int xoff, yoff; /* x and y offset into image */
         int x = loc->x0;
         int y = loc->y0;
-        int width;
-        int height;
 
         if (!nsfb_plot_clip_ctx(nsfb, loc))
                 return true;
 
-        height = (loc->y1 - loc->y0);
-        width = (loc->x1 - loc->x0);
+        glyph8_area(nsfb, loc, loc->x0 - x, loc->y0 - y, pixel, pitch,
+                    c & 0xFFFFFF);
+
+        return true;
+}
+
+static bool
+glyph_run(nsfb_t *nsfb,
+          nsfb_plot_glyph_format_t format,
+          const nsfb_plot_glyph_t *glyphs,
+          int glyphc,
+          nsfb_colour_t c)
+{
+        nsfb_bbox_t run; /* extent of the whole run */
+        nsfb_bbox_t loc;
+        PLOT_TYPE fgpix = 0;
+        bool inside;
+        int gloop;
 
-        xoff = loc->x0 - x;
-        yoff = loc->y0 - y;
+        if (glyphc <= 0)
+                return true;
 
-        pvideo = get_xy_loc(nsfb, loc->x0, loc->y0);
+        run = glyphs[0].loc;
+        for (gloop = 1; gloop < glyphc; gloop++) {
+                if (glyphs[gloop].loc.x0 < run.x0)
+                        run.x0 = glyphs[gloop].loc.x0;
+                if (glyphs[gloop].loc.y0 < run.y0)
+                        run.y0 = glyphs[gloop].loc.y0;
+                if (glyphs[gloop].loc.x1 > run.x1)
+                        run.x1 = glyphs[gloop].loc.x1;
+                if (glyphs[gloop].loc.y1 > run.y1)
+                        run.y1 = glyphs[gloop].loc.y1;
+        }
+
+        /* reject the whole run if it lies outside the clipping region and
+         * skip clipping each glyph if it lies entirely within it
+         */
+        if ((run.x1 <= nsfb->clip.x0) ||
+            (run.y1 <= nsfb->clip.y0) ||
+            (run.x0 >= nsfb->clip.x1) ||
+            (run.y0 >= nsfb->clip.y1))
+                return true;
 
-        fgcol = c & 0xFFFFFF;
+        inside = ((run.x0 >= nsfb->clip.x0) &&
+                  (run.y0 >= nsfb->clip.y0) &&
+                  (run.x1 <= nsfb->clip.x1) &&
+                  (run.y1 <= nsfb->clip.y1));
+
+        if (format == NSFB_PLOT_GLYPH_1BPP)
+                fgpix = colour_to_pixel(nsfb, c);
+
+        for (gloop = 0; gloop < glyphc; gloop++) {
+                loc = glyphs[gloop].loc;
+                if (!inside && !nsfb_plot_clip_ctx(nsfb, &loc))
+                        continue;
+
+                if (format == NSFB_PLOT_GLYPH_1BPP) {
+                        glyph1_area(nsfb, &loc,
+                                    loc.x0 - glyphs[gloop].loc.x0,
+                                    loc.y0 - glyphs[gloop].loc.y0,
+                                    glyphs[gloop].pixel,
+                                    glyphs[gloop].pitch,
+                                    fgpix);
+                } else {
+                        glyph8_area(nsfb, &loc,
+                                    loc.x0 - glyphs[gloop].loc.x0,
+                                    loc.y0 - glyphs[gloop].loc.y0,
+                                    glyphs[gloop].pixel,
+                                    glyphs[gloop].pitch,
+                                    c & 0xFFFFFF);
+                }
+        }
 
+        return true;
+}
+
+/* number of pixels blended by the coverage kernel in one go */
+#define FILL_BLEND_CHUNK 256
+
+/* combine a translucent colour with each pixel of an area by an operator.
+ *
+ * The area must lie within the clipping region. Colours drawn over the
+ * destination go through the glyph kernel with a constant coverage of the
+ * colour's alpha where the format has one.
+ */
+static void
+fill_compose(nsfb_t *nsfb,
+             PLOT_TYPE *pvideo,
+             int width,
+             int height,
+             nsfb_colour_t c,
+             nsfb_plot_op_t op)
+{
+        uint8_t cov[FILL_BLEND_CHUNK];
+        PLOT_TYPE *pv;
+        PLOT_TYPE last_in = 0; /* last destination pixel composed */
+        PLOT_TYPE last_out = 0; /* and the result of composing it */
+        bool have_last = false;
+        int xloop, yloop;
+        int n;
+
+        if ((op == NSFB_PLOT_OP_OVER) && glyph_kernel(nsfb)) {
+                memset(cov, c >> 24, (width < FILL_BLEND_CHUNK) ?
+                       width : FILL_BLEND_CHUNK);
+                for (yloop = 0; yloop < height; yloop++) {
+                        for (xloop = 0; xloop < width; xloop += n) {
+                                n = width - xloop;
+                                if (n > FILL_BLEND_CHUNK)
+                                        n = FILL_BLEND_CHUNK;
+                                glyph_row(nsfb, pvideo + xloop, cov, n,
+                                          c & 0xFFFFFF);
+                        }
+                        pvideo += PLOT_LINELEN(nsfb->linelen);
+                }
+                return;
+        }
+
+        /* the colour is constant so runs of equal destination pixels
+         * compose to the same result, which saves the conversions
+         */
         for (yloop = 0; yloop < height; yloop++) {
+                pv = pvideo;
+                for (xloop = 0; xloop < width; xloop++, pv++) {
+                        if (!have_last || (*pv != last_in)) {
+                                last_in = *pv;
+                                last_out = colour_to_pixel(nsfb,
+                                        compose_colour(c,
+                                                pixel_to_colour(nsfb, *pv),
+                                                op));
+                                have_last = true;
+                        }
+                        *pv = last_out;
+                }
+                pvideo += PLOT_LINELEN(nsfb->linelen);
+        }
+}
+
+/* fill a rectangle combining a colour with each pixel by an operator.
+ *
+ * Opaque colours drawn over the destination are stored by the plain fill.
+ */
+static bool
+fill_op(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t c, nsfb_plot_op_t op)
+{
+        if ((op == NSFB_PLOT_OP_SRC) ||
+            ((op == NSFB_PLOT_OP_OVER) && ((c >> 24) == 0xFF)))
+                return nsfb->plotter_fns->fill(nsfb, rect, c);
+
+        if ((c >> 24) == 0)
+                return true; /* transparent leaves the destination alone */
+
+        if (!nsfb_plot_clip_ctx(nsfb, rect))
+                return true; /* fill lies outside current clipping region */
+
+        fill_compose(nsfb, get_xy_loc(nsfb, rect->x0, rect->y0),
+                     rect->x1 - rect->x0, rect->y1 - rect->y0, c, op);
+
+        return true;
+}
+
+/* rectangles narrower than this are filled without the fill kernel */
+#define FILL_RECTS_NARROW 8
+
+/* fill many rectangles a band of rows at a time.
+ *
+ * The rectangles are clipped together into arrays of their edges and
+ * bucketed by their top row. The rows are then walked from top to bottom
+ * in bands over which the same rectangles are present, filling the part
+ * of each rectangle within the band in the order the rectangles were
+ * given, so overlaps come out as if they had been filled one after
+ * another.
+ */
+static bool
+fill_rects(nsfb_t *nsfb,
+           int rectc,
+           const nsfb_bbox_t *rect,
+           const nsfb_colour_t *colour)
+{
+        int *x0, *y0, *x1, *y1; /* clipped edges of each kept rectangle */
+        int *src; /* index of each kept rectangle in the parameters */
+        int *opaque; /* whether each kept rectangle is opaque */
+        int *order; /* kept rectangles by top row */
+        int *start; /* index into order of the first on each row */
+        int *active; /* rectangles crossing the band, in parameter order */
+        uint32_t *ent; /* native colour of each kept rectangle */
+        int clipx0 = nsfb->clip.x0, clipy0 = nsfb->clip.y0;
+        int clipx1 = nsfb->clip.x1, clipy1 = nsfb->clip.y1;
+        int rows = clipy1 - clipy0;
+        int keptc = 0;
+        int activec = 0;
+        int i, j, k;
+        int y, band, next;
+        int t0, t1;
+        PLOT_TYPE *pvideo;
+        PLOT_TYPE *pv;
+        nsfb_colour_t c;
+
+        if ((rectc <= 0) || (rows <= 0) || (clipx1 <= clipx0))
+                return true;
+
+        x0 = malloc(rectc * (8 * sizeof(int) + sizeof(uint32_t)) +
+                    (rows + 1) * sizeof(int));
+        if (x0 == NULL)
+                return false;
+        y0 = x0 + rectc;
+        x1 = y0 + rectc;
+        y1 = x1 + rectc;
+        src = y1 + rectc;
+        opaque = src + rectc;
+        order = opaque + rectc;
+        active = order + rectc;
+        start = active + rectc;
+        ent = (uint32_t *)(start + rows + 1);
+
+        /* clip every rectangle, dropping empty and transparent ones */
+        for (i = 0; i < rectc; i++) {
+                t0 = rect[i].x0; t1 = rect[i].x1;
+                x0[keptc] = (t0 < t1) ? t0 : t1;
+                x1[keptc] = (t0 < t1) ? t1 : t0;
+                t0 = rect[i].y0; t1 = rect[i].y1;
+                y0[keptc] = (t0 < t1) ? t0 : t1;
+                y1[keptc] = (t0 < t1) ? t1 : t0;
+
+                if (x0[keptc] < clipx0) x0[keptc] = clipx0;
+                if (x1[keptc] > clipx1) x1[keptc] = clipx1;
+                if (y0[keptc] < clipy0) y0[keptc] = clipy0;
+                if (y1[keptc] > clipy1) y1[keptc] = clipy1;
+
+                src[keptc] = i;
+                keptc += ((x0[keptc] < x1[keptc]) &&
+                          (y0[keptc] < y1[keptc]) &&
+                          ((colour[i] >> 24) != 0));
+        }
+
+        /* counting sort by top row, which keeps the parameter order of
+         * rectangles starting on the same row
+         */
+        memset(start, 0, (rows + 1) * sizeof(int));
+        for (i = 0; i < keptc; i++)
+                start[y0[i] - clipy0 + 1]++;
+        for (y = 0; y < rows; y++)
+                start[y + 1] += start[y];
+        for (i = 0; i < keptc; i++)
+                order[start[y0[i] - clipy0]++] = i;
+        for (y = rows; y > 0; y--)
+                start[y] = start[y - 1];
+        start[0] = 0;
+
+        /* converted colours, or the colour itself for translucent ones */
+        for (i = 0; i < keptc; i++) {
+                c = colour[src[i]];
+                opaque[i] = ((c >> 24) == 0xFF);
+                ent[i] = opaque[i] ? colour_to_pixel(nsfb, c) : c;
+        }
+
+        next = 0;
+        for (y = clipy0; y < clipy1; y = band) {
+                if (activec == 0) {
+                        if (next == keptc)
+                                break;
+                        y = y0[order[next]]; /* skip empty rows */
+                }
+
+                /* add the rectangles starting on this row */
+                for (; (next < start[y - clipy0 + 1]); next++) {
+                        k = order[next];
+                        for (j = activec; (j > 0) && (active[j - 1] > k); j--)
+                                active[j] = active[j - 1];
+                        active[j] = k;
+                        activec++;
+                }
+
+                /* the band ends where a rectangle starts or ends */
+                band = (next < keptc) ? y0[order[next]] : clipy1;
+                for (i = 0; i < activec; i++) {
+                        if (y1[active[i]] < band)
+                                band = y1[active[i]];
+                }
+
+                pvideo = get_xy_loc(nsfb, 0, y);
+                for (i = 0, j = 0; i < activec; i++) {
+                        k = active[i];
+                        if (opaque[k] && (x1[k] - x0[k] < FILL_RECTS_NARROW)) {
+                                /* cheaper stored directly than through
+                                 * the fill kernel */
+                                pv = pvideo + x0[k];
+                                for (t0 = y; t0 < band; t0++) {
+                                        for (t1 = 0; t1 < x1[k] - x0[k]; t1++)
+                                                pv[t1] = ent[k];
+                                        pv += PLOT_LINELEN(nsfb->linelen);
+                                }
+                        } else if (opaque[k]) {
+                                fill_area(nsfb, pvideo + x0[k], x1[k] - x0[k],
+                                          band - y, ent[k]);
+                        } else {
+                                fill_compose(nsfb, pvideo + x0[k],
+                                             x1[k] - x0[k], band - y,
+                                             ent[k], NSFB_PLOT_OP_OVER);
+                        }
+
+                        /* retire the rectangles ending with the band */
+                        if (y1[k] > band)
+                                active[j++] = k;
+                }
+                activec = j;
+        }
+
+        free(x0);
+
+        return true;
+}
+
+/* plot a row of colours, combining them with the destination by op */
+static inline void
+bitmap_row(nsfb_t *nsfb,
+           PLOT_TYPE *pvideo,
+           const nsfb_colour_t *pixel,
+           int width,
+           nsfb_plot_op_t op)
+{
+        nsfb_colour_t abpixel; /* alphablended pixel */
+        int xloop;
+
+        if ((op == NSFB_PLOT_OP_OVER) && blend_kernel(nsfb)) {
+                blend_row(nsfb, pvideo, pixel, width);
+        } else if (op == NSFB_PLOT_OP_OVER) {
                 for (xloop = 0; xloop < width; xloop++) {
-                        abpixel = (pixel[((yoff + yloop) * pitch) + xloop + xoff] << 24) | fgcol;
+                        abpixel = pixel[xloop];
                         if ((abpixel & 0xFF000000) != 0) {
-                                /* pixel is not transparent */
+                                /* pixel is not transparent; have to
+                                 * plot something */
                                 if ((abpixel & 0xFF000000) != 0xFF000000) {
-                                        abpixel = nsfb_plot_ablend(abpixel,
-                                                                   pixel_to_colour(nsfb, *(pvideo + xloop)));
+                                        /* pixel is not opaque; need to
+                                         * blend */
+                                        abpixel = nsfb_plot_ablend(
+                                                        abpixel,
+                                                        pixel_to_colour(
+                                                        nsfb,
+                                                        *(pvideo + xloop)));
                                 }
 
-                                *(pvideo + xloop) = colour_to_pixel(nsfb, abpixel);
+                                *(pvideo + xloop) = colour_to_pixel(
+                                                nsfb, abpixel);
                         }
                 }
-                pvideo += PLOT_LINELEN(nsfb->linelen);
+        } else if (op == NSFB_PLOT_OP_SRC) {
+                for (xloop = 0; xloop < width; xloop++) {
+                        *(pvideo + xloop) = colour_to_pixel(
+                                        nsfb, pixel[xloop]);
+                }
+        } else {
+                for (xloop = 0; xloop < width; xloop++) {
+                        if ((pixel[xloop] & 0xFF000000) == 0)
+                                continue;
+
+                        *(pvideo + xloop) = colour_to_pixel(nsfb,
+                                        compose_colour(pixel[xloop],
+                                                pixel_to_colour(nsfb,
+                                                        *(pvideo + xloop)),
+                                                op));
+                }
         }
+}
 
-        return true;
+/* the operator a bitmap plot asks for with its flags */
+static inline nsfb_plot_op_t bitmap_flags_op(unsigned int flags)
+{
+        return (flags & NSFB_PLOT_BITMAP_ALPHA) ?
+                NSFB_PLOT_OP_OVER : NSFB_PLOT_OP_SRC;
 }
 
 static bool bitmap_scaled(nsfb_t *nsfb, const nsfb_bbox_t *loc,
 		const nsfb_colour_t *pixel, int bmp_width, int bmp_height,
-		int bmp_stride, bool alpha)
+		int bmp_stride, unsigned int flags, nsfb_plot_op_t op)
 {
 	PLOT_TYPE *pvideo;
-	PLOT_TYPE *pvideo_limit;
-	nsfb_colour_t abpixel; /* alphablended pixel */
-	int xloop;
-	int xoff, yoff, xoffs; /* x and y offsets into image */
+	nsfb_scale_t scale;
+	int yloop;
 	int x = loc->x0;
 	int y = loc->y0;
 	int width = loc->x1 - loc->x0; /* size to scale to */
 	int height = loc->y1 - loc->y0; /* size to scale to */
-	int rheight, rwidth; /* post-clipping render area dimensions */
-	int dx, dy; /* scale factor (integer part) */
-	int dxr, dyr; /* scale factor (remainder) */
-	int rx, ry, rxs; /* remainder trackers */
 	nsfb_bbox_t clipped; /* clipped display */
 	bool set_dither = false; /* true iff we enabled dithering here */
 
+	if (bmp_width <= 0 || bmp_height <= 0 || width <= 0 || height <= 0)
+		return true;
+
 	/* The part of the scaled image actually displayed is cropped to the
 	 * current context. */
 	clipped.x0 = x;
@@ -261,147 +1080,49 @@ static bool bitmap_scaled(nsfb_t *nsfb, const nsfb_bbox_t *loc,
 	if (!nsfb_plot_clip_ctx(nsfb, &clipped))
 		return true;
 
-	/* get height of rendering region, after clipping */
-	if (height > (clipped.y1 - clipped.y0))
-		rheight = (clipped.y1 - clipped.y0);
-	else
-		rheight = height;
-
-	/* get width of rendering region, after clipping */
-	if (width > (clipped.x1 - clipped.x0))
-		rwidth = (clipped.x1 - clipped.x0);
-	else
-		rwidth = width;
+	/* the source columns and weights of every plotted column are
+	 * worked out once, leaving only the rows to produce */
+	if (!nsfb_scale_init(&scale, nsfb->kernel_fns, flags, pixel,
+			bmp_width, bmp_height, bmp_stride, width, height,
+			clipped.x0 - x, clipped.x1 - x))
+		return false;
 
 	/* Enable error diffusion for paletted screens, if not already on */
 	if (nsfb->palette != NULL &&
 			nsfb_palette_dithering_on(nsfb->palette) == false) {
-		nsfb_palette_dither_init(nsfb->palette, rwidth);
+		nsfb_palette_dither_init(nsfb->palette, scale.width);
 		set_dither = true;
 	}
 
-	/* get veritcal (y) and horizontal (x) scale factors; both integer
-	 * part and remainder */
-	dx = bmp_width / width;
-	dy = (bmp_height / height) * bmp_stride;
-	dxr = bmp_width % width;
-	dyr = bmp_height % height;
-
-	/* get start offsets to part of image being scaled, after clipping and
-	 * set remainder trackers to correct starting value */
-	if (clipped.x0 - x != 0) {
-		xoffs = ((clipped.x0 - x) * bmp_width) / width;
-		rxs = ((clipped.x0 - x) * bmp_width) % width;
-	} else {
-		xoffs = 0;
-		rxs = 0;
-	}
-	if (clipped.y0 - y != 0) {
-		yoff = (((clipped.y0 - y) * bmp_height) / height) * bmp_stride;
-		ry = ((clipped.y0 - y) * bmp_height) % height;
-	} else {
-		yoff = 0;
-		ry = 0;
-	}
-
 	/* plot the image */
 	pvideo = get_xy_loc(nsfb, clipped.x0, clipped.y0);
-	pvideo_limit = pvideo + PLOT_LINELEN(nsfb->linelen) * rheight;
-	if (alpha) {
-		for (; pvideo < pvideo_limit;
-				pvideo += PLOT_LINELEN(nsfb->linelen)) {
-			/* looping through render area vertically */
-			xoff = xoffs;
-			rx = rxs;
-			for (xloop = 0; xloop < rwidth; xloop++) {
-				/* looping through render area horizontally */
-				/* get value of source pixel in question */
-				abpixel = pixel[yoff + xoff];
-				if ((abpixel & 0xFF000000) != 0) {
-					/* pixel is not transparent; have to
-					 * plot something */
-					if ((abpixel & 0xFF000000) !=
-							0xFF000000) {
-						/* pixel is not opaque; need to
-						 * blend */
-						abpixel = nsfb_plot_ablend(
-								abpixel,
-								pixel_to_colour(
-								nsfb, 
-								*(pvideo +
-								xloop)));
-					}
-					/* plot pixel */
-					*(pvideo + xloop) = colour_to_pixel(
-							nsfb, abpixel);
-				}
-				/* handle horizontal interpolation */
-				xoff += dx;
-				rx += dxr;
-				if (rx >= width) {
-					xoff++;
-					rx -= width;
-				}
-			}
-			/* handle vertical interpolation */
-			yoff += dy;
-			ry += dyr;
-			if (ry >= height) {
-				yoff += bmp_stride;
-				ry -= height;
-			}
-		}
-	} else {
-		for (; pvideo < pvideo_limit;
-				pvideo += PLOT_LINELEN(nsfb->linelen)) {
-			/* looping through render area vertically */
-			xoff = xoffs;
-			rx = rxs;
-			for (xloop = 0; xloop < rwidth; xloop++) {
-				/* looping through render area horizontally */
-				/* get value of source pixel in question */
-				abpixel = pixel[yoff + xoff];
-				/* plot pixel */
-				*(pvideo + xloop) = colour_to_pixel(
-						nsfb, abpixel);
-
-				/* handle horizontal interpolation */
-				xoff += dx;
-				rx += dxr;
-				if (rx >= width) {
-					xoff++;
-					rx -= width;
-				}
-			}
-			/* handle vertical interpolation */
-			yoff += dy;
-			ry += dyr;
-			if (ry >= height) {
-				yoff += bmp_stride;
-				ry -= height;
-			}
-		}
+	for (yloop = clipped.y0 - y; yloop < clipped.y1 - y; yloop++) {
+		bitmap_row(nsfb, pvideo, nsfb_scale_row(&scale, yloop),
+				scale.width, op);
+		pvideo += PLOT_LINELEN(nsfb->linelen);
 	}
 
 	if (set_dither) {
 		nsfb_palette_dither_fini(nsfb->palette);
 	}
 
+	nsfb_scale_fini(&scale);
+
 	return true;
 }
 
 static bool
-bitmap(nsfb_t *nsfb,
-       const nsfb_bbox_t *loc,
-       const nsfb_colour_t *pixel,
-       int bmp_width,
-       int bmp_height,
-       int bmp_stride,
-       bool alpha)
+bitmap_op(nsfb_t *nsfb,
+          const nsfb_bbox_t *loc,
+          const nsfb_colour_t *pixel,
+          int bmp_width,
+          int bmp_height,
+          int bmp_stride,
+          unsigned int flags,
+          nsfb_plot_op_t op)
 {
         PLOT_TYPE *pvideo;
-        nsfb_colour_t abpixel; /* alphablended pixel */
-        int xloop, yloop;
+        int yloop;
         int xoff, yoff; /* x and y offset into image */
         int x = loc->x0;
         int y = loc->y0;
@@ -413,10 +1134,15 @@ bitmap(nsfb_t *nsfb,
         if (width == 0 || height == 0)
                 return true;
 
-        /* Scaled bitmaps are handled by a separate function */
+        /* Scaled bitmaps are handled by a separate function, which
+         * filters by alpha for every operator that uses it */
+        flags &= ~NSFB_PLOT_BITMAP_ALPHA;
+        if (op != NSFB_PLOT_OP_SRC)
+                flags |= NSFB_PLOT_BITMAP_ALPHA;
+
         if (width != bmp_width || height != bmp_height)
                 return bitmap_scaled(nsfb, loc, pixel, bmp_width, bmp_height,
-                                bmp_stride, alpha);
+                                bmp_stride, flags, op);
 
         /* The part of the image actually displayed is cropped to the
          * current context. */
@@ -448,40 +1174,9 @@ bitmap(nsfb_t *nsfb,
         /* plot the image */
         pvideo = get_xy_loc(nsfb, clipped.x0, clipped.y0);
 
-        if (alpha) {
-                for (yloop = yoff; yloop < height; yloop += bmp_stride) {
-                        for (xloop = 0; xloop < width; xloop++) {
-                                abpixel = pixel[yloop + xloop + xoff];
-                                if ((abpixel & 0xFF000000) != 0) {
-                                        /* pixel is not transparent; have to
-                                         * plot something */
-                                        if ((abpixel & 0xFF000000) !=
-                                                       0xFF000000) {
-                                                /* pixel is not opaque; need to
-                                                 * blend */
-                                                abpixel = nsfb_plot_ablend(
-                                                                abpixel,
-                                                                pixel_to_colour(
-                                                                nsfb,
-                                                                *(pvideo +
-                                                                xloop)));
-                                        }
-
-                                        *(pvideo + xloop) = colour_to_pixel(
-                                                        nsfb, abpixel);
-                                }
-                        }
-                        pvideo += PLOT_LINELEN(nsfb->linelen);
-                }
-        } else {
-                for (yloop = yoff; yloop < height; yloop += bmp_stride) {
-                        for (xloop = 0; xloop < width; xloop++) {
-                                abpixel = pixel[yloop + xloop + xoff];
-                                *(pvideo + xloop) = colour_to_pixel(
-                                                nsfb, abpixel);
-                        }
-                        pvideo += PLOT_LINELEN(nsfb->linelen);
-                }
+        for (yloop = yoff; yloop < height; yloop += bmp_stride) {
+                bitmap_row(nsfb, pvideo, pixel + yloop + xoff, width, op);
+                pvideo += PLOT_LINELEN(nsfb->linelen);
         }
 
         if (set_dither) {
@@ -491,6 +1186,19 @@ bitmap(nsfb_t *nsfb,
         return true;
 }
 
+static bool
+bitmap(nsfb_t *nsfb,
+       const nsfb_bbox_t *loc,
+       const nsfb_colour_t *pixel,
+       int bmp_width,
+       int bmp_height,
+       int bmp_stride,
+       unsigned int flags)
+{
+        return bitmap_op(nsfb, loc, pixel, bmp_width, bmp_height, bmp_stride,
+                         flags, bitmap_flags_op(flags));
+}
+
 static inline bool
 bitmap_tiles_x(nsfb_t *nsfb,
 		const nsfb_bbox_t *loc,
@@ -720,7 +1428,8 @@ bitmap_tiles(nsfb_t *nsfb,
 			for (tx = 0; tx < tiles_x; tx++) {
 				ok &= bitmap_scaled(nsfb, &tloc, pixel,
 						bmp_width, bmp_height,
-						bmp_stride, alpha);
+						bmp_stride, alpha,
+						bitmap_flags_op(alpha));
 				tloc.x0 += width;
 				tloc.x1 += width;
 			}
@@ -762,6 +1471,127 @@ bitmap_tiles(nsfb_t *nsfb,
 	return ok;
 }
 
+static bool
+convert(nsfb_t *nsfb, const nsfb_colour_t *colour, void *pixel, int width)
+{
+        PLOT_TYPE *pvideo = pixel;
+        int xloop;
+
+        for (xloop = 0; xloop < width; xloop++)
+                pvideo[xloop] = colour_to_pixel(nsfb, colour[xloop]);
+
+        return true;
+}
+
+static bool
+blend(nsfb_t *nsfb, int x, int y, const nsfb_colour_t *colour, int width)
+{
+        bitmap_row(nsfb, get_xy_loc(nsfb, x, y), colour, width,
+                   NSFB_PLOT_OP_OVER);
+
+        return true;
+}
+
+static bool
+spans(nsfb_t *nsfb, int y, const int *x, int spanc, nsfb_colour_t c)
+{
+        PLOT_TYPE *pvideo = get_xy_loc(nsfb, 0, y);
+        PLOT_TYPE ent = colour_to_pixel(nsfb, c);
+
+        for (; spanc > 0; spanc--, x += 2)
+                fill_row(nsfb, pvideo + x[0], x[1] - x[0], ent);
+
+        return true;
+}
+
+static bool
+coverage(nsfb_t *nsfb,
+         int x,
+         int y,
+         const uint8_t *cov,
+         int width,
+         nsfb_colour_t c)
+{
+        nsfb_bbox_t loc;
+
+        loc.x0 = x;
+        loc.y0 = y;
+        loc.x1 = x + width;
+        loc.y1 = y + 1;
+
+        glyph8_area(nsfb, &loc, 0, 0, cov, width, c & 0xFFFFFF);
+
+        return true;
+}
+
+static bool
+span_list(nsfb_t *nsfb,
+          int spanc,
+          const nsfb_plot_span_t *span,
+          nsfb_colour_t c)
+{
+        uint8_t scaled[FILL_BLEND_CHUNK]; /* coverage scaled by alpha */
+        const uint8_t *cov;
+        nsfb_bbox_t loc;
+        PLOT_TYPE ent = colour_to_pixel(nsfb, c);
+        unsigned int alpha;
+        int x0, x1;
+        int i, n;
+
+        for (; spanc > 0; spanc--, span++) {
+                if ((span->y < nsfb->clip.y0) || (span->y >= nsfb->clip.y1))
+                        continue;
+
+                x0 = (span->x0 < nsfb->clip.x0) ? nsfb->clip.x0 : span->x0;
+                x1 = (span->x1 > nsfb->clip.x1) ? nsfb->clip.x1 : span->x1;
+                if (x0 >= x1)
+                        continue;
+
+                alpha = (span->alpha * (c >> 24) + 127) / 255;
+                if (alpha == 0)
+                        continue;
+
+                if (span->cov == NULL) {
+                        if (alpha == 0xFF) {
+                                fill_row(nsfb, get_xy_loc(nsfb, x0, span->y),
+                                         x1 - x0, ent);
+                        } else {
+                                fill_compose(nsfb,
+                                             get_xy_loc(nsfb, x0, span->y),
+                                             x1 - x0, 1,
+                                             (c & 0xFFFFFF) | (alpha << 24),
+                                             NSFB_PLOT_OP_OVER);
+                        }
+                        continue;
+                }
+
+                cov = span->cov + (x0 - span->x0);
+                loc.y0 = span->y;
+                loc.y1 = span->y + 1;
+
+                if (alpha == 0xFF) {
+                        loc.x0 = x0;
+                        loc.x1 = x1;
+                        glyph8_area(nsfb, &loc, 0, 0, cov, 0, c & 0xFFFFFF);
+                        continue;
+                }
+
+                /* the coverage is scaled by the alpha a chunk at a time */
+                for (loc.x0 = x0; loc.x0 < x1; loc.x0 += n, cov += n) {
+                        n = x1 - loc.x0;
+                        if (n > FILL_BLEND_CHUNK)
+                                n = FILL_BLEND_CHUNK;
+                        for (i = 0; i < n; i++)
+                                scaled[i] = (cov[i] * alpha + 127) / 255;
+                        loc.x1 = loc.x0 + n;
+                        glyph8_area(nsfb, &loc, 0, 0, scaled, 0,
+                                    c & 0xFFFFFF);
+                }
+        }
+
+        return true;
+}
+
 static bool readrect(nsfb_t *nsfb, nsfb_bbox_t *rect, nsfb_colour_t *buffer)
 {
         PLOT_TYPE *pvideo;
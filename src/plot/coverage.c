@@ -0,0 +1,446 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Anti-aliased fill rasterizer (implementation).
+ *
+ * Contours are rasterized a row at a time. Every edge crossing the row
+ * adds, to the column each part of it lies in, the height it covers and
+ * the area it leaves to its right within that column. Summing the heights
+ * from the left then gives the winding of each pixel, scaled by 256, and
+ * subtracting the area accumulated in the pixel itself corrects that for
+ * edges passing through it. This is the cell accumulation scheme of the
+ * FreeType and AGG rasterizers held in a dense buffer. As with those,
+ * pixels holding areas of several different windings get the coverage of
+ * their average winding.
+ *
+ * The row buffer spans the columns of the contours within the surface,
+ * whatever the clip, so a pixel gets the same coverage however the plot is
+ * clipped or split into tiles and bands. Only the columns inside the
+ * clipping region are plotted. Parts of edges left of the surface are
+ * replaced by vertical edges along its left side, which leaves the winding
+ * of everything to their right unchanged, and parts to the right of it are
+ * dropped.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+
+#include "nsfb.h"
+#include "plot.h"
+#include "coverage.h"
+
+#define ONE (1 << NSFB_PLOT_SUBPIXEL_SHIFT)
+
+/** An edge of a contour, kept in the direction it was given. */
+struct cov_edge {
+        int x0, y0; /**< first vertex */
+        int x1, y1; /**< second vertex */
+        int top, bottom; /**< vertical extent */
+};
+
+/** Accumulation buffer for a row. */
+struct cov_row {
+        int x0; /**< first column of the buffer */
+        int width; /**< number of columns accumulated */
+        int clip0, clip1; /**< columns plotted, relative to the buffer */
+        int *cover; /**< height covered in each column */
+        int *area; /**< area right of the edges in each column */
+        int min, max; /**< columns touched on this row */
+};
+
+static int cov_edge_cmp(const void *a, const void *b)
+{
+        return ((const struct cov_edge *)a)->top -
+                ((const struct cov_edge *)b)->top;
+}
+
+/* x coordinate of an edge at a y coordinate */
+static inline int cov_edge_x(const struct cov_edge *e, int y)
+{
+        return e->x0 + ((int64_t)(y - e->y0) * (e->x1 - e->x0)) /
+                (e->y1 - e->y0);
+}
+
+static inline void
+cov_cell(struct cov_row *row, int ex, int cover, int area)
+{
+        row->cover[ex] += cover;
+        row->area[ex] += area;
+        if (ex < row->min)
+                row->min = ex;
+        if (ex > row->max)
+                row->max = ex;
+}
+
+/* accumulate a line within the row.
+ *
+ * x coordinates are relative to the start of the buffer and y coordinates
+ * to the top of the row, both in subpixels.
+ */
+static void
+cov_hline(struct cov_row *row, int x1, int y1, int x2, int y2)
+{
+        int ex1 = x1 >> NSFB_PLOT_SUBPIXEL_SHIFT;
+        int ex2 = x2 >> NSFB_PLOT_SUBPIXEL_SHIFT;
+        int fx1 = x1 & (ONE - 1);
+        int fx2 = x2 & (ONE - 1);
+        int first, incr;
+        int delta, lift, mod, rem;
+        int p, dx;
+
+        if (y1 == y2)
+                return;
+
+        /* within a single column */
+        if (ex1 == ex2) {
+                delta = y2 - y1;
+                cov_cell(row, ex1, delta, (fx1 + fx2) * delta);
+                return;
+        }
+
+        /* across several columns, the first and last partially */
+        p = (ONE - fx1) * (y2 - y1);
+        first = ONE;
+        incr = 1;
+        dx = x2 - x1;
+        if (dx < 0) {
+                p = fx1 * (y2 - y1);
+                first = 0;
+                incr = -1;
+                dx = -dx;
+        }
+
+        delta = p / dx;
+        mod = p % dx;
+        if (mod < 0) {
+                delta--;
+                mod += dx;
+        }
+        cov_cell(row, ex1, delta, (fx1 + first) * delta);
+        ex1 += incr;
+        y1 += delta;
+
+        if (ex1 != ex2) {
+                p = ONE * (y2 - y1 + delta);
+                lift = p / dx;
+                rem = p % dx;
+                if (rem < 0) {
+                        lift--;
+                        rem += dx;
+                }
+                mod -= dx;
+
+                while (ex1 != ex2) {
+                        delta = lift;
+                        mod += rem;
+                        if (mod >= 0) {
+                                mod -= dx;
+                                delta++;
+                        }
+                        cov_cell(row, ex1, delta, ONE * delta);
+                        y1 += delta;
+                        ex1 += incr;
+                }
+        }
+
+        delta = y2 - y1;
+        cov_cell(row, ex2, delta, (fx2 + ONE - first) * delta);
+}
+
+/* clip a line within the row horizontally and accumulate it */
+static void
+cov_line(struct cov_row *row, int x1, int y1, int x2, int y2)
+{
+        int rx = row->width << NSFB_PLOT_SUBPIXEL_SHIFT;
+        int ym;
+
+        /* split lines crossing either side of the buffer */
+        if ((x1 < 0 && x2 > 0) || (x1 > 0 && x2 < 0)) {
+                ym = y1 + ((int64_t)(0 - x1) * (y2 - y1)) / (x2 - x1);
+                cov_line(row, x1, y1, 0, ym);
+                cov_line(row, 0, ym, x2, y2);
+                return;
+        }
+        if ((x1 < rx && x2 > rx) || (x1 > rx && x2 < rx)) {
+                ym = y1 + ((int64_t)(rx - x1) * (y2 - y1)) / (x2 - x1);
+                cov_line(row, x1, y1, rx, ym);
+                cov_line(row, rx, ym, x2, y2);
+                return;
+        }
+
+        if (x1 <= 0 && x2 <= 0) {
+                /* left of the buffer, only its winding matters */
+                cov_hline(row, 0, y1, 0, y2);
+        } else if (x1 < rx || x2 < rx) {
+                cov_hline(row, x1, y1, x2, y2);
+        }
+}
+
+/* turn accumulated area into the coverage of a pixel */
+static inline int
+cov_alpha(int area, nsfb_plot_fill_rule_t rule)
+{
+        int cov = area >> (NSFB_PLOT_SUBPIXEL_SHIFT + 1);
+
+        if (cov < 0)
+                cov = -cov;
+
+        if (rule != NSFB_PLOT_FILL_NONZERO) {
+                cov &= (2 * ONE) - 1;
+                if (cov > ONE)
+                        cov = (2 * ONE) - cov;
+        }
+
+        if (cov > 0xFF)
+                cov = 0xFF;
+
+        return cov;
+}
+
+/* exported interface documented in coverage.h */
+bool
+nsfb_coverage_fill(nsfb_t *nsfb,
+                   const nsfb_point_t *point,
+                   const int *contour,
+                   int contourc,
+                   nsfb_colour_t c,
+                   nsfb_plot_fill_rule_t rule)
+{
+        struct cov_edge *edges;
+        struct cov_edge **active;
+        struct cov_edge *e;
+        struct cov_row row;
+        uint8_t *cov;
+        int *span;
+        int spanc;
+        int pointc = 0;
+        int edgec = 0;
+        int activec = 0;
+        int next = 0;
+        int minx, miny, maxx, maxy;
+        int ry0, ry1;
+        int top, bot;
+        int ya, yb;
+        int acc;
+        int alpha = c >> 24;
+        int start, end;
+        int i, j, k, y;
+
+        if (alpha == 0)
+                return true;
+
+        for (i = 0; i < contourc; i++)
+                pointc += contour[i];
+        if (pointc < 3)
+                return true;
+
+        minx = maxx = point[0].x;
+        miny = maxy = point[0].y;
+        for (i = 1; i < pointc; i++) {
+                if (point[i].x < minx)
+                        minx = point[i].x;
+                if (point[i].x > maxx)
+                        maxx = point[i].x;
+                if (point[i].y < miny)
+                        miny = point[i].y;
+                if (point[i].y > maxy)
+                        maxy = point[i].y;
+        }
+
+        /* rows and columns that may be plotted */
+        ry0 = miny >> NSFB_PLOT_SUBPIXEL_SHIFT;
+        ry1 = (maxy + ONE - 1) >> NSFB_PLOT_SUBPIXEL_SHIFT;
+        if (ry0 < nsfb->clip.y0)
+                ry0 = nsfb->clip.y0;
+        if (ry1 > nsfb->clip.y1)
+                ry1 = nsfb->clip.y1;
+
+        /* the buffer is not cut to the clip, which would alter how the
+         * edges are split between its columns
+         */
+        row.x0 = minx >> NSFB_PLOT_SUBPIXEL_SHIFT;
+        i = (maxx + ONE - 1) >> NSFB_PLOT_SUBPIXEL_SHIFT;
+        if (row.x0 < 0)
+                row.x0 = 0;
+        if (i > nsfb->width)
+                i = nsfb->width;
+        row.width = i - row.x0;
+
+        row.clip0 = nsfb->clip.x0 - row.x0;
+        row.clip1 = nsfb->clip.x1 - row.x0;
+        if (row.clip0 < 0)
+                row.clip0 = 0;
+        if (row.clip1 > row.width)
+                row.clip1 = row.width;
+
+        if (ry0 >= ry1 || row.clip0 >= row.clip1)
+                return true;
+
+        /* the buffers have a column past the end for lines ending on the
+         * right side of the surface
+         */
+        edges = malloc(pointc * (sizeof(struct cov_edge) +
+                                 sizeof(struct cov_edge *)) +
+                       (row.width + 2) * 3 * sizeof(int) +
+                       row.width);
+        if (edges == NULL)
+                return false;
+        active = (struct cov_edge **)(edges + pointc);
+        row.cover = (int *)(active + pointc);
+        row.area = row.cover + row.width + 2;
+        span = row.area + row.width + 2;
+        cov = (uint8_t *)(span + row.width + 2);
+
+        memset(row.cover, 0, (row.width + 2) * 2 * sizeof(int));
+
+        /* build the edge table, relative to the buffer */
+        for (i = 0, k = 0; i < contourc; k += contour[i], i++) {
+                for (j = 0; j < contour[i]; j++) {
+                        e = &edges[edgec];
+                        e->x0 = point[k + j].x -
+                                (row.x0 << NSFB_PLOT_SUBPIXEL_SHIFT);
+                        e->y0 = point[k + j].y;
+                        if (j + 1 < contour[i]) {
+                                e->x1 = point[k + j + 1].x;
+                                e->y1 = point[k + j + 1].y;
+                        } else {
+                                e->x1 = point[k].x;
+                                e->y1 = point[k].y;
+                        }
+                        e->x1 -= row.x0 << NSFB_PLOT_SUBPIXEL_SHIFT;
+
+                        /* horizontal edges cover nothing */
+                        if (e->y0 == e->y1)
+                                continue;
+
+                        if (e->y0 < e->y1) {
+                                e->top = e->y0;
+                                e->bottom = e->y1;
+                        } else {
+                                e->top = e->y1;
+                                e->bottom = e->y0;
+                        }
+                        edgec++;
+                }
+        }
+        qsort(edges, edgec, sizeof(struct cov_edge), cov_edge_cmp);
+
+        for (y = ry0; y < ry1; y++) {
+                top = y << NSFB_PLOT_SUBPIXEL_SHIFT;
+                bot = top + ONE;
+
+                /* retire edges ending above this row */
+                for (i = 0, j = 0; i < activec; i++) {
+                        if (active[i]->bottom > top)
+                                active[j++] = active[i];
+                }
+                activec = j;
+
+                /* add edges starting above the bottom of this row */
+                while (next < edgec && edges[next].top < bot) {
+                        e = &edges[next++];
+                        if (e->bottom > top)
+                                active[activec++] = e;
+                }
+
+                row.min = row.width + 1;
+                row.max = -1;
+
+                for (i = 0; i < activec; i++) {
+                        e = active[i];
+                        ya = (e->top > top) ? e->top : top;
+                        yb = (e->bottom < bot) ? e->bottom : bot;
+
+                        if (e->y0 < e->y1) {
+                                cov_line(&row,
+                                         cov_edge_x(e, ya), ya - top,
+                                         cov_edge_x(e, yb), yb - top);
+                        } else {
+                                cov_line(&row,
+                                         cov_edge_x(e, yb), yb - top,
+                                         cov_edge_x(e, ya), ya - top);
+                        }
+                }
+
+                if (row.max < 0)
+                        continue;
+
+                /* sum the columns into coverage from the first edge,
+                 * keeping only the clipped columns and stopping once past
+                 * the last edge with nothing left covered
+                 */
+                acc = 0;
+                for (i = row.min; i < row.clip0; i++) {
+                        acc += row.cover[i];
+                        row.cover[i] = 0;
+                        row.area[i] = 0;
+                }
+                start = i;
+                for (; i < row.clip1; i++) {
+                        if (i > row.max && acc == 0)
+                                break;
+
+                        acc += row.cover[i];
+                        k = cov_alpha(acc * (2 * ONE) - row.area[i], rule);
+                        if (alpha != 0xFF)
+                                k = (k * alpha + 127) / 255;
+                        cov[i] = k;
+
+                        row.cover[i] = 0;
+                        row.area[i] = 0;
+                }
+                end = i;
+                for (; i <= row.max; i++) {
+                        row.cover[i] = 0;
+                        row.area[i] = 0;
+                }
+
+                /* fill fully covered runs and blend the rest */
+                spanc = 0;
+                for (i = start; i < end; ) {
+                        if (cov[i] == 0) {
+                                i++;
+                                continue;
+                        }
+
+                        j = i;
+                        if (cov[i] == 0xFF) {
+                                while (i < end && cov[i] == 0xFF)
+                                        i++;
+                                span[spanc * 2] = row.x0 + j;
+                                span[spanc * 2 + 1] = row.x0 + i;
+                                spanc++;
+                        } else {
+                                while (i < end &&
+                                       cov[i] != 0 &&
+                                       cov[i] != 0xFF)
+                                        i++;
+                                nsfb->plotter_fns->coverage(nsfb,
+                                                row.x0 + j, y,
+                                                cov + j, i - j, c);
+                        }
+                }
+
+                if (spanc > 0)
+                        nsfb->plotter_fns->spans(nsfb, y, span, spanc, c);
+        }
+
+        free(edges);
+
+        return true;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
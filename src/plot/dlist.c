@@ -0,0 +1,1175 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Display list (implementation).
+ *
+ * Between nsfb_frame_begin() and nsfb_frame_end() the public plotters
+ * append a command to the list instead of plotting. Each command holds its
+ * parameters, the clipping region when it was recorded and the area it can
+ * touch within that region. Lines, spans and glyph bitmaps are copied into
+ * a data area behind the commands so the caller may reuse its buffers,
+ * bitmap pixels are referenced.
+ *
+ * When the list is plotted on a context with workers the commands are
+ * binned by the tiles their area covers, and the tiles are plotted in
+ * parallel, each running its commands in the order they were recorded with
+ * the clipping region narrowed to the tile. Commands whose pixels depend on
+ * where they are clipped are run whole on the calling thread between the
+ * tiled runs either side of them, as are all commands on contexts without
+ * workers.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+#include "libnsfb_plot_util.h"
+
+#include "nsfb.h"
+#include "plot.h"
+#include "workers.h"
+#include "dlist.h"
+
+/* tiles are (1 << DLIST_TILE_SHIFT) pixels square */
+#define DLIST_TILE_SHIFT 7
+
+/* recorded lines are copied to the stack this many at a time as the line
+ * plotter clips them in place
+ */
+#define DLIST_LINE_CHUNK 64
+
+/* initial number of commands and bytes of data */
+#define DLIST_INITIAL_CMDS 64
+#define DLIST_INITIAL_DATA 4096
+
+enum dlist_type {
+        DLIST_CLG,
+        DLIST_FILL,
+        DLIST_FILL_RECTS,
+        DLIST_RECTANGLE,
+        DLIST_SPANS,
+        DLIST_LINES,
+        DLIST_POLYLINES,
+        DLIST_POLYGON,
+        DLIST_ARC,
+        DLIST_POINT,
+        DLIST_ELLIPSE,
+        DLIST_BITMAP,
+        DLIST_GLYPH,
+        DLIST_GLYPH_RUN,
+};
+
+struct dlist_cmd {
+        enum dlist_type type;
+        nsfb_bbox_t clip; /**< clipping region when recorded */
+        nsfb_bbox_t extent; /**< area plotted, within the clipping region */
+        nsfb_colour_t c;
+        int count; /**< number of elements in the data */
+        size_t data; /**< offset of the data */
+
+        union {
+                struct {
+                        nsfb_bbox_t rect;
+                        nsfb_plot_op_t op;
+                } fill;
+                struct {
+                        nsfb_bbox_t rect;
+                        int line_width;
+                        bool dotted;
+                        bool dashed;
+                } rectangle;
+                nsfb_plot_pen_t pen;
+                nsfb_plot_fill_rule_t rule;
+                struct {
+                        int x;
+                        int y;
+                        int radius;
+                        int angle1;
+                        int angle2;
+                } arc;
+                struct {
+                        nsfb_plotfn_ellipse_t *fn;
+                        nsfb_bbox_t bbox;
+                } ellipse;
+                struct {
+                        nsfb_bbox_t loc;
+                        const nsfb_colour_t *pixel;
+                        int bmp_width;
+                        int bmp_height;
+                        int bmp_stride;
+                        unsigned int flags;
+                        nsfb_plot_op_t op;
+                } bitmap;
+                struct {
+                        nsfb_plot_glyph_format_t format;
+                        nsfb_bbox_t loc;
+                        int pitch;
+                } glyph;
+        } u;
+};
+
+struct nsfb_dlist_s {
+        struct dlist_cmd *cmd;
+        int cmdc;
+        int cmd_size; /**< number of commands allocated */
+
+        uint8_t *data; /**< parameters copied from the caller */
+        size_t datac;
+        size_t data_size; /**< bytes of data allocated */
+
+        /* binning, rebuilt each time the list is plotted */
+        int *bin; /**< first entry of each tile, and one past the last */
+        int bin_size;
+        int *entry; /**< indexes of the commands in each tile, in order */
+        int entry_size;
+        int across; /**< number of tiles across the screen */
+};
+
+/* exported interface documented in dlist.h */
+void nsfb_dlist_destroy(nsfb_dlist_t *dlist)
+{
+        free(dlist->entry);
+        free(dlist->bin);
+        free(dlist->data);
+        free(dlist->cmd);
+        free(dlist);
+}
+
+/* clip the area a command plots, false if it is entirely clipped away */
+static inline bool
+dlist_extent(nsfb_t *nsfb, nsfb_bbox_t *extent)
+{
+        return nsfb_plot_clip_ctx(nsfb, extent);
+}
+
+/* the recording failed, plot what has been recorded so the caller may
+ * plot immediately
+ */
+static bool dlist_punt(nsfb_t *nsfb)
+{
+        nsfb_dlist_flush(nsfb);
+        return false;
+}
+
+/* reserve data for a command, returning its offset or 0 on failure.
+ *
+ * The data is aligned for any of the copied structures. Offset zero is
+ * never returned, so data elements pointing within the same allocation
+ * may keep a zero offset for NULL.
+ */
+static size_t dlist_data(nsfb_dlist_t *dlist, size_t len)
+{
+        size_t off = (dlist->datac + 7) & ~(size_t)7;
+        size_t size;
+        uint8_t *data;
+
+        if (off == 0)
+                off = 8;
+
+        if (off + len > dlist->data_size) {
+                size = (dlist->data_size == 0) ?
+                        DLIST_INITIAL_DATA : dlist->data_size * 2;
+                while (size < off + len)
+                        size *= 2;
+                data = realloc(dlist->data, size);
+                if (data == NULL)
+                        return 0;
+                dlist->data = data;
+                dlist->data_size = size;
+        }
+
+        dlist->datac = off + len;
+
+        return off;
+}
+
+/* append a command plotting within a clipped extent */
+static struct dlist_cmd *
+dlist_add(nsfb_t *nsfb,
+          enum dlist_type type,
+          const nsfb_bbox_t *extent,
+          nsfb_colour_t c)
+{
+        nsfb_dlist_t *dlist = nsfb->dlist;
+        struct dlist_cmd *cmd;
+        int size;
+
+        if (dlist->cmdc == dlist->cmd_size) {
+                size = (dlist->cmd_size == 0) ?
+                        DLIST_INITIAL_CMDS : dlist->cmd_size * 2;
+                cmd = realloc(dlist->cmd, size * sizeof(struct dlist_cmd));
+                if (cmd == NULL)
+                        return NULL;
+                dlist->cmd = cmd;
+                dlist->cmd_size = size;
+        }
+
+        cmd = &dlist->cmd[dlist->cmdc++];
+        cmd->type = type;
+        cmd->clip = nsfb->clip;
+        cmd->extent = *extent;
+        cmd->c = c;
+        cmd->count = 0;
+        cmd->data = 0;
+
+        return cmd;
+}
+
+/* normalise a box and grow it by a margin on every side */
+static void
+dlist_grow(nsfb_bbox_t *extent, const nsfb_bbox_t *box, int margin)
+{
+        nsfb_bbox_t b = *box;
+
+        extent->x0 = ((b.x0 < b.x1) ? b.x0 : b.x1) - margin;
+        extent->y0 = ((b.y0 < b.y1) ? b.y0 : b.y1) - margin;
+        extent->x1 = ((b.x0 < b.x1) ? b.x1 : b.x0) + margin;
+        extent->y1 = ((b.y0 < b.y1) ? b.y1 : b.y0) + margin;
+}
+
+/* grow an extent to include a normalised box */
+static void dlist_union(nsfb_bbox_t *extent, const nsfb_bbox_t *box)
+{
+        if (box->x0 < extent->x0)
+                extent->x0 = box->x0;
+        if (box->y0 < extent->y0)
+                extent->y0 = box->y0;
+        if (box->x1 > extent->x1)
+                extent->x1 = box->x1;
+        if (box->y1 > extent->y1)
+                extent->y1 = box->y1;
+}
+
+/* exported interface documented in dlist.h */
+bool nsfb_dlist_clg(nsfb_t *nsfb, nsfb_colour_t c)
+{
+        nsfb_bbox_t extent = nsfb->clip;
+
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        if (dlist_add(nsfb, DLIST_CLG, &extent, c) == NULL)
+                return dlist_punt(nsfb);
+
+        return true;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_fill(nsfb_t *nsfb,
+                nsfb_bbox_t *rect,
+                nsfb_colour_t c,
+                nsfb_plot_op_t op)
+{
+        struct dlist_cmd *cmd;
+        nsfb_bbox_t extent;
+
+        /* the rectangle is clipped in place as the plotter would */
+        if (!nsfb_plot_clip_ctx(nsfb, rect))
+                return true;
+
+        extent = *rect;
+        cmd = dlist_add(nsfb, DLIST_FILL, &extent, c);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->u.fill.rect = extent;
+        cmd->u.fill.op = op;
+
+        return true;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_fill_rects(nsfb_t *nsfb,
+                      int rectc,
+                      const nsfb_bbox_t *rect,
+                      const nsfb_colour_t *colour)
+{
+        nsfb_dlist_t *dlist = nsfb->dlist;
+        struct dlist_cmd *cmd;
+        nsfb_bbox_t extent;
+        nsfb_bbox_t box;
+        size_t off;
+        int loop;
+
+        if (rectc <= 0)
+                return true;
+
+        dlist_grow(&extent, &rect[0], 0);
+        for (loop = 1; loop < rectc; loop++) {
+                dlist_grow(&box, &rect[loop], 0);
+                dlist_union(&extent, &box);
+        }
+
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        off = dlist_data(dlist, rectc * (sizeof(nsfb_bbox_t) + sizeof(nsfb_colour_t)));
+        if (off == 0)
+                return dlist_punt(nsfb);
+        memcpy(dlist->data + off, rect, rectc * sizeof(nsfb_bbox_t));
+        memcpy(dlist->data + off + rectc * sizeof(nsfb_bbox_t), colour,
+               rectc * sizeof(nsfb_colour_t));
+
+        cmd = dlist_add(nsfb, DLIST_FILL_RECTS, &extent, 0);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->count = rectc;
+        cmd->data = off;
+
+        return true;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_rectangle(nsfb_t *nsfb,
+                     nsfb_bbox_t *rect,
+                     int line_width,
+                     nsfb_colour_t c,
+                     bool dotted,
+                     bool dashed)
+{
+        struct dlist_cmd *cmd;
+        nsfb_bbox_t extent;
+
+        dlist_grow(&extent, rect, ((line_width > 0) ? line_width : 0) + 1);
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        cmd = dlist_add(nsfb, DLIST_RECTANGLE, &extent, c);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->u.rectangle.rect = *rect;
+        cmd->u.rectangle.line_width = line_width;
+        cmd->u.rectangle.dotted = dotted;
+        cmd->u.rectangle.dashed = dashed;
+
+        return true;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_spans(nsfb_t *nsfb,
+                 int spanc,
+                 const nsfb_plot_span_t *span,
+                 nsfb_colour_t c)
+{
+        nsfb_dlist_t *dlist = nsfb->dlist;
+        struct dlist_cmd *cmd;
+        nsfb_plot_span_t *copy;
+        nsfb_bbox_t extent;
+        size_t covc = 0;
+        size_t covoff;
+        size_t off;
+        int loop;
+
+        extent.x0 = extent.y0 = 0;
+        extent.x1 = extent.y1 = 0;
+        for (loop = 0; loop < spanc; loop++) {
+                if (span[loop].x1 <= span[loop].x0)
+                        continue;
+                if (extent.x0 >= extent.x1) {
+                        extent.x0 = span[loop].x0;
+                        extent.x1 = span[loop].x1;
+                        extent.y0 = span[loop].y;
+                        extent.y1 = span[loop].y + 1;
+                } else {
+                        if (span[loop].x0 < extent.x0)
+                                extent.x0 = span[loop].x0;
+                        if (span[loop].x1 > extent.x1)
+                                extent.x1 = span[loop].x1;
+                        if (span[loop].y < extent.y0)
+                                extent.y0 = span[loop].y;
+                        if (span[loop].y >= extent.y1)
+                                extent.y1 = span[loop].y + 1;
+                }
+                if (span[loop].cov != NULL)
+                        covc += span[loop].x1 - span[loop].x0;
+        }
+
+        if ((extent.x0 >= extent.x1) || !dlist_extent(nsfb, &extent))
+                return true;
+
+        /* the coverage follows the spans, at a non zero offset */
+        off = dlist_data(dlist, spanc * sizeof(nsfb_plot_span_t) + covc);
+        if (off == 0)
+                return dlist_punt(nsfb);
+
+        copy = (nsfb_plot_span_t *)(void *)(dlist->data + off);
+        covoff = off + spanc * sizeof(nsfb_plot_span_t);
+        for (loop = 0; loop < spanc; loop++) {
+                copy[loop] = span[loop];
+                copy[loop].cov = NULL;
+                if ((span[loop].cov != NULL) &&
+                    (span[loop].x1 > span[loop].x0)) {
+                        memcpy(dlist->data + covoff, span[loop].cov,
+                               span[loop].x1 - span[loop].x0);
+                        copy[loop].cov = (const uint8_t *)(uintptr_t)covoff;
+                        covoff += span[loop].x1 - span[loop].x0;
+                }
+        }
+
+        cmd = dlist_add(nsfb, DLIST_SPANS, &extent, c);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->count = spanc;
+        cmd->data = off;
+
+        return true;
+}
+
+/* area a stroke can touch around the points it joins.
+ *
+ * Wide strokes extend by half their width beyond the points, more at
+ * mitred corners, which are limited to twice the width.
+ */
+static int dlist_pen_margin(const nsfb_plot_pen_t *pen)
+{
+        return ((pen->stroke_width > 1) ? 2 * pen->stroke_width : 1) + 1;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_lines(nsfb_t *nsfb,
+                 int linec,
+                 const nsfb_bbox_t *line,
+                 nsfb_plot_pen_t *pen)
+{
+        nsfb_dlist_t *dlist = nsfb->dlist;
+        struct dlist_cmd *cmd;
+        nsfb_bbox_t extent;
+        nsfb_bbox_t box;
+        size_t off;
+        int loop;
+
+        if (linec <= 0)
+                return true;
+
+        dlist_grow(&extent, &line[0], 0);
+        for (loop = 1; loop < linec; loop++) {
+                dlist_grow(&box, &line[loop], 0);
+                dlist_union(&extent, &box);
+        }
+        dlist_grow(&extent, &extent, dlist_pen_margin(pen));
+
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        off = dlist_data(dlist, linec * sizeof(nsfb_bbox_t));
+        if (off == 0)
+                return dlist_punt(nsfb);
+        memcpy(dlist->data + off, line, linec * sizeof(nsfb_bbox_t));
+
+        cmd = dlist_add(nsfb, DLIST_LINES, &extent, 0);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->count = linec;
+        cmd->data = off;
+        cmd->u.pen = *pen;
+
+        return true;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_polylines(nsfb_t *nsfb,
+                     int pointc,
+                     const nsfb_point_t *points,
+                     nsfb_plot_pen_t *pen)
+{
+        nsfb_dlist_t *dlist = nsfb->dlist;
+        struct dlist_cmd *cmd;
+        nsfb_bbox_t extent;
+        size_t off;
+        int loop;
+
+        if (pointc <= 0)
+                return true;
+
+        extent.x0 = extent.x1 = points[0].x;
+        extent.y0 = extent.y1 = points[0].y;
+        for (loop = 1; loop < pointc; loop++) {
+                if (points[loop].x < extent.x0)
+                        extent.x0 = points[loop].x;
+                if (points[loop].x > extent.x1)
+                        extent.x1 = points[loop].x;
+                if (points[loop].y < extent.y0)
+                        extent.y0 = points[loop].y;
+                if (points[loop].y > extent.y1)
+                        extent.y1 = points[loop].y;
+        }
+        dlist_grow(&extent, &extent, dlist_pen_margin(pen));
+
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        off = dlist_data(dlist, pointc * sizeof(nsfb_point_t));
+        if (off == 0)
+                return dlist_punt(nsfb);
+        memcpy(dlist->data + off, points, pointc * sizeof(nsfb_point_t));
+
+        cmd = dlist_add(nsfb, DLIST_POLYLINES, &extent, 0);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->count = pointc;
+        cmd->data = off;
+        cmd->u.pen = *pen;
+
+        return true;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_polygon(nsfb_t *nsfb,
+                   const int *p,
+                   unsigned int n,
+                   nsfb_colour_t fill,
+                   nsfb_plot_fill_rule_t rule)
+{
+        nsfb_dlist_t *dlist = nsfb->dlist;
+        struct dlist_cmd *cmd;
+        nsfb_bbox_t extent;
+        unsigned int loop;
+        size_t off;
+
+        if (n == 0)
+                return true;
+
+        extent.x0 = extent.x1 = p[0];
+        extent.y0 = extent.y1 = p[1];
+        for (loop = 1; loop < n; loop++) {
+                if (p[loop * 2] < extent.x0)
+                        extent.x0 = p[loop * 2];
+                if (p[loop * 2] > extent.x1)
+                        extent.x1 = p[loop * 2];
+                if (p[loop * 2 + 1] < extent.y0)
+                        extent.y0 = p[loop * 2 + 1];
+                if (p[loop * 2 + 1] > extent.y1)
+                        extent.y1 = p[loop * 2 + 1];
+        }
+        extent.x1++;
+        extent.y1++;
+
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        off = dlist_data(dlist, n * 2 * sizeof(int));
+        if (off == 0)
+                return dlist_punt(nsfb);
+        memcpy(dlist->data + off, p, n * 2 * sizeof(int));
+
+        cmd = dlist_add(nsfb, DLIST_POLYGON, &extent, fill);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->count = n;
+        cmd->data = off;
+        cmd->u.rule = rule;
+
+        return true;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_arc(nsfb_t *nsfb,
+               int x,
+               int y,
+               int radius,
+               int angle1,
+               int angle2,
+               nsfb_colour_t c)
+{
+        struct dlist_cmd *cmd;
+        nsfb_bbox_t extent;
+
+        if (radius < 0)
+                return true;
+
+        extent.x0 = x - radius - 1;
+        extent.y0 = y - radius - 1;
+        extent.x1 = x + radius + 2;
+        extent.y1 = y + radius + 2;
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        cmd = dlist_add(nsfb, DLIST_ARC, &extent, c);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->u.arc.x = x;
+        cmd->u.arc.y = y;
+        cmd->u.arc.radius = radius;
+        cmd->u.arc.angle1 = angle1;
+        cmd->u.arc.angle2 = angle2;
+
+        return true;
+}
+
+/* exported interface documented in dlist.h */
+bool nsfb_dlist_point(nsfb_t *nsfb, int x, int y, nsfb_colour_t c)
+{
+        nsfb_bbox_t extent;
+
+        extent.x0 = x;
+        extent.y0 = y;
+        extent.x1 = x + 1;
+        extent.y1 = y + 1;
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        if (dlist_add(nsfb, DLIST_POINT, &extent, c) == NULL)
+                return dlist_punt(nsfb);
+
+        return true;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_ellipse(nsfb_t *nsfb,
+                   nsfb_plotfn_ellipse_t *fn,
+                   nsfb_bbox_t *ellipse,
+                   nsfb_colour_t c)
+{
+        struct dlist_cmd *cmd;
+        nsfb_bbox_t extent;
+
+        dlist_grow(&extent, ellipse, 2);
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        cmd = dlist_add(nsfb, DLIST_ELLIPSE, &extent, c);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->u.ellipse.fn = fn;
+        cmd->u.ellipse.bbox = *ellipse;
+
+        return true;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_bitmap(nsfb_t *nsfb,
+                  const nsfb_bbox_t *loc,
+                  const nsfb_colour_t *pixel,
+                  int bmp_width,
+                  int bmp_height,
+                  int bmp_stride,
+                  unsigned int flags,
+                  nsfb_plot_op_t op)
+{
+        struct dlist_cmd *cmd;
+        nsfb_bbox_t extent = *loc;
+
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        cmd = dlist_add(nsfb, DLIST_BITMAP, &extent, 0);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->u.bitmap.loc = *loc;
+        cmd->u.bitmap.pixel = pixel;
+        cmd->u.bitmap.bmp_width = bmp_width;
+        cmd->u.bitmap.bmp_height = bmp_height;
+        cmd->u.bitmap.bmp_stride = bmp_stride;
+        cmd->u.bitmap.flags = flags;
+        cmd->u.bitmap.op = op;
+
+        return true;
+}
+
+/* bytes of glyph bitmap a plot of a glyph may read */
+static size_t
+dlist_glyph_size(nsfb_plot_glyph_format_t format,
+                 const nsfb_bbox_t *loc,
+                 int pitch)
+{
+        size_t size = (size_t)(loc->y1 - loc->y0 - 1) * pitch +
+                (loc->x1 - loc->x0);
+
+        if (format == NSFB_PLOT_GLYPH_1BPP)
+                size = (size + 7) / 8;
+
+        return size;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_glyph(nsfb_t *nsfb,
+                 nsfb_plot_glyph_format_t format,
+                 nsfb_bbox_t *loc,
+                 const uint8_t *pixel,
+                 int pitch,
+                 nsfb_colour_t c)
+{
+        nsfb_dlist_t *dlist = nsfb->dlist;
+        struct dlist_cmd *cmd;
+        nsfb_bbox_t extent = *loc;
+        size_t size;
+        size_t off;
+
+        if (pitch < 0)
+                return dlist_punt(nsfb);
+
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        size = dlist_glyph_size(format, loc, pitch);
+        off = dlist_data(dlist, size);
+        if (off == 0)
+                return dlist_punt(nsfb);
+        memcpy(dlist->data + off, pixel, size);
+
+        cmd = dlist_add(nsfb, DLIST_GLYPH, &extent, c);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->data = off;
+        cmd->u.glyph.format = format;
+        cmd->u.glyph.loc = *loc;
+        cmd->u.glyph.pitch = pitch;
+
+        /* the location is clipped in place as the plotter would */
+        *loc = extent;
+
+        return true;
+}
+
+/* exported interface documented in dlist.h */
+bool
+nsfb_dlist_glyph_run(nsfb_t *nsfb,
+                     nsfb_plot_glyph_format_t format,
+                     const nsfb_plot_glyph_t *glyphs,
+                     int glyphc,
+                     nsfb_colour_t c)
+{
+        nsfb_dlist_t *dlist = nsfb->dlist;
+        struct dlist_cmd *cmd;
+        nsfb_plot_glyph_t *copy;
+        nsfb_bbox_t extent;
+        size_t size = 0;
+        size_t pixoff;
+        size_t off;
+        int loop;
+
+        if (glyphc <= 0)
+                return true;
+
+        extent = glyphs[0].loc;
+        for (loop = 0; loop < glyphc; loop++) {
+                if (glyphs[loop].pitch < 0)
+                        return dlist_punt(nsfb);
+                if ((glyphs[loop].loc.x1 <= glyphs[loop].loc.x0) ||
+                    (glyphs[loop].loc.y1 <= glyphs[loop].loc.y0))
+                        continue;
+                dlist_union(&extent, &glyphs[loop].loc);
+                size += dlist_glyph_size(format, &glyphs[loop].loc,
+                                         glyphs[loop].pitch);
+        }
+
+        if (!dlist_extent(nsfb, &extent))
+                return true;
+
+        /* the bitmaps follow the glyphs, at a non zero offset */
+        off = dlist_data(dlist, glyphc * sizeof(nsfb_plot_glyph_t) + size);
+        if (off == 0)
+                return dlist_punt(nsfb);
+
+        copy = (nsfb_plot_glyph_t *)(void *)(dlist->data + off);
+        pixoff = off + glyphc * sizeof(nsfb_plot_glyph_t);
+        for (loop = 0; loop < glyphc; loop++) {
+                copy[loop] = glyphs[loop];
+                copy[loop].pixel = NULL;
+                if ((glyphs[loop].loc.x1 <= glyphs[loop].loc.x0) ||
+                    (glyphs[loop].loc.y1 <= glyphs[loop].loc.y0))
+                        continue;
+                size = dlist_glyph_size(format, &glyphs[loop].loc,
+                                        glyphs[loop].pitch);
+                memcpy(dlist->data + pixoff, glyphs[loop].pixel, size);
+                copy[loop].pixel = (const uint8_t *)(uintptr_t)pixoff;
+                pixoff += size;
+        }
+
+        cmd = dlist_add(nsfb, DLIST_GLYPH_RUN, &extent, c);
+        if (cmd == NULL)
+                return dlist_punt(nsfb);
+
+        cmd->count = glyphc;
+        cmd->data = off;
+        cmd->u.glyph.format = format;
+
+        return true;
+}
+
+/* turn the data offsets held in copied spans and glyphs into pointers */
+static void dlist_resolve(nsfb_dlist_t *dlist)
+{
+        nsfb_plot_glyph_t *glyph;
+        nsfb_plot_span_t *span;
+        struct dlist_cmd *cmd;
+        int loop;
+        int c;
+
+        for (c = 0; c < dlist->cmdc; c++) {
+                cmd = &dlist->cmd[c];
+                if (cmd->type == DLIST_SPANS) {
+                        span = (nsfb_plot_span_t *)(void *)(dlist->data + cmd->data);
+                        for (loop = 0; loop < cmd->count; loop++) {
+                                if (span[loop].cov != NULL)
+                                        span[loop].cov = dlist->data +
+                                                (uintptr_t)span[loop].cov;
+                        }
+                } else if (cmd->type == DLIST_GLYPH_RUN) {
+                        glyph = (nsfb_plot_glyph_t *)(void *)(dlist->data + cmd->data);
+                        for (loop = 0; loop < cmd->count; loop++) {
+                                if (glyph[loop].pixel != NULL)
+                                        glyph[loop].pixel = dlist->data +
+                                                (uintptr_t)glyph[loop].pixel;
+                        }
+                }
+        }
+}
+
+/* run one command on a context whose clipping region is already set */
+static bool
+dlist_run(nsfb_t *nsfb, const nsfb_dlist_t *dlist, const struct dlist_cmd *cmd)
+{
+        const uint8_t *data = dlist->data + cmd->data;
+        nsfb_bbox_t line[DLIST_LINE_CHUNK];
+        nsfb_plot_pen_t pen;
+        nsfb_bbox_t rect;
+        int done;
+        int n;
+
+        switch (cmd->type) {
+        case DLIST_CLG:
+                return nsfb->plotter_fns->clg(nsfb, cmd->c);
+
+        case DLIST_FILL:
+                rect = cmd->u.fill.rect;
+                return nsfb->plotter_fns->fill_op(nsfb, &rect, cmd->c,
+                                                  cmd->u.fill.op);
+
+        case DLIST_FILL_RECTS:
+                return nsfb->plotter_fns->fill_rects(nsfb, cmd->count,
+                        (const nsfb_bbox_t *)(const void *)data,
+                        (const nsfb_colour_t *)(const void *)
+                        (data + cmd->count * sizeof(nsfb_bbox_t)));
+
+        case DLIST_RECTANGLE:
+                rect = cmd->u.rectangle.rect;
+                return nsfb->plotter_fns->rectangle(nsfb, &rect,
+                                                    cmd->u.rectangle.line_width,
+                                                    cmd->c,
+                                                    cmd->u.rectangle.dotted,
+                                                    cmd->u.rectangle.dashed);
+
+        case DLIST_SPANS:
+                return nsfb->plotter_fns->span_list(nsfb, cmd->count,
+                        (const nsfb_plot_span_t *)(const void *)data, cmd->c);
+
+        case DLIST_LINES:
+                for (done = 0; done < cmd->count; done += n) {
+                        n = cmd->count - done;
+                        if (n > DLIST_LINE_CHUNK)
+                                n = DLIST_LINE_CHUNK;
+                        memcpy(line, data + done * sizeof(nsfb_bbox_t),
+                               n * sizeof(nsfb_bbox_t));
+                        pen = cmd->u.pen;
+                        if (!nsfb->plotter_fns->line(nsfb, n, line, &pen))
+                                return false;
+                }
+                return true;
+
+        case DLIST_POLYLINES:
+                pen = cmd->u.pen;
+                return nsfb->plotter_fns->polylines(nsfb, cmd->count,
+                        (const nsfb_point_t *)(const void *)data, &pen);
+
+        case DLIST_POLYGON:
+                return nsfb->plotter_fns->polygon(nsfb,
+                        (const int *)(const void *)data, cmd->count,
+                        cmd->c, cmd->u.rule);
+
+        case DLIST_ARC:
+                return nsfb->plotter_fns->arc(nsfb, cmd->u.arc.x,
+                                              cmd->u.arc.y,
+                                              cmd->u.arc.radius,
+                                              cmd->u.arc.angle1,
+                                              cmd->u.arc.angle2, cmd->c);
+
+        case DLIST_POINT:
+                return nsfb->plotter_fns->point(nsfb, cmd->extent.x0,
+                                                cmd->extent.y0, cmd->c);
+
+        case DLIST_ELLIPSE:
+                rect = cmd->u.ellipse.bbox;
+                return cmd->u.ellipse.fn(nsfb, &rect, cmd->c);
+
+        case DLIST_BITMAP:
+                return nsfb->plotter_fns->bitmap_op(nsfb,
+                                                    &cmd->u.bitmap.loc,
+                                                    cmd->u.bitmap.pixel,
+                                                    cmd->u.bitmap.bmp_width,
+                                                    cmd->u.bitmap.bmp_height,
+                                                    cmd->u.bitmap.bmp_stride,
+                                                    cmd->u.bitmap.flags,
+                                                    cmd->u.bitmap.op);
+
+        case DLIST_GLYPH:
+                rect = cmd->u.glyph.loc;
+                if (cmd->u.glyph.format == NSFB_PLOT_GLYPH_1BPP)
+                        return nsfb->plotter_fns->glyph1(nsfb, &rect, data,
+                                                         cmd->u.glyph.pitch,
+                                                         cmd->c);
+                return nsfb->plotter_fns->glyph8(nsfb, &rect, data,
+                                                 cmd->u.glyph.pitch, cmd->c);
+
+        case DLIST_GLYPH_RUN:
+                return nsfb->plotter_fns->glyph_run(nsfb,
+                        cmd->u.glyph.format,
+                        (const nsfb_plot_glyph_t *)(const void *)data,
+                        cmd->count, cmd->c);
+        }
+
+        return false;
+}
+
+/* whether a command can be plotted a tile at a time.
+ *
+ * Thin lines are clipped by moving their ends before they are stepped, so
+ * a tile may plot different pixels from the whole line, and are run whole.
+ * Thin anti-aliased lines only skip the steps outside the clip, and
+ * anti-aliased fills, ellipses and wide strokes accumulate coverage
+ * without regard to the clip, so all of those are tiled.
+ */
+static bool dlist_tileable(const struct dlist_cmd *cmd)
+{
+        switch (cmd->type) {
+        case DLIST_LINES:
+        case DLIST_POLYLINES:
+                if (cmd->u.pen.stroke_type == NFSB_PLOT_OPTYPE_SOLID_AA)
+                        return true;
+                return cmd->u.pen.stroke_width > 1;
+
+        case DLIST_RECTANGLE:
+                return cmd->u.rectangle.line_width > 1;
+
+        default:
+                return true;
+        }
+}
+
+/* run a range of commands in order on the calling thread */
+static bool
+dlist_replay(nsfb_t *nsfb, const nsfb_dlist_t *dlist, int first, int last)
+{
+        nsfb_bbox_t clip = nsfb->clip;
+        bool ok = true;
+        int c;
+
+        for (c = first; c < last; c++) {
+                nsfb->clip = dlist->cmd[c].clip;
+                if (!dlist_run(nsfb, dlist, &dlist->cmd[c]))
+                        ok = false;
+        }
+
+        nsfb->clip = clip;
+
+        return ok;
+}
+
+/* sort a range of commands into the tiles their extents cover, keeping
+ * them in order within each tile
+ */
+static bool
+dlist_bin(nsfb_t *nsfb, nsfb_dlist_t *dlist, int first, int last)
+{
+        const struct dlist_cmd *cmd;
+        int across = (nsfb->width + (1 << DLIST_TILE_SHIFT) - 1) >> DLIST_TILE_SHIFT;
+        int down = (nsfb->height + (1 << DLIST_TILE_SHIFT) - 1) >> DLIST_TILE_SHIFT;
+        int tilec = across * down;
+        int entryc = 0;
+        int tx0, ty0, tx1, ty1;
+        int tx, ty;
+        int *alloc;
+        int c;
+
+        if (tilec + 1 > dlist->bin_size) {
+                alloc = realloc(dlist->bin, (tilec + 1) * sizeof(int));
+                if (alloc == NULL)
+                        return false;
+                dlist->bin = alloc;
+                dlist->bin_size = tilec + 1;
+        }
+        memset(dlist->bin, 0, (tilec + 1) * sizeof(int));
+
+        /* count the commands in each tile, shifted up by one */
+        for (c = first; c < last; c++) {
+                cmd = &dlist->cmd[c];
+                tx0 = cmd->extent.x0 >> DLIST_TILE_SHIFT;
+                ty0 = cmd->extent.y0 >> DLIST_TILE_SHIFT;
+                tx1 = (cmd->extent.x1 - 1) >> DLIST_TILE_SHIFT;
+                ty1 = (cmd->extent.y1 - 1) >> DLIST_TILE_SHIFT;
+                for (ty = ty0; ty <= ty1; ty++) {
+                        for (tx = tx0; tx <= tx1; tx++)
+                                dlist->bin[ty * across + tx + 1]++;
+                }
+                entryc += (ty1 - ty0 + 1) * (tx1 - tx0 + 1);
+        }
+
+        if (entryc > dlist->entry_size) {
+                alloc = realloc(dlist->entry, entryc * sizeof(int));
+                if (alloc == NULL)
+                        return false;
+                dlist->entry = alloc;
+                dlist->entry_size = entryc;
+        }
+
+        /* the counts become the start of each tile, which are advanced as
+         * entries are added so each ends at the start of the next tile
+         */
+        for (c = 1; c <= tilec; c++)
+                dlist->bin[c] += dlist->bin[c - 1];
+
+        for (c = first; c < last; c++) {
+                cmd = &dlist->cmd[c];
+                tx0 = cmd->extent.x0 >> DLIST_TILE_SHIFT;
+                ty0 = cmd->extent.y0 >> DLIST_TILE_SHIFT;
+                tx1 = (cmd->extent.x1 - 1) >> DLIST_TILE_SHIFT;
+                ty1 = (cmd->extent.y1 - 1) >> DLIST_TILE_SHIFT;
+                for (ty = ty0; ty <= ty1; ty++) {
+                        for (tx = tx0; tx <= tx1; tx++)
+                                dlist->entry[dlist->bin[ty * across + tx]++] = c;
+                }
+        }
+
+        /* shift the ends back down to be the starts */
+        memmove(dlist->bin + 1, dlist->bin, tilec * sizeof(int));
+        dlist->bin[0] = 0;
+        dlist->across = across;
+
+        return true;
+}
+
+/* run the commands binned in one tile */
+static bool dlist_tile(nsfb_t *tile, void *ctx)
+{
+        const nsfb_dlist_t *dlist = ctx;
+        const struct dlist_cmd *cmd;
+        nsfb_bbox_t clip = tile->clip;
+        bool ok = true;
+        int t;
+        int e;
+
+        t = (clip.y0 >> DLIST_TILE_SHIFT) * dlist->across +
+                (clip.x0 >> DLIST_TILE_SHIFT);
+
+        for (e = dlist->bin[t]; e < dlist->bin[t + 1]; e++) {
+                cmd = &dlist->cmd[dlist->entry[e]];
+                tile->clip = clip;
+                if (!nsfb_plot_clip(&cmd->clip, &tile->clip))
+                        continue;
+                if (!dlist_run(tile, dlist, cmd))
+                        ok = false;
+        }
+
+        return ok;
+}
+
+/* exported interface documented in dlist.h */
+bool nsfb_dlist_flush(nsfb_t *nsfb)
+{
+        nsfb_dlist_t *dlist = nsfb->dlist;
+        nsfb_bbox_t screen;
+        bool ok = true;
+        bool share;
+        bool tiled;
+        int first;
+        int last;
+
+        if (dlist->cmdc == 0)
+                return true;
+
+        dlist_resolve(dlist);
+
+        screen.x0 = screen.y0 = 0;
+        screen.x1 = nsfb->width;
+        screen.y1 = nsfb->height;
+
+        /* the list is plotted in runs of commands which can or cannot be
+         * tiled, each run finishing before the next starts. Paletted
+         * formats carry dithering state between rows so are never tiled.
+         */
+        share = (nsfb->workers != NULL) && (nsfb->palette == NULL);
+
+        for (first = 0; first < dlist->cmdc; first = last) {
+                tiled = share && dlist_tileable(&dlist->cmd[first]);
+                for (last = first + 1; last < dlist->cmdc; last++) {
+                        if (tiled != (share &&
+                                      dlist_tileable(&dlist->cmd[last])))
+                                break;
+                }
+
+                if (tiled && dlist_bin(nsfb, dlist, first, last)) {
+                        if (!nsfb_workers_run_tiles(nsfb, &screen,
+                                                    1 << DLIST_TILE_SHIFT,
+                                                    dlist_tile, dlist))
+                                ok = false;
+                } else if (!dlist_replay(nsfb, dlist, first, last)) {
+                        ok = false;
+                }
+        }
+
+        dlist->cmdc = 0;
+        dlist->datac = 0;
+
+        return ok;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_frame_begin(nsfb_t *nsfb)
+{
+        if (nsfb->dlist != NULL)
+                return false;
+
+        nsfb->dlist = calloc(1, sizeof(nsfb_dlist_t));
+
+        return (nsfb->dlist != NULL);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_frame_end(nsfb_t *nsfb)
+{
+        bool ok;
+
+        if (nsfb->dlist == NULL)
+                return false;
+
+        ok = nsfb_dlist_flush(nsfb);
+
+        nsfb_dlist_destroy(nsfb->dlist);
+        nsfb->dlist = NULL;
+
+        return ok;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
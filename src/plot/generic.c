@@ -12,7 +12,7 @@
  */
 
 #include <stdbool.h>
-#include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -23,6 +23,10 @@
 #include "nsfb.h"
 #include "plot.h"
 #include "surface.h"
+#include "kernel.h"
+#include "coverage.h"
+#include "stroke.h"
+#include "region.h"
 
 extern const nsfb_plotter_fns_t _nsfb_1bpp_plotters;
 extern const nsfb_plotter_fns_t _nsfb_8bpp_plotters;
@@ -63,235 +67,106 @@ static bool clg(nsfb_t *nsfb, nsfb_colour_t c)
     return nsfb->plotter_fns->fill(nsfb, &nsfb->clip, c);
 }
 
-/**
- * Establish whether there is any value in a line's crossing.
- * (Helper function for find_span().)
- *
- * \param  x	 x coordinate of intersection
- * \param  y	 current y level
- * \param  x0	 line start coordinate
- * \param  y0	 line start coordinate
- * \param  x1	 line end coordinate
- * \param  y1	 line end coordinate
- * \return true	 if crossing has value
- *
- *                         +            |                             | /
- *                        /             |                             |/
- *   y level --      ----/----      ----+----      ----+----      ----+----
- *                      /              /              /|
- *                     +             /               / |
- *
- *                      (a)            (b)            (c)            (d)
- *
- *
- * Figure (a) values:  1     = 1  --  Odd  -- Valid crossing
- * Figure (b) values:  0 + 1 = 1  --  Odd  -- Valid crossing
- * Figure (c) values:  1 + 1 = 2  --  Even -- Not valid crossing
- * Figure (d) values:  0 + 0 = 0  --  Even -- Not valid crossing
- *
- * Vertices are shared between consecutive lines.  This function ensures that
- * the vertex point is only counted as a crossing for one of the lines by
- * only considering crossings of the top vertex.  This is what NetSurf's
- * plotter API expects.
- *
- * It's up to the client to call this function for both lines and check the
- * evenness of the total.
- */
-static bool establish_crossing_value(int x, int y, int x0, int y0,
-				     int x1, int y1)
-{
-    bool v1 = (x == x0 && y == y0); /* whether we're crossing 1st vertex */
-    bool v2 = (x == x1 && y == y1); /* whether we're crossing 2nd vertex */
+/** A polygon edge, kept in the direction it was given. */
+struct poly_edge {
+    int x0, y0; /* first vertex */
+    int dx, dy; /* vector to the second vertex */
+    int top, bottom; /* rows crossed, from top up to but excluding bottom */
+    int wind; /* winding direction, 1 downwards or -1 upwards */
+    int num; /* distance along x from x0 to the crossing times dy */
+    int x; /* crossing on the current row */
+};
 
-    if ((v1 && (y0 < y1)) || (v2 && (y1 < y0))) {
-	/* crossing top vertex */
-	return true;
-    } else if (!v1 && !v2) {
-	/* Intersection with current y level is not at a vertex.
-	 * Normal crossing. */
-	return true;
-    }
-    return false;
-}
+/* polygons with up to this many vertices are plotted without allocation */
+#define POLY_STACK_EDGES 32
 
+static int poly_edge_cmp(const void *a, const void *b)
+{
+    return ((const struct poly_edge *)a)->top -
+	((const struct poly_edge *)b)->top;
+}
 
 /**
- * Find first filled span along horizontal line at given coordinate
+ * Find where an edge crosses the current row.
  *
- * \param  p	 array of polygon vertices (x1, y1, x2, y2, ... , xN, yN)
- * \param  n	 number of polygon vertex values (N * 2)
- * \param  x	 current position along current scan line
- * \param  y	 position of current scan line
- * \param  x0	 updated to start of filled area
- * \param  x1	 updated to end of filled area
- * \return true	 if an intersection was found
+ * The crossing is rounded to the nearest column, halves away from the
+ * first vertex, so an edge covers the same pixels whichever polygon it is
+ * part of.
  */
-static bool find_span(const int *p, int n, int x, int y, int *x0, int *x1)
-{
-    int i;
-    int p_x0, p_y0;
-    int p_x1, p_y1;
-    int x0_min, x1_min;
-    int x_new;
-    unsigned int x0c, x1c; /* counters for crossings at span end points */
-    bool crossing_value;
-    bool found_span_start = false;
-
-    x0_min = x1_min = INT_MIN;
-    x0c = x1c = 0;
-    *x0 = *x1 = INT_MAX;
-
-    /* search row for next span, returning it if one exists */
-    do {
-	/* reset endpoint info, if valid span endpoints not found */
-	if (!found_span_start)
-	    *x0 = INT_MAX;
-	*x1 = INT_MAX;
-
-	/* search all lines in polygon */
-	for (i = 0; i < n; i = i + 2) {
-	    /* get line endpoints */
-	    if (i != n - 2) {
-		/* not the last line */
-		p_x0 = p[i];		p_y0 = p[i + 1];
-		p_x1 = p[i + 2];	p_y1 = p[i + 3];
-	    } else {
-		/* last line; 2nd endpoint is first vertex */
-		p_x0 = p[i];		p_y0 = p[i + 1];
-		p_x1 = p[0];		p_y1 = p[1];
-	    }
-	    /* ignore horizontal lines */
-	    if (p_y0 == p_y1)
-		continue;
-
-	    /* ignore lines that don't cross this y level */
-	    if ((y < p_y0 && y < p_y1) || (y > p_y0 && y > p_y1))
-		continue;
-
-	    if (p_x0 == p_x1) {
-		/* vertical line, x is constant */
-		x_new = p_x0;
-	    } else {
-		/* find crossing (intersection of this line and
-		 * current y level) */
-		int num = (y - p_y0) * (p_x1 - p_x0);
-		int den = (p_y1 - p_y0);
-
-		/* To round to nearest (rather than down)
-		 * half the denominator is either added to
-		 * or subtracted from the numerator,
-		 * depending on whether the numerator and
-		 * denominator have the same sign. */
-		num = ((num < 0) == (den < 0)) ?
-		    num + (den / 2) :
-		    num - (den / 2);
-		x_new = p_x0 + num / den;
-	    }
-
-	    /* ignore crossings before current x */
-	    if (x_new < x ||
-		(!found_span_start && x_new < x0_min) ||
-		(found_span_start && x_new < x1_min))
-		continue;
-
-	    crossing_value = establish_crossing_value(x_new, y,
-						      p_x0, p_y0, p_x1, p_y1);
-
-
-	    /* set nearest intersections as filled area endpoints */
-	    if (!found_span_start &&
-		x_new < *x0 && crossing_value) {
-		/* nearer than first endpoint */
-		*x1 = *x0;
-		x1c = x0c;
-		*x0 = x_new;
-		x0c = 1;
-	    } else if (!found_span_start &&
-		       x_new == *x0 && crossing_value) {
-		/* same as first endpoint */
-		x0c++;
-	    } else if (x_new < *x1 && crossing_value) {
-		/* nearer than second endpoint */
-		*x1 = x_new;
-		x1c = 1;
-	    } else if (x_new == *x1 && crossing_value) {
-		/* same as second endpoint */
-		x1c++;
-	    }
-	}
-	/* check whether the span endpoints have been found */
-	if (!found_span_start && x0c % 2 == 1) {
-	    /* valid fill start found */
-	    found_span_start = true;
+static inline int poly_edge_x(const struct poly_edge *e)
+{
+    int num = e->num;
 
-	}
-	if (x1c % 2 == 1) {
-	    /* valid fill endpoint found */
-	    if (!found_span_start) {
-		/* not got a start yet; use this as start */
-		found_span_start = true;
-		x0c = x1c;
-		*x0 = *x1;
-	    } else {
-		/* got valid end of span */
-		return true;
-	    }
-	}
-	/* if current positions aren't valid endpoints, set new
-	 * minimums after current positions */
-	if (!found_span_start)
-	    x0_min = *x0 + 1;
-	x1_min = *x1 + 1;
+    if (e->dx == 0)
+	return e->x0;
 
-    } while (*x1 != INT_MAX);
+    num = ((num < 0) == (e->dy < 0)) ? num + (e->dy / 2) : num - (e->dy / 2);
 
-    /* no spans found */
-    return false;
+    return e->x0 + num / e->dy;
 }
 
-
 /**
  * Plot a polygon
  *
+ * Edges are sorted by their top row once. Each row then has the edges
+ * crossing it in an active list kept in order of their crossings, which
+ * barely changes from row to row, and the spans between crossings inside
+ * the polygon are filled together.
+ *
+ * Each edge crosses the rows from its top vertex up to but excluding its
+ * bottom vertex so shared vertices are counted once and horizontal edges
+ * not at all.
+ *
  * \param  nsfb	 framebuffer context
  * \param  p	 array of polygon vertices (x1, y1, x2, y2, ... , xN, yN)
  * \param  n	 number of polygon vertices (N)
  * \param  c	 fill colour
+ * \param  rule	 fill rule
  * \return true	 if no errors
  */
-static bool polygon(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t c)
+static bool
+polygon(nsfb_t *nsfb,
+	const int *p,
+	unsigned int n,
+	nsfb_colour_t c,
+	nsfb_plot_fill_rule_t rule)
 {
+    struct poly_edge edge_stack[POLY_STACK_EDGES];
+    struct poly_edge *active_stack[POLY_STACK_EDGES];
+    int span_stack[POLY_STACK_EDGES];
+    struct poly_edge *edges = edge_stack;
+    struct poly_edge **active = active_stack;
+    struct poly_edge *e;
+    int *span = span_stack;
     int poly_x0, poly_y0; /* Bounding box top left corner */
     int poly_x1, poly_y1; /* Bounding box bottom right corner */
-    int i, j; /* indexes */
-    int x0, x1; /* filled span extents */
+    int edgec; /* number of non horizontal edges */
+    int activec; /* number of edges crossing the current row */
+    int next; /* next edge to become active */
+    int spanc; /* number of spans on the current row */
+    int wind; /* winding number left of the current crossing */
+    int x0; /* start of the current span */
+    int x1; /* end of the current span */
     int y; /* current y coordinate */
     int y_max; /* bottom of plot area */
-    nsfb_bbox_t fline;
-    nsfb_plot_pen_t pen;
-
-    /* find no. of vertex values */
-    int v = n * 2;
+    unsigned int i, j;
 
     /* Can't plot polygons with 2 or fewer vertices */
     if (n <= 2)
 	return true;
 
-    pen.stroke_colour = c;
-
     /* Find polygon bounding box */
-    poly_x0 = poly_x1 = *p;
+    poly_x0 = poly_x1 = p[0];
     poly_y0 = poly_y1 = p[1];
-    for (i = 2; i < v; i = i + 2) {
-	j = i + 1;
-	if (p[i] < poly_x0)
-	    poly_x0 = p[i];
-	else if (p[i] > poly_x1)
-	    poly_x1 = p[i];
-	if (p[j] < poly_y0)
-	    poly_y0 = p[j];
-	else if (p[j] > poly_y1)
-	    poly_y1 = p[j];
+    for (i = 1; i < n; i++) {
+	if (p[i * 2] < poly_x0)
+	    poly_x0 = p[i * 2];
+	else if (p[i * 2] > poly_x1)
+	    poly_x1 = p[i * 2];
+	if (p[i * 2 + 1] < poly_y0)
+	    poly_y0 = p[i * 2 + 1];
+	else if (p[i * 2 + 1] > poly_y1)
+	    poly_y1 = p[i * 2 + 1];
     }
 
     /* Don't try to plot it if it's outside the clip rectangle */
@@ -301,6 +176,43 @@ static bool polygon(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t c)
 	nsfb->clip.x0 > poly_x1)
 	return true;
 
+    if (n > POLY_STACK_EDGES) {
+	/* the pointers go first as they need the strictest alignment */
+	active = malloc(n * (sizeof(struct poly_edge *) +
+			     sizeof(struct poly_edge) +
+			     sizeof(int)));
+	if (active == NULL)
+	    return false;
+	edges = (struct poly_edge *)(active + n);
+	span = (int *)(edges + n);
+    }
+
+    /* build the edge table */
+    edgec = 0;
+    for (i = 0; i < n; i++) {
+	j = (i + 1 == n) ? 0 : i + 1;
+
+	/* ignore horizontal lines */
+	if (p[i * 2 + 1] == p[j * 2 + 1])
+	    continue;
+
+	e = &edges[edgec++];
+	e->x0 = p[i * 2];
+	e->y0 = p[i * 2 + 1];
+	e->dx = p[j * 2] - e->x0;
+	e->dy = p[j * 2 + 1] - e->y0;
+	if (e->dy > 0) {
+	    e->top = e->y0;
+	    e->bottom = p[j * 2 + 1];
+	    e->wind = 1;
+	} else {
+	    e->top = p[j * 2 + 1];
+	    e->bottom = e->y0;
+	    e->wind = -1;
+	}
+    }
+    qsort(edges, edgec, sizeof(struct poly_edge), poly_edge_cmp);
+
     /* Find the top of the important area */
     if (poly_y0 > nsfb->clip.y0)
 	y = poly_y0;
@@ -313,34 +225,81 @@ static bool polygon(nsfb_t *nsfb, const int *p, unsigned int n, nsfb_colour_t c)
     else
 	y_max = nsfb->clip.y1;
 
+    activec = 0;
+    next = 0;
     for (; y < y_max; y++) {
-	x1 = poly_x0 - 1;
-	/* For each row */
-	while (find_span(p, v, x1 + 1, y, &x0, &x1)) {
-	    /* don't draw anything outside clip region */
-	    if (x1 < nsfb->clip.x0)
+	/* retire edges which end above this row and step the rest */
+	j = 0;
+	for (i = 0; i < (unsigned int)activec; i++) {
+	    e = active[i];
+	    if (e->bottom > y) {
+		e->num += e->dx;
+		active[j++] = e;
+	    }
+	}
+	activec = j;
+
+	/* add edges which start on or above this row */
+	while (next < edgec && edges[next].top <= y) {
+	    e = &edges[next++];
+	    if (e->bottom > y) {
+		e->num = (y - e->y0) * e->dx;
+		active[activec++] = e;
+	    }
+	}
+
+	/* find the crossings, keeping the list in order */
+	for (i = 0; i < (unsigned int)activec; i++) {
+	    e = active[i];
+	    e->x = poly_edge_x(e);
+	    for (j = i; j > 0 && active[j - 1]->x > e->x; j--)
+		active[j] = active[j - 1];
+	    active[j] = e;
+	}
+
+	/* collect the spans inside the polygon */
+	spanc = 0;
+	wind = 0;
+	x0 = 0;
+	for (i = 0; i < (unsigned int)activec; i++) {
+	    if (wind == 0)
+		x0 = active[i]->x;
+
+	    if (rule == NSFB_PLOT_FILL_NONZERO)
+		wind += active[i]->wind;
+	    else
+		wind ^= 1;
+
+	    if (wind != 0)
 		continue;
-	    else if (x0 < nsfb->clip.x0)
+
+	    /* don't draw anything outside clip region */
+	    x1 = active[i]->x;
+	    if (x0 < nsfb->clip.x0)
 		x0 = nsfb->clip.x0;
-	    if (x0 > nsfb->clip.x1)
-		break;
-	    else if (x1 > nsfb->clip.x1)
+	    if (x1 > nsfb->clip.x1)
 		x1 = nsfb->clip.x1;
+	    if (x1 <= x0)
+		continue;
 
-	    fline.x0 = x0;
-	    fline.y0 = y;
-	    fline.x1 = x1;
-	    fline.y1 = y;
-
-	    /* draw this filled span on current row */
-	    nsfb->plotter_fns->line(nsfb, 1, &fline, &pen);
-
-	    /* don't look for more spans if already at end of clip
-	     * region or polygon */
-	    if (x1 == nsfb->clip.x1 || x1 == poly_x1)
-		break;
+	    if (spanc > 0 && span[spanc * 2 - 1] == x0) {
+		/* join spans which meet */
+		span[spanc * 2 - 1] = x1;
+	    } else {
+		span[spanc * 2] = x0;
+		span[spanc * 2 + 1] = x1;
+		spanc++;
+	    }
 	}
+
+	/* draw the filled spans on current row */
+	if (spanc > 0)
+	    nsfb->plotter_fns->spans(nsfb, y, span, spanc, c);
     }
+
+    if (active != active_stack)
+	free(active);
+
     return true;
 }
 
@@ -350,16 +309,38 @@ rectangle(nsfb_t *nsfb, nsfb_bbox_t *rect,
 	  bool dotted, bool dashed)
 {
     nsfb_bbox_t side[4];
+    nsfb_point_t corner[4];
     nsfb_plot_pen_t pen;
 
     pen.stroke_colour = c;
     pen.stroke_width = line_width;
-    if (dotted || dashed) {
+    pen.stroke_cap = NSFB_PLOT_CAP_BUTT;
+    pen.stroke_join = NSFB_PLOT_JOIN_MITRE;
+    if (dotted) {
+	/* alternate dots and gaps */
 	pen.stroke_type = NFSB_PLOT_OPTYPE_PATTERN;
+	pen.stroke_pattern = 0x55555555;
+    } else if (dashed) {
+	/* dashes and gaps four times the line width */
+	pen.stroke_type = NFSB_PLOT_OPTYPE_PATTERN;
+	pen.stroke_pattern = 0x0F0F0F0F;
     } else {
 	pen.stroke_type = NFSB_PLOT_OPTYPE_SOLID;
     }
 
+    if (line_width > 1) {
+	corner[0].x = rect->x0;
+	corner[0].y = rect->y0;
+	corner[1].x = rect->x1;
+	corner[1].y = rect->y0;
+	corner[2].x = rect->x1;
+	corner[2].y = rect->y1;
+	corner[3].x = rect->x0;
+	corner[3].y = rect->y1;
+
+	return nsfb_stroke_polyline(nsfb, corner, 4, true, &pen);
+    }
+
     side[0] = *rect;
     side[1] = *rect;
     side[2] = *rect;
@@ -373,173 +354,149 @@ rectangle(nsfb_t *nsfb, nsfb_bbox_t *rect,
     return nsfb->plotter_fns->line(nsfb, 4, side, &pen);
 }
 
-/* plotter routine for ellipse points */
-static void
-ellipsepoints(nsfb_t *nsfb, int cx, int cy, int x, int y, nsfb_colour_t c)
+/* The rows of an ellipse fitted to a bounding box.
+ *
+ * The ellipse is centred on the pixel (cx, cy) and spans rx pixels either
+ * side of it horizontally and ry vertically. A pixel is inside if its
+ * centre lies within the ellipse whose radii are half a pixel longer, so
+ * each row is a single span. With doubled coordinates the column x is
+ * inside on the row dy from the centre where
+ * (2x)^2 b2 <= a2 (b2 - (2dy)^2)
+ */
+struct ellipse_rows {
+    int cx, cy;
+    int ry;
+    uint64_t a2; /* square of twice the extended horizontal radius */
+    uint64_t b2; /* square of twice the extended vertical radius */
+};
+
+/* the furthest column from the centre inside the ellipse on a row */
+static inline int ellipse_row_half(const struct ellipse_rows *e, int dy)
 {
-    nsfb->plotter_fns->point(nsfb, cx + x, cy + y, c);
-    nsfb->plotter_fns->point(nsfb, cx - x, cy + y, c);
-    nsfb->plotter_fns->point(nsfb, cx + x, cy - y, c);
-    nsfb->plotter_fns->point(nsfb, cx - x, cy - y, c);
+    uint64_t d2 = (uint64_t)(2 * dy) * (2 * dy);
+
+    return nsfb_plot_isqrt(e->a2 * (e->b2 - d2) / e->b2) >> 1;
 }
 
-static void
-ellipsefill(nsfb_t *nsfb, int cx, int cy, int x, int y, nsfb_colour_t c)
+/* step the furthest column of a row in to that of the next row out from the
+ * centre, -1 once past the ellipse
+ */
+static inline int
+ellipse_row_next(const struct ellipse_rows *e, int half, int dy)
 {
-    nsfb_bbox_t fline[2];
-    nsfb_plot_pen_t pen;
-
-    pen.stroke_colour = c;
+    uint64_t limit;
 
-    fline[0].x0 = fline[1].x0 = cx - x;
-    fline[0].x1 = fline[1].x1 = cx + x;
-    fline[0].y0 = fline[0].y1 = cy + y;
-    fline[1].y0 = fline[1].y1 = cy - y;
+    if (dy > e->ry)
+	return -1;
 
-    nsfb->plotter_fns->line(nsfb, 2, fline, &pen);
+    limit = e->a2 * (e->b2 - (uint64_t)(2 * dy) * (2 * dy));
+    while ((uint64_t)(2 * half) * (2 * half) * e->b2 > limit)
+	half--;
 
+    return half;
 }
 
-#define ROUND(a) ((int)(a+0.5))
-
-static bool
-ellipse_midpoint(nsfb_t *nsfb,
-		 int cx,
-		 int cy,
-		 int rx,
-		 int ry,
-		 nsfb_colour_t c,
-		 void (ellipsefn)(nsfb_t *nsfb, int cx, int cy, int x, int y, nsfb_colour_t c))
-{
-    int rx2 = rx * rx;
-    int ry2 = ry * ry;
-    int tworx2 = 2 * rx2;
-    int twory2 = 2 * ry2;
-    int p;
-    int x = 0;
-    int y = ry;
-    int px = 0;
-    int py = tworx2 * y;
-
-    ellipsefn(nsfb, cx, cy, x, y, c);
-
-    /* region 1 */
-    p = ROUND(ry2 - (rx2 * ry) + (0.25 * rx2));
-    while (px < py) {
-        x++;
-        px += twory2;
-        if (p <0) {
-            p+=ry2 + px;
-        } else {
-            y--;
-            py -= tworx2;
-            p+=ry2 + px - py;
-        }
-        ellipsefn(nsfb, cx, cy, x, y, c);
-    }
-
-    /* region 2 */
-    p = ROUND(ry2*(x+0.5)*(x+0.5) + rx2*(y-1)*(y-1) - rx2*ry2);
-    while (y > 0) {
-        y--;
-        py -= tworx2;
-        if (p > 0) {
-            p+=rx2 - py;
-        } else {
-            x++;
-            px += twory2;
-            p+=rx2 - py + px;
-        }
-        ellipsefn(nsfb, cx, cy, x, y, c);
-    }
-    return true;
-}
-
-
-/* plotter routine for 8way circle symetry */
-static void
-circlepoints(nsfb_t *nsfb, int cx, int cy, int x, int y, nsfb_colour_t c)
+/* append a span of a row, clipped to the columns of the clipping region */
+static inline int
+ellipse_span(const nsfb_t *nsfb, int *span, int x0, int x1)
 {
-    nsfb->plotter_fns->point(nsfb, cx + x, cy + y, c);
-    nsfb->plotter_fns->point(nsfb, cx - x, cy + y, c);
-    nsfb->plotter_fns->point(nsfb, cx + x, cy - y, c);
-    nsfb->plotter_fns->point(nsfb, cx - x, cy - y, c);
-    nsfb->plotter_fns->point(nsfb, cx + y, cy + x, c);
-    nsfb->plotter_fns->point(nsfb, cx - y, cy + x, c);
-    nsfb->plotter_fns->point(nsfb, cx + y, cy - x, c);
-    nsfb->plotter_fns->point(nsfb, cx - y, cy - x, c);
+    if (x0 < nsfb->clip.x0)
+	x0 = nsfb->clip.x0;
+    if (x1 > nsfb->clip.x1)
+	x1 = nsfb->clip.x1;
+    if (x0 >= x1)
+	return 0;
+
+    span[0] = x0;
+    span[1] = x1;
+    return 1;
 }
 
-static void
-circlefill(nsfb_t *nsfb, int cx, int cy, int x, int y, nsfb_colour_t c)
+/* Plot an ellipse as spans, each row within the clipping region once.
+ *
+ * The rows are walked out from the centre, each plotted above and below
+ * it, so the furthest column only ever steps inwards and one square root
+ * finds the first. The outline is the pixels of each row not inside the
+ * next row out, and at least the outermost one, so it is eight way
+ * connected.
+ */
+static bool
+ellipse_rows(nsfb_t *nsfb, const nsfb_bbox_t *ellipse, nsfb_colour_t c, bool outline)
 {
-    nsfb_bbox_t fline[4];
-    nsfb_plot_pen_t pen;
-
-    pen.stroke_colour = c;
-
-    fline[0].x0 = fline[1].x0 = cx - x;
-    fline[0].x1 = fline[1].x1 = cx + x;
-    fline[0].y0 = fline[0].y1 = cy + y;
-    fline[1].y0 = fline[1].y1 = cy - y;
-
-    fline[2].x0 = fline[3].x0 = cx - y;
-    fline[2].x1 = fline[3].x1 = cx + y;
-    fline[2].y0 = fline[2].y1 = cy + x;
-    fline[3].y0 = fline[3].y1 = cy - x;
+    struct ellipse_rows e;
+    int rx = (ellipse->x1 - ellipse->x0) >> 1;
+    int y0, y1;
+    int dy, dy1;
+    int half, next;
+    int inner;
+    int span[4];
+    int spanc;
+
+    e.ry = (ellipse->y1 - ellipse->y0) >> 1;
+    if ((rx < 0) || (e.ry < 0))
+	return true;
 
-    nsfb->plotter_fns->line(nsfb, 4, fline, &pen);
-}
+    e.cx = ellipse->x0 + rx;
+    e.cy = ellipse->y0 + e.ry;
+    e.a2 = (uint64_t)(2 * rx + 1) * (2 * rx + 1);
+    e.b2 = (uint64_t)(2 * e.ry + 1) * (2 * e.ry + 1);
+
+    /* the rows within the clipping region */
+    y0 = e.cy - e.ry;
+    if (y0 < nsfb->clip.y0)
+	y0 = nsfb->clip.y0;
+    y1 = e.cy + e.ry + 1;
+    if (y1 > nsfb->clip.y1)
+	y1 = nsfb->clip.y1;
+    if (y0 >= y1)
+	return true;
 
-static bool circle_midpoint(nsfb_t *nsfb,
-                            int cx,
-                            int cy,
-                            int r,
-                            nsfb_colour_t c,
-                            void (circfn)(nsfb_t *nsfb, int cx, int cy, int x, int y, nsfb_colour_t c))
-{
-    int x = 0;
-    int y = r;
-    int p = 1 - r;
+    /* and their distances from the centre */
+    if (y0 > e.cy)
+	dy = y0 - e.cy;
+    else if (y1 <= e.cy)
+	dy = e.cy - (y1 - 1);
+    else
+	dy = 0;
+    dy1 = abs(y0 - e.cy);
+    if (dy1 < y1 - 1 - e.cy)
+	dy1 = y1 - 1 - e.cy;
+
+    half = ellipse_row_half(&e, dy);
+    for (; dy <= dy1; dy++, half = next) {
+	next = ellipse_row_next(&e, half, dy + 1);
+
+	inner = outline ? next + 1 : 0;
+	if (inner > half)
+	    inner = half;
+
+	if (inner <= 0) {
+	    spanc = ellipse_span(nsfb, span, e.cx - half, e.cx + half + 1);
+	} else {
+	    spanc = ellipse_span(nsfb, span, e.cx - half, e.cx - inner + 1);
+	    spanc += ellipse_span(nsfb, span + 2 * spanc,
+				  e.cx + inner, e.cx + half + 1);
+	}
+	if (spanc == 0)
+	    continue;
 
-    circfn(nsfb, cx, cy, x, y, c);
-    while (x < y) {
-        x++;
-        if (p < 0) {
-            p += 2 * x + 1;
-        } else {
-            y--;
-            p += 2 * (x - y) + 1;
-        }
-        circfn(nsfb, cx, cy, x, y, c);
+	if (e.cy - dy >= y0)
+	    nsfb->plotter_fns->spans(nsfb, e.cy - dy, span, spanc, c);
+	if ((dy != 0) && (e.cy + dy < y1))
+	    nsfb->plotter_fns->spans(nsfb, e.cy + dy, span, spanc, c);
     }
+
     return true;
 }
 
 static bool ellipse(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c)
 {
-    int width = (ellipse->x1 - ellipse->x0)>>1;
-    int height = (ellipse->y1 - ellipse->y0)>>1;
-
-    if (width == height) {
-        /* circle */
-        return circle_midpoint(nsfb, ellipse->x0 + width, ellipse->y0 + height, width, c, circlepoints);
-    } else {
-        return ellipse_midpoint(nsfb, ellipse->x0 + width, ellipse->y0 + height, width, height, c, ellipsepoints);
-    }
+    return ellipse_rows(nsfb, ellipse, c, true);
 }
 
 static bool ellipse_fill(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c)
 {
-    int width = (ellipse->x1 - ellipse->x0) >> 1;
-    int height = (ellipse->y1 - ellipse->y0) >> 1;
-
-    if (width == height) {
-        /* circle */
-        return circle_midpoint(nsfb, ellipse->x0 + width, ellipse->y0 + height, width, c, circlefill);
-    } else {
-        return ellipse_midpoint(nsfb, ellipse->x0 + width, ellipse->y0 + height, width, height, c, ellipsefill);
-    }
+    return ellipse_rows(nsfb, ellipse, c, false);
 }
 
 
@@ -603,122 +560,239 @@ copy(nsfb_t *nsfb, nsfb_bbox_t *srcbox, nsfb_bbox_t *dstbox)
 
 
 
-static bool arc(nsfb_t *nsfb, int x, int y, int radius, int angle1, int angle2, nsfb_colour_t c)
+/* curves are flattened into no more than this many segments */
+#define CURVE_SEG_MAX 128
+
+/* greatest distance, in subpixels, of a flattened curve from the curve */
+#define CURVE_FLATNESS ((1 << NSFB_PLOT_SUBPIXEL_SHIFT) / 32)
+
+/* exported interface documented in plot.h */
+unsigned int nsfb_plot_isqrt(uint64_t v)
 {
-    nsfb=nsfb;
-    x = x;
-    y = y;
-    radius = radius;
-    c = c;
-    angle1=angle1;
-    angle2=angle2;
-    return true;
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > v)
+	bit >>= 2;
+
+    while (bit != 0) {
+	if (v >= root + bit) {
+	    v -= root + bit;
+	    root = (root >> 1) + bit;
+	} else {
+	    root >>= 1;
+	}
+	bit >>= 2;
+    }
+    return root;
 }
 
-#define N_SEG 30
+/* sines of whole degrees up to a right angle, with NSFB_PLOT_UNIT_SHIFT
+ * fractional bits
+ */
+static const int degree_sin[91] = {
+    0, 286, 572, 857, 1143, 1428, 1713, 1997, 2280, 2563,
+    2845, 3126, 3406, 3686, 3964, 4240, 4516, 4790, 5063, 5334,
+    5604, 5872, 6138, 6402, 6664, 6924, 7182, 7438, 7692, 7943,
+    8192, 8438, 8682, 8923, 9162, 9397, 9630, 9860, 10087, 10311,
+    10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+    12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+    14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+    15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+    16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+    16384,
+};
+
+/* exported interface documented in plot.h */
+void nsfb_plot_unit_angle(int angle, int *cosine, int *sine)
+{
+    angle %= 360;
+    if (angle < 0)
+	angle += 360;
+
+    switch (angle / 90) {
+    case 0:
+	*cosine = degree_sin[90 - angle];
+	*sine = degree_sin[angle];
+	break;
 
-static int
-cubic_points(unsigned int pointc,
-             nsfb_point_t *point,
-             nsfb_bbox_t *curve,
-             nsfb_point_t *ctrla,
-             nsfb_point_t *ctrlb)
-{
-    unsigned int seg_loop;
-    double t;
-    double one_minus_t;
-    double a;
-    double b;
-    double c;
-    double d;
-    double x;
-    double y;
-    int cur_point;
+    case 1:
+	*cosine = -degree_sin[angle - 90];
+	*sine = degree_sin[180 - angle];
+	break;
 
-    point[0].x = curve->x0;
-    point[0].y = curve->y0;
-    cur_point = 1;
-    pointc--;
+    case 2:
+	*cosine = -degree_sin[270 - angle];
+	*sine = -degree_sin[angle - 180];
+	break;
+
+    default:
+	*cosine = degree_sin[angle - 270];
+	*sine = -degree_sin[360 - angle];
+	break;
+    }
+}
 
-    for (seg_loop = 1; seg_loop < pointc; ++seg_loop) {
-        t = (double)seg_loop / (double)pointc;
+/* exported interface documented in plot.h */
+int nsfb_plot_arc_sweep(int *angle1, int angle2)
+{
+    int sweep = angle2 - *angle1;
 
-        one_minus_t = 1.0 - t;
+    *angle1 %= 360;
+    if (*angle1 < 0)
+	*angle1 += 360;
 
-        a = one_minus_t * one_minus_t * one_minus_t;
-        b = 3.0 * t * one_minus_t * one_minus_t;
-        c = 3.0 * t * t * one_minus_t;
-        d = t * t * t;
+    if ((sweep >= 360) || (sweep <= -360))
+	return 360;
 
-        x = a * curve->x0 + b * ctrla->x + c * ctrlb->x + d * curve->x1;
-        y = a * curve->y0 + b * ctrla->y + c * ctrlb->y + d * curve->y1;
+    sweep %= 360;
+    if (sweep < 0)
+	sweep += 360;
 
-        point[cur_point].x = x;
-        point[cur_point].y = y;
-        if ((point[cur_point].x != point[cur_point - 1].x) ||
-            (point[cur_point].y != point[cur_point - 1].y))
-	    cur_point++;
-    }
+    return sweep;
+}
 
-    point[cur_point].x = curve->x1;
-    point[cur_point].y = curve->y1;
-    if ((point[cur_point].x != point[cur_point - 1].x) ||
-        (point[cur_point].y != point[cur_point - 1].y))
-	cur_point++;
+/* length of the second difference of three control points */
+static unsigned int
+curve_dd(const nsfb_point_t *a, const nsfb_point_t *b, const nsfb_point_t *c)
+{
+    int64_t ddx = a->x - 2 * (int64_t)b->x + c->x;
+    int64_t ddy = a->y - 2 * (int64_t)b->y + c->y;
 
-    return cur_point;
+    return nsfb_plot_isqrt(ddx * ddx + ddy * ddy);
 }
 
-/* calculate a series of points which describe a quadratic bezier spline.
+/* number of segments needed to flatten a bezier curve.
+ *
+ * A curve split into n equal parameter steps is within |P''| / 8n^2 of its
+ * chords. P'' is 2dd for a quadratic and at most 6 max(dd) for a cubic,
+ * where dd are the second differences of the control points.
  *
- * fills an array of points with values describing a quadratic curve. Both the
- * start and end points are included as the first and last points
- * respectively. Only if the next point on the curve is different from its
- * predecessor is the point added which ensures points for the same position
- * are not repeated.
+ * \param ctrl control points in subpixels
+ * \param ctrlc number of control points, 3 or 4
  */
-static int
-quadratic_points(unsigned int pointc,
-                 nsfb_point_t *point,
-                 nsfb_bbox_t *curve,
-                 nsfb_point_t *ctrla)
-{
-    unsigned int seg_loop;
-    double t;
-    double one_minus_t;
-    double a;
-    double b;
-    double c;
-    double x;
-    double y;
-    int cur_point;
+static int curve_segments(const nsfb_point_t *ctrl, int ctrlc)
+{
+    uint64_t dd;
+    uint64_t sq;
+    unsigned int n;
+
+    dd = curve_dd(&ctrl[0], &ctrl[1], &ctrl[2]);
+    if (ctrlc == 4) {
+	sq = curve_dd(&ctrl[1], &ctrl[2], &ctrl[3]);
+	if (sq > dd)
+	    dd = sq;
+	dd *= 3;
+    }
 
-    point[0].x = curve->x0;
-    point[0].y = curve->y0;
-    cur_point = 1;
-    pointc--; /* we have added the start point, one less point in the curve */
+    sq = (dd + 4 * CURVE_FLATNESS - 1) / (4 * CURVE_FLATNESS);
+    n = nsfb_plot_isqrt(sq);
+    if ((uint64_t)n * n < sq)
+	n++;
 
-    for (seg_loop = 1; seg_loop < pointc; ++seg_loop) {
-        t = (double)seg_loop / (double)pointc;
+    if (n < 1)
+	n = 1;
+    else if (n > CURVE_SEG_MAX)
+	n = CURVE_SEG_MAX;
 
-        one_minus_t = 1.0 - t;
+    return n;
+}
 
-        a = one_minus_t * one_minus_t;
-        b = 2.0 * t * one_minus_t;
-        c = t * t;
+/* divide rounding to nearest, halves up as path coordinates are */
+static inline int curve_round(int64_t v, int64_t d)
+{
+    v += d / 2;
+    if (v < 0)
+	return -((d - 1 - v) / d);
+    return v / d;
+}
 
-        x = a * curve->x0 + b * ctrla->x + c * curve->x1;
-        y = a * curve->y0 + b * ctrla->y + c * curve->y1;
+/* calculate a series of points which describe a bezier curve.
+ *
+ * fills an array of points with values describing a quadratic or cubic
+ * curve. Both the start and end points are included as the first and last
+ * points respectively. Only if the next point on the curve is different
+ * from its predecessor is the point added which ensures points for the
+ * same position are not repeated.
+ *
+ * The curve is evaluated by forward differencing in integers scaled by the
+ * cube of the segment count, so it is exact at every step, and the points
+ * are rounded once when they are stored.
+ *
+ * \param point array of at least curve_segments() + 1 points to fill
+ * \param ctrl control points in subpixels
+ * \param ctrlc number of control points, 3 or 4
+ * \param down bits to scale the points down by
+ * \return the number of points
+ */
+static int
+curve_points(nsfb_point_t *point, const nsfb_point_t *ctrl, int ctrlc, int down)
+{
+    int64_t n = curve_segments(ctrl, ctrlc);
+    int64_t den;
+    int64_t x, dx, ddx, dddx;
+    int64_t y, dy, ddy, dddy;
+    int64_t ax, bx, cx;
+    int64_t ay, by, cy;
+    int seg_loop;
+    int cur_point;
 
-        point[cur_point].x = x;
-        point[cur_point].y = y;
-        if ((point[cur_point].x != point[cur_point - 1].x) ||
-            (point[cur_point].y != point[cur_point - 1].y))
+    if (ctrlc == 3) {
+	/* P(t) = at^2 + bt + p0, scaled by n^2 */
+	ax = ctrl[0].x - 2 * (int64_t)ctrl[1].x + ctrl[2].x;
+	ay = ctrl[0].y - 2 * (int64_t)ctrl[1].y + ctrl[2].y;
+	bx = 2 * ((int64_t)ctrl[1].x - ctrl[0].x);
+	by = 2 * ((int64_t)ctrl[1].y - ctrl[0].y);
+
+	den = n * n;
+	dx = ax + bx * n;
+	dy = ay + by * n;
+	ddx = 2 * ax;
+	ddy = 2 * ay;
+	dddx = 0;
+	dddy = 0;
+    } else {
+	/* P(t) = at^3 + bt^2 + ct + p0, scaled by n^3 */
+	ax = 3 * ((int64_t)ctrl[1].x - ctrl[2].x) + ctrl[3].x - ctrl[0].x;
+	ay = 3 * ((int64_t)ctrl[1].y - ctrl[2].y) + ctrl[3].y - ctrl[0].y;
+	bx = 3 * (ctrl[0].x - 2 * (int64_t)ctrl[1].x + ctrl[2].x);
+	by = 3 * (ctrl[0].y - 2 * (int64_t)ctrl[1].y + ctrl[2].y);
+	cx = 3 * ((int64_t)ctrl[1].x - ctrl[0].x);
+	cy = 3 * ((int64_t)ctrl[1].y - ctrl[0].y);
+
+	den = n * n * n;
+	dx = ax + (bx + cx * n) * n;
+	dy = ay + (by + cy * n) * n;
+	ddx = 6 * ax + 2 * bx * n;
+	ddy = 6 * ay + 2 * by * n;
+	dddx = 6 * ax;
+	dddy = 6 * ay;
+    }
+    x = ctrl[0].x * den;
+    y = ctrl[0].y * den;
+    den <<= down;
+
+    point[0].x = curve_round(x, den);
+    point[0].y = curve_round(y, den);
+    cur_point = 1;
+
+    for (seg_loop = 1; seg_loop < n; seg_loop++) {
+	x += dx;
+	y += dy;
+	dx += ddx;
+	dy += ddy;
+	ddx += dddx;
+	ddy += dddy;
+
+	point[cur_point].x = curve_round(x, den);
+	point[cur_point].y = curve_round(y, den);
+	if ((point[cur_point].x != point[cur_point - 1].x) ||
+	    (point[cur_point].y != point[cur_point - 1].y))
 	    cur_point++;
     }
 
-    point[cur_point].x = curve->x1;
-    point[cur_point].y = curve->y1;
+    point[cur_point].x = curve_round(ctrl[ctrlc - 1].x, 1 << down);
+    point[cur_point].y = curve_round(ctrl[ctrlc - 1].y, 1 << down);
     if ((point[cur_point].x != point[cur_point - 1].x) ||
         (point[cur_point].y != point[cur_point - 1].y))
 	cur_point++;
@@ -735,122 +809,498 @@ polylines(nsfb_t *nsfb,
     int point_loop;
     nsfb_bbox_t line;
 
-    if (pen->stroke_type != NFSB_PLOT_OPTYPE_NONE) {
-        for (point_loop = 0; point_loop < (pointc - 1); point_loop++) {
-            line = *(nsfb_bbox_t *)&points[point_loop];
-            nsfb->plotter_fns->line(nsfb, 1, &line, pen);
-	}
+    if (pen->stroke_type == NFSB_PLOT_OPTYPE_NONE)
+        return true;
+
+    if (pen->stroke_width > 1)
+        return nsfb_stroke_polyline(nsfb, points, pointc, false, pen);
+
+    for (point_loop = 0; point_loop < (pointc - 1); point_loop++) {
+        line = *(nsfb_bbox_t *)&points[point_loop];
+        nsfb->plotter_fns->line(nsfb, 1, &line, pen);
     }
     return true;
 }
 
+/* flatten and stroke a curve given in pixels */
+static bool
+curve(nsfb_t *nsfb,
+      nsfb_point_t *ctrl,
+      int ctrlc,
+      nsfb_plot_pen_t *pen)
+{
+    nsfb_point_t points[CURVE_SEG_MAX + 1];
+    int ctrl_loop;
+
+    if (pen->stroke_type == NFSB_PLOT_OPTYPE_NONE)
+        return false;
+
+    for (ctrl_loop = 0; ctrl_loop < ctrlc; ctrl_loop++) {
+	ctrl[ctrl_loop].x *= 1 << NSFB_PLOT_SUBPIXEL_SHIFT;
+	ctrl[ctrl_loop].y *= 1 << NSFB_PLOT_SUBPIXEL_SHIFT;
+    }
 
+    return polylines(nsfb,
+		     curve_points(points, ctrl, ctrlc,
+				  NSFB_PLOT_SUBPIXEL_SHIFT),
+		     points, pen);
+}
 
 static bool
 quadratic(nsfb_t *nsfb,
-          nsfb_bbox_t *curve,
+          nsfb_bbox_t *curve_box,
           nsfb_point_t *ctrla,
           nsfb_plot_pen_t *pen)
 {
-    nsfb_point_t points[N_SEG];
+    nsfb_point_t ctrl[3];
 
-    if (pen->stroke_type == NFSB_PLOT_OPTYPE_NONE)
-        return false;
+    ctrl[0].x = curve_box->x0;
+    ctrl[0].y = curve_box->y0;
+    ctrl[1] = *ctrla;
+    ctrl[2].x = curve_box->x1;
+    ctrl[2].y = curve_box->y1;
 
-    return polylines(nsfb, quadratic_points(N_SEG, points, curve, ctrla), points, pen);
+    return curve(nsfb, ctrl, 3, pen);
 }
 
 static bool
 cubic(nsfb_t *nsfb,
-      nsfb_bbox_t *curve,
+      nsfb_bbox_t *curve_box,
       nsfb_point_t *ctrla,
       nsfb_point_t *ctrlb,
       nsfb_plot_pen_t *pen)
 {
-    nsfb_point_t points[N_SEG];
+    nsfb_point_t ctrl[4];
 
-    if (pen->stroke_type == NFSB_PLOT_OPTYPE_NONE)
-        return false;
+    ctrl[0].x = curve_box->x0;
+    ctrl[0].y = curve_box->y0;
+    ctrl[1] = *ctrla;
+    ctrl[2] = *ctrlb;
+    ctrl[3].x = curve_box->x1;
+    ctrl[3].y = curve_box->y1;
 
-    return polylines(nsfb, cubic_points(N_SEG, points, curve, ctrla,ctrlb), points, pen);
+    return curve(nsfb, ctrl, 4, pen);
 }
 
 
-static bool
-path(nsfb_t *nsfb, int pathc, nsfb_plot_pathop_t *pathop, nsfb_plot_pen_t *pen)
+/* scale a path coordinate up to subpixels and down to the nearest pixel */
+static inline int path_coord(int v, int up, int down)
+{
+    v *= 1 << up;
+    if (down != 0)
+	return (v + (1 << (down - 1))) >> down;
+    return v;
+}
+
+static inline void
+path_point(nsfb_point_t *pt, const nsfb_plot_pathop_t *pathop, int up, int down)
+{
+    pt->x = path_coord(pathop->point.x, up, down);
+    pt->y = path_coord(pathop->point.y, up, down);
+}
+
+/* control points, in subpixels, of the curve ending at a path operation */
+static inline void
+path_curve(nsfb_point_t *ctrl, int ctrlc, const nsfb_plot_pathop_t *pathop, int up)
+{
+    int ctrl_loop;
+
+    for (ctrl_loop = 0; ctrl_loop < ctrlc; ctrl_loop++) {
+	path_point(&ctrl[ctrl_loop], pathop - (ctrlc - 1) + ctrl_loop, up, 0);
+    }
+}
+
+/* drop subpaths started by the control points of a curve */
+static inline int path_unstart(const int *contour, int startc, int curve)
+{
+    if (contour != NULL) {
+	while (startc > 0 && contour[startc - 1] > curve)
+	    startc--;
+    }
+    return startc;
+}
+
+/**
+ * Flatten a path into a list of vertices.
+ *
+ * The control points of curves are given by the operations preceding the
+ * curve, whatever their type. Other move operations start a new subpath,
+ * the index of the first vertex of each is stored in contour if it is not
+ * NULL.
+ *
+ * Curves are flattened in subpixels, so coordinates are always scaled up
+ * to those before being scaled down to the vertices.
+ *
+ * \param  pathc	 number of path operations
+ * \param  pathop	 path operations
+ * \param  up	 bits to scale coordinates up to subpixels by
+ * \param  down	 bits to scale subpixels down to vertices by
+ * \param  pts	 updated with the vertices
+ * \param  contour	 updated with the start of each subpath or NULL
+ * \param  contourc	 updated with the number of subpaths
+ * \return the number of vertices
+ */
+static int
+path_points(int pathc,
+	    nsfb_plot_pathop_t *pathop,
+	    int up,
+	    int down,
+	    nsfb_point_t *pts,
+	    int *contour,
+	    int *contourc)
 {
     int path_loop;
-    nsfb_point_t *pts;
-    nsfb_point_t *curpt;
-    int ptc = 0;
-    nsfb_bbox_t curve;
-    nsfb_point_t ctrla;
-    nsfb_point_t ctrlb;
+    nsfb_point_t *curpt = pts;
+    nsfb_point_t ctrl[4];
+    int ctrlc;
     int added_count = 0;
     int bpts;
+    int startc = 0;
 
-    /* count the verticies in the path and add N_SEG extra for curves */
     for (path_loop = 0; path_loop < pathc; path_loop++) {
-        ptc++;
-        if ((pathop[path_loop].operation == NFSB_PLOT_PATHOP_QUAD) ||
-            (pathop[path_loop].operation == NFSB_PLOT_PATHOP_CUBIC))
-            ptc += N_SEG;
+        switch (pathop[path_loop].operation) {
+        case NFSB_PLOT_PATHOP_QUAD:
+        case NFSB_PLOT_PATHOP_CUBIC:
+            if (pathop[path_loop].operation == NFSB_PLOT_PATHOP_QUAD)
+                ctrlc = 3;
+            else
+                ctrlc = 4;
+            curpt -= ctrlc - 1;
+            added_count -= ctrlc - 1;
+            startc = path_unstart(contour, startc, added_count);
+            path_curve(ctrl, ctrlc, &pathop[path_loop], up);
+            bpts = curve_points(curpt, ctrl, ctrlc, down);
+            curpt += bpts;
+            added_count += bpts;
+            break;
+
+        default:
+            if ((contour != NULL) &&
+                ((startc == 0) ||
+                 (pathop[path_loop].operation == NFSB_PLOT_PATHOP_MOVE)))
+                contour[startc++] = added_count;
+            path_point(curpt, &pathop[path_loop], up, down);
+            curpt++;
+            added_count ++;
+            break;
+        }
     }
 
-    /* allocate storage for the vertexes */
-    curpt = pts = malloc(ptc * sizeof(nsfb_point_t));
+    if (contour != NULL) {
+        /* convert the starts into lengths */
+        for (path_loop = 0; path_loop < startc; path_loop++) {
+            if (path_loop + 1 < startc)
+                contour[path_loop] = contour[path_loop + 1] - contour[path_loop];
+            else
+                contour[path_loop] = added_count - contour[path_loop];
+        }
+        *contourc = startc;
+    }
 
+    return added_count;
+}
+
+/* paths with up to this many vertices and operations are flattened on the
+ * stack
+ */
+#define PATH_STACK_POINTS 256
+
+static bool
+path(nsfb_t *nsfb,
+     int pathc,
+     nsfb_plot_pathop_t *pathop,
+     nsfb_plot_pen_t *pen,
+     bool subpixel)
+{
+    nsfb_point_t pts_stack[PATH_STACK_POINTS];
+    int contour_stack[PATH_STACK_POINTS];
+    nsfb_point_t *pts = pts_stack;
+    int *contour = contour_stack;
+    nsfb_point_t ctrl[4];
+    int path_loop;
+    int contourc;
+    int ptc = 0;
+    int up = subpixel ? 0 : NSFB_PLOT_SUBPIXEL_SHIFT;
+    int added_count;
+    bool aa_fill = (pen->fill_type == NFSB_PLOT_OPTYPE_SOLID_AA);
+    bool fill = (pen->fill_type != NFSB_PLOT_OPTYPE_NONE) && !aa_fill;
+    bool ret = true;
+
+    /* count the verticies in the path, curves replace their control
+     * points with at most one more vertex than they have segments
+     */
     for (path_loop = 0; path_loop < pathc; path_loop++) {
         switch (pathop[path_loop].operation) {
         case NFSB_PLOT_PATHOP_QUAD:
-            curpt-=2;
-            added_count -= 2;
-            curve.x0 = pathop[path_loop - 2].point.x;
-            curve.y0 = pathop[path_loop - 2].point.y;
-            ctrla.x = pathop[path_loop - 1].point.x;
-            ctrla.y = pathop[path_loop - 1].point.y;
-            curve.x1 = pathop[path_loop].point.x;
-            curve.y1 = pathop[path_loop].point.y;
-            bpts = quadratic_points(N_SEG, curpt, &curve, &ctrla);
-            curpt += bpts;
-            added_count += bpts;
+            path_curve(ctrl, 3, &pathop[path_loop], up);
+            ptc += curve_segments(ctrl, 3) - 1;
             break;
 
         case NFSB_PLOT_PATHOP_CUBIC:
-            curpt-=3;
-            added_count -=3;
-            curve.x0 = pathop[path_loop - 3].point.x;
-            curve.y0 = pathop[path_loop - 3].point.y;
-            ctrla.x = pathop[path_loop - 2].point.x;
-            ctrla.y = pathop[path_loop - 2].point.y;
-            ctrlb.x = pathop[path_loop - 1].point.x;
-            ctrlb.y = pathop[path_loop - 1].point.y;
-            curve.x1 = pathop[path_loop].point.x;
-            curve.y1 = pathop[path_loop].point.y;
-            bpts = cubic_points(N_SEG, curpt, &curve, &ctrla, &ctrlb);
-            curpt += bpts;
-            added_count += bpts;
+            path_curve(ctrl, 4, &pathop[path_loop], up);
+            ptc += curve_segments(ctrl, 4) - 2;
             break;
 
         default:
-            *curpt = pathop[path_loop].point;
-            curpt++;
-            added_count ++;
+            ptc++;
             break;
         }
     }
 
-    if (pen->fill_type != NFSB_PLOT_OPTYPE_NONE) {
-        polygon(nsfb, (int *)pts, added_count, pen->fill_colour);
+    /* allocate storage for the vertexes and the subpaths */
+    if (ptc > PATH_STACK_POINTS || pathc > PATH_STACK_POINTS) {
+	pts = malloc(ptc * sizeof(nsfb_point_t) + pathc * sizeof(int));
+	if (pts == NULL)
+	    return false;
+	contour = (int *)(pts + ptc);
     }
 
-    if (pen->stroke_type != NFSB_PLOT_OPTYPE_NONE) {
-        polylines(nsfb, added_count, pts, pen);
+    if (aa_fill) {
+	added_count = path_points(pathc, pathop, up, 0,
+				  pts, contour, &contourc);
+	ret = nsfb_coverage_fill(nsfb, pts, contour, contourc,
+				 pen->fill_colour, pen->fill_rule);
     }
 
-    free(pts);
+    if (fill || (pen->stroke_type != NFSB_PLOT_OPTYPE_NONE)) {
+	added_count = path_points(pathc, pathop,
+				  up, NSFB_PLOT_SUBPIXEL_SHIFT,
+				  pts, NULL, NULL);
 
-    return true;
+	if (fill) {
+	    polygon(nsfb, (int *)pts, added_count, pen->fill_colour,
+		    pen->fill_rule);
+	}
+
+	if (pen->stroke_type != NFSB_PLOT_OPTYPE_NONE) {
+	    polylines(nsfb, added_count, pts, pen);
+	}
+    }
+
+    if (pts != pts_stack)
+	free(pts);
+
+    return ret;
+}
+
+/* cosines of the eighths of a circle, with ELLIPSE_UNIT_SHIFT fractional bits */
+#define ELLIPSE_UNIT_SHIFT 14
+static const int ellipse_cos[8] = {
+    16384, 11585, 0, -11585, -16384, -11585, 0, 11585
+};
+
+/* length of the control arms of a cubic bezier approximating an eighth of a
+ * circle, 4/3 tan(pi/16), with ELLIPSE_UNIT_SHIFT fractional bits
+ */
+#define ELLIPSE_ARM 4345
+
+#define ELLIPSE_PATHOPS 25
+
+static inline void
+ellipse_pathop(nsfb_plot_pathop_t *op,
+	       nsfb_plot_pathop_type_t operation,
+	       int cx, int cy, int rx, int ry,
+	       int ux, int uy)
+{
+    op->operation = operation;
+    op->point.x = cx + (int)(((int64_t)ux * rx) >> ELLIPSE_UNIT_SHIFT);
+    op->point.y = cy + (int)(((int64_t)uy * ry) >> ELLIPSE_UNIT_SHIFT);
+}
+
+/* build the path of an ellipse, in subpixels, from eight cubic arcs */
+static void
+ellipse_path(nsfb_plot_pathop_t *op, int cx, int cy, int rx, int ry)
+{
+    int arc;
+    int ca, sa, cb, sb;
+
+    ellipse_pathop(op++, NFSB_PLOT_PATHOP_MOVE, cx, cy, rx, ry,
+		   ellipse_cos[0], ellipse_cos[6]);
+
+    for (arc = 0; arc < 8; arc++) {
+	ca = ellipse_cos[arc];
+	sa = ellipse_cos[(arc + 6) & 7];
+	cb = ellipse_cos[(arc + 1) & 7];
+	sb = ellipse_cos[(arc + 7) & 7];
+
+	ellipse_pathop(op++, NFSB_PLOT_PATHOP_LINE, cx, cy, rx, ry,
+		       ca - ((ELLIPSE_ARM * sa) >> ELLIPSE_UNIT_SHIFT),
+		       sa + ((ELLIPSE_ARM * ca) >> ELLIPSE_UNIT_SHIFT));
+	ellipse_pathop(op++, NFSB_PLOT_PATHOP_LINE, cx, cy, rx, ry,
+		       cb + ((ELLIPSE_ARM * sb) >> ELLIPSE_UNIT_SHIFT),
+		       sb - ((ELLIPSE_ARM * cb) >> ELLIPSE_UNIT_SHIFT));
+	ellipse_pathop(op++, NFSB_PLOT_PATHOP_CUBIC, cx, cy, rx, ry,
+		       cb, sb);
+    }
+}
+
+/* fill the ellipse of a bounding box with anti-aliased edges, or if inset
+ * is not zero the ring between it and the ellipse inset subpixels inside it
+ */
+static bool
+ellipse_aa_ring(nsfb_t *nsfb,
+		const nsfb_bbox_t *ellipse,
+		int inset,
+		nsfb_colour_t c)
+{
+    nsfb_plot_pathop_t pathop[2 * ELLIPSE_PATHOPS];
+    nsfb_plot_pen_t pen;
+    int rx = (ellipse->x1 - ellipse->x0) >> 1;
+    int ry = (ellipse->y1 - ellipse->y0) >> 1;
+    int cx, cy;
+    int pathc = ELLIPSE_PATHOPS;
+    int half = 1 << (NSFB_PLOT_SUBPIXEL_SHIFT - 1);
+
+    if ((rx < 0) || (ry < 0))
+	return true;
+
+    /* the same centre and extended radii as the aliased ellipse */
+    cx = (ellipse->x0 + rx) * (1 << NSFB_PLOT_SUBPIXEL_SHIFT) + half;
+    cy = (ellipse->y0 + ry) * (1 << NSFB_PLOT_SUBPIXEL_SHIFT) + half;
+    rx <<= NSFB_PLOT_SUBPIXEL_SHIFT;
+    ry <<= NSFB_PLOT_SUBPIXEL_SHIFT;
+
+    ellipse_path(pathop, cx, cy, rx + half, ry + half);
+    if ((inset != 0) && (rx > inset - half) && (ry > inset - half)) {
+	/* reflected so it winds the other way and cuts out of the fill */
+	ellipse_path(pathop + pathc, cx, cy,
+		     rx + half - inset, -(ry + half - inset));
+	pathc += ELLIPSE_PATHOPS;
+    }
+
+    memset(&pen, 0, sizeof(pen));
+    pen.stroke_type = NFSB_PLOT_OPTYPE_NONE;
+    pen.fill_type = NFSB_PLOT_OPTYPE_SOLID_AA;
+    pen.fill_colour = c;
+    pen.fill_rule = NSFB_PLOT_FILL_NONZERO;
+
+    return path(nsfb, pathc, pathop, &pen, true);
+}
+
+/* the outline is a ring a pixel wide centred on the radii of the aliased
+ * outline
+ */
+static bool ellipse_aa(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c)
+{
+    return ellipse_aa_ring(nsfb, ellipse, 1 << NSFB_PLOT_SUBPIXEL_SHIFT, c);
+}
+
+static bool
+ellipse_fill_aa(nsfb_t *nsfb, nsfb_bbox_t *ellipse, nsfb_colour_t c)
+{
+    return ellipse_aa_ring(nsfb, ellipse, 0, c);
+}
+
+/* the vertices of an arc are at most this many degrees apart */
+#define ARC_STEP_MAX 15
+
+/* most vertices of an arc, and its centre */
+#define ARC_POINTS (360 + 1)
+
+/* a vertex of an arc about the centre (cx, cy), all in subpixels */
+static inline void
+arc_point(nsfb_point_t *point, int cx, int cy, int64_t r, int angle)
+{
+    int round = 1 << (NSFB_PLOT_UNIT_SHIFT - 1);
+    int cosine, sine;
+
+    nsfb_plot_unit_angle(angle, &cosine, &sine);
+    point->x = cx + (int)((r * cosine + round) >> NSFB_PLOT_UNIT_SHIFT);
+    point->y = cy - (int)((r * sine + round) >> NSFB_PLOT_UNIT_SHIFT);
+}
+
+/* the vertices of an arc, in subpixels, at whole degrees along it and far
+ * enough apart that each chord is within about 1/32 of a pixel of the arc
+ */
+static int
+arc_points(nsfb_point_t *point, int x, int y, int radius, int angle1, int sweep)
+{
+    int64_t r = (int64_t)radius << NSFB_PLOT_SUBPIXEL_SHIFT;
+    int half = 1 << (NSFB_PLOT_SUBPIXEL_SHIFT - 1);
+    int cx = x * (1 << NSFB_PLOT_SUBPIXEL_SHIFT) + half;
+    int cy = y * (1 << NSFB_PLOT_SUBPIXEL_SHIFT) + half;
+    int step;
+    int angle;
+    int pointc = 0;
+
+    if (radius >= 64)
+	step = 1;
+    else if (radius >= 16)
+	step = 3;
+    else if (radius >= 4)
+	step = 6;
+    else
+	step = ARC_STEP_MAX;
+
+    for (angle = 0; angle < sweep; angle += step)
+	arc_point(&point[pointc++], cx, cy, r, angle1 + angle);
+
+    /* open arcs always finish on their end */
+    if (sweep != 360)
+	arc_point(&point[pointc++], cx, cy, r, angle1 + sweep);
+
+    return pointc;
+}
+
+/* the sector is filled first, from the vertices of the arc and its centre,
+ * then the arc is stroked over it. Thin solid arcs are rasterized directly.
+ */
+static bool
+arc_pen(nsfb_t *nsfb,
+	int x,
+	int y,
+	int radius,
+	int angle1,
+	int angle2,
+	nsfb_plot_pen_t *pen)
+{
+    nsfb_point_t point[ARC_POINTS];
+    int fill_point[2 * ARC_POINTS];
+    int contour;
+    int sweep;
+    int pointc;
+    int point_loop;
+    bool ret = true;
+
+    if (radius < 0)
+	return true;
+
+    sweep = nsfb_plot_arc_sweep(&angle1, angle2);
+    if (sweep == 0)
+	return true;
+
+    /* the centre comes before the arc */
+    point[0].x = x * (1 << NSFB_PLOT_SUBPIXEL_SHIFT) + (1 << (NSFB_PLOT_SUBPIXEL_SHIFT - 1));
+    point[0].y = y * (1 << NSFB_PLOT_SUBPIXEL_SHIFT) + (1 << (NSFB_PLOT_SUBPIXEL_SHIFT - 1));
+    pointc = arc_points(point + 1, x, y, radius, angle1, sweep);
+
+    if (pen->fill_type == NFSB_PLOT_OPTYPE_SOLID_AA) {
+	/* a whole circle is filled without its centre */
+	contour = pointc + ((sweep == 360) ? 0 : 1);
+	ret = nsfb_coverage_fill(nsfb, point + pointc + 1 - contour, &contour,
+				 1, pen->fill_colour, NSFB_PLOT_FILL_NONZERO);
+    } else if (pen->fill_type != NFSB_PLOT_OPTYPE_NONE) {
+	contour = pointc + ((sweep == 360) ? 0 : 1);
+	for (point_loop = 0; point_loop < contour; point_loop++) {
+	    fill_point[2 * point_loop] =
+		point[pointc + 1 - contour + point_loop].x >> NSFB_PLOT_SUBPIXEL_SHIFT;
+	    fill_point[2 * point_loop + 1] =
+		point[pointc + 1 - contour + point_loop].y >> NSFB_PLOT_SUBPIXEL_SHIFT;
+	}
+	ret = polygon(nsfb, fill_point, contour, pen->fill_colour,
+		      NSFB_PLOT_FILL_NONZERO);
+    }
+
+    if (!ret || (pen->stroke_type == NFSB_PLOT_OPTYPE_NONE))
+	return ret;
+
+    if ((pen->stroke_type == NFSB_PLOT_OPTYPE_SOLID) && (pen->stroke_width <= 1))
+	return nsfb->plotter_fns->arc(nsfb, x, y, radius,
+				      angle1, angle1 + sweep,
+				      pen->stroke_colour);
+
+    return nsfb_stroke_polyline_subpixel(nsfb, point + 1, pointc,
+					 sweep == 360, pen);
 }
 
 bool select_plotters(nsfb_t *nsfb)
@@ -920,18 +1370,29 @@ bool select_plotters(nsfb_t *nsfb)
     nsfb->plotter_fns->rectangle = rectangle;
     nsfb->plotter_fns->ellipse = ellipse;
     nsfb->plotter_fns->ellipse_fill = ellipse_fill;
+    nsfb->plotter_fns->ellipse_aa = ellipse_aa;
+    nsfb->plotter_fns->ellipse_fill_aa = ellipse_fill_aa;
     nsfb->plotter_fns->copy = copy;
-    nsfb->plotter_fns->arc = arc;
+    nsfb->plotter_fns->arc_pen = arc_pen;
     nsfb->plotter_fns->quadratic = quadratic;
     nsfb->plotter_fns->cubic = cubic;
     nsfb->plotter_fns->path = path;
     nsfb->plotter_fns->polylines = polylines;
 
+    /* choose the row kernels for this context, falling back to the
+     * scalar ones if the requested set is unavailable
+     */
+    nsfb->kernel_fns = nsfb_kernel_select(nsfb->simd);
+    if (nsfb->kernel_fns == NULL)
+	nsfb->kernel_fns = &_nsfb_kernel_generic;
+
     /* set default clip rectangle to size of framebuffer */
     nsfb->clip.x0 = 0;
     nsfb->clip.y0 = 0;
     nsfb->clip.x1 = nsfb->width;
     nsfb->clip.y1 = nsfb->height;
+    if (nsfb->region != NULL)
+	nsfb_region_reset(nsfb);
 
     return true;
 }
@@ -0,0 +1,492 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Glyph cache (implementation).
+ *
+ * Glyphs are packed one after another into shared atlas pages, each entry
+ * header followed directly by its bitmap. 8bpp rows are exactly the glyph
+ * width and 1bpp rows are exactly the glyph width in bits. Entries are
+ * found through a hash of the id and size chained through the entries
+ * themselves, so adding a glyph never allocates unless a new page is
+ * needed.
+ *
+ * Pages are kept on a list in order of use and the budget is enforced by
+ * discarding the least recently used page with all the glyphs in it. A
+ * replaced glyph leaves a hole in its page which is reclaimed when every
+ * glyph in the page has gone.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+
+#include "nsfb.h"
+#include "plot.h"
+#include "dlist.h"
+#include "damage.h"
+#include "region.h"
+
+/* initial number of hash buckets, must be a power of two */
+#define GLYPH_CACHE_BUCKETS 256
+
+/* size of an atlas page, glyphs larger than this get a page of their own */
+#define GLYPH_ATLAS_PAGE (16 * 1024)
+
+/* alignment of entries within a page */
+#define GLYPH_ALIGN(n) (((n) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+struct glyph_page;
+
+struct glyph_entry {
+        struct glyph_entry *next; /**< next entry in hash bucket */
+        struct glyph_page *page; /**< page holding the entry */
+
+        uint32_t id;
+        int size;
+        bool live; /**< entry is in the hash, false once replaced */
+        nsfb_plot_glyph_format_t format;
+        int x; /**< bitmap offset from plot position */
+        int y;
+        int width;
+        int height;
+        size_t bytes; /**< aligned size of the entry within the page */
+
+        uint8_t pixel[];
+};
+
+struct glyph_page {
+        struct glyph_page *prev_used; /**< more recently used page */
+        struct glyph_page *next_used; /**< less recently used page */
+
+        size_t bytes; /**< size of the page including this header */
+        size_t fill; /**< offset of the first free byte */
+        unsigned int live; /**< number of live entries in the page */
+};
+
+/* offset of the first entry in a page */
+#define GLYPH_PAGE_HEADER GLYPH_ALIGN(sizeof(struct glyph_page))
+
+struct nsfb_glyph_cache_s {
+        struct glyph_entry **bucket;
+        unsigned int bucketc; /**< number of buckets, a power of two */
+
+        struct glyph_page *mru; /**< most recently used page */
+        struct glyph_page *lru; /**< least recently used page */
+        struct glyph_page *open; /**< page new entries are packed into */
+
+        nsfb_glyph_cache_stats_t stats;
+};
+
+static inline unsigned int
+glyph_hash(uint32_t id, int size)
+{
+        return (id * 2654435761u) ^ ((uint32_t)size * 40503u);
+}
+
+static struct glyph_entry **
+glyph_find(nsfb_glyph_cache_t *cache, uint32_t id, int size)
+{
+        struct glyph_entry **link;
+
+        link = &cache->bucket[glyph_hash(id, size) & (cache->bucketc - 1)];
+        while ((*link != NULL) &&
+               (((*link)->id != id) || ((*link)->size != size))) {
+                link = &(*link)->next;
+        }
+        return link;
+}
+
+static void
+glyph_unuse(nsfb_glyph_cache_t *cache, struct glyph_page *page)
+{
+        if (page->prev_used != NULL)
+                page->prev_used->next_used = page->next_used;
+        else
+                cache->mru = page->next_used;
+
+        if (page->next_used != NULL)
+                page->next_used->prev_used = page->prev_used;
+        else
+                cache->lru = page->prev_used;
+}
+
+static void
+glyph_use(nsfb_glyph_cache_t *cache, struct glyph_page *page)
+{
+        page->prev_used = NULL;
+        page->next_used = cache->mru;
+        if (cache->mru != NULL)
+                cache->mru->prev_used = page;
+        else
+                cache->lru = page;
+        cache->mru = page;
+}
+
+/* unlink a page from the cache and free it */
+static void
+glyph_page_free(nsfb_glyph_cache_t *cache, struct glyph_page *page)
+{
+        glyph_unuse(cache, page);
+        if (cache->open == page)
+                cache->open = NULL;
+
+        cache->stats.used -= page->bytes;
+        free(page);
+}
+
+/* remove an entry from the hash, freeing its page once it is empty */
+static void
+glyph_discard(nsfb_glyph_cache_t *cache, struct glyph_entry *entry)
+{
+        struct glyph_entry **link;
+        struct glyph_page *page = entry->page;
+
+        link = glyph_find(cache, entry->id, entry->size);
+        *link = entry->next;
+        entry->live = false;
+        cache->stats.count--;
+
+        page->live--;
+        if (page->live == 0)
+                glyph_page_free(cache, page);
+}
+
+/* discard a page and every live entry in it */
+static void
+glyph_page_discard(nsfb_glyph_cache_t *cache, struct glyph_page *page)
+{
+        struct glyph_entry *entry;
+        size_t offset;
+
+        for (offset = GLYPH_PAGE_HEADER;
+             offset < page->fill;
+             offset += entry->bytes) {
+                entry = (struct glyph_entry *)((uint8_t *)page + offset);
+                if (entry->live) {
+                        *glyph_find(cache, entry->id, entry->size) =
+                                entry->next;
+                        cache->stats.count--;
+                        cache->stats.evictions++;
+                }
+        }
+
+        glyph_page_free(cache, page);
+}
+
+/* discard least recently used pages until there is room for bytes */
+static void
+glyph_evict(nsfb_glyph_cache_t *cache, size_t bytes)
+{
+        while ((cache->lru != NULL) &&
+               (cache->stats.used + bytes > cache->stats.budget)) {
+                glyph_page_discard(cache, cache->lru);
+        }
+}
+
+/* find room for an entry, packing it into the open page if it fits */
+static struct glyph_entry *
+glyph_alloc(nsfb_glyph_cache_t *cache, size_t bytes)
+{
+        struct glyph_page *page = cache->open;
+        struct glyph_entry *entry;
+        size_t page_bytes;
+
+        if ((page == NULL) || (page->fill + bytes > page->bytes)) {
+                page_bytes = GLYPH_ATLAS_PAGE;
+                if (page_bytes > cache->stats.budget)
+                        page_bytes = cache->stats.budget;
+                if (page_bytes < GLYPH_PAGE_HEADER + bytes)
+                        page_bytes = GLYPH_PAGE_HEADER + bytes;
+
+                if (page_bytes > cache->stats.budget)
+                        return NULL;
+
+                glyph_evict(cache, page_bytes);
+
+                page = malloc(page_bytes);
+                if (page == NULL)
+                        return NULL;
+
+                page->bytes = page_bytes;
+                page->fill = GLYPH_PAGE_HEADER;
+                page->live = 0;
+                glyph_use(cache, page);
+                cache->stats.used += page_bytes;
+
+                /* an oversized glyph fills its page so keep packing into
+                 * the previous one
+                 */
+                if ((cache->open == NULL) ||
+                    (page_bytes - GLYPH_PAGE_HEADER - bytes >=
+                     cache->open->bytes - cache->open->fill)) {
+                        cache->open = page;
+                }
+        } else if (page != cache->mru) {
+                glyph_unuse(cache, page);
+                glyph_use(cache, page);
+        }
+
+        entry = (struct glyph_entry *)((uint8_t *)page + page->fill);
+        entry->page = page;
+        entry->bytes = bytes;
+        page->fill += bytes;
+        page->live++;
+
+        return entry;
+}
+
+/* double the number of hash buckets, failure just leaves longer chains */
+static void
+glyph_rehash(nsfb_glyph_cache_t *cache)
+{
+        struct glyph_entry **bucket;
+        struct glyph_entry *entry;
+        struct glyph_entry *next;
+        unsigned int bucketc = cache->bucketc * 2;
+        unsigned int b;
+        unsigned int h;
+
+        bucket = calloc(bucketc, sizeof(struct glyph_entry *));
+        if (bucket == NULL)
+                return;
+
+        for (b = 0; b < cache->bucketc; b++) {
+                for (entry = cache->bucket[b]; entry != NULL; entry = next) {
+                        next = entry->next;
+                        h = glyph_hash(entry->id, entry->size) & (bucketc - 1);
+                        entry->next = bucket[h];
+                        bucket[h] = entry;
+                }
+        }
+
+        free(cache->bucket);
+        cache->bucket = bucket;
+        cache->bucketc = bucketc;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+nsfb_glyph_cache_t *nsfb_glyph_cache_create(size_t budget)
+{
+        nsfb_glyph_cache_t *cache;
+
+        cache = calloc(1, sizeof(nsfb_glyph_cache_t));
+        if (cache == NULL)
+                return NULL;
+
+        cache->bucketc = GLYPH_CACHE_BUCKETS;
+        cache->bucket = calloc(cache->bucketc, sizeof(struct glyph_entry *));
+        if (cache->bucket == NULL) {
+                free(cache);
+                return NULL;
+        }
+
+        cache->stats.budget = budget;
+
+        return cache;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+void nsfb_glyph_cache_destroy(nsfb_glyph_cache_t *cache)
+{
+        if (cache == NULL)
+                return;
+
+        nsfb_glyph_cache_flush(cache);
+        free(cache->bucket);
+        free(cache);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+void nsfb_glyph_cache_set_budget(nsfb_glyph_cache_t *cache, size_t budget)
+{
+        cache->stats.budget = budget;
+        glyph_evict(cache, 0);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+void nsfb_glyph_cache_flush(nsfb_glyph_cache_t *cache)
+{
+        struct glyph_page *page;
+        struct glyph_page *next;
+
+        for (page = cache->mru; page != NULL; page = next) {
+                next = page->next_used;
+                free(page);
+        }
+
+        memset(cache->bucket, 0, cache->bucketc * sizeof(struct glyph_entry *));
+        cache->mru = cache->lru = cache->open = NULL;
+        cache->stats.count = 0;
+        cache->stats.used = 0;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+void nsfb_glyph_cache_stats(nsfb_glyph_cache_t *cache,
+                            nsfb_glyph_cache_stats_t *stats)
+{
+        *stats = cache->stats;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_glyph_cache_add(nsfb_glyph_cache_t *cache,
+                          uint32_t id,
+                          int size,
+                          nsfb_plot_glyph_format_t format,
+                          const uint8_t *pixel,
+                          int width,
+                          int height,
+                          int pitch,
+                          int x,
+                          int y)
+{
+        struct glyph_entry **link;
+        struct glyph_entry *entry;
+        size_t bytes;
+        size_t pixels;
+        unsigned int bit;
+        int row;
+        int col;
+
+        if ((width < 0) || (height < 0))
+                return false;
+
+        if (format == NSFB_PLOT_GLYPH_1BPP) {
+                pixels = ((size_t)width * height + 7) / 8;
+        } else {
+                pixels = (size_t)width * height;
+        }
+        bytes = GLYPH_ALIGN(sizeof(struct glyph_entry) + pixels);
+
+        link = glyph_find(cache, id, size);
+        if (*link != NULL)
+                glyph_discard(cache, *link);
+
+        entry = glyph_alloc(cache, bytes);
+        if (entry == NULL)
+                return false;
+
+        entry->id = id;
+        entry->size = size;
+        entry->live = true;
+        entry->format = format;
+        entry->x = x;
+        entry->y = y;
+        entry->width = width;
+        entry->height = height;
+
+        if (format == NSFB_PLOT_GLYPH_1BPP) {
+                /* repack the rows with no padding between them */
+                memset(entry->pixel, 0, pixels);
+                bit = 0;
+                for (row = 0; row < height; row++) {
+                        for (col = 0; col < width; col++) {
+                                unsigned int src = row * pitch + col;
+
+                                if (pixel[src >> 3] & (0x80 >> (src & 7)))
+                                        entry->pixel[bit >> 3] |=
+                                                0x80 >> (bit & 7);
+                                bit++;
+                        }
+                }
+        } else {
+                for (row = 0; row < height; row++) {
+                        memcpy(entry->pixel + row * width,
+                               pixel + row * pitch,
+                               width);
+                }
+        }
+
+        if (cache->stats.count >= cache->bucketc * 2)
+                glyph_rehash(cache);
+
+        link = glyph_find(cache, id, size);
+        entry->next = NULL;
+        *link = entry;
+
+        cache->stats.count++;
+
+        return true;
+}
+
+/* plot a cached glyph clipped to the clipping rectangle */
+static void
+glyph_entry_plot(nsfb_t *nsfb,
+                 struct glyph_entry *entry,
+                 const nsfb_bbox_t *where,
+                 nsfb_colour_t c)
+{
+        nsfb_bbox_t loc = *where;
+
+        nsfb_damage_mark(nsfb, &loc);
+
+        /* the bitmap is copied as the entry may be evicted before the
+         * frame is plotted
+         */
+        if ((nsfb->dlist != NULL) &&
+            nsfb_dlist_glyph(nsfb, entry->format, &loc, entry->pixel,
+                             entry->width, c))
+                return;
+
+        if (entry->format == NSFB_PLOT_GLYPH_1BPP) {
+                nsfb->plotter_fns->glyph1(nsfb, &loc, entry->pixel,
+                                          entry->width, c);
+        } else {
+                nsfb->plotter_fns->glyph8(nsfb, &loc, entry->pixel,
+                                          entry->width, c);
+        }
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_glyph_cached(nsfb_t *nsfb,
+                            nsfb_glyph_cache_t *cache,
+                            uint32_t id,
+                            int size,
+                            int x,
+                            int y,
+                            nsfb_colour_t c)
+{
+        struct glyph_entry *entry;
+        nsfb_bbox_t loc;
+
+        entry = *glyph_find(cache, id, size);
+        if (entry == NULL) {
+                cache->stats.misses++;
+                return false;
+        }
+        cache->stats.hits++;
+
+        if (entry->page != cache->mru) {
+                glyph_unuse(cache, entry->page);
+                glyph_use(cache, entry->page);
+        }
+
+        loc.x0 = x + entry->x;
+        loc.y0 = y + entry->y;
+        loc.x1 = loc.x0 + entry->width;
+        loc.y1 = loc.y0 + entry->height;
+
+        if (nsfb_region_active(nsfb)) {
+                nsfb_region_start(nsfb, &loc);
+                while (nsfb_region_next(nsfb))
+                        glyph_entry_plot(nsfb, entry, &loc, c);
+                return true;
+        }
+
+        glyph_entry_plot(nsfb, entry, &loc, c);
+
+        return true;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
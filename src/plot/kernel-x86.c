@@ -0,0 +1,892 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * x86 SSE2 and AVX2 row kernels (implementation).
+ *
+ * Each kernel is compiled for its instruction set with a target attribute
+ * and only ever called after nsfb_kernel_select() has checked the cpu
+ * supports it.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+#include "libnsfb_plot_util.h"
+
+#include "kernel.h"
+
+#ifdef NSFB_KERNEL_X86
+
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+/* scalar blend of a single pixel, used for row tails.
+ *
+ * This is nsfb_plot_ablend() with the pixel conversions of the 32bpp
+ * plotters folded in. Blending works on each channel independently so
+ * swapping red and blue of the source gives the same result as converting
+ * the destination to a colour and back.
+ */
+static inline uint32_t
+blend_pixel(uint32_t d, uint32_t s, enum nsfb_kernel_fmt32_e fmt)
+{
+        uint32_t a = s >> 24;
+        uint32_t inv = 0x100 - a;
+        uint32_t rb, g;
+
+        if (a == 0)
+                return d;
+
+        if (fmt == NSFB_KERNEL_XRGB8888) {
+                s = (s & 0xFF00FF00) |
+                        ((s >> 16) & 0xFF) | ((s & 0xFF) << 16);
+        }
+
+        if (a == 0xFF) {
+                if (fmt == NSFB_KERNEL_XRGB8888)
+                        return s & 0xFFFFFF;
+                return s;
+        }
+
+        rb = ((s & 0xFF00FF) * a + (d & 0xFF00FF) * inv) >> 8;
+        g  = ((s & 0x00FF00) * a + (d & 0x00FF00) * inv) >> 8;
+
+        return (rb & 0xFF00FF) | (g & 0xFF00);
+}
+
+/* convert a colour to RGB565 as the 16bpp plotters do */
+static inline uint16_t rgb565(uint32_t c)
+{
+        return ((c & 0xF8) << 8) | ((c & 0xFC00) >> 5) | ((c & 0xF80000) >> 19);
+}
+
+/* scalar coverage blend of a single RGB565 pixel, used for row tails.
+ *
+ * This is the 16bpp plotters' pixel_to_colour(), nsfb_plot_ablend() and
+ * colour_to_pixel() sequence.
+ */
+static inline uint16_t
+glyph_pixel16(uint16_t d, uint8_t a, uint32_t c, uint16_t ent)
+{
+        nsfb_colour_t dc;
+
+        if (a == 0)
+                return d;
+
+        if (a == 0xFF)
+                return ent;
+
+        dc = ((d & 0x1F) << 19) | ((d & 0x7E0) << 5) | ((d & 0xF800) >> 8);
+        return rgb565(nsfb_plot_ablend(((uint32_t)a << 24) | c, dc));
+}
+
+/* scalar interpolation of a single pixel, used for row tails */
+static inline uint32_t lerp_pixel(uint32_t a, uint32_t b, unsigned int w)
+{
+        uint32_t rb;
+        uint32_t ag;
+
+        rb = ((a & 0xff00ff) * (256 - w) + (b & 0xff00ff) * w + 0x800080);
+        ag = (((a >> 8) & 0xff00ff) * (256 - w) +
+              ((b >> 8) & 0xff00ff) * w + 0x800080);
+
+        return ((rb >> 8) & 0xff00ff) | (ag & 0xff00ff00);
+}
+
+/* number of pixels to store before a pointer reaches an alignment */
+#define HEAD_LEN(ptr, align, size) \
+        ((int)((((align) - ((uintptr_t)(ptr) & ((align) - 1))) & ((align) - 1)) / (size)))
+
+static SSE2 void
+sse2_fill32(uint32_t *pvid, int llen, int width, int height, uint32_t ent)
+{
+        __m128i v = _mm_set1_epi32(ent);
+        uint32_t *prow;
+        int head;
+        int w;
+
+        for (; height > 0; height--, pvid += llen) {
+                prow = pvid;
+                w = width;
+
+                /* unaligned row head */
+                head = HEAD_LEN(prow, 16, 4);
+                if (((uintptr_t)prow & 3) != 0)
+                        head = w; /* cannot be aligned, do it all scalar */
+                for (; head > 0 && w > 0; head--, w--)
+                        *prow++ = ent;
+
+                while (w >= 16) {
+                        _mm_store_si128((__m128i *)(void *)prow, v);
+                        _mm_store_si128((__m128i *)(void *)(prow + 4), v);
+                        _mm_store_si128((__m128i *)(void *)(prow + 8), v);
+                        _mm_store_si128((__m128i *)(void *)(prow + 12), v);
+                        prow += 16;
+                        w -= 16;
+                }
+                while (w >= 4) {
+                        _mm_store_si128((__m128i *)(void *)prow, v);
+                        prow += 4;
+                        w -= 4;
+                }
+
+                /* row tail */
+                while (w-- > 0)
+                        *prow++ = ent;
+        }
+}
+
+static SSE2 void
+sse2_fill16(uint16_t *pvid, int llen, int width, int height, uint16_t ent)
+{
+        __m128i v = _mm_set1_epi16(ent);
+        uint16_t *prow;
+        int head;
+        int w;
+
+        for (; height > 0; height--, pvid += llen) {
+                prow = pvid;
+                w = width;
+
+                head = HEAD_LEN(prow, 16, 2);
+                if (((uintptr_t)prow & 1) != 0)
+                        head = w;
+                for (; head > 0 && w > 0; head--, w--)
+                        *prow++ = ent;
+
+                while (w >= 32) {
+                        _mm_store_si128((__m128i *)(void *)prow, v);
+                        _mm_store_si128((__m128i *)(void *)(prow + 8), v);
+                        _mm_store_si128((__m128i *)(void *)(prow + 16), v);
+                        _mm_store_si128((__m128i *)(void *)(prow + 24), v);
+                        prow += 32;
+                        w -= 32;
+                }
+                while (w >= 8) {
+                        _mm_store_si128((__m128i *)(void *)prow, v);
+                        prow += 8;
+                        w -= 8;
+                }
+
+                while (w-- > 0)
+                        *prow++ = ent;
+        }
+}
+
+static inline SSE2 __m128i sse2_swap_rb(__m128i s)
+{
+        const __m128i m_ag = _mm_set1_epi32(0xFF00FF00);
+        const __m128i m_c = _mm_set1_epi32(0xFF);
+
+        return _mm_or_si128(_mm_and_si128(s, m_ag),
+                            _mm_or_si128(_mm_and_si128(_mm_srli_epi32(s, 16), m_c),
+                                         _mm_slli_epi32(_mm_and_si128(s, m_c), 16)));
+}
+
+/* blend four pixels, each channel is (s * a + d * (256 - a)) >> 8 which
+ * never exceeds 0xFF00 so it can be done in unsigned 16 bit lanes.
+ */
+static inline SSE2 __m128i sse2_blend4(__m128i s, __m128i d)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i c256 = _mm_set1_epi16(0x100);
+        __m128i a = _mm_srli_epi32(s, 24);
+        __m128i alo, ahi;
+        __m128i lo, hi;
+
+        /* spread each alpha across the four channels of its pixel */
+        a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+        alo = _mm_unpacklo_epi32(a, a);
+        ahi = _mm_unpackhi_epi32(a, a);
+
+        lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), alo),
+                           _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+                                           _mm_sub_epi16(c256, alo)));
+        hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), ahi),
+                           _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+                                           _mm_sub_epi16(c256, ahi)));
+
+        return _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+}
+
+static inline SSE2 __m128i sse2_select(__m128i mask, __m128i a, __m128i b)
+{
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static SSE2 void
+sse2_blend32(uint32_t *pvid,
+             const uint32_t *pixel,
+             int width,
+             enum nsfb_kernel_fmt32_e fmt)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i opaque = _mm_set1_epi32(0xFF);
+        const __m128i rgb = _mm_set1_epi32(0xFFFFFF);
+        __m128i s, d, so, a, tmask, omask;
+        int tm, om;
+
+        for (; width >= 4; width -= 4, pvid += 4, pixel += 4) {
+                s = _mm_loadu_si128((const __m128i *)(const void *)pixel);
+                a = _mm_srli_epi32(s, 24);
+                tmask = _mm_cmpeq_epi32(a, zero);
+                tm = _mm_movemask_epi8(tmask);
+                if (tm == 0xFFFF)
+                        continue; /* transparent run */
+
+                omask = _mm_cmpeq_epi32(a, opaque);
+                om = _mm_movemask_epi8(omask);
+
+                if (fmt == NSFB_KERNEL_XRGB8888) {
+                        s = sse2_swap_rb(s);
+                        so = _mm_and_si128(s, rgb);
+                } else {
+                        so = s;
+                }
+
+                if (om == 0xFFFF) {
+                        /* opaque run */
+                        _mm_storeu_si128((__m128i *)(void *)pvid, so);
+                        continue;
+                }
+
+                d = _mm_loadu_si128((const __m128i *)(const void *)pvid);
+                if ((tm | om) == 0xFFFF) {
+                        /* only opaque and transparent, nothing to blend */
+                        d = sse2_select(omask, so, d);
+                } else {
+                        d = sse2_select(tmask, d,
+                                sse2_select(omask, so,
+                                        _mm_and_si128(sse2_blend4(s, d), rgb)));
+                }
+                _mm_storeu_si128((__m128i *)(void *)pvid, d);
+        }
+
+        for (; width > 0; width--, pvid++, pixel++)
+                *pvid = blend_pixel(*pvid, *pixel, fmt);
+}
+
+static SSE2 void
+sse2_glyph32(uint32_t *pvid,
+             const uint8_t *cov,
+             int width,
+             uint32_t c,
+             enum nsfb_kernel_fmt32_e fmt)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i opaque = _mm_set1_epi32(0xFF);
+        const __m128i rgb = _mm_set1_epi32(0xFFFFFF);
+        __m128i col, so, s, d, a, tmask, omask;
+        uint32_t c4;
+
+        c &= 0xFFFFFF;
+        col = _mm_set1_epi32(c);
+        if (fmt == NSFB_KERNEL_XRGB8888) {
+                col = sse2_swap_rb(col);
+                so = col;
+        } else {
+                so = _mm_or_si128(col, _mm_set1_epi32(0xFF000000));
+        }
+
+        for (; width >= 4; width -= 4, pvid += 4, cov += 4) {
+                memcpy(&c4, cov, 4);
+                if (c4 == 0)
+                        continue; /* no coverage */
+
+                if (c4 == 0xFFFFFFFF) {
+                        /* full coverage */
+                        _mm_storeu_si128((__m128i *)(void *)pvid, so);
+                        continue;
+                }
+
+                a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c4), zero);
+                a = _mm_unpacklo_epi16(a, zero);
+                tmask = _mm_cmpeq_epi32(a, zero);
+                omask = _mm_cmpeq_epi32(a, opaque);
+                s = _mm_or_si128(_mm_slli_epi32(a, 24), col);
+
+                d = _mm_loadu_si128((const __m128i *)(const void *)pvid);
+                d = sse2_select(tmask, d,
+                        sse2_select(omask, so,
+                                _mm_and_si128(sse2_blend4(s, d), rgb)));
+                _mm_storeu_si128((__m128i *)(void *)pvid, d);
+        }
+
+        for (; width > 0; width--, pvid++, cov++)
+                *pvid = blend_pixel(*pvid, ((uint32_t)*cov << 24) | c, fmt);
+}
+
+/* blend one colour channel held in 16 bit lanes */
+static inline SSE2 __m128i
+sse2_blend_channel(__m128i s, __m128i d, __m128i a, __m128i inv)
+{
+        return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a),
+                                            _mm_mullo_epi16(d, inv)), 8);
+}
+
+static SSE2 void
+sse2_glyph16(uint16_t *pvid, const uint8_t *cov, int width, uint32_t c)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i opaque = _mm_set1_epi16(0xFF);
+        const __m128i c256 = _mm_set1_epi16(0x100);
+        const __m128i m_f8 = _mm_set1_epi16(0xF8);
+        const __m128i m_fc = _mm_set1_epi16(0xFC);
+        const __m128i sr = _mm_set1_epi16(c & 0xFF);
+        const __m128i sg = _mm_set1_epi16((c >> 8) & 0xFF);
+        const __m128i sb = _mm_set1_epi16((c >> 16) & 0xFF);
+        uint16_t ent = rgb565(c);
+        const __m128i so = _mm_set1_epi16(ent);
+        __m128i a, inv, d, r, g, b, tmask, omask;
+        uint64_t c8;
+
+        for (; width >= 8; width -= 8, pvid += 8, cov += 8) {
+                memcpy(&c8, cov, 8);
+                if (c8 == 0)
+                        continue;
+
+                if (c8 == UINT64_MAX) {
+                        _mm_storeu_si128((__m128i *)(void *)pvid, so);
+                        continue;
+                }
+
+                a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(const void *)cov), zero);
+                inv = _mm_sub_epi16(c256, a);
+                tmask = _mm_cmpeq_epi16(a, zero);
+                omask = _mm_cmpeq_epi16(a, opaque);
+
+                /* expand the destination to 8 bit channels as
+                 * pixel_to_colour() does, blend and pack back
+                 */
+                d = _mm_loadu_si128((const __m128i *)(const void *)pvid);
+                r = _mm_and_si128(_mm_srli_epi16(d, 8), m_f8);
+                g = _mm_and_si128(_mm_srli_epi16(d, 3), m_fc);
+                b = _mm_and_si128(_mm_slli_epi16(d, 3), m_f8);
+
+                r = sse2_blend_channel(sr, r, a, inv);
+                g = sse2_blend_channel(sg, g, a, inv);
+                b = sse2_blend_channel(sb, b, a, inv);
+
+                r = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(r, m_f8), 8),
+                                 _mm_or_si128(_mm_slli_epi16(_mm_and_si128(g, m_fc), 3),
+                                              _mm_srli_epi16(b, 3)));
+
+                d = sse2_select(tmask, d, sse2_select(omask, so, r));
+                _mm_storeu_si128((__m128i *)(void *)pvid, d);
+        }
+
+        for (; width > 0; width--, pvid++, cov++)
+                *pvid = glyph_pixel16(*pvid, *cov, c, ent);
+}
+
+/* interpolate 8 bit channels held in 16 bit lanes */
+static inline SSE2 __m128i
+sse2_lerp_channels(__m128i a, __m128i b, __m128i wa, __m128i wb)
+{
+        const __m128i half = _mm_set1_epi16(0x80);
+
+        return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(
+                        _mm_mullo_epi16(a, wa), _mm_mullo_epi16(b, wb)),
+                                half), 8);
+}
+
+static SSE2 void
+sse2_lerp32(uint32_t *out,
+            const uint32_t *a,
+            const uint32_t *b,
+            int width,
+            unsigned int w)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i wa = _mm_set1_epi16(256 - w);
+        const __m128i wb = _mm_set1_epi16(w);
+        __m128i sa, sb, lo, hi;
+
+        for (; width >= 4; width -= 4, out += 4, a += 4, b += 4) {
+                sa = _mm_loadu_si128((const __m128i *)(const void *)a);
+                sb = _mm_loadu_si128((const __m128i *)(const void *)b);
+                lo = sse2_lerp_channels(_mm_unpacklo_epi8(sa, zero),
+                                        _mm_unpacklo_epi8(sb, zero), wa, wb);
+                hi = sse2_lerp_channels(_mm_unpackhi_epi8(sa, zero),
+                                        _mm_unpackhi_epi8(sb, zero), wa, wb);
+                _mm_storeu_si128((__m128i *)(void *)out,
+                                 _mm_packus_epi16(lo, hi));
+        }
+
+        for (; width > 0; width--)
+                *out++ = lerp_pixel(*a++, *b++, w);
+}
+
+/* the two pixels of each pair are adjacent so a single 64 bit load
+ * fetches both and the weights are applied to the low and high halves.
+ */
+static SSE2 void
+sse2_hlerp32(uint32_t *out,
+             const uint32_t *src,
+             const int *x,
+             const uint16_t *w,
+             int width)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i half = _mm_set1_epi16(0x80);
+        __m128i p0, p1, w0, w1;
+
+        for (; width >= 2; width -= 2, out += 2, x += 2, w += 2) {
+                p0 = _mm_loadl_epi64((const __m128i *)(const void *)(src + x[0]));
+                p1 = _mm_loadl_epi64((const __m128i *)(const void *)(src + x[1]));
+                p0 = _mm_unpacklo_epi8(p0, zero);
+                p1 = _mm_unpacklo_epi8(p1, zero);
+
+                w0 = _mm_set_epi16(w[0], w[0], w[0], w[0],
+                                   256 - w[0], 256 - w[0],
+                                   256 - w[0], 256 - w[0]);
+                w1 = _mm_set_epi16(w[1], w[1], w[1], w[1],
+                                   256 - w[1], 256 - w[1],
+                                   256 - w[1], 256 - w[1]);
+                p0 = _mm_mullo_epi16(p0, w0);
+                p1 = _mm_mullo_epi16(p1, w1);
+
+                /* add the weighted right pixel to the left one */
+                p0 = _mm_add_epi16(p0, _mm_srli_si128(p0, 8));
+                p1 = _mm_add_epi16(p1, _mm_srli_si128(p1, 8));
+                p0 = _mm_srli_epi16(_mm_add_epi16(
+                                _mm_unpacklo_epi64(p0, p1), half), 8);
+
+                _mm_storel_epi64((__m128i *)(void *)out,
+                                 _mm_packus_epi16(p0, p0));
+        }
+
+        if (width > 0)
+                *out = lerp_pixel(src[x[0]], src[x[0] + 1], w[0]);
+}
+
+/* differences are gathered across four vectors before testing as most rows
+ * compared are unchanged and read to the end
+ */
+static SSE2 bool sse2_equal(const uint8_t *a, const uint8_t *b, int len)
+{
+        __m128i diff;
+
+        while (len >= 64) {
+                diff = _mm_or_si128(
+                        _mm_or_si128(
+                                _mm_xor_si128(_mm_loadu_si128((const __m128i *)a),
+                                              _mm_loadu_si128((const __m128i *)b)),
+                                _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + 16)),
+                                              _mm_loadu_si128((const __m128i *)(b + 16)))),
+                        _mm_or_si128(
+                                _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + 32)),
+                                              _mm_loadu_si128((const __m128i *)(b + 32))),
+                                _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + 48)),
+                                              _mm_loadu_si128((const __m128i *)(b + 48)))));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xffff)
+                        return false;
+                a += 64;
+                b += 64;
+                len -= 64;
+        }
+
+        while (len >= 16) {
+                diff = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)a),
+                                      _mm_loadu_si128((const __m128i *)b));
+                if (_mm_movemask_epi8(diff) != 0xffff)
+                        return false;
+                a += 16;
+                b += 16;
+                len -= 16;
+        }
+
+        return memcmp(a, b, len) == 0;
+}
+
+const nsfb_kernel_fns_t _nsfb_kernel_sse2 = {
+        .name = "sse2",
+        .fill32 = sse2_fill32,
+        .fill16 = sse2_fill16,
+        .blend32 = sse2_blend32,
+        .glyph32 = sse2_glyph32,
+        .glyph16 = sse2_glyph16,
+        .lerp32 = sse2_lerp32,
+        .hlerp32 = sse2_hlerp32,
+        .equal = sse2_equal,
+};
+
+static AVX2 void
+avx2_fill32(uint32_t *pvid, int llen, int width, int height, uint32_t ent)
+{
+        __m256i v = _mm256_set1_epi32(ent);
+        uint32_t *prow;
+        int head;
+        int w;
+
+        for (; height > 0; height--, pvid += llen) {
+                prow = pvid;
+                w = width;
+
+                head = HEAD_LEN(prow, 32, 4);
+                if (((uintptr_t)prow & 3) != 0)
+                        head = w;
+                for (; head > 0 && w > 0; head--, w--)
+                        *prow++ = ent;
+
+                while (w >= 32) {
+                        _mm256_store_si256((__m256i *)(void *)prow, v);
+                        _mm256_store_si256((__m256i *)(void *)(prow + 8), v);
+                        _mm256_store_si256((__m256i *)(void *)(prow + 16), v);
+                        _mm256_store_si256((__m256i *)(void *)(prow + 24), v);
+                        prow += 32;
+                        w -= 32;
+                }
+                while (w >= 8) {
+                        _mm256_store_si256((__m256i *)(void *)prow, v);
+                        prow += 8;
+                        w -= 8;
+                }
+
+                while (w-- > 0)
+                        *prow++ = ent;
+        }
+}
+
+static AVX2 void
+avx2_fill16(uint16_t *pvid, int llen, int width, int height, uint16_t ent)
+{
+        __m256i v = _mm256_set1_epi16(ent);
+        uint16_t *prow;
+        int head;
+        int w;
+
+        for (; height > 0; height--, pvid += llen) {
+                prow = pvid;
+                w = width;
+
+                head = HEAD_LEN(prow, 32, 2);
+                if (((uintptr_t)prow & 1) != 0)
+                        head = w;
+                for (; head > 0 && w > 0; head--, w--)
+                        *prow++ = ent;
+
+                while (w >= 64) {
+                        _mm256_store_si256((__m256i *)(void *)prow, v);
+                        _mm256_store_si256((__m256i *)(void *)(prow + 16), v);
+                        _mm256_store_si256((__m256i *)(void *)(prow + 32), v);
+                        _mm256_store_si256((__m256i *)(void *)(prow + 48), v);
+                        prow += 64;
+                        w -= 64;
+                }
+                while (w >= 16) {
+                        _mm256_store_si256((__m256i *)(void *)prow, v);
+                        prow += 16;
+                        w -= 16;
+                }
+
+                while (w-- > 0)
+                        *prow++ = ent;
+        }
+}
+
+static inline AVX2 __m256i avx2_swap_rb(__m256i s)
+{
+        const __m256i m_ag = _mm256_set1_epi32(0xFF00FF00);
+        const __m256i m_c = _mm256_set1_epi32(0xFF);
+
+        return _mm256_or_si256(_mm256_and_si256(s, m_ag),
+                               _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(s, 16), m_c),
+                                               _mm256_slli_epi32(_mm256_and_si256(s, m_c), 16)));
+}
+
+/* blend eight pixels, as sse2_blend4() the unpacks work within each 128 bit
+ * lane which is fine as long as source, destination and alpha agree.
+ */
+static inline AVX2 __m256i avx2_blend8(__m256i s, __m256i d)
+{
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i c256 = _mm256_set1_epi16(0x100);
+        __m256i a = _mm256_srli_epi32(s, 24);
+        __m256i alo, ahi;
+        __m256i lo, hi;
+
+        a = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+        alo = _mm256_unpacklo_epi32(a, a);
+        ahi = _mm256_unpackhi_epi32(a, a);
+
+        lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), alo),
+                              _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero),
+                                                 _mm256_sub_epi16(c256, alo)));
+        hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), ahi),
+                              _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero),
+                                                 _mm256_sub_epi16(c256, ahi)));
+
+        return _mm256_packus_epi16(_mm256_srli_epi16(lo, 8),
+                                   _mm256_srli_epi16(hi, 8));
+}
+
+static AVX2 void
+avx2_blend32(uint32_t *pvid,
+             const uint32_t *pixel,
+             int width,
+             enum nsfb_kernel_fmt32_e fmt)
+{
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i opaque = _mm256_set1_epi32(0xFF);
+        const __m256i rgb = _mm256_set1_epi32(0xFFFFFF);
+        __m256i s, d, so, a, tmask, omask;
+        int tm, om;
+
+        for (; width >= 8; width -= 8, pvid += 8, pixel += 8) {
+                s = _mm256_loadu_si256((const __m256i *)(const void *)pixel);
+                a = _mm256_srli_epi32(s, 24);
+                tmask = _mm256_cmpeq_epi32(a, zero);
+                tm = _mm256_movemask_epi8(tmask);
+                if (tm == -1)
+                        continue; /* transparent run */
+
+                omask = _mm256_cmpeq_epi32(a, opaque);
+                om = _mm256_movemask_epi8(omask);
+
+                if (fmt == NSFB_KERNEL_XRGB8888) {
+                        s = avx2_swap_rb(s);
+                        so = _mm256_and_si256(s, rgb);
+                } else {
+                        so = s;
+                }
+
+                if (om == -1) {
+                        /* opaque run */
+                        _mm256_storeu_si256((__m256i *)(void *)pvid, so);
+                        continue;
+                }
+
+                d = _mm256_loadu_si256((const __m256i *)(const void *)pvid);
+                if ((tm | om) == -1) {
+                        d = _mm256_blendv_epi8(d, so, omask);
+                } else {
+                        d = _mm256_blendv_epi8(
+                                _mm256_blendv_epi8(
+                                        _mm256_and_si256(avx2_blend8(s, d), rgb),
+                                        so, omask),
+                                d, tmask);
+                }
+                _mm256_storeu_si256((__m256i *)(void *)pvid, d);
+        }
+
+        for (; width > 0; width--, pvid++, pixel++)
+                *pvid = blend_pixel(*pvid, *pixel, fmt);
+}
+
+static AVX2 void
+avx2_glyph32(uint32_t *pvid,
+             const uint8_t *cov,
+             int width,
+             uint32_t c,
+             enum nsfb_kernel_fmt32_e fmt)
+{
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i opaque = _mm256_set1_epi32(0xFF);
+        const __m256i rgb = _mm256_set1_epi32(0xFFFFFF);
+        __m256i col, so, s, d, a, tmask, omask;
+        uint64_t c8;
+
+        c &= 0xFFFFFF;
+        col = _mm256_set1_epi32(c);
+        if (fmt == NSFB_KERNEL_XRGB8888) {
+                col = avx2_swap_rb(col);
+                so = col;
+        } else {
+                so = _mm256_or_si256(col, _mm256_set1_epi32(0xFF000000));
+        }
+
+        for (; width >= 8; width -= 8, pvid += 8, cov += 8) {
+                memcpy(&c8, cov, 8);
+                if (c8 == 0)
+                        continue; /* no coverage */
+
+                if (c8 == UINT64_MAX) {
+                        /* full coverage */
+                        _mm256_storeu_si256((__m256i *)(void *)pvid, so);
+                        continue;
+                }
+
+                a = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(const void *)cov));
+                tmask = _mm256_cmpeq_epi32(a, zero);
+                omask = _mm256_cmpeq_epi32(a, opaque);
+                s = _mm256_or_si256(_mm256_slli_epi32(a, 24), col);
+
+                d = _mm256_loadu_si256((const __m256i *)(const void *)pvid);
+                d = _mm256_blendv_epi8(
+                        _mm256_blendv_epi8(
+                                _mm256_and_si256(avx2_blend8(s, d), rgb),
+                                so, omask),
+                        d, tmask);
+                _mm256_storeu_si256((__m256i *)(void *)pvid, d);
+        }
+
+        for (; width > 0; width--, pvid++, cov++)
+                *pvid = blend_pixel(*pvid, ((uint32_t)*cov << 24) | c, fmt);
+}
+
+static inline AVX2 __m256i
+avx2_blend_channel(__m256i s, __m256i d, __m256i a, __m256i inv)
+{
+        return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(s, a),
+                                                  _mm256_mullo_epi16(d, inv)), 8);
+}
+
+static AVX2 void
+avx2_glyph16(uint16_t *pvid, const uint8_t *cov, int width, uint32_t c)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi8(-1);
+        const __m256i opaque = _mm256_set1_epi16(0xFF);
+        const __m256i c256 = _mm256_set1_epi16(0x100);
+        const __m256i m_f8 = _mm256_set1_epi16(0xF8);
+        const __m256i m_fc = _mm256_set1_epi16(0xFC);
+        const __m256i sr = _mm256_set1_epi16(c & 0xFF);
+        const __m256i sg = _mm256_set1_epi16((c >> 8) & 0xFF);
+        const __m256i sb = _mm256_set1_epi16((c >> 16) & 0xFF);
+        uint16_t ent = rgb565(c);
+        const __m256i so = _mm256_set1_epi16(ent);
+        __m256i a, inv, d, r, g, b, tmask, omask;
+        __m128i c16;
+
+        for (; width >= 16; width -= 16, pvid += 16, cov += 16) {
+                c16 = _mm_loadu_si128((const __m128i *)(const void *)cov);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(c16, zero)) == 0xFFFF)
+                        continue;
+
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(c16, ones)) == 0xFFFF) {
+                        _mm256_storeu_si256((__m256i *)(void *)pvid, so);
+                        continue;
+                }
+
+                a = _mm256_cvtepu8_epi16(c16);
+                inv = _mm256_sub_epi16(c256, a);
+                tmask = _mm256_cmpeq_epi16(a, _mm256_setzero_si256());
+                omask = _mm256_cmpeq_epi16(a, opaque);
+
+                d = _mm256_loadu_si256((const __m256i *)(const void *)pvid);
+                r = _mm256_and_si256(_mm256_srli_epi16(d, 8), m_f8);
+                g = _mm256_and_si256(_mm256_srli_epi16(d, 3), m_fc);
+                b = _mm256_and_si256(_mm256_slli_epi16(d, 3), m_f8);
+
+                r = avx2_blend_channel(sr, r, a, inv);
+                g = avx2_blend_channel(sg, g, a, inv);
+                b = avx2_blend_channel(sb, b, a, inv);
+
+                r = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(r, m_f8), 8),
+                                    _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(g, m_fc), 3),
+                                                    _mm256_srli_epi16(b, 3)));
+
+                d = _mm256_blendv_epi8(_mm256_blendv_epi8(r, so, omask), d, tmask);
+                _mm256_storeu_si256((__m256i *)(void *)pvid, d);
+        }
+
+        for (; width > 0; width--, pvid++, cov++)
+                *pvid = glyph_pixel16(*pvid, *cov, c, ent);
+}
+
+static inline AVX2 __m256i
+avx2_lerp_channels(__m256i a, __m256i b, __m256i wa, __m256i wb)
+{
+        const __m256i half = _mm256_set1_epi16(0x80);
+
+        return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(
+                        _mm256_mullo_epi16(a, wa), _mm256_mullo_epi16(b, wb)),
+                                half), 8);
+}
+
+static AVX2 void
+avx2_lerp32(uint32_t *out,
+            const uint32_t *a,
+            const uint32_t *b,
+            int width,
+            unsigned int w)
+{
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i wa = _mm256_set1_epi16(256 - w);
+        const __m256i wb = _mm256_set1_epi16(w);
+        __m256i sa, sb, lo, hi;
+
+        for (; width >= 8; width -= 8, out += 8, a += 8, b += 8) {
+                sa = _mm256_loadu_si256((const __m256i *)(const void *)a);
+                sb = _mm256_loadu_si256((const __m256i *)(const void *)b);
+                lo = avx2_lerp_channels(_mm256_unpacklo_epi8(sa, zero),
+                                        _mm256_unpacklo_epi8(sb, zero),
+                                        wa, wb);
+                hi = avx2_lerp_channels(_mm256_unpackhi_epi8(sa, zero),
+                                        _mm256_unpackhi_epi8(sb, zero),
+                                        wa, wb);
+                /* unpack and pack both work within lanes so the pixel
+                 * order is preserved */
+                _mm256_storeu_si256((__m256i *)(void *)out,
+                                    _mm256_packus_epi16(lo, hi));
+        }
+
+        for (; width > 0; width--)
+                *out++ = lerp_pixel(*a++, *b++, w);
+}
+
+static AVX2 bool avx2_equal(const uint8_t *a, const uint8_t *b, int len)
+{
+        __m256i diff;
+
+        while (len >= 128) {
+                diff = _mm256_or_si256(
+                        _mm256_or_si256(
+                                _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)a),
+                                                 _mm256_loadu_si256((const __m256i *)b)),
+                                _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + 32)),
+                                                 _mm256_loadu_si256((const __m256i *)(b + 32)))),
+                        _mm256_or_si256(
+                                _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + 64)),
+                                                 _mm256_loadu_si256((const __m256i *)(b + 64))),
+                                _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + 96)),
+                                                 _mm256_loadu_si256((const __m256i *)(b + 96)))));
+                if (!_mm256_testz_si256(diff, diff))
+                        return false;
+                a += 128;
+                b += 128;
+                len -= 128;
+        }
+
+        while (len >= 32) {
+                diff = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)a),
+                                        _mm256_loadu_si256((const __m256i *)b));
+                if (!_mm256_testz_si256(diff, diff))
+                        return false;
+                a += 32;
+                b += 32;
+                len -= 32;
+        }
+
+        return sse2_equal(a, b, len);
+}
+
+const nsfb_kernel_fns_t _nsfb_kernel_avx2 = {
+        .name = "avx2",
+        .fill32 = avx2_fill32,
+        .fill16 = avx2_fill16,
+        .blend32 = avx2_blend32,
+        .glyph32 = avx2_glyph32,
+        .glyph16 = avx2_glyph16,
+        .lerp32 = avx2_lerp32,
+        .hlerp32 = sse2_hlerp32, /* gathering pairs gains nothing from avx2 */
+        .equal = avx2_equal,
+};
+
+#endif /* NSFB_KERNEL_X86 */
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
@@ -0,0 +1,205 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Portable row kernels and kernel selection (implementation).
+ *
+ * These are the reference implementations, the SIMD variants in
+ * kernel-x86.c must produce identical output.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+
+#include "kernel.h"
+
+static void
+fill32(uint32_t *pvid, int llen, int width, int height, uint32_t ent)
+{
+        int w;
+
+        llen -= width;
+
+        while (height-- > 0) {
+                w = width;
+                while (w >= 16) {
+                       *pvid++ = ent; *pvid++ = ent;
+                       *pvid++ = ent; *pvid++ = ent;
+                       *pvid++ = ent; *pvid++ = ent;
+                       *pvid++ = ent; *pvid++ = ent;
+                       *pvid++ = ent; *pvid++ = ent;
+                       *pvid++ = ent; *pvid++ = ent;
+                       *pvid++ = ent; *pvid++ = ent;
+                       *pvid++ = ent; *pvid++ = ent;
+                       w-=16;
+                }
+                while (w >= 4) {
+                       *pvid++ = ent; *pvid++ = ent;
+                       *pvid++ = ent; *pvid++ = ent;
+                       w-=4;
+                }
+                while (w > 0) {
+                       *pvid++ = ent;
+                       w--;
+                }
+                pvid += llen;
+        }
+}
+
+static void
+fill16(uint16_t *pvid16, int llen, int width, int height, uint16_t ent16)
+{
+        int w;
+        uint32_t *pvid32;
+        uint32_t ent32;
+
+        if ((((uintptr_t)pvid16 & 3) == 0) &&
+            ((width & 1) == 0) &&
+            ((llen & 1) == 0)) {
+                /* aligned to 32bit value and width is even */
+                ent32 = ent16 | (ent16 << 16);
+                pvid32 = (void *)pvid16;
+
+                fill32(pvid32, llen >> 1, width >> 1, height, ent32);
+        } else {
+                llen -= width;
+
+                while (height-- > 0) {
+                        for (w = width; w > 0; w--) *pvid16++ = ent16;
+                        pvid16 += llen;
+                }
+        }
+}
+
+/* interpolate the four channels of two pixels, two channels at a time */
+static inline uint32_t lerp_pixel(uint32_t a, uint32_t b, unsigned int w)
+{
+        uint32_t rb;
+        uint32_t ag;
+
+        rb = ((a & 0xff00ff) * (256 - w) + (b & 0xff00ff) * w + 0x800080);
+        ag = (((a >> 8) & 0xff00ff) * (256 - w) +
+              ((b >> 8) & 0xff00ff) * w + 0x800080);
+
+        return ((rb >> 8) & 0xff00ff) | (ag & 0xff00ff00);
+}
+
+static void
+lerp32(uint32_t *out, const uint32_t *a, const uint32_t *b, int width,
+       unsigned int w)
+{
+        while (width-- > 0)
+                *out++ = lerp_pixel(*a++, *b++, w);
+}
+
+static void
+hlerp32(uint32_t *out, const uint32_t *src, const int *x, const uint16_t *w,
+        int width)
+{
+        int n;
+
+        for (n = 0; n < width; n++)
+                out[n] = lerp_pixel(src[x[n]], src[x[n] + 1], w[n]);
+}
+
+static bool equal(const uint8_t *a, const uint8_t *b, int len)
+{
+        return memcmp(a, b, len) == 0;
+}
+
+#define GLYPH1_BIT(n, b) (((n) & (b)) ? -1 : 0)
+#define GLYPH1_MASK(n) {                                                \
+        GLYPH1_BIT(n, 0x80), GLYPH1_BIT(n, 0x40),                       \
+        GLYPH1_BIT(n, 0x20), GLYPH1_BIT(n, 0x10),                       \
+        GLYPH1_BIT(n, 0x08), GLYPH1_BIT(n, 0x04),                       \
+        GLYPH1_BIT(n, 0x02), GLYPH1_BIT(n, 0x01) }
+#define GLYPH1_MASK4(n) GLYPH1_MASK(n), GLYPH1_MASK(n + 1),             \
+        GLYPH1_MASK(n + 2), GLYPH1_MASK(n + 3)
+#define GLYPH1_MASK16(n) GLYPH1_MASK4(n), GLYPH1_MASK4(n + 4),          \
+        GLYPH1_MASK4(n + 8), GLYPH1_MASK4(n + 12)
+#define GLYPH1_MASK64(n) GLYPH1_MASK16(n), GLYPH1_MASK16(n + 16),       \
+        GLYPH1_MASK16(n + 32), GLYPH1_MASK16(n + 48)
+
+/* exported interface documented in kernel.h */
+const int8_t nsfb_kernel_glyph1_mask[256][8] = {
+        GLYPH1_MASK64(0), GLYPH1_MASK64(64),
+        GLYPH1_MASK64(128), GLYPH1_MASK64(192)
+};
+
+const nsfb_kernel_fns_t _nsfb_kernel_generic = {
+        .name = "generic",
+        .fill32 = fill32,
+        .fill16 = fill16,
+        .lerp32 = lerp32,
+        .hlerp32 = hlerp32,
+        .equal = equal,
+};
+
+#ifdef NSFB_KERNEL_X86
+/* query the cpu once, the answer cannot change while we are running */
+static enum nsfb_plot_simd_e cpu_simd(void)
+{
+        static enum nsfb_plot_simd_e level = NSFB_PLOT_SIMD_AUTO;
+
+        if (level == NSFB_PLOT_SIMD_AUTO) {
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx2")) {
+                        level = NSFB_PLOT_SIMD_AVX2;
+                } else if (__builtin_cpu_supports("sse2")) {
+                        level = NSFB_PLOT_SIMD_SSE2;
+                } else {
+                        level = NSFB_PLOT_SIMD_NONE;
+                }
+        }
+        return level;
+}
+#else
+static enum nsfb_plot_simd_e cpu_simd(void)
+{
+        return NSFB_PLOT_SIMD_NONE;
+}
+#endif
+
+/* exported interface documented in kernel.h */
+const nsfb_kernel_fns_t *nsfb_kernel_select(enum nsfb_plot_simd_e simd)
+{
+        enum nsfb_plot_simd_e avail = cpu_simd();
+
+        if (simd == NSFB_PLOT_SIMD_AUTO)
+                simd = avail;
+
+        if (simd == NSFB_PLOT_SIMD_NONE)
+                return &_nsfb_kernel_generic;
+
+        /* the levels are ordered so any lower level is also available */
+        if (avail == NSFB_PLOT_SIMD_NONE || simd > avail)
+                return NULL;
+
+#ifdef NSFB_KERNEL_X86
+        switch (simd) {
+        case NSFB_PLOT_SIMD_SSE2:
+                return &_nsfb_kernel_sse2;
+
+        case NSFB_PLOT_SIMD_AVX2:
+                return &_nsfb_kernel_avx2;
+
+        default:
+                break;
+        }
+#endif
+        return NULL;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
@@ -0,0 +1,117 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Pre-converted pixmaps (implementation).
+ *
+ * A pixmap holds a bitmap converted to the pixel format of a context with
+ * rows packed at the context's bits per pixel. Each row is described by
+ * the runs of opaque and translucent pixels it contains, transparent
+ * pixels belong to no run. Opaque runs are plotted by copying the
+ * converted pixels and translucent runs by blending their original
+ * colours, which are kept for just those runs.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+
+#include "nsfb.h"
+#include "plot.h"
+#include "palette.h"
+#include "runs.h"
+
+struct nsfb_pixmap_s {
+        enum nsfb_format_e format; /**< format of the pixels */
+        uint8_t *pixel; /**< converted pixels */
+        nsfb_runs_t runs; /**< runs of the bitmap */
+};
+
+/* exported interface documented in libnsfb_plot.h */
+void nsfb_pixmap_destroy(nsfb_pixmap_t *pixmap)
+{
+        if (pixmap == NULL)
+                return;
+
+        free(pixmap->pixel);
+        nsfb_runs_fini(&pixmap->runs);
+        free(pixmap);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+nsfb_pixmap_t *
+nsfb_pixmap_create(nsfb_t *nsfb,
+                   const nsfb_colour_t *pixel,
+                   int width,
+                   int height,
+                   int stride)
+{
+        nsfb_pixmap_t *pixmap;
+        bool set_dither = false;
+        size_t pitch;
+        int yloop;
+
+        if (nsfb->bpp < 8 || width <= 0 || height <= 0)
+                return NULL;
+
+        pixmap = calloc(1, sizeof(nsfb_pixmap_t));
+        if (pixmap == NULL)
+                return NULL;
+
+        pixmap->format = nsfb->format;
+
+        pitch = (size_t)width * (nsfb->bpp / 8);
+        pixmap->pixel = malloc(pitch * height);
+        if (pixmap->pixel == NULL) {
+                free(pixmap);
+                return NULL;
+        }
+
+        if (!nsfb_runs_init(&pixmap->runs, pixel, width, height, stride,
+                            false)) {
+                free(pixmap->pixel);
+                free(pixmap);
+                return NULL;
+        }
+
+        /* Enable error diffusion for paletted screens, if not already on */
+        if (nsfb->palette != NULL &&
+            nsfb_palette_dithering_on(nsfb->palette) == false) {
+                nsfb_palette_dither_init(nsfb->palette, width);
+                set_dither = true;
+        }
+
+        for (yloop = 0; yloop < height; yloop++) {
+                nsfb->plotter_fns->convert(nsfb, pixel,
+                                           pixmap->pixel + yloop * pitch,
+                                           width);
+                pixel += stride;
+        }
+
+        if (set_dither) {
+                nsfb_palette_dither_fini(nsfb->palette);
+        }
+
+        return pixmap;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_pixmap(nsfb_t *nsfb, const nsfb_pixmap_t *pixmap, int x, int y)
+{
+        if (nsfb->format != pixmap->format)
+                return false;
+
+        return nsfb_runs_plot(nsfb, &pixmap->runs, x, y, pixmap->pixel);
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
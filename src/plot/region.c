@@ -0,0 +1,608 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Clipping regions and the clip stack (implementation).
+ *
+ * A region is held as a list of disjoint rectangles in bands. Every
+ * rectangle of a band has the same top and bottom, the bands are sorted
+ * from the top of the screen down and the rectangles of a band from left to
+ * right. Touching rectangles within a band are joined and a band with the
+ * same rectangles as the one above it is joined to that, so each region has
+ * a single smallest form.
+ *
+ * Operations on a region cut the current rectangles as needed and build the
+ * bands again from the pieces. While the clip is a single rectangle it is
+ * held only in the context, as the plotters use it, and the region is
+ * unused.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+#include "libnsfb_plot_util.h"
+
+#include "nsfb.h"
+#include "plot.h"
+#include "region.h"
+
+/** a saved clip */
+struct region_save {
+        nsfb_bbox_t *rect; /* rectangles, or NULL for the clipping rectangle */
+        int rectc;
+        nsfb_bbox_t clip;
+};
+
+struct nsfb_region_s {
+        bool active; /* the clip is the rectangles rather than the context's */
+        nsfb_bbox_t *rect;
+        int rectc;
+
+        struct region_save *save;
+        int savec;
+        int save_size;
+
+        /* a plot being run for each rectangle */
+        bool running;
+        bool inside; /* run once within the bounding box instead */
+        nsfb_bbox_t extent;
+        nsfb_bbox_t clip;
+        int next;
+};
+
+static int region_int_cmp(const void *a, const void *b)
+{
+        int ia = *(const int *)a;
+        int ib = *(const int *)b;
+
+        return (ia > ib) - (ia < ib);
+}
+
+static int region_x0_cmp(const void *a, const void *b)
+{
+        int ia = ((const nsfb_bbox_t *)a)->x0;
+        int ib = ((const nsfb_bbox_t *)b)->x0;
+
+        return (ia > ib) - (ia < ib);
+}
+
+/* build the bands covering the union of a list of rectangles.
+ *
+ * The rectangles must not be empty. Returns the number of rectangles built
+ * or -1 if memory could not be allocated.
+ */
+static int
+region_build(const nsfb_bbox_t *in, int inc, nsfb_bbox_t **out)
+{
+        nsfb_bbox_t *rect = NULL;
+        nsfb_bbox_t *span;
+        nsfb_bbox_t *tmp;
+        int rect_size = 0;
+        int rectc = 0;
+        int prev = 0; /* first rectangle of the band above */
+        int prevc = 0;
+        int spanc;
+        int *y;
+        int yc;
+        int band;
+        int loop;
+        int n;
+
+        *out = NULL;
+        if (inc == 0)
+                return 0;
+
+        y = malloc(inc * 2 * sizeof(int));
+        span = malloc(inc * sizeof(nsfb_bbox_t));
+        if ((y == NULL) || (span == NULL)) {
+                free(y);
+                free(span);
+                return -1;
+        }
+
+        /* every edge starts a band */
+        for (loop = 0; loop < inc; loop++) {
+                y[loop * 2] = in[loop].y0;
+                y[loop * 2 + 1] = in[loop].y1;
+        }
+        qsort(y, inc * 2, sizeof(int), region_int_cmp);
+        for (yc = 1, loop = 1; loop < inc * 2; loop++) {
+                if (y[loop] != y[yc - 1])
+                        y[yc++] = y[loop];
+        }
+
+        for (band = 0; band < yc - 1; band++) {
+                /* the spans of the rectangles crossing the band */
+                spanc = 0;
+                for (loop = 0; loop < inc; loop++) {
+                        if ((in[loop].y0 <= y[band]) &&
+                            (in[loop].y1 >= y[band + 1]))
+                                span[spanc++] = in[loop];
+                }
+                if (spanc == 0)
+                        continue;
+
+                qsort(span, spanc, sizeof(nsfb_bbox_t), region_x0_cmp);
+
+                /* room for every span unjoined */
+                if (rectc + spanc > rect_size) {
+                        rect_size = (rect_size * 2) + spanc;
+                        tmp = realloc(rect, rect_size * sizeof(nsfb_bbox_t));
+                        if (tmp == NULL) {
+                                free(rect);
+                                free(y);
+                                free(span);
+                                return -1;
+                        }
+                        rect = tmp;
+                }
+
+                n = rectc;
+                rect[n] = span[0];
+                for (loop = 1; loop < spanc; loop++) {
+                        if (span[loop].x0 <= rect[n].x1) {
+                                if (span[loop].x1 > rect[n].x1)
+                                        rect[n].x1 = span[loop].x1;
+                        } else {
+                                rect[++n] = span[loop];
+                        }
+                }
+                n = n + 1 - rectc;
+                for (loop = rectc; loop < rectc + n; loop++) {
+                        rect[loop].y0 = y[band];
+                        rect[loop].y1 = y[band + 1];
+                }
+
+                /* extend the band above instead if it matches */
+                if ((prevc == n) && (rect[prev].y1 == y[band])) {
+                        for (loop = 0; loop < n; loop++) {
+                                if ((rect[prev + loop].x0 != rect[rectc + loop].x0) ||
+                                    (rect[prev + loop].x1 != rect[rectc + loop].x1))
+                                        break;
+                        }
+                        if (loop == n) {
+                                for (loop = prev; loop < prev + n; loop++)
+                                        rect[loop].y1 = y[band + 1];
+                                continue;
+                        }
+                }
+
+                prev = rectc;
+                prevc = n;
+                rectc += n;
+        }
+
+        free(y);
+        free(span);
+
+        *out = rect;
+        return rectc;
+}
+
+static nsfb_region_t *region_get(nsfb_t *nsfb)
+{
+        if (nsfb->region == NULL)
+                nsfb->region = calloc(1, sizeof(nsfb_region_t));
+
+        return nsfb->region;
+}
+
+/* the rectangles of the current clip */
+static const nsfb_bbox_t *region_rects(nsfb_t *nsfb, int *rectc)
+{
+        nsfb_region_t *region = nsfb->region;
+
+        if ((region != NULL) && region->active) {
+                *rectc = region->rectc;
+                return region->rect;
+        }
+
+        *rectc = ((nsfb->clip.x0 < nsfb->clip.x1) &&
+                  (nsfb->clip.y0 < nsfb->clip.y1)) ? 1 : 0;
+        return &nsfb->clip;
+}
+
+/* set the clip to the union of a list of rectangles, taking ownership of
+ * the list which may contain empty rectangles.
+ */
+static bool region_set(nsfb_t *nsfb, nsfb_bbox_t *in, int inc)
+{
+        nsfb_region_t *region = region_get(nsfb);
+        nsfb_bbox_t screen;
+        nsfb_bbox_t *rect;
+        int rectc;
+        int loop;
+        int n;
+
+        if (region == NULL) {
+                free(in);
+                return false;
+        }
+
+        screen.x0 = screen.y0 = 0;
+        screen.x1 = nsfb->width;
+        screen.y1 = nsfb->height;
+
+        for (loop = 0, n = 0; loop < inc; loop++) {
+                if (nsfb_plot_clip(&screen, &in[loop]) &&
+                    (in[loop].x0 < in[loop].x1) &&
+                    (in[loop].y0 < in[loop].y1))
+                        in[n++] = in[loop];
+        }
+
+        rectc = region_build(in, n, &rect);
+        free(in);
+        if (rectc < 0)
+                return false;
+
+        free(region->rect);
+        region->rect = rect;
+        region->rectc = rectc;
+
+        if (rectc == 1) {
+                /* the plotters clip to a single rectangle themselves */
+                region->active = false;
+                nsfb->clip = rect[0];
+                return true;
+        }
+
+        region->active = true;
+        if (rectc == 0) {
+                nsfb->clip.x0 = nsfb->clip.y0 = 0;
+                nsfb->clip.x1 = nsfb->clip.y1 = 0;
+                return true;
+        }
+
+        nsfb->clip = rect[0];
+        nsfb->clip.y1 = rect[rectc - 1].y1;
+        for (loop = 1; loop < rectc; loop++) {
+                if (rect[loop].x0 < nsfb->clip.x0)
+                        nsfb->clip.x0 = rect[loop].x0;
+                if (rect[loop].x1 > nsfb->clip.x1)
+                        nsfb->clip.x1 = rect[loop].x1;
+        }
+
+        return true;
+}
+
+/* copy the rectangles of the current clip with room for more */
+static nsfb_bbox_t *region_copy(nsfb_t *nsfb, int *rectc, int extra)
+{
+        const nsfb_bbox_t *rect;
+        nsfb_bbox_t *copy;
+
+        rect = region_rects(nsfb, rectc);
+
+        copy = malloc((*rectc + extra + 1) * sizeof(nsfb_bbox_t));
+        if (copy != NULL)
+                memcpy(copy, rect, *rectc * sizeof(nsfb_bbox_t));
+
+        return copy;
+}
+
+/* exported interface documented in region.h */
+void nsfb_region_destroy(nsfb_region_t *region)
+{
+        while (region->savec > 0)
+                free(region->save[--region->savec].rect);
+
+        free(region->save);
+        free(region->rect);
+        free(region);
+}
+
+/* exported interface documented in region.h */
+void nsfb_region_reset(nsfb_t *nsfb)
+{
+        nsfb->region->active = false;
+}
+
+/* exported interface documented in region.h */
+bool nsfb_region_multiple(nsfb_t *nsfb)
+{
+        return nsfb->region->active && !nsfb->region->running;
+}
+
+/* exported interface documented in region.h */
+void nsfb_region_start(nsfb_t *nsfb, const nsfb_bbox_t *extent)
+{
+        nsfb_region_t *region = nsfb->region;
+        int lo;
+        int hi;
+        int mid;
+
+        region->running = true;
+        region->extent = *extent;
+        region->clip = nsfb->clip;
+
+        /* reject the whole plot if it misses the bounding box */
+        if ((extent->x1 <= nsfb->clip.x0) || (extent->x0 >= nsfb->clip.x1) ||
+            (extent->y1 <= nsfb->clip.y0) || (extent->y0 >= nsfb->clip.y1)) {
+                region->next = region->rectc;
+                return;
+        }
+
+        /* the first rectangle ending below the top of the extent */
+        lo = 0;
+        hi = region->rectc;
+        while (lo < hi) {
+                mid = (lo + hi) / 2;
+                if (region->rect[mid].y1 <= extent->y0)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+        region->next = lo;
+}
+
+/* exported interface documented in region.h */
+bool nsfb_region_start_inside(nsfb_t *nsfb, const nsfb_bbox_t *area)
+{
+        nsfb_region_t *region = nsfb->region;
+        const nsfb_bbox_t *rect;
+        int covered;
+        int lo;
+        int hi;
+        int mid;
+
+        if ((area->x0 >= area->x1) || (area->y0 >= area->y1))
+                return false;
+
+        /* the first rectangle ending below the top of the area */
+        lo = 0;
+        hi = region->rectc;
+        while (lo < hi) {
+                mid = (lo + hi) / 2;
+                if (region->rect[mid].y1 <= area->y0)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        /* every band down to the bottom of the area must have a rectangle
+         * spanning it, and the bands must follow on without a gap
+         */
+        covered = area->y0;
+        for (; lo < region->rectc; lo++) {
+                rect = &region->rect[lo];
+                if ((rect->y0 > covered) || (covered >= area->y1))
+                        break;
+
+                if ((rect->x0 <= area->x0) && (rect->x1 >= area->x1))
+                        covered = rect->y1;
+        }
+        if (covered < area->y1)
+                return false;
+
+        region->running = true;
+        region->inside = true;
+        region->extent = *area;
+        region->clip = nsfb->clip;
+        region->next = region->rectc;
+
+        return true;
+}
+
+/* exported interface documented in region.h */
+bool nsfb_region_next(nsfb_t *nsfb)
+{
+        nsfb_region_t *region = nsfb->region;
+        const nsfb_bbox_t *rect;
+
+        if (region->inside) {
+                region->inside = false;
+                return true;
+        }
+
+        while (region->next < region->rectc) {
+                rect = &region->rect[region->next++];
+
+                /* bands below the extent are not visited */
+                if (rect->y0 >= region->extent.y1)
+                        break;
+
+                if ((rect->x1 > region->extent.x0) &&
+                    (rect->x0 < region->extent.x1)) {
+                        nsfb->clip = *rect;
+                        return true;
+                }
+        }
+
+        nsfb->clip = region->clip;
+        region->running = false;
+
+        return false;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_set_clip_region(nsfb_t *nsfb, int rectc, const nsfb_bbox_t *rect)
+{
+        nsfb_bbox_t *copy;
+        int loop;
+
+        if (rectc < 0)
+                return false;
+
+        copy = malloc((rectc + 1) * sizeof(nsfb_bbox_t));
+        if (copy == NULL)
+                return false;
+
+        /* rectangles may be given with their corners either way round */
+        for (loop = 0; loop < rectc; loop++) {
+                copy[loop].x0 = (rect[loop].x0 < rect[loop].x1) ? rect[loop].x0 : rect[loop].x1;
+                copy[loop].y0 = (rect[loop].y0 < rect[loop].y1) ? rect[loop].y0 : rect[loop].y1;
+                copy[loop].x1 = (rect[loop].x0 < rect[loop].x1) ? rect[loop].x1 : rect[loop].x0;
+                copy[loop].y1 = (rect[loop].y0 < rect[loop].y1) ? rect[loop].y1 : rect[loop].y0;
+        }
+
+        return region_set(nsfb, copy, rectc);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+int nsfb_plot_get_clip_region(nsfb_t *nsfb, nsfb_bbox_t *rect, int rectc)
+{
+        const nsfb_bbox_t *clip;
+        int clipc;
+
+        clip = region_rects(nsfb, &clipc);
+        if (rect != NULL)
+                memcpy(rect, clip, ((rectc < clipc) ? rectc : clipc) * sizeof(nsfb_bbox_t));
+
+        return clipc;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_intersect_clip(nsfb_t *nsfb, const nsfb_bbox_t *clip)
+{
+        nsfb_bbox_t *rect;
+        int rectc;
+        int loop;
+
+        rect = region_copy(nsfb, &rectc, 0);
+        if (rect == NULL)
+                return false;
+
+        for (loop = 0; loop < rectc; loop++) {
+                if (!nsfb_plot_clip(clip, &rect[loop]))
+                        rect[loop].x1 = rect[loop].x0;
+        }
+
+        return region_set(nsfb, rect, rectc);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_exclude_clip(nsfb_t *nsfb, const nsfb_bbox_t *exclude)
+{
+        const nsfb_bbox_t *clip;
+        nsfb_bbox_t *rect;
+        nsfb_bbox_t r;
+        int clipc;
+        int rectc;
+        int loop;
+
+        if ((exclude->x0 >= exclude->x1) || (exclude->y0 >= exclude->y1))
+                return true;
+
+        /* each rectangle leaves up to four pieces around the excluded one */
+        clip = region_rects(nsfb, &clipc);
+        rect = malloc((clipc * 4 + 1) * sizeof(nsfb_bbox_t));
+        if (rect == NULL)
+                return false;
+
+        for (loop = 0, rectc = 0; loop < clipc; loop++) {
+                r = clip[loop];
+
+                if ((r.x1 <= exclude->x0) || (r.x0 >= exclude->x1) ||
+                    (r.y1 <= exclude->y0) || (r.y0 >= exclude->y1)) {
+                        rect[rectc++] = r;
+                        continue;
+                }
+
+                if (r.y0 < exclude->y0) {
+                        rect[rectc] = r;
+                        rect[rectc++].y1 = exclude->y0;
+                        r.y0 = exclude->y0;
+                }
+                if (r.y1 > exclude->y1) {
+                        rect[rectc] = r;
+                        rect[rectc++].y0 = exclude->y1;
+                        r.y1 = exclude->y1;
+                }
+                if (r.x0 < exclude->x0) {
+                        rect[rectc] = r;
+                        rect[rectc++].x1 = exclude->x0;
+                }
+                if (r.x1 > exclude->x1) {
+                        rect[rectc] = r;
+                        rect[rectc++].x0 = exclude->x1;
+                }
+        }
+
+        return region_set(nsfb, rect, rectc);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_push_clip(nsfb_t *nsfb, const nsfb_bbox_t *clip)
+{
+        nsfb_region_t *region = region_get(nsfb);
+        struct region_save *save;
+        int size;
+
+        if (region == NULL)
+                return false;
+
+        if (region->savec == region->save_size) {
+                size = (region->save_size == 0) ? 8 : region->save_size * 2;
+                save = realloc(region->save, size * sizeof(struct region_save));
+                if (save == NULL)
+                        return false;
+                region->save = save;
+                region->save_size = size;
+        }
+
+        save = &region->save[region->savec];
+        save->clip = nsfb->clip;
+        save->rect = NULL;
+        save->rectc = 0;
+        if (region->active) {
+                save->rect = region_copy(nsfb, &save->rectc, 0);
+                if (save->rect == NULL)
+                        return false;
+        }
+        region->savec++;
+
+        if ((clip != NULL) && !nsfb_plot_intersect_clip(nsfb, clip)) {
+                region->savec--;
+                free(save->rect);
+                return false;
+        }
+
+        return true;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_pop_clip(nsfb_t *nsfb)
+{
+        nsfb_region_t *region = nsfb->region;
+        struct region_save *save;
+        nsfb_bbox_t *rect;
+
+        if ((region == NULL) || (region->savec == 0))
+                return false;
+
+        save = &region->save[--region->savec];
+
+        if (save->rect != NULL) {
+                /* restored through region_set which takes the list and
+                 * clips it to the screen in case the geometry changed
+                 */
+                if (region_set(nsfb, save->rect, save->rectc))
+                        return true;
+        } else {
+                rect = malloc(sizeof(nsfb_bbox_t));
+                if (rect != NULL) {
+                        *rect = save->clip;
+                        if (region_set(nsfb, rect, 1))
+                                return true;
+                }
+        }
+
+        /* without memory to rebuild it fall back to the bounding box */
+        region->active = false;
+        nsfb->clip = save->clip;
+
+        return true;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
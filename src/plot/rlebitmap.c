@@ -0,0 +1,77 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Run encoded bitmaps (implementation).
+ *
+ * Unlike a pixmap a run encoded bitmap keeps its colours, only the alpha
+ * of each pixel is examined in advance, so it may be plotted on a context
+ * of any format.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+
+#include "nsfb.h"
+#include "runs.h"
+
+struct nsfb_rle_bitmap_s {
+        nsfb_runs_t runs; /**< runs of the bitmap */
+};
+
+/* exported interface documented in libnsfb_plot.h */
+nsfb_rle_bitmap_t *
+nsfb_rle_bitmap_create(const nsfb_colour_t *pixel,
+                       int width,
+                       int height,
+                       int stride)
+{
+        nsfb_rle_bitmap_t *rle;
+
+        if (width <= 0 || height <= 0)
+                return NULL;
+
+        rle = malloc(sizeof(nsfb_rle_bitmap_t));
+        if (rle == NULL)
+                return NULL;
+
+        if (!nsfb_runs_init(&rle->runs, pixel, width, height, stride, true)) {
+                free(rle);
+                return NULL;
+        }
+
+        return rle;
+}
+
+/* exported interface documented in libnsfb_plot.h */
+void nsfb_rle_bitmap_destroy(nsfb_rle_bitmap_t *rle)
+{
+        if (rle == NULL)
+                return;
+
+        nsfb_runs_fini(&rle->runs);
+        free(rle);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool
+nsfb_plot_rle_bitmap(nsfb_t *nsfb, const nsfb_rle_bitmap_t *rle, int x, int y)
+{
+        if (nsfb->bpp < 8)
+                return false;
+
+        return nsfb_runs_plot(nsfb, &rle->runs, x, y, NULL);
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
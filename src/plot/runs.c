@@ -0,0 +1,287 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Bitmaps split into alpha runs (implementation).
+ *
+ * Shared by pixmaps, which copy opaque runs from pixels converted to the
+ * context format, and run encoded bitmaps, which convert them from their
+ * colours. Either way transparent pixels are skipped without being looked
+ * at and only translucent runs go through the blender.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+#include "libnsfb_plot_util.h"
+
+#include "nsfb.h"
+#include "plot.h"
+#include "palette.h"
+#include "runs.h"
+#include "dlist.h"
+#include "damage.h"
+#include "region.h"
+
+/* Opaque runs and transparent gaps shorter than this within translucent
+ * areas are blended along with them, the blenders handle such pixels
+ * cheaply and it avoids plotting many tiny runs.
+ */
+#define RUN_MIN 8
+
+/* number of pixels from x, up to RUN_MIN, with the alpha a */
+static inline int
+alpha_len(const nsfb_colour_t *pixel, int x, int width, uint32_t a)
+{
+        int len = 0;
+
+        while ((x + len < width) &&
+               (len < RUN_MIN) &&
+               ((pixel[x + len] >> 24) == a))
+                len++;
+
+        return len;
+}
+
+/* split a row of a bitmap into runs.
+ *
+ * If run is NULL the runs and colours are only counted.
+ */
+static int
+split_row(nsfb_run_t *run,
+          const nsfb_colour_t *pixel,
+          int width,
+          nsfb_colour_t *colour,
+          int *colourc,
+          bool opaque_colours)
+{
+        bool opaque;
+        uint32_t a;
+        int runc = 0;
+        int start;
+        int len;
+        int xloop;
+
+        for (xloop = 0; xloop < width; ) {
+                a = pixel[xloop] >> 24;
+                if (a == 0) {
+                        xloop++;
+                        continue;
+                }
+
+                start = xloop;
+                opaque = (alpha_len(pixel, xloop, width, 0xFF) == RUN_MIN);
+                if (opaque) {
+                        while (xloop < width &&
+                               (pixel[xloop] >> 24) == 0xFF)
+                                xloop++;
+                } else {
+                        /* up to a long opaque run or long gap */
+                        while (xloop < width) {
+                                a = pixel[xloop] >> 24;
+                                if (a == 0xFF) {
+                                        len = alpha_len(pixel, xloop,
+                                                        width, 0xFF);
+                                        if (len == RUN_MIN)
+                                                break;
+                                } else if (a == 0) {
+                                        len = alpha_len(pixel, xloop,
+                                                        width, 0);
+                                        if (len == RUN_MIN ||
+                                            xloop + len == width)
+                                                break;
+                                } else {
+                                        len = 1;
+                                }
+                                xloop += len;
+                        }
+                }
+
+                if (run != NULL) {
+                        run->x = start;
+                        run->len = xloop - start;
+                        run->opaque = opaque;
+                        run->colour = -1;
+                }
+
+                if (!opaque || opaque_colours) {
+                        if (run != NULL) {
+                                run->colour = *colourc;
+                                memcpy(colour + *colourc, pixel + start,
+                                       run->len * sizeof(nsfb_colour_t));
+                        }
+                        *colourc += xloop - start;
+                }
+
+                if (run != NULL)
+                        run++;
+                runc++;
+        }
+
+        return runc;
+}
+
+/* exported interface documented in runs.h */
+bool
+nsfb_runs_init(nsfb_runs_t *runs,
+               const nsfb_colour_t *pixel,
+               int width,
+               int height,
+               int stride,
+               bool opaque_colours)
+{
+        int runc = 0;
+        int colourc = 0;
+        int yloop;
+
+        memset(runs, 0, sizeof(nsfb_runs_t));
+        runs->width = width;
+        runs->height = height;
+
+        for (yloop = 0; yloop < height; yloop++) {
+                runc += split_row(NULL, pixel + yloop * stride, width,
+                                  NULL, &colourc, opaque_colours);
+        }
+
+        runs->row = malloc((height + 1) * sizeof(int));
+        runs->run = malloc((runc + 1) * sizeof(nsfb_run_t));
+        runs->colour = malloc((colourc + 1) * sizeof(nsfb_colour_t));
+        if (runs->row == NULL || runs->run == NULL || runs->colour == NULL) {
+                nsfb_runs_fini(runs);
+                return false;
+        }
+
+        runc = 0;
+        colourc = 0;
+        for (yloop = 0; yloop < height; yloop++) {
+                runs->row[yloop] = runc;
+                runc += split_row(runs->run + runc, pixel + yloop * stride,
+                                  width, runs->colour, &colourc,
+                                  opaque_colours);
+        }
+        runs->row[height] = runc;
+
+        return true;
+}
+
+/* exported interface documented in runs.h */
+void nsfb_runs_fini(nsfb_runs_t *runs)
+{
+        free(runs->row);
+        free(runs->run);
+        free(runs->colour);
+}
+
+/* exported interface documented in runs.h */
+bool
+nsfb_runs_plot(nsfb_t *nsfb,
+               const nsfb_runs_t *runs,
+               int x,
+               int y,
+               const uint8_t *pixel)
+{
+        const nsfb_run_t *run;
+        const nsfb_run_t *run_end;
+        const uint8_t *src = NULL;
+        uint8_t *dst;
+        nsfb_bbox_t clipped;
+        size_t pitch;
+        int bytes = nsfb->bpp / 8;
+        bool set_dither = false;
+        int x0, x1;
+        int yloop;
+        bool ret = true;
+
+        clipped.x0 = x;
+        clipped.y0 = y;
+        clipped.x1 = x + runs->width;
+        clipped.y1 = y + runs->height;
+
+        if (nsfb_region_active(nsfb)) {
+                nsfb_region_start(nsfb, &clipped);
+                while (nsfb_region_next(nsfb))
+                        ret = nsfb_runs_plot(nsfb, runs, x, y, pixel) && ret;
+                return ret;
+        }
+
+        nsfb_dlist_sync(nsfb);
+
+        if (!nsfb_plot_clip_ctx(nsfb, &clipped))
+                return true;
+
+        nsfb_damage_mark(nsfb, &clipped);
+
+        pitch = (size_t)runs->width * bytes;
+        if (pixel != NULL)
+                src = pixel + (clipped.y0 - y) * pitch;
+        dst = nsfb->ptr + clipped.y0 * nsfb->linelen;
+
+        /* Enable error diffusion for paletted screens, if not already on */
+        if (pixel == NULL &&
+            nsfb->palette != NULL &&
+            nsfb_palette_dithering_on(nsfb->palette) == false) {
+                nsfb_palette_dither_init(nsfb->palette,
+                                         clipped.x1 - clipped.x0);
+                set_dither = true;
+        }
+
+        for (yloop = clipped.y0 - y; yloop < clipped.y1 - y; yloop++) {
+                run = runs->run + runs->row[yloop];
+                run_end = runs->run + runs->row[yloop + 1];
+
+                for (; run < run_end; run++) {
+                        x0 = x + run->x;
+                        x1 = x0 + run->len;
+                        if (x0 >= clipped.x1)
+                                break;
+                        if (x1 <= clipped.x0)
+                                continue;
+
+                        if (x0 < clipped.x0)
+                                x0 = clipped.x0;
+                        if (x1 > clipped.x1)
+                                x1 = clipped.x1;
+
+                        if (!run->opaque) {
+                                nsfb->plotter_fns->blend(nsfb,
+                                        x0, y + yloop,
+                                        runs->colour + run->colour +
+                                        (x0 - x - run->x),
+                                        x1 - x0);
+                        } else if (src != NULL) {
+                                memcpy(dst + x0 * bytes,
+                                       src + (x0 - x) * bytes,
+                                       (x1 - x0) * bytes);
+                        } else {
+                                nsfb->plotter_fns->convert(nsfb,
+                                        runs->colour + run->colour +
+                                        (x0 - x - run->x),
+                                        dst + x0 * bytes,
+                                        x1 - x0);
+                        }
+                }
+
+                if (src != NULL)
+                        src += pitch;
+                dst += nsfb->linelen;
+        }
+
+        if (set_dither) {
+                nsfb_palette_dither_fini(nsfb->palette);
+        }
+
+        return true;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
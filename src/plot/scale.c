@@ -0,0 +1,377 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Bitmap scaling engine (implementation).
+ *
+ * A plan is built for each scaled plot holding, for every destination
+ * column, the source column (and for the filters the weight or span) it
+ * reads. Rows are then produced one at a time as ::nsfb_colour_t values
+ * which the plotters convert or blend as for an unscaled bitmap.
+ *
+ * The bilinear filter samples at pixel centres. With alpha it works on
+ * premultiplied colours so fully transparent pixels, whose colour is
+ * arbitrary, do not tint the edges of an image. The box filter averages
+ * every source pixel whose top left corner falls in the destination
+ * pixel, weighted by alpha when blending.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+
+#include "kernel.h"
+#include "scale.h"
+
+/* channels accumulated per source column by the box filter: weight, the
+ * three weighted colours and alpha.
+ */
+#define BOX_CHANNELS 5
+
+static inline uint32_t premultiply(uint32_t c)
+{
+        uint32_t a = c >> 24;
+        uint32_t rb, g;
+
+        if (a == 0xff)
+                return c;
+        if (a == 0)
+                return 0;
+
+        /* divide by 255 with rounding, two channels at a time */
+        rb = (c & 0xff00ff) * a + 0x800080;
+        rb = ((rb + ((rb >> 8) & 0xff00ff)) >> 8) & 0xff00ff;
+        g = (c & 0xff00) * a + 0x8000;
+        g = ((g + ((g >> 8) & 0xff00)) >> 8) & 0xff00;
+
+        return (c & 0xff000000) | rb | g;
+}
+
+static inline uint32_t unpremultiply(uint32_t c)
+{
+        uint32_t a = c >> 24;
+        uint32_t half = a / 2;
+
+        /* interpolation keeps every channel at or below alpha so the
+         * results need no clamping
+         */
+        if (a == 0xff || a == 0)
+                return c;
+
+        return (c & 0xff000000) |
+                ((((c >> 16) & 0xff) * 255 + half) / a) << 16 |
+                ((((c >> 8) & 0xff) * 255 + half) / a) << 8 |
+                (((c & 0xff) * 255 + half) / a);
+}
+
+/* source position of a destination pixel centre in 1/256ths of a pixel */
+static inline int
+centre(int d, int dsize, int ssize)
+{
+        int64_t f;
+
+        f = ((2 * (int64_t)d + 1) * ssize * 256) / (2 * (int64_t)dsize) - 128;
+        if (f < 0)
+                f = 0;
+        return f;
+}
+
+/* exported interface documented in scale.h */
+bool
+nsfb_scale_init(nsfb_scale_t *scale,
+                const nsfb_kernel_fns_t *kernel_fns,
+                unsigned int flags,
+                const nsfb_colour_t *pixel,
+                int bmp_width,
+                int bmp_height,
+                int bmp_stride,
+                int width,
+                int height,
+                int x0,
+                int x1)
+{
+        int n;
+        int f;
+        int sx0;
+        int sx1;
+
+        memset(scale, 0, sizeof(nsfb_scale_t));
+
+        scale->kernel_fns = kernel_fns;
+        scale->filter = flags & NSFB_PLOT_BITMAP_FILTER;
+        scale->alpha = (flags & NSFB_PLOT_BITMAP_ALPHA) != 0;
+        scale->bmp_height = bmp_height;
+        scale->bmp_stride = bmp_stride;
+        scale->height = height;
+        scale->width = x1 - x0;
+
+        /* an empty or inverted source or destination has no plan, the
+         * filters would size their row buffers from it
+         */
+        if ((bmp_width <= 0) || (bmp_height <= 0) ||
+            (width <= 0) || (height <= 0) ||
+            (x0 < 0) || (x1 > width) || (scale->width <= 0))
+                return false;
+
+        scale->x = malloc(scale->width * sizeof(int));
+        scale->out = malloc(scale->width * sizeof(nsfb_colour_t));
+        if (scale->x == NULL || scale->out == NULL)
+                goto fail;
+
+        switch (scale->filter) {
+        case NSFB_PLOT_BITMAP_BILINEAR:
+                scale->xw = malloc(scale->width * sizeof(uint16_t));
+                if (scale->xw == NULL)
+                        goto fail;
+
+                for (n = 0; n < scale->width; n++) {
+                        f = centre(x0 + n, width, bmp_width);
+                        scale->x[n] = f >> 8;
+                        scale->xw[n] = f & 0xff;
+                        if (scale->x[n] >= bmp_width - 1) {
+                                scale->x[n] = bmp_width - 1;
+                                scale->xw[n] = 0;
+                        }
+                }
+                /* the right pixel of the last pair may be past the edge
+                 * of the bitmap, it has no weight but must be readable
+                 */
+                sx0 = scale->x[0];
+                sx1 = scale->x[scale->width - 1] + 2;
+                break;
+
+        case NSFB_PLOT_BITMAP_BOX:
+                scale->xend = malloc(scale->width * sizeof(int));
+                if (scale->xend == NULL)
+                        goto fail;
+
+                for (n = 0; n < scale->width; n++) {
+                        scale->x[n] = ((int64_t)(x0 + n) * bmp_width) / width;
+                        scale->xend[n] = ((int64_t)(x0 + n + 1) * bmp_width) / width;
+                        if (scale->xend[n] <= scale->x[n])
+                                scale->xend[n] = scale->x[n] + 1;
+                }
+                sx0 = scale->x[0];
+                sx1 = scale->xend[scale->width - 1];
+                break;
+
+        default:
+                scale->filter = NSFB_PLOT_BITMAP_NEAREST;
+                for (n = 0; n < scale->width; n++) {
+                        scale->x[n] = ((int64_t)(x0 + n) * bmp_width) / width;
+                }
+                sx0 = scale->x[0];
+                sx1 = scale->x[scale->width - 1] + 1;
+                break;
+        }
+
+        /* make the plan relative to the first source column used */
+        for (n = 0; n < scale->width; n++) {
+                scale->x[n] -= sx0;
+                if (scale->xend != NULL)
+                        scale->xend[n] -= sx0;
+        }
+        scale->pixel = pixel + sx0;
+        scale->span = sx1 - sx0;
+        scale->cols = scale->span;
+        if (scale->cols > bmp_width - sx0)
+                scale->cols = bmp_width - sx0;
+
+        if (scale->filter == NSFB_PLOT_BITMAP_BILINEAR) {
+                scale->row[0] = malloc(scale->span * sizeof(uint32_t));
+                scale->row[1] = malloc(scale->span * sizeof(uint32_t));
+                scale->vrow = malloc(scale->span * sizeof(uint32_t));
+                if (scale->row[0] == NULL ||
+                    scale->row[1] == NULL ||
+                    scale->vrow == NULL)
+                        goto fail;
+                scale->rowy[0] = scale->rowy[1] = -1;
+        } else if (scale->filter == NSFB_PLOT_BITMAP_BOX) {
+                scale->acc = malloc(scale->span * BOX_CHANNELS *
+                                    sizeof(uint64_t));
+                if (scale->acc == NULL)
+                        goto fail;
+        }
+
+        return true;
+
+fail:
+        nsfb_scale_fini(scale);
+        return false;
+}
+
+/* get a source row copied, premultiplied if necessary and padded to the
+ * span. Rows are cached by parity as the bilinear filter always reads an
+ * odd and even row together.
+ */
+static const uint32_t *
+bilinear_src_row(nsfb_scale_t *scale, int y)
+{
+        const nsfb_colour_t *src;
+        uint32_t *row;
+        int n;
+
+        if (scale->rowy[y & 1] == y)
+                return scale->row[y & 1];
+
+        row = scale->row[y & 1];
+        src = scale->pixel + y * scale->bmp_stride;
+
+        if (scale->alpha) {
+                for (n = 0; n < scale->cols; n++)
+                        row[n] = premultiply(src[n]);
+        } else {
+                memcpy(row, src, scale->cols * sizeof(uint32_t));
+        }
+        for (n = scale->cols; n < scale->span; n++)
+                row[n] = row[scale->cols - 1];
+
+        scale->rowy[y & 1] = y;
+
+        return row;
+}
+
+static void
+bilinear_row(nsfb_scale_t *scale, int y)
+{
+        const uint32_t *r0;
+        const uint32_t *r1;
+        int f;
+        int sy;
+        unsigned int wy;
+        int n;
+
+        f = centre(y, scale->height, scale->bmp_height);
+        sy = f >> 8;
+        wy = f & 0xff;
+        if (sy >= scale->bmp_height - 1) {
+                sy = scale->bmp_height - 1;
+                wy = 0;
+        }
+
+        r0 = bilinear_src_row(scale, sy);
+        if (wy != 0) {
+                r1 = bilinear_src_row(scale, sy + 1);
+                scale->kernel_fns->lerp32(scale->vrow, r0, r1,
+                                          scale->span, wy);
+                r0 = scale->vrow;
+        }
+
+        scale->kernel_fns->hlerp32(scale->out, r0, scale->x, scale->xw,
+                                   scale->width);
+
+        if (scale->alpha) {
+                for (n = 0; n < scale->width; n++)
+                        scale->out[n] = unpremultiply(scale->out[n]);
+        }
+}
+
+static void
+box_row(nsfb_scale_t *scale, int y)
+{
+        const nsfb_colour_t *src;
+        uint64_t *acc;
+        uint64_t sum[BOX_CHANNELS];
+        uint64_t count;
+        uint32_t c;
+        uint32_t w;
+        int sy0, sy1;
+        int sy;
+        int n, k;
+
+        sy0 = ((int64_t)y * scale->bmp_height) / scale->height;
+        sy1 = ((int64_t)(y + 1) * scale->bmp_height) / scale->height;
+        if (sy1 <= sy0)
+                sy1 = sy0 + 1;
+
+        /* sum each source column over the rows covered */
+        memset(scale->acc, 0, scale->span * BOX_CHANNELS * sizeof(uint64_t));
+        for (sy = sy0; sy < sy1; sy++) {
+                src = scale->pixel + sy * scale->bmp_stride;
+                acc = scale->acc;
+                for (n = 0; n < scale->span; n++) {
+                        c = src[n];
+                        w = scale->alpha ? (c >> 24) : 1;
+                        acc[0] += w;
+                        acc[1] += (c & 0xff) * w;
+                        acc[2] += ((c >> 8) & 0xff) * w;
+                        acc[3] += ((c >> 16) & 0xff) * w;
+                        acc[4] += c >> 24;
+                        acc += BOX_CHANNELS;
+                }
+        }
+
+        /* then the columns covered by each destination pixel */
+        for (n = 0; n < scale->width; n++) {
+                memset(sum, 0, sizeof(sum));
+                for (k = scale->x[n]; k < scale->xend[n]; k++) {
+                        acc = scale->acc + k * BOX_CHANNELS;
+                        sum[0] += acc[0];
+                        sum[1] += acc[1];
+                        sum[2] += acc[2];
+                        sum[3] += acc[3];
+                        sum[4] += acc[4];
+                }
+
+                count = (uint64_t)(scale->xend[n] - scale->x[n]) * (sy1 - sy0);
+                c = ((sum[4] + count / 2) / count) << 24;
+                if (sum[0] != 0) {
+                        c |= ((sum[1] + sum[0] / 2) / sum[0]) |
+                                ((sum[2] + sum[0] / 2) / sum[0]) << 8 |
+                                ((sum[3] + sum[0] / 2) / sum[0]) << 16;
+                }
+                scale->out[n] = c;
+        }
+}
+
+/* exported interface documented in scale.h */
+const nsfb_colour_t *nsfb_scale_row(nsfb_scale_t *scale, int y)
+{
+        const nsfb_colour_t *src;
+        int n;
+
+        switch (scale->filter) {
+        case NSFB_PLOT_BITMAP_BILINEAR:
+                bilinear_row(scale, y);
+                break;
+
+        case NSFB_PLOT_BITMAP_BOX:
+                box_row(scale, y);
+                break;
+
+        default:
+                src = scale->pixel + (((int64_t)y * scale->bmp_height) /
+                                      scale->height) * scale->bmp_stride;
+                for (n = 0; n < scale->width; n++)
+                        scale->out[n] = src[scale->x[n]];
+                break;
+        }
+
+        return scale->out;
+}
+
+/* exported interface documented in scale.h */
+void nsfb_scale_fini(nsfb_scale_t *scale)
+{
+        free(scale->x);
+        free(scale->xend);
+        free(scale->xw);
+        free(scale->row[0]);
+        free(scale->row[1]);
+        free(scale->vrow);
+        free(scale->acc);
+        free(scale->out);
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
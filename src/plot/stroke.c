@@ -0,0 +1,988 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Wide and patterned line stroker (implementation).
+ *
+ * A polyline is walked once, adding a convex contour to an outline for
+ * each dash along every segment and for the joins and caps between them.
+ * The contours are all given the same orientation and filled together
+ * with the non-zero rule, so the union of the pieces is plotted with each
+ * pixel written once, as spans written straight into each row.
+ *
+ * Outlines are built in subpixels with the vertices of the polyline at
+ * pixel centres, so strokes of odd and even widths cover whole pixels.
+ * Each segment is first cut down to the surface widened by the furthest a
+ * join or cap can reach, working in 64 bits, so far off screen vertices
+ * neither overflow the subpixel coordinates nor produce dashes that can
+ * never be seen. The dash pattern is advanced over the lengths cut away so
+ * the visible dashes keep their phase. The cut ignores the clipping
+ * rectangle so a stroke plotted a tile or region rectangle at a time cuts
+ * every piece the same way.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+
+#include "nsfb.h"
+#include "plot.h"
+#include "coverage.h"
+#include "stroke.h"
+
+#define ONE (1 << NSFB_PLOT_SUBPIXEL_SHIFT)
+
+/* fractional bits of unit vectors */
+#define UNIT_SHIFT 14
+#define UNIT (1 << UNIT_SHIFT)
+
+/* outlines of up to this many vertices are built and filled on the stack */
+#define STROKE_STACK_POINTS 128
+
+/* mitres longer than this many half widths are bevelled instead */
+#define MITRE_LIMIT 4
+
+/* widest stroke, keeping the widened surface within an int */
+#define STROKE_MAX_WIDTH (1 << 16)
+
+/* vertices are cut to within this many subpixels of the surface, further
+ * than any join, cap or anti-aliased edge reaches
+ */
+#define STROKE_MARGIN(s) ((int64_t)MITRE_LIMIT * (s)->hw + 2 * ONE)
+
+/* sort the active edges with qsort when more than this many start on a row */
+#define STROKE_SORT_INSERT 16
+
+/* cosines of the first 17 of 64 directions around a circle */
+static const int unit_cos[17] = {
+        16384, 16305, 16069, 15679, 15137, 14449, 13623, 12665, 11585,
+        10394, 9102, 7723, 6270, 4756, 3196, 1606, 0
+};
+
+/** Outline of a stroke being built. */
+struct stroke {
+        nsfb_point_t *point; /**< vertices of the contours */
+        int pointc; /**< number of vertices */
+        int pointn; /**< number of vertices allocated */
+        int *contour; /**< number of vertices in each contour */
+        int contourc; /**< number of contours */
+        int contourn; /**< number of contours allocated */
+        int start; /**< first vertex of the contour being added */
+        bool failed; /**< an allocation failed */
+        bool aa; /**< fill with anti-aliased edges */
+        bool subpixel; /**< vertices are given in subpixels */
+
+        int hw; /**< half the width, in subpixels */
+        nsfb_plot_cap_t cap; /**< style of the ends of dashes */
+        nsfb_plot_join_t join; /**< style of the corners within dashes */
+        uint32_t pattern; /**< dash pattern, set bits are drawn */
+        int unit; /**< length of each bit of the pattern, in subpixels */
+
+        int64_t bx0, by0; /**< top left of the widened surface, in subpixels */
+        int64_t bx1, by1; /**< bottom right of the widened surface */
+
+        nsfb_point_t point_stack[STROKE_STACK_POINTS];
+        int contour_stack[STROKE_STACK_POINTS / 4];
+};
+
+/** A segment of a polyline, in subpixels. */
+struct stroke_seg {
+        nsfb_point_t a; /**< start, unless cut */
+        nsfb_point_t b; /**< end, unless cut */
+        bool cut_a; /**< the start lies outside the widened surface */
+        bool cut_b; /**< the end lies outside the widened surface */
+        int64_t ox, oy; /**< start, whether cut or not */
+        int64_t dx, dy; /**< vector from start to end */
+        int64_t full; /**< length of the whole segment */
+        int64_t skip; /**< length cut from the start */
+        int64_t rest; /**< length cut from the end */
+        int len; /**< length of the visible part */
+        int ux, uy; /**< unit direction */
+        int nx, ny; /**< offset of the left side, half the width long */
+};
+
+/** An edge of the outline, kept in the direction it was given. */
+struct stroke_edge {
+        int x0, y0; /**< first vertex */
+        int x1, y1; /**< second vertex */
+        int ry0, ry1; /**< rows whose centres it crosses */
+        int wind; /**< direction, 1 down or -1 up */
+        int cx; /**< first column whose centre is right of the edge */
+};
+
+/* scale a length by a unit vector component */
+static inline int scale(int len, int u)
+{
+        return ((int64_t)len * u + UNIT / 2) >> UNIT_SHIFT;
+}
+
+static void unit_dir(int k, int *ux, int *uy)
+{
+        int i = k & 15;
+
+        switch (k >> 4) {
+        case 0:
+                *ux = unit_cos[i];
+                *uy = unit_cos[16 - i];
+                break;
+
+        case 1:
+                *ux = -unit_cos[16 - i];
+                *uy = unit_cos[i];
+                break;
+
+        case 2:
+                *ux = -unit_cos[i];
+                *uy = -unit_cos[16 - i];
+                break;
+
+        default:
+                *ux = unit_cos[16 - i];
+                *uy = -unit_cos[i];
+                break;
+        }
+}
+
+static bool stroke_grow(struct stroke *s, bool contour)
+{
+        void *buf;
+
+        if (contour) {
+                if (s->contour == s->contour_stack) {
+                        buf = malloc(s->contourn * 2 * sizeof(int));
+                        if (buf != NULL)
+                                memcpy(buf, s->contour,
+                                       s->contourc * sizeof(int));
+                } else {
+                        buf = realloc(s->contour,
+                                      s->contourn * 2 * sizeof(int));
+                }
+                if (buf == NULL)
+                        return false;
+                s->contour = buf;
+                s->contourn *= 2;
+        } else {
+                if (s->point == s->point_stack) {
+                        buf = malloc(s->pointn * 2 * sizeof(nsfb_point_t));
+                        if (buf != NULL)
+                                memcpy(buf, s->point,
+                                       s->pointc * sizeof(nsfb_point_t));
+                } else {
+                        buf = realloc(s->point,
+                                      s->pointn * 2 * sizeof(nsfb_point_t));
+                }
+                if (buf == NULL)
+                        return false;
+                s->point = buf;
+                s->pointn *= 2;
+        }
+        return true;
+}
+
+/* add a vertex, offset from a point, to the contour being built */
+static void
+stroke_vertex(struct stroke *s, const nsfb_point_t *p, int dx, int dy)
+{
+        if (s->failed)
+                return;
+
+        if (s->pointc == s->pointn && !stroke_grow(s, false)) {
+                s->failed = true;
+                return;
+        }
+
+        s->point[s->pointc].x = p->x + dx;
+        s->point[s->pointc].y = p->y + dy;
+        s->pointc++;
+}
+
+/* finish the contour being built, turning it to the common orientation */
+static void stroke_close(struct stroke *s)
+{
+        nsfb_point_t *p = s->point + s->start;
+        nsfb_point_t t;
+        int n = s->pointc - s->start;
+        int64_t area = 0;
+        int i, j;
+
+        if (s->failed)
+                return;
+
+        for (i = 0; i < n; i++) {
+                j = (i + 1 == n) ? 0 : i + 1;
+                area += (int64_t)p[i].x * p[j].y - (int64_t)p[j].x * p[i].y;
+        }
+
+        if (area == 0) {
+                /* degenerate, covers nothing */
+                s->pointc = s->start;
+                return;
+        }
+
+        if (area < 0) {
+                for (i = 0, j = n - 1; i < j; i++, j--) {
+                        t = p[i];
+                        p[i] = p[j];
+                        p[j] = t;
+                }
+        }
+
+        if (s->contourc == s->contourn && !stroke_grow(s, true)) {
+                s->failed = true;
+                return;
+        }
+        s->contour[s->contourc++] = n;
+        s->start = s->pointc;
+}
+
+/* add a disc, with fewer sides when small */
+static void stroke_disc(struct stroke *s, const nsfb_point_t *p)
+{
+        int step;
+        int ux, uy;
+        int k;
+
+        if (s->hw <= 2 * ONE)
+                step = 8;
+        else if (s->hw <= 8 * ONE)
+                step = 4;
+        else if (s->hw <= 32 * ONE)
+                step = 2;
+        else
+                step = 1;
+
+        for (k = 0; k < 64; k += step) {
+                unit_dir(k, &ux, &uy);
+                stroke_vertex(s, p, scale(s->hw, ux), scale(s->hw, uy));
+        }
+        stroke_close(s);
+}
+
+/* a * b / c rounded down, for non-negative values below 2^42 */
+static int64_t muldiv(int64_t a, int64_t b, int64_t c)
+{
+        int64_t hi;
+        int64_t lo;
+        int64_t q;
+        int64_t r;
+
+        if (a < ((int64_t)1 << 31) && b < ((int64_t)1 << 31))
+                return (a * b) / c;
+
+        /* split a so neither partial product overflows */
+        hi = (a >> 21) * b;
+        lo = (a & ((1 << 21) - 1)) * b;
+        q = (hi / c) << 21;
+        r = (hi % c) << 21;
+        q += r / c;
+        r = (r % c) + (lo % c);
+
+        return q + (lo / c) + (r / c);
+}
+
+/* length of a vector with components below 2^41 */
+static int64_t vec_len(int64_t dx, int64_t dy)
+{
+        int shift = 0;
+
+        if (dx < 0)
+                dx = -dx;
+        if (dy < 0)
+                dy = -dy;
+        while ((dx >> shift) >= ((int64_t)1 << 31) ||
+               (dy >> shift) >= ((int64_t)1 << 31))
+                shift++;
+        dx >>= shift;
+        dy >>= shift;
+
+        return (int64_t)nsfb_plot_isqrt(dx * dx + dy * dy) << shift;
+}
+
+/* a vertex of the polyline in subpixels */
+static void
+stroke_pos(const struct stroke *s,
+           const nsfb_point_t *p,
+           int64_t *x,
+           int64_t *y)
+{
+        if (s->subpixel) {
+                *x = p->x;
+                *y = p->y;
+        } else {
+                /* vertices are at pixel centres */
+                *x = (int64_t)p->x * ONE + ONE / 2;
+                *y = (int64_t)p->y * ONE + ONE / 2;
+        }
+}
+
+static inline bool stroke_inside(const struct stroke *s, int64_t x, int64_t y)
+{
+        return x >= s->bx0 && x <= s->bx1 && y >= s->by0 && y <= s->by1;
+}
+
+/* narrow the distances along one axis of a segment to the widened surface,
+ * false if it misses
+ */
+static bool
+clip_axis(int64_t a, int64_t d, int64_t lo, int64_t hi, int64_t len,
+          int64_t *t0, int64_t *t1)
+{
+        int64_t t;
+
+        if (d < 0) {
+                /* mirror so the segment runs up the axis */
+                t = lo;
+                lo = -hi;
+                hi = -t;
+                a = -a;
+                d = -d;
+        }
+
+        if (a + d < lo || a > hi)
+                return false;
+
+        if (a < lo) {
+                t = muldiv(lo - a, len, d);
+                if (t > *t0)
+                        *t0 = t;
+        }
+        if (a + d > hi) {
+                t = muldiv(hi - a, len, d);
+                if (t < *t1)
+                        *t1 = t;
+        }
+        return true;
+}
+
+/* set up a segment cut to the widened surface, false if it has no length */
+static bool
+stroke_seg(struct stroke *s,
+           struct stroke_seg *seg,
+           const nsfb_point_t *a,
+           const nsfb_point_t *b)
+{
+        int64_t ax, ay;
+        int64_t dx, dy;
+        int64_t len;
+        int64_t t0;
+        int64_t t1;
+
+        stroke_pos(s, a, &ax, &ay);
+        stroke_pos(s, b, &dx, &dy);
+        dx -= ax;
+        dy -= ay;
+
+        len = vec_len(dx, dy);
+        if (len == 0)
+                return false;
+
+        seg->ox = ax;
+        seg->oy = ay;
+        seg->dx = dx;
+        seg->dy = dy;
+        seg->full = len;
+
+        seg->ux = (dx * UNIT) / len;
+        seg->uy = (dy * UNIT) / len;
+        seg->nx = scale(s->hw, -seg->uy);
+        seg->ny = scale(s->hw, seg->ux);
+
+        seg->cut_a = !stroke_inside(s, ax, ay);
+        seg->cut_b = !stroke_inside(s, ax + dx, ay + dy);
+
+        t0 = 0;
+        t1 = len;
+        if ((seg->cut_a || seg->cut_b) &&
+            (!clip_axis(ax, dx, s->bx0, s->bx1, len, &t0, &t1) ||
+             !clip_axis(ay, dy, s->by0, s->by1, len, &t0, &t1) ||
+             t0 > t1)) {
+                /* nothing of it can be seen */
+                t0 = len;
+                t1 = len;
+        }
+
+        /* a vertex within the widened surface fits in an int */
+        if (!seg->cut_a) {
+                seg->a.x = ax;
+                seg->a.y = ay;
+        }
+        if (!seg->cut_b) {
+                seg->b.x = ax + dx;
+                seg->b.y = ay + dy;
+        }
+        seg->len = t1 - t0;
+        seg->skip = t0;
+        seg->rest = len - t1;
+
+        return true;
+}
+
+/* advance the dash pattern over a length of the polyline left unplotted */
+static void
+stroke_skip(const struct stroke *s, int64_t len, int *bit, int *left, bool *on)
+{
+        if (len < *left) {
+                *left -= len;
+                return;
+        }
+
+        len -= *left;
+        *bit = (*bit + 1 + (int)((len / s->unit) & 31)) & 31;
+        *left = s->unit - (int)(len % s->unit);
+        *on = ((s->pattern >> *bit) & 1) != 0;
+}
+
+/* point a distance along a segment */
+static void
+seg_point(const struct stroke_seg *seg, int t, nsfb_point_t *p)
+{
+        int64_t u = seg->skip + t;
+
+        /* measured from the uncut start so cutting moves no vertex */
+        if (seg->dx < 0)
+                p->x = seg->ox - muldiv(-seg->dx, u, seg->full);
+        else
+                p->x = seg->ox + muldiv(seg->dx, u, seg->full);
+        if (seg->dy < 0)
+                p->y = seg->oy - muldiv(-seg->dy, u, seg->full);
+        else
+                p->y = seg->oy + muldiv(seg->dy, u, seg->full);
+}
+
+/* add the part of a segment between two distances along it */
+static void
+stroke_piece(struct stroke *s, const struct stroke_seg *seg, int t0, int t1)
+{
+        nsfb_point_t pa;
+        nsfb_point_t pb;
+
+        seg_point(seg, t0, &pa);
+        seg_point(seg, t1, &pb);
+
+        stroke_vertex(s, &pa, seg->nx, seg->ny);
+        stroke_vertex(s, &pb, seg->nx, seg->ny);
+        stroke_vertex(s, &pb, -seg->nx, -seg->ny);
+        stroke_vertex(s, &pa, -seg->nx, -seg->ny);
+        stroke_close(s);
+}
+
+/* add a cap at the start (dir -1) or end (dir 1) of a dash */
+static void
+stroke_cap(struct stroke *s,
+           const struct stroke_seg *seg,
+           const nsfb_point_t *p,
+           int dir)
+{
+        int ex;
+        int ey;
+
+        switch (s->cap) {
+        case NSFB_PLOT_CAP_ROUND:
+                stroke_disc(s, p);
+                break;
+
+        case NSFB_PLOT_CAP_SQUARE:
+                ex = scale(s->hw, seg->ux) * dir;
+                ey = scale(s->hw, seg->uy) * dir;
+                stroke_vertex(s, p, seg->nx, seg->ny);
+                stroke_vertex(s, p, seg->nx + ex, seg->ny + ey);
+                stroke_vertex(s, p, -seg->nx + ex, -seg->ny + ey);
+                stroke_vertex(s, p, -seg->nx, -seg->ny);
+                stroke_close(s);
+                break;
+
+        default:
+                /* butt ends add nothing */
+                break;
+        }
+}
+
+/* add the join between two segments on the outside of the corner */
+static void
+stroke_join(struct stroke *s,
+            const struct stroke_seg *s1,
+            const struct stroke_seg *s2,
+            const nsfb_point_t *p)
+{
+        int64_t cross = (int64_t)s1->ux * s2->uy - (int64_t)s1->uy * s2->ux;
+        int64_t dot = (int64_t)s1->ux * s2->ux + (int64_t)s1->uy * s2->uy;
+        int64_t c;
+        int o1x = s1->nx, o1y = s1->ny;
+        int o2x = s2->nx, o2y = s2->ny;
+
+        if (cross == 0 && dot > 0)
+                return;
+
+        /* turning towards the left side puts the corner on the right */
+        if (cross > 0) {
+                o1x = -o1x;
+                o1y = -o1y;
+                o2x = -o2x;
+                o2y = -o2y;
+        }
+
+        /* one plus the cosine of the angle between the segments */
+        c = UNIT + (dot >> UNIT_SHIFT);
+        if (c < 0)
+                c = 0;
+
+        switch (s->join) {
+        case NSFB_PLOT_JOIN_ROUND:
+                /* a bevel is within a quarter pixel of shallow arcs */
+                if ((int64_t)s->hw * (UNIT - (int)nsfb_plot_isqrt(c * UNIT / 2)) >=
+                    (int64_t)(ONE / 4) * UNIT) {
+                        stroke_disc(s, p);
+                        return;
+                }
+                break;
+
+        case NSFB_PLOT_JOIN_BEVEL:
+                break;
+
+        default:
+                /* the mitre is sqrt(2 / c) half widths long */
+                if (MITRE_LIMIT * MITRE_LIMIT * c < 2 * UNIT)
+                        break;
+
+                stroke_vertex(s, p, 0, 0);
+                stroke_vertex(s, p, o1x, o1y);
+                stroke_vertex(s, p,
+                              ((int64_t)(o1x + o2x) * UNIT) / c,
+                              ((int64_t)(o1y + o2y) * UNIT) / c);
+                stroke_vertex(s, p, o2x, o2y);
+                stroke_close(s);
+                return;
+        }
+
+        stroke_vertex(s, p, 0, 0);
+        stroke_vertex(s, p, o1x, o1y);
+        stroke_vertex(s, p, o2x, o2y);
+        stroke_close(s);
+}
+
+/* add the outline of a polyline, following the dash pattern along it */
+static void
+stroke_walk(struct stroke *s,
+            const nsfb_point_t *point,
+            int pointc,
+            bool closed)
+{
+        struct stroke_seg seg;
+        struct stroke_seg prev;
+        struct stroke_seg first;
+        nsfb_point_t p;
+        int64_t x, y;
+        bool have_prev = false;
+        bool join_ends;
+        bool start_pending;
+        bool on;
+        bool next;
+        int bit = 0;
+        int left = s->unit;
+        int segc;
+        int i, t, t0, step;
+
+        if (pointc < 1)
+                return;
+
+        /* a closed dashed line is dashed around its closing segment */
+        if (closed && pointc > 2) {
+                segc = pointc;
+                join_ends = (s->pattern == 0xFFFFFFFF);
+        } else {
+                segc = pointc - 1;
+                join_ends = false;
+        }
+
+        on = (s->pattern & 1) != 0;
+        start_pending = on;
+
+        for (i = 0; i < segc; i++) {
+                if (!stroke_seg(s, &seg, &point[i],
+                                &point[(i + 1 == pointc) ? 0 : i + 1]))
+                        continue;
+
+                if (seg.skip > 0)
+                        stroke_skip(s, seg.skip, &bit, &left, &on);
+
+                t0 = -1;
+                if (on) {
+                        if (seg.cut_a) {
+                                /* any cap or join is out of sight */
+                                start_pending = false;
+                        } else if (start_pending) {
+                                if (!join_ends)
+                                        stroke_cap(s, &seg, &seg.a, -1);
+                                start_pending = false;
+                        } else if (have_prev) {
+                                stroke_join(s, &prev, &seg, &seg.a);
+                        }
+                        t0 = 0;
+                }
+
+                for (t = 0; t < seg.len; ) {
+                        step = seg.len - t;
+                        if (step > left)
+                                step = left;
+                        t += step;
+                        left -= step;
+                        if (left != 0)
+                                continue;
+
+                        bit = (bit + 1) & 31;
+                        left = s->unit;
+                        next = ((s->pattern >> bit) & 1) != 0;
+
+                        if (on && !next) {
+                                stroke_piece(s, &seg, t0, t);
+                                seg_point(&seg, t, &p);
+                                stroke_cap(s, &seg, &p, 1);
+                                t0 = -1;
+                        } else if (!on && next) {
+                                if (t < seg.len) {
+                                        seg_point(&seg, t, &p);
+                                        stroke_cap(s, &seg, &p, -1);
+                                        t0 = t;
+                                } else {
+                                        /* begins with the next segment */
+                                        start_pending = true;
+                                }
+                        }
+                        on = next;
+                }
+
+                if (t0 >= 0 && t0 < seg.len)
+                        stroke_piece(s, &seg, t0, seg.len);
+
+                if (seg.rest > 0) {
+                        stroke_skip(s, seg.rest, &bit, &left, &on);
+                        start_pending = false;
+                }
+
+                if (!have_prev)
+                        first = seg;
+                prev = seg;
+                have_prev = true;
+        }
+
+        if (!have_prev) {
+                /* a single point, only caps give it any extent */
+                stroke_pos(s, &point[0], &x, &y);
+                if (on && stroke_inside(s, x, y)) {
+                        seg.a.x = x;
+                        seg.a.y = y;
+                        seg.ux = UNIT;
+                        seg.uy = 0;
+                        seg.nx = 0;
+                        seg.ny = s->hw;
+                        stroke_cap(s, &seg, &seg.a, -1);
+                        if (s->cap != NSFB_PLOT_CAP_ROUND)
+                                stroke_cap(s, &seg, &seg.a, 1);
+                }
+                return;
+        }
+
+        if (on && !start_pending) {
+                if (join_ends) {
+                        if (!first.cut_a)
+                                stroke_join(s, &prev, &first, &first.a);
+                } else if (!prev.cut_b) {
+                        stroke_cap(s, &prev, &prev.b, 1);
+                }
+        }
+}
+
+static int stroke_edge_cmp(const void *a, const void *b)
+{
+        return ((const struct stroke_edge *)a)->ry0 -
+                ((const struct stroke_edge *)b)->ry0;
+}
+
+static int stroke_active_cmp(const void *a, const void *b)
+{
+        return (*(struct stroke_edge * const *)a)->cx -
+                (*(struct stroke_edge * const *)b)->cx;
+}
+
+/* fill the outline with the non-zero rule, sampling at pixel centres */
+static bool stroke_fill(nsfb_t *nsfb, struct stroke *s, nsfb_colour_t c)
+{
+        struct stroke_edge edge_stack[STROKE_STACK_POINTS];
+        struct stroke_edge *active_stack[STROKE_STACK_POINTS];
+        int span_stack[STROKE_STACK_POINTS * 2];
+        struct stroke_edge *edges = edge_stack;
+        struct stroke_edge **active = active_stack;
+        int *span = span_stack;
+        struct stroke_edge *e;
+        const nsfb_point_t *p0;
+        const nsfb_point_t *p1;
+        int64_t x;
+        int edgec = 0;
+        int activec = 0;
+        int next = 0;
+        int added;
+        int spanc;
+        int ry0, ry1;
+        int sy;
+        int wind;
+        int x0, x1;
+        int i, j, k, y;
+
+        if (s->pointc < 3)
+                return true;
+
+        if (s->pointc > STROKE_STACK_POINTS) {
+                edges = malloc(s->pointc * (sizeof(struct stroke_edge) +
+                                            sizeof(struct stroke_edge *) +
+                                            2 * sizeof(int)));
+                if (edges == NULL)
+                        return false;
+                active = (struct stroke_edge **)(edges + s->pointc);
+                span = (int *)(active + s->pointc);
+        }
+
+        /* build the edge table */
+        ry0 = nsfb->clip.y1;
+        ry1 = nsfb->clip.y0;
+        for (i = 0, k = 0; i < s->contourc; k += s->contour[i], i++) {
+                for (j = 0; j < s->contour[i]; j++) {
+                        p0 = &s->point[k + j];
+                        if (j + 1 < s->contour[i])
+                                p1 = p0 + 1;
+                        else
+                                p1 = &s->point[k];
+
+                        e = &edges[edgec];
+                        if (p0->y < p1->y) {
+                                e->ry0 = p0->y;
+                                e->ry1 = p1->y;
+                                e->wind = 1;
+                        } else {
+                                e->ry0 = p1->y;
+                                e->ry1 = p0->y;
+                                e->wind = -1;
+                        }
+
+                        /* the rows whose centres lie within the edge */
+                        e->ry0 = (e->ry0 + ONE / 2 - 1) >> NSFB_PLOT_SUBPIXEL_SHIFT;
+                        e->ry1 = (e->ry1 + ONE / 2 - 1) >> NSFB_PLOT_SUBPIXEL_SHIFT;
+                        if (e->ry0 < nsfb->clip.y0)
+                                e->ry0 = nsfb->clip.y0;
+                        if (e->ry1 > nsfb->clip.y1)
+                                e->ry1 = nsfb->clip.y1;
+                        if (e->ry0 >= e->ry1)
+                                continue;
+
+                        e->x0 = p0->x;
+                        e->y0 = p0->y;
+                        e->x1 = p1->x;
+                        e->y1 = p1->y;
+
+                        if (e->ry0 < ry0)
+                                ry0 = e->ry0;
+                        if (e->ry1 > ry1)
+                                ry1 = e->ry1;
+                        edgec++;
+                }
+        }
+        qsort(edges, edgec, sizeof(struct stroke_edge), stroke_edge_cmp);
+
+        for (y = ry0; y < ry1; y++) {
+                sy = (y << NSFB_PLOT_SUBPIXEL_SHIFT) + ONE / 2;
+
+                /* retire finished edges and add those starting here */
+                for (i = 0, j = 0; i < activec; i++) {
+                        if (active[i]->ry1 > y)
+                                active[j++] = active[i];
+                }
+                activec = j;
+                added = 0;
+                while (next < edgec && edges[next].ry0 <= y) {
+                        active[activec++] = &edges[next++];
+                        added++;
+                }
+
+                /* crossings of the row centre */
+                for (i = 0; i < activec; i++) {
+                        e = active[i];
+                        x = e->x0 + ((int64_t)(sy - e->y0) * (e->x1 - e->x0)) /
+                                (e->y1 - e->y0);
+                        e->cx = (x + ONE / 2 - 1) >> NSFB_PLOT_SUBPIXEL_SHIFT;
+                }
+
+                /* the active edges stay in order of their crossings, which
+                 * change little from one row to the next, so only rows
+                 * where many edges start need a full sort
+                 */
+                if (added > STROKE_SORT_INSERT) {
+                        qsort(active, activec, sizeof(struct stroke_edge *),
+                              stroke_active_cmp);
+                } else {
+                        for (i = 1; i < activec; i++) {
+                                e = active[i];
+                                for (j = i;
+                                     j > 0 && active[j - 1]->cx > e->cx;
+                                     j--)
+                                        active[j] = active[j - 1];
+                                active[j] = e;
+                        }
+                }
+
+                /* spans where the winding is not zero */
+                spanc = 0;
+                wind = 0;
+                x0 = 0;
+                for (i = 0; i < activec; i++) {
+                        if (wind == 0)
+                                x0 = active[i]->cx;
+                        wind += active[i]->wind;
+                        if (wind != 0)
+                                continue;
+
+                        x1 = active[i]->cx;
+                        if (x0 < nsfb->clip.x0)
+                                x0 = nsfb->clip.x0;
+                        if (x1 > nsfb->clip.x1)
+                                x1 = nsfb->clip.x1;
+                        if (x0 >= x1)
+                                continue;
+
+                        if (spanc > 0 && span[spanc * 2 - 1] >= x0) {
+                                span[spanc * 2 - 1] = x1;
+                        } else {
+                                span[spanc * 2] = x0;
+                                span[spanc * 2 + 1] = x1;
+                                spanc++;
+                        }
+                }
+
+                if (spanc > 0)
+                        nsfb->plotter_fns->spans(nsfb, y, span, spanc, c);
+        }
+
+        if (edges != edge_stack)
+                free(edges);
+
+        return true;
+}
+
+static void
+stroke_init(nsfb_t *nsfb, struct stroke *s, const nsfb_plot_pen_t *pen)
+{
+        int width = (pen->stroke_width > 1) ? pen->stroke_width : 1;
+
+        if (width > STROKE_MAX_WIDTH)
+                width = STROKE_MAX_WIDTH;
+
+        s->point = s->point_stack;
+        s->pointc = 0;
+        s->pointn = STROKE_STACK_POINTS;
+        s->contour = s->contour_stack;
+        s->contourc = 0;
+        s->contourn = STROKE_STACK_POINTS / 4;
+        s->start = 0;
+        s->failed = false;
+        s->aa = (pen->stroke_type == NFSB_PLOT_OPTYPE_SOLID_AA);
+        s->subpixel = false;
+
+        s->hw = width * ONE / 2;
+        s->cap = pen->stroke_cap;
+        s->join = pen->stroke_join;
+        s->unit = width * ONE;
+        if (pen->stroke_type == NFSB_PLOT_OPTYPE_PATTERN)
+                s->pattern = pen->stroke_pattern;
+        else
+                s->pattern = 0xFFFFFFFF;
+
+        s->bx0 = -STROKE_MARGIN(s);
+        s->by0 = -STROKE_MARGIN(s);
+        s->bx1 = (int64_t)nsfb->width * ONE + STROKE_MARGIN(s);
+        s->by1 = (int64_t)nsfb->height * ONE + STROKE_MARGIN(s);
+}
+
+static bool stroke_finish(nsfb_t *nsfb, struct stroke *s, nsfb_colour_t c)
+{
+        bool ret = !s->failed;
+
+        if (ret && s->aa)
+                ret = nsfb_coverage_fill(nsfb, s->point, s->contour,
+                                         s->contourc, c,
+                                         NSFB_PLOT_FILL_NONZERO);
+        else if (ret)
+                ret = stroke_fill(nsfb, s, c);
+
+        if (s->point != s->point_stack)
+                free(s->point);
+        if (s->contour != s->contour_stack)
+                free(s->contour);
+
+        return ret;
+}
+
+/* exported interface documented in stroke.h */
+bool
+nsfb_stroke_polyline(nsfb_t *nsfb,
+                     const nsfb_point_t *point,
+                     int pointc,
+                     bool closed,
+                     const nsfb_plot_pen_t *pen)
+{
+        struct stroke s;
+
+        stroke_init(nsfb, &s, pen);
+        stroke_walk(&s, point, pointc, closed);
+
+        return stroke_finish(nsfb, &s, pen->stroke_colour);
+}
+
+/* exported interface documented in stroke.h */
+bool
+nsfb_stroke_polyline_subpixel(nsfb_t *nsfb,
+                              const nsfb_point_t *point,
+                              int pointc,
+                              bool closed,
+                              const nsfb_plot_pen_t *pen)
+{
+        struct stroke s;
+
+        stroke_init(nsfb, &s, pen);
+        s.subpixel = true;
+        stroke_walk(&s, point, pointc, closed);
+
+        return stroke_finish(nsfb, &s, pen->stroke_colour);
+}
+
+/* exported interface documented in stroke.h */
+bool
+nsfb_stroke_lines(nsfb_t *nsfb,
+                  const nsfb_bbox_t *line,
+                  int linec,
+                  const nsfb_plot_pen_t *pen)
+{
+        struct stroke s;
+        nsfb_point_t point[2];
+
+        stroke_init(nsfb, &s, pen);
+        for (; linec > 0; linec--, line++) {
+                point[0].x = line->x0;
+                point[0].y = line->y0;
+                point[1].x = line->x1;
+                point[1].y = line->y1;
+                stroke_walk(&s, point, 2, false);
+        }
+
+        return stroke_finish(nsfb, &s, pen->stroke_colour);
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
@@ -0,0 +1,293 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Band parallel worker pool (implementation).
+ *
+ * A pool holds threads which sleep until an operation is run. The area an
+ * operation plots is cut into horizontal bands, or square tiles for the
+ * display list, more of them than there are threads, and every thread
+ * including the caller takes the next unplotted cell until there are none
+ * left. Threads finishing early so pick up the cells the others have not
+ * reached, which balances uneven cells without per thread queues. The
+ * caller then waits for the workers to finish their last cell before
+ * returning.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+#include "libnsfb_plot_util.h"
+
+#include "nsfb.h"
+#include "plot.h"
+#include "workers.h"
+
+/* operations plotting fewer pixels than this are not split */
+#define WORKERS_MIN_AREA (256 * 256)
+
+/* bands are never cut thinner than this many rows */
+#define WORKERS_MIN_ROWS 16
+
+/* bands cut for each thread, so early finishers have bands to take */
+#define WORKERS_BANDS_PER_THREAD 4
+
+struct nsfb_workers_s {
+        pthread_t *thread; /**< worker threads, one fewer than threadc */
+        int threadc; /**< threads plotting, including the caller */
+
+        pthread_mutex_t lock;
+        pthread_cond_t start; /**< signalled when a job is posted */
+        pthread_cond_t done; /**< signalled when the last worker finishes */
+
+        unsigned int generation; /**< incremented for each job */
+        bool quit; /**< workers should exit */
+        int running; /**< workers still plotting the current job */
+
+        /* current job */
+        const nsfb_t *nsfb;
+        nsfb_workers_fn_t *fn;
+        void *ctx;
+        nsfb_bbox_t extent; /**< clipped area of the job */
+        int cols; /**< width of each cell */
+        int rows; /**< height of each cell */
+        int across; /**< number of cells across the extent */
+        int next; /**< next cell to plot */
+        int cellc; /**< number of cells */
+        bool ok;
+};
+
+/* plot cells of the current job until none are left */
+static void workers_cells(nsfb_workers_t *workers)
+{
+        nsfb_t band;
+        bool ok;
+        int b;
+
+        band = *workers->nsfb;
+        band.workers = NULL;
+        band.dlist = NULL;
+
+        for (;;) {
+                pthread_mutex_lock(&workers->lock);
+                b = workers->next++;
+                pthread_mutex_unlock(&workers->lock);
+
+                if (b >= workers->cellc)
+                        break;
+
+                band.clip = workers->extent;
+                band.clip.x0 += (b % workers->across) * workers->cols;
+                band.clip.y0 += (b / workers->across) * workers->rows;
+                if (band.clip.x1 > band.clip.x0 + workers->cols)
+                        band.clip.x1 = band.clip.x0 + workers->cols;
+                if (band.clip.y1 > band.clip.y0 + workers->rows)
+                        band.clip.y1 = band.clip.y0 + workers->rows;
+
+                ok = workers->fn(&band, workers->ctx);
+                if (!ok) {
+                        pthread_mutex_lock(&workers->lock);
+                        workers->ok = false;
+                        pthread_mutex_unlock(&workers->lock);
+                }
+        }
+}
+
+static void *workers_main(void *arg)
+{
+        nsfb_workers_t *workers = arg;
+        unsigned int seen = 0;
+
+        pthread_mutex_lock(&workers->lock);
+        for (;;) {
+                while (!workers->quit && (workers->generation == seen))
+                        pthread_cond_wait(&workers->start, &workers->lock);
+                if (workers->quit)
+                        break;
+                seen = workers->generation;
+                pthread_mutex_unlock(&workers->lock);
+
+                workers_cells(workers);
+
+                pthread_mutex_lock(&workers->lock);
+                if (--workers->running == 0)
+                        pthread_cond_signal(&workers->done);
+        }
+        pthread_mutex_unlock(&workers->lock);
+
+        return NULL;
+}
+
+/* exported interface documented in workers.h */
+void nsfb_workers_destroy(nsfb_workers_t *workers)
+{
+        int t;
+
+        pthread_mutex_lock(&workers->lock);
+        workers->quit = true;
+        pthread_cond_broadcast(&workers->start);
+        pthread_mutex_unlock(&workers->lock);
+
+        for (t = 0; t < workers->threadc - 1; t++)
+                pthread_join(workers->thread[t], NULL);
+
+        pthread_cond_destroy(&workers->done);
+        pthread_cond_destroy(&workers->start);
+        pthread_mutex_destroy(&workers->lock);
+        free(workers->thread);
+        free(workers);
+}
+
+/* exported interface documented in workers.h */
+bool nsfb_workers_want(nsfb_t *nsfb, const nsfb_bbox_t *extent)
+{
+        nsfb_bbox_t clipped = *extent;
+
+        /* paletted formats carry dithering state between rows */
+        if ((nsfb->workers == NULL) || (nsfb->palette != NULL))
+                return false;
+
+        if (!nsfb_plot_clip_ctx(nsfb, &clipped))
+                return false;
+
+        return ((clipped.y1 - clipped.y0) >= 2 * WORKERS_MIN_ROWS) &&
+                ((int64_t)(clipped.x1 - clipped.x0) *
+                 (clipped.y1 - clipped.y0) >= WORKERS_MIN_AREA);
+}
+
+/* run a job over cells of an area, which must not be empty */
+static bool
+workers_grid(nsfb_t *nsfb,
+             const nsfb_bbox_t *extent,
+             int cols,
+             int rows,
+             nsfb_workers_fn_t *fn,
+             void *ctx)
+{
+        nsfb_workers_t *workers = nsfb->workers;
+        bool ok;
+
+        pthread_mutex_lock(&workers->lock);
+        workers->nsfb = nsfb;
+        workers->fn = fn;
+        workers->ctx = ctx;
+        workers->extent = *extent;
+        workers->cols = cols;
+        workers->rows = rows;
+        workers->across = (extent->x1 - extent->x0 + cols - 1) / cols;
+        workers->cellc = workers->across *
+                ((extent->y1 - extent->y0 + rows - 1) / rows);
+        workers->next = 0;
+        workers->ok = true;
+        workers->running = workers->threadc - 1;
+        workers->generation++;
+        pthread_cond_broadcast(&workers->start);
+        pthread_mutex_unlock(&workers->lock);
+
+        workers_cells(workers);
+
+        pthread_mutex_lock(&workers->lock);
+        while (workers->running > 0)
+                pthread_cond_wait(&workers->done, &workers->lock);
+        ok = workers->ok;
+        pthread_mutex_unlock(&workers->lock);
+
+        return ok;
+}
+
+/* exported interface documented in workers.h */
+bool nsfb_workers_run(nsfb_t *nsfb,
+                      const nsfb_bbox_t *extent,
+                      nsfb_workers_fn_t *fn,
+                      void *ctx)
+{
+        nsfb_bbox_t clipped = *extent;
+        int height;
+        int bandc;
+
+        if (!nsfb_plot_clip_ctx(nsfb, &clipped))
+                return true;
+
+        height = clipped.y1 - clipped.y0;
+
+        bandc = nsfb->workers->threadc * WORKERS_BANDS_PER_THREAD;
+        if (bandc > height / WORKERS_MIN_ROWS)
+                bandc = height / WORKERS_MIN_ROWS;
+        if (bandc < 1)
+                bandc = 1;
+
+        return workers_grid(nsfb, &clipped, clipped.x1 - clipped.x0,
+                            (height + bandc - 1) / bandc, fn, ctx);
+}
+
+/* exported interface documented in workers.h */
+bool nsfb_workers_run_tiles(nsfb_t *nsfb,
+                            const nsfb_bbox_t *extent,
+                            int size,
+                            nsfb_workers_fn_t *fn,
+                            void *ctx)
+{
+        if ((extent->x0 >= extent->x1) || (extent->y0 >= extent->y1))
+                return true;
+
+        return workers_grid(nsfb, extent, size, size, fn, ctx);
+}
+
+/* exported interface documented in libnsfb_plot.h */
+bool nsfb_plot_set_threads(nsfb_t *nsfb, int threads)
+{
+        nsfb_workers_t *workers;
+        int t;
+
+        if (nsfb->workers != NULL) {
+                if (nsfb->workers->threadc == threads)
+                        return true;
+                nsfb_workers_destroy(nsfb->workers);
+                nsfb->workers = NULL;
+        }
+
+        if (threads <= 1)
+                return true;
+
+        workers = calloc(1, sizeof(nsfb_workers_t));
+        if (workers == NULL)
+                return false;
+
+        workers->thread = malloc((threads - 1) * sizeof(pthread_t));
+        if (workers->thread == NULL) {
+                free(workers);
+                return false;
+        }
+
+        pthread_mutex_init(&workers->lock, NULL);
+        pthread_cond_init(&workers->start, NULL);
+        pthread_cond_init(&workers->done, NULL);
+
+        /* the pool only counts the threads actually started */
+        workers->threadc = 1;
+        for (t = 0; t < threads - 1; t++) {
+                if (pthread_create(&workers->thread[t], NULL,
+                                   workers_main, workers) != 0) {
+                        nsfb_workers_destroy(workers);
+                        return false;
+                }
+                workers->threadc++;
+        }
+
+        nsfb->workers = workers;
+
+        return true;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset:8
+ * End:
+ */
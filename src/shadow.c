@@ -0,0 +1,302 @@
+/*
+ * This file is part of libnsfb, http://www.netsurf-browser.org/
+ * Licenced under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file
+ * Shadow frame comparison (implementation).
+ *
+ * A copy of the frame as it was last passed to the surface is kept and the
+ * screen divided into square tiles. On update each tile of the area is
+ * compared with the copy and only those which differ are copied and passed
+ * on, runs of them joined into a single rectangle.
+ *
+ * A tile is only trusted once all of it has been copied, so after enabling
+ * or a change of geometry the first update of each tile is passed on
+ * without comparison.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+#include "libnsfb_plot_util.h"
+
+#include "nsfb.h"
+#include "cursor.h"
+#include "kernel.h"
+#include "shadow.h"
+#include "surface.h"
+
+/* tile size, large enough that a row of a tile is a worthwhile compare */
+#define SHADOW_TILE_SHIFT 6
+#define SHADOW_TILE (1 << SHADOW_TILE_SHIFT)
+
+struct nsfb_shadow_s {
+    uint8_t *ptr; /* frame as last passed to the surface */
+    uint8_t *valid; /* tiles held wholly in the frame */
+
+    /* geometry the frame was allocated for */
+    int width;
+    int height;
+    int linelen;
+    int bpp;
+    int tilec; /* tiles in a row */
+
+    nsfb_shadow_stats_t stats;
+};
+
+/* reallocate the frame if the geometry has changed since it was made */
+static bool shadow_resize(nsfb_t *nsfb, nsfb_shadow_t *shadow)
+{
+    int tiler;
+
+    if ((shadow->ptr != NULL) &&
+	(shadow->width == nsfb->width) &&
+	(shadow->height == nsfb->height) &&
+	(shadow->linelen == nsfb->linelen) &&
+	(shadow->bpp == nsfb->bpp))
+	return true;
+
+    free(shadow->ptr);
+    free(shadow->valid);
+
+    shadow->tilec = (nsfb->width + SHADOW_TILE - 1) >> SHADOW_TILE_SHIFT;
+    tiler = (nsfb->height + SHADOW_TILE - 1) >> SHADOW_TILE_SHIFT;
+
+    shadow->ptr = malloc((size_t)nsfb->linelen * nsfb->height);
+    shadow->valid = calloc((size_t)shadow->tilec * tiler, 1);
+    if ((shadow->ptr == NULL) || (shadow->valid == NULL)) {
+	free(shadow->ptr);
+	free(shadow->valid);
+	shadow->ptr = NULL;
+	shadow->valid = NULL;
+	return false;
+    }
+
+    shadow->width = nsfb->width;
+    shadow->height = nsfb->height;
+    shadow->linelen = nsfb->linelen;
+    shadow->bpp = nsfb->bpp;
+
+    return true;
+}
+
+/* compare part of a tile with the frame, copying it if it differs */
+static bool
+shadow_tile_changed(nsfb_t *nsfb, nsfb_shadow_t *shadow, const nsfb_bbox_t *tile, bool valid)
+{
+    nsfb_kernfn_equal_t *equal = nsfb->kernel_fns->equal;
+    size_t offset;
+    int len;
+    int y;
+
+    offset = (size_t)tile->y0 * nsfb->linelen + ((tile->x0 * nsfb->bpp) >> 3);
+    len = ((tile->x1 * nsfb->bpp + 7) >> 3) - ((tile->x0 * nsfb->bpp) >> 3);
+
+    if (valid) {
+	for (y = tile->y0; y < tile->y1; y++) {
+	    if (!equal(nsfb->ptr + offset, shadow->ptr + offset, len))
+		break;
+	    offset += nsfb->linelen;
+	}
+	if (y == tile->y1)
+	    return false;
+    } else {
+	y = tile->y0;
+    }
+
+    /* rows before the first difference are already the same */
+    for (; y < tile->y1; y++) {
+	memcpy(shadow->ptr + offset, nsfb->ptr + offset, len);
+	offset += nsfb->linelen;
+    }
+
+    return true;
+}
+
+/* pass a rectangle to the surface, joining it to the pending one below if
+ * they are the same width
+ */
+static int
+shadow_forward(nsfb_t *nsfb, nsfb_bbox_t *pending, const nsfb_bbox_t *run)
+{
+    int ret = 0;
+
+    if ((run != NULL) &&
+	(pending->x0 == run->x0) && (pending->x1 == run->x1) &&
+	(pending->y1 == run->y0)) {
+	pending->y1 = run->y1;
+	return 0;
+    }
+
+    if (pending->x0 < pending->x1)
+	ret = nsfb->surface_rtns->update(nsfb, pending);
+
+    if (run != NULL)
+	*pending = *run;
+    else
+	pending->x0 = pending->x1 = 0;
+
+    return ret;
+}
+
+/* exported interface documented in shadow.h */
+void nsfb_shadow_destroy(nsfb_shadow_t *shadow)
+{
+    free(shadow->ptr);
+    free(shadow->valid);
+    free(shadow);
+}
+
+/* exported interface documented in shadow.h */
+int nsfb_shadow_update(nsfb_t *nsfb, nsfb_bbox_t *box)
+{
+    nsfb_shadow_t *shadow = nsfb->shadow;
+    struct nsfb_cursor_s *cursor = nsfb->cursor;
+    nsfb_bbox_t area = *box;
+    nsfb_bbox_t screen;
+    nsfb_bbox_t pending = { 0, 0, 0, 0 };
+    nsfb_bbox_t run;
+    nsfb_bbox_t tile;
+    uint8_t *valid;
+    bool rows_whole;
+    bool whole;
+    int ret = 0;
+    int tx;
+    int ty;
+
+    screen.x0 = screen.y0 = 0;
+    screen.x1 = nsfb->width;
+    screen.y1 = nsfb->height;
+
+    if (!nsfb_plot_clip(&screen, &area) ||
+	(area.x0 >= area.x1) || (area.y0 >= area.y1) ||
+	!shadow_resize(nsfb, shadow))
+	return nsfb->surface_rtns->update(nsfb, box);
+
+    /* pixels smaller than a byte are compared a whole byte at a time */
+    if (nsfb->bpp < 8) {
+	area.x0 &= ~7;
+	area.x1 = (area.x1 + 7) & ~7;
+	if (area.x1 > nsfb->width)
+	    area.x1 = nsfb->width;
+    }
+
+    for (ty = area.y0 >> SHADOW_TILE_SHIFT; (ty << SHADOW_TILE_SHIFT) < area.y1; ty++) {
+	tile.y0 = ty << SHADOW_TILE_SHIFT;
+	tile.y1 = tile.y0 + SHADOW_TILE;
+	if (tile.y1 > nsfb->height)
+	    tile.y1 = nsfb->height;
+	rows_whole = (tile.y0 >= area.y0) && (tile.y1 <= area.y1);
+	if (tile.y0 < area.y0)
+	    tile.y0 = area.y0;
+	if (tile.y1 > area.y1)
+	    tile.y1 = area.y1;
+
+	run.x0 = run.x1 = 0;
+	run.y0 = tile.y0;
+	run.y1 = tile.y1;
+
+	valid = shadow->valid + ty * shadow->tilec;
+
+	for (tx = area.x0 >> SHADOW_TILE_SHIFT; (tx << SHADOW_TILE_SHIFT) < area.x1; tx++) {
+	    tile.x0 = tx << SHADOW_TILE_SHIFT;
+	    tile.x1 = tile.x0 + SHADOW_TILE;
+	    if (tile.x1 > nsfb->width)
+		tile.x1 = nsfb->width;
+	    whole = rows_whole && (tile.x0 >= area.x0) && (tile.x1 <= area.x1);
+	    if (tile.x0 < area.x0)
+		tile.x0 = area.x0;
+	    if (tile.x1 > area.x1)
+		tile.x1 = area.x1;
+
+	    shadow->stats.compared++;
+
+	    if (!shadow_tile_changed(nsfb, shadow, &tile, valid[tx] != 0)) {
+		shadow->stats.skipped++;
+		if (run.x0 < run.x1) {
+		    if (shadow_forward(nsfb, &pending, &run) != 0)
+			ret = -1;
+		    run.x0 = run.x1 = 0;
+		}
+		continue;
+	    }
+
+	    shadow->stats.changed++;
+	    if (whole)
+		valid[tx] = 1;
+
+	    if (run.x0 == run.x1)
+		run.x0 = tile.x0;
+	    run.x1 = tile.x1;
+	}
+
+	if (run.x0 < run.x1) {
+	    if (shadow_forward(nsfb, &pending, &run) != 0)
+		ret = -1;
+	}
+    }
+
+    if (shadow_forward(nsfb, &pending, NULL) != 0)
+	ret = -1;
+
+    /* a cursor cleared by a claim is restored by the surface on update,
+     * which must happen even when nothing under it changed
+     */
+    if ((cursor != NULL) && (cursor->plotted == false)) {
+	tile.x0 = cursor->loc.x0 - cursor->hotspot_x;
+	tile.y0 = cursor->loc.y0 - cursor->hotspot_y;
+	tile.x1 = cursor->loc.x1 - cursor->hotspot_x;
+	tile.y1 = cursor->loc.y1 - cursor->hotspot_y;
+	if (nsfb_plot_clip(&screen, &tile) &&
+	    (tile.x0 < tile.x1) && (tile.y0 < tile.y1) &&
+	    (nsfb->surface_rtns->update(nsfb, &tile) != 0))
+	    ret = -1;
+    }
+
+    return ret;
+}
+
+/* exported interface documented in libnsfb.h */
+int nsfb_set_shadow_compare(nsfb_t *nsfb, bool compare)
+{
+    if (!compare) {
+	if (nsfb->shadow != NULL) {
+	    nsfb_shadow_destroy(nsfb->shadow);
+	    nsfb->shadow = NULL;
+	}
+	return 0;
+    }
+
+    if (nsfb->shadow != NULL)
+	return 0;
+
+    nsfb->shadow = calloc(1, sizeof(nsfb_shadow_t));
+    if (nsfb->shadow == NULL)
+	return -1;
+
+    return 0;
+}
+
+/* exported interface documented in libnsfb.h */
+int nsfb_get_shadow_stats(nsfb_t *nsfb, nsfb_shadow_stats_t *stats)
+{
+    if (nsfb->shadow == NULL)
+	return -1;
+
+    *stats = nsfb->shadow->stats;
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-basic-offset: 4
+ *  tab-width: 8
+ * End:
+ */
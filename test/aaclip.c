@@ -0,0 +1,169 @@
+/* libnsfb anti-aliased clipping test program
+ *
+ * Plots anti-aliased paths and ellipses once unclipped and again under
+ * several clipping rectangles, and checks that every pixel inside a clip
+ * gets the same coverage as without it.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+
+#define WIDTH 320
+#define HEIGHT 240
+
+#define BACKGROUND 0xff000000
+#define FILL_COLOUR 0xffe0c0a0
+
+static const nsfb_bbox_t clips[] = {
+    { 37, 11, 301, 229 },
+    { 101, 0, 102, 240 },
+    { 0, 50, 160, 190 },
+    { 159, 93, 320, 147 },
+    { 3, 3, 17, 231 },
+};
+
+#define CLIPC (int)(sizeof(clips) / sizeof(clips[0]))
+
+static nsfb_t *new_surface(enum nsfb_type_e fetype)
+{
+    nsfb_t *nsfb;
+
+    nsfb = nsfb_new(fetype);
+    if (nsfb == NULL)
+        return NULL;
+
+    if ((nsfb_set_geometry(nsfb, WIDTH, HEIGHT, NSFB_FMT_XRGB8888) == -1) ||
+        (nsfb_init(nsfb) == -1)) {
+        nsfb_free(nsfb);
+        return NULL;
+    }
+
+    return nsfb;
+}
+
+/* plot the shapes, some reaching off the surface */
+static void plot_shapes(nsfb_t *nsfb)
+{
+    static const int star[] = {
+        -40, 20,   150, 60,   30, 230,   90, -10,   180, 210,
+    };
+    nsfb_plot_pathop_t pathop[5];
+    nsfb_plot_pen_t pen;
+    nsfb_bbox_t ellipse;
+    int loop;
+
+    for (loop = 0; loop < 5; loop++) {
+        pathop[loop].operation = (loop == 0) ?
+            NFSB_PLOT_PATHOP_MOVE : NFSB_PLOT_PATHOP_LINE;
+        pathop[loop].point.x = star[loop * 2];
+        pathop[loop].point.y = star[loop * 2 + 1];
+    }
+
+    memset(&pen, 0, sizeof(pen));
+    pen.stroke_type = NFSB_PLOT_OPTYPE_NONE;
+    pen.fill_type = NFSB_PLOT_OPTYPE_SOLID_AA;
+    pen.fill_colour = FILL_COLOUR;
+    pen.fill_rule = NSFB_PLOT_FILL_EVENODD;
+    nsfb_plot_path(nsfb, 5, pathop, &pen);
+
+    ellipse.x0 = 170;
+    ellipse.y0 = 20;
+    ellipse.x1 = 397;
+    ellipse.y1 = 133;
+    nsfb_plot_ellipse_fill_aa(nsfb, &ellipse, FILL_COLOUR);
+
+    ellipse.x0 = -63;
+    ellipse.y0 = 121;
+    ellipse.x1 = 233;
+    ellipse.y1 = 250;
+    nsfb_plot_ellipse_aa(nsfb, &ellipse, FILL_COLOUR);
+}
+
+static int compare(nsfb_t *clipped, nsfb_t *whole, const nsfb_bbox_t *clip)
+{
+    uint8_t *cptr, *wptr;
+    int cstride, wstride;
+    uint32_t c, w;
+    int errors = 0;
+    int x, y;
+
+    nsfb_get_buffer(clipped, &cptr, &cstride);
+    nsfb_get_buffer(whole, &wptr, &wstride);
+
+    for (y = 0; y < HEIGHT; y++) {
+        for (x = 0; x < WIDTH; x++) {
+            c = ((uint32_t *)(void *)(cptr + y * cstride))[x] & 0xffffff;
+            w = ((uint32_t *)(void *)(wptr + y * wstride))[x] & 0xffffff;
+            if ((x < clip->x0) || (x >= clip->x1) ||
+                (y < clip->y0) || (y >= clip->y1))
+                w = BACKGROUND & 0xffffff;
+            if (c != w)
+                errors++;
+        }
+    }
+
+    if (errors != 0)
+        fprintf(stderr, "clip %d,%d-%d,%d: %d pixels differ\n",
+                clip->x0, clip->y0, clip->x1, clip->y1, errors);
+
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    const char *fename;
+    enum nsfb_type_e fetype;
+    nsfb_t *clipped;
+    nsfb_t *whole;
+    nsfb_bbox_t clip;
+    int errors = 0;
+    int loop;
+
+    if (argc < 2) {
+        fename = "ram";
+    } else {
+        fename = argv[1];
+    }
+
+    fetype = nsfb_type_from_name(fename);
+    if (fetype == NSFB_SURFACE_NONE) {
+        fprintf(stderr, "Unable to convert \"%s\" to nsfb surface type\n", fename);
+        return 1;
+    }
+
+    clipped = new_surface(fetype);
+    whole = new_surface(fetype);
+    if ((clipped == NULL) || (whole == NULL)) {
+        fprintf(stderr, "Unable to initialise \"%s\" nsfb surface\n", fename);
+        return 4;
+    }
+
+    nsfb_plot_clg(whole, BACKGROUND);
+    plot_shapes(whole);
+
+    for (loop = 0; loop < CLIPC; loop++) {
+        nsfb_plot_set_clip(clipped, NULL);
+        nsfb_plot_clg(clipped, BACKGROUND);
+        clip = clips[loop];
+        nsfb_plot_set_clip(clipped, &clip);
+        plot_shapes(clipped);
+
+        errors += compare(clipped, whole, &clips[loop]);
+    }
+
+    nsfb_free(clipped);
+    nsfb_free(whole);
+
+    if (errors != 0)
+        return 5;
+
+    printf("PASS\n");
+
+    return 0;
+}
@@ -72,6 +72,7 @@ int main(int argc, char **argv)
     pen.stroke_colour = 0xff000000;
     pen.fill_colour = 0xffff0000;
     pen.stroke_type = NFSB_PLOT_OPTYPE_SOLID;
+    pen.stroke_width = 1;
     pen.fill_type = NFSB_PLOT_OPTYPE_NONE;
 
     for (loop=-300;loop < 600;loop+=100) {
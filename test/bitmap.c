@@ -134,6 +134,25 @@ int main(int argc, char **argv)
 
     nsfb_plot_copy(nsfb, &box2, nsfb, &box3);
 
+    /* the globe scaled down and up with filtering */
+    box3.x0 = 0;
+    box3.y0 = 300;
+    box3.x1 = box3.x0 + 66;
+    box3.y1 = box3.y0 + 67;
+
+    nsfb_plot_bitmap(nsfb, &box3, (const nsfb_colour_t *)(void *)fbptr,
+		     nsglobe.width, nsglobe.height, fbstride / 4,
+		     NSFB_PLOT_BITMAP_ALPHA | NSFB_PLOT_BITMAP_BOX);
+
+    box3.x0 = 66;
+    box3.y0 = 300;
+    box3.x1 = box3.x0 + 300;
+    box3.y1 = box3.y0 + 300;
+
+    nsfb_plot_bitmap(nsfb, &box3, (const nsfb_colour_t *)(void *)fbptr,
+		     nsglobe.width, nsglobe.height, fbstride / 4,
+		     NSFB_PLOT_BITMAP_ALPHA | NSFB_PLOT_BITMAP_BILINEAR);
+
     nsfb_update(nsfb, &box);
 
     /* wait for quit event or timeout */
@@ -90,6 +90,7 @@ int main(int argc, char **argv)
     pen.stroke_colour = 0xff0000ff;
     pen.fill_colour = 0xffff0000;
     pen.stroke_type = NFSB_PLOT_OPTYPE_SOLID;
+    pen.stroke_width = 1;
     pen.fill_type = NFSB_PLOT_OPTYPE_NONE;
 
     nsfb_plot_path(nsfb, fill_shape(path, 100, 50), path, &pen);
@@ -100,6 +100,11 @@ int main(int argc, char **argv)
     int p[] = { 300,300,  350,350, 400,300, 450,250, 400,200};
     int loop;
     nsfb_plot_pen_t pen;
+    nsfb_point_t zigzag[4];
+    nsfb_bbox_t cells[64];
+    nsfb_colour_t cellc[64];
+    nsfb_plot_span_t spans[32];
+    uint8_t ramp[96];
     const char *dumpfile = NULL;
 
     if (argc < 2) {
@@ -146,6 +151,8 @@ int main(int argc, char **argv)
     }
 
     /* draw black radial lines from the origin */
+    pen.stroke_type = NFSB_PLOT_OPTYPE_SOLID;
+    pen.stroke_width = 1;
     pen.stroke_colour = 0xff000000;
     for (loop = 0; loop < box.x1; loop += 20) {
         box2 = box;
@@ -181,6 +188,16 @@ int main(int argc, char **argv)
         nsfb_plot_line(nsfb, &box2, &pen);
     }
 
+    /* draw translucent anti-aliased radial lines from the top left */
+    pen.stroke_type = NFSB_PLOT_OPTYPE_SOLID_AA;
+    pen.stroke_colour = 0x80800080;
+    for (loop = 10; loop < box.x1; loop += 20) {
+        box2 = box;
+        box2.x1 = loop;
+        nsfb_plot_line(nsfb, &box2, &pen);
+    }
+    pen.stroke_type = NFSB_PLOT_OPTYPE_SOLID;
+
     /* draw an unclipped rectangle */
     box2.x0 = box2.y0 = 100;
     box2.x1 = box2.y1 = 300;
@@ -232,6 +249,102 @@ int main(int argc, char **argv)
 
     nsfb_plot_ellipse(nsfb, &box3, 0xffff0000);
 
+    /* the same shapes anti-aliased */
+    box3.x0 = 700;
+    box3.x1 = 800;
+    box3.y0 = 300;
+    box3.y1 = 500;
+
+    nsfb_plot_ellipse_fill_aa(nsfb, &box3, 0xff0000ff);
+
+    nsfb_plot_ellipse_aa(nsfb, &box3, 0xffff0000);
+
+    /* an anti-aliased pie chart with a thin arc around it */
+    pen.stroke_type = NFSB_PLOT_OPTYPE_NONE;
+    pen.fill_type = NFSB_PLOT_OPTYPE_SOLID_AA;
+    pen.fill_colour = 0xff0080ff;
+    nsfb_plot_arc_pen(nsfb, 700, 150, 80, 30, 150, &pen);
+    pen.fill_colour = 0xff00c000;
+    nsfb_plot_arc_pen(nsfb, 700, 150, 80, 150, 390, &pen);
+    pen.fill_type = NFSB_PLOT_OPTYPE_NONE;
+    pen.stroke_type = NFSB_PLOT_OPTYPE_SOLID;
+    nsfb_plot_arc(nsfb, 700, 150, 90, 30, 150, 0xff000000);
+
+    /* a wide anti-aliased arc with round caps */
+    pen.stroke_type = NFSB_PLOT_OPTYPE_SOLID_AA;
+    pen.stroke_width = 7;
+    pen.stroke_cap = NSFB_PLOT_CAP_ROUND;
+    pen.stroke_join = NSFB_PLOT_JOIN_ROUND;
+    pen.stroke_colour = 0xff800000;
+    nsfb_plot_arc_pen(nsfb, 700, 150, 100, 200, 340, &pen);
+    pen.stroke_type = NFSB_PLOT_OPTYPE_SOLID;
+    pen.stroke_width = 1;
+    pen.stroke_cap = NSFB_PLOT_CAP_BUTT;
+    pen.stroke_join = NSFB_PLOT_JOIN_MITRE;
+
+    /* wide strokes with each join and cap style */
+    pen.stroke_width = 9;
+    for (loop = 0; loop < 3; loop++) {
+        zigzag[0].x = 50 + loop * 100;
+        zigzag[0].y = 560;
+        zigzag[1].x = zigzag[0].x + 25;
+        zigzag[1].y = 440;
+        zigzag[2].x = zigzag[0].x + 50;
+        zigzag[2].y = 540;
+        zigzag[3].x = zigzag[0].x + 75;
+        zigzag[3].y = 460;
+
+        pen.stroke_colour = 0xff008000;
+        pen.stroke_cap = loop;
+        pen.stroke_join = loop;
+        nsfb_plot_polylines(nsfb, 4, zigzag, &pen);
+    }
+    pen.stroke_width = 1;
+    pen.stroke_cap = NSFB_PLOT_CAP_BUTT;
+    pen.stroke_join = NSFB_PLOT_JOIN_MITRE;
+
+    box2.x0 = 40;
+    box2.y0 = 420;
+    box2.x1 = 340;
+    box2.y1 = 580;
+    nsfb_plot_rectangle(nsfb, &box2, 3, 0xff800080, false, true);
+
+    /* the overlays, cells and spans are recorded and plotted together */
+    nsfb_frame_begin(nsfb);
+
+    /* translucent overlays across the zigzags with each operator */
+    for (loop = NSFB_PLOT_OP_OVER; loop <= NSFB_PLOT_OP_XOR; loop++) {
+        box3.x0 = 45 + (loop - NSFB_PLOT_OP_OVER) * 72;
+        box3.x1 = box3.x0 + 60;
+        box3.y0 = 430;
+        box3.y1 = 570;
+        nsfb_plot_rectangle_fill_op(nsfb, &box3, 0x80c08040, loop);
+    }
+
+    /* a grid of cells filled in one batch */
+    for (loop = 0; loop < 64; loop++) {
+        cells[loop].x0 = 360 + (loop % 8) * 12;
+        cells[loop].y0 = 430 + (loop / 8) * 12;
+        cells[loop].x1 = cells[loop].x0 + 11;
+        cells[loop].y1 = cells[loop].y0 + 11;
+        cellc[loop] = 0xff000000 | (loop * 0x030507);
+    }
+    nsfb_plot_fill_rects(nsfb, 64, cells, cellc);
+
+    /* spans fading in across their length */
+    for (loop = 0; loop < 96; loop++)
+        ramp[loop] = loop * 255 / 95;
+    for (loop = 0; loop < 32; loop++) {
+        spans[loop].y = 430 + loop;
+        spans[loop].x0 = 460 + loop;
+        spans[loop].x1 = spans[loop].x0 + 96;
+        spans[loop].alpha = 0xFF;
+        spans[loop].cov = ramp;
+    }
+    nsfb_plot_spans(nsfb, 32, spans, 0xff000080);
+
+    nsfb_frame_end(nsfb);
+
     box2.x0 = 400;
     box2.y0 = 400;
     box2.x1 = 500;
@@ -276,6 +389,9 @@ int main(int argc, char **argv)
 
     srand(1234);
 
+    /* update only what each rectangle altered */
+    nsfb_set_damage_tracking(nsfb, true);
+
     for (loop=0; loop < 10000; loop++) {
         nsfb_claim(nsfb, &box2);
         box3.x0 = rand() / (RAND_MAX / box.x1);
@@ -283,9 +399,11 @@ int main(int argc, char **argv)
         box3.x1 = rand() / (RAND_MAX / 400);
         box3.y1 = rand() / (RAND_MAX / 400);
         nsfb_plot_rectangle_fill(nsfb, &box3, 0xff000000 | rand());
-        nsfb_update(nsfb, &box2);
+        nsfb_update_damage(nsfb);
     }
 
+    nsfb_set_damage_tracking(nsfb, false);
+
     /* wait for quit event or timeout */
     while (waitloop > 0) {
 	if (nsfb_event(nsfb, &event, 1000)  == false) {
@@ -0,0 +1,155 @@
+/* libnsfb large polygon test program
+ *
+ * Plots polygons with more vertices than the plotter keeps on the stack,
+ * with odd and even counts, and checks each against the same outline with
+ * a vertex repeated, which must fill exactly the same pixels.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+
+#define WIDTH 400
+#define HEIGHT 400
+
+#define BACKGROUND 0xff000000
+#define FILL_COLOUR 0xff40a020
+
+#define MAX_SIDES 101
+
+static nsfb_t *new_surface(enum nsfb_type_e fetype)
+{
+    nsfb_t *nsfb;
+
+    nsfb = nsfb_new(fetype);
+    if (nsfb == NULL)
+        return NULL;
+
+    if ((nsfb_set_geometry(nsfb, WIDTH, HEIGHT, NSFB_FMT_XRGB8888) == -1) ||
+        (nsfb_init(nsfb) == -1)) {
+        nsfb_free(nsfb);
+        return NULL;
+    }
+
+    return nsfb;
+}
+
+/* a star of the given number of points, with the first point repeated
+ * after it when asked
+ */
+static int star(int *p, int sides, bool repeat)
+{
+    int pointc = 0;
+    double radius;
+    int loop;
+
+    for (loop = 0; loop < sides; loop++) {
+        radius = (loop & 1) ? 90 : 180;
+        p[pointc * 2] = (WIDTH / 2) + (int)(radius * cos(loop * 2 * M_PI / sides));
+        p[pointc * 2 + 1] = (HEIGHT / 2) + (int)(radius * sin(loop * 2 * M_PI / sides));
+        pointc++;
+
+        if (repeat && (loop == 0)) {
+            p[pointc * 2] = p[0];
+            p[pointc * 2 + 1] = p[1];
+            pointc++;
+        }
+    }
+
+    return pointc;
+}
+
+static void plot_star(nsfb_t *nsfb, int sides, bool repeat)
+{
+    int p[(MAX_SIDES + 1) * 2];
+    int pointc;
+
+    nsfb_plot_clg(nsfb, BACKGROUND);
+    pointc = star(p, sides, repeat);
+    nsfb_plot_polygon(nsfb, p, pointc, FILL_COLOUR);
+}
+
+static int compare(nsfb_t *a, nsfb_t *b, int sides)
+{
+    uint8_t *aptr, *bptr;
+    int astride, bstride;
+    int filled = 0;
+    int errors = 0;
+    uint32_t pa, pb;
+    int x, y;
+
+    nsfb_get_buffer(a, &aptr, &astride);
+    nsfb_get_buffer(b, &bptr, &bstride);
+
+    for (y = 0; y < HEIGHT; y++) {
+        for (x = 0; x < WIDTH; x++) {
+            pa = ((uint32_t *)(void *)(aptr + y * astride))[x] & 0xffffff;
+            pb = ((uint32_t *)(void *)(bptr + y * bstride))[x] & 0xffffff;
+            if (pa != pb)
+                errors++;
+            if (pa != (BACKGROUND & 0xffffff))
+                filled++;
+        }
+    }
+
+    if (filled == 0) {
+        fprintf(stderr, "%d sides: nothing plotted\n", sides);
+        errors++;
+    }
+    if (errors != 0)
+        fprintf(stderr, "%d sides: %d pixels differ\n", sides, errors);
+
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    static const int sides[] = { 33, 34, 35, 63, 64, 65, 101 };
+    const char *fename;
+    enum nsfb_type_e fetype;
+    nsfb_t *plain;
+    nsfb_t *repeated;
+    int errors = 0;
+    int loop;
+
+    if (argc < 2) {
+        fename = "ram";
+    } else {
+        fename = argv[1];
+    }
+
+    fetype = nsfb_type_from_name(fename);
+    if (fetype == NSFB_SURFACE_NONE) {
+        fprintf(stderr, "Unable to convert \"%s\" to nsfb surface type\n", fename);
+        return 1;
+    }
+
+    plain = new_surface(fetype);
+    repeated = new_surface(fetype);
+    if ((plain == NULL) || (repeated == NULL)) {
+        fprintf(stderr, "Unable to initialise \"%s\" nsfb surface\n", fename);
+        return 4;
+    }
+
+    for (loop = 0; loop < (int)(sizeof(sides) / sizeof(sides[0])); loop++) {
+        plot_star(plain, sides[loop], false);
+        plot_star(repeated, sides[loop], true);
+        errors += compare(plain, repeated, sides[loop]);
+    }
+
+    nsfb_free(plain);
+    nsfb_free(repeated);
+
+    if (errors != 0)
+        return 5;
+
+    printf("PASS\n");
+
+    return 0;
+}
@@ -78,6 +78,7 @@ int main(int argc, char **argv)
 
     pen.stroke_colour = 0xff000000;
     pen.stroke_type = NFSB_PLOT_OPTYPE_SOLID;
+    pen.stroke_width = 1;
 
 
     for (rotate =0; rotate < (2 * M_PI); rotate += (M_PI / 8)) {
@@ -0,0 +1,256 @@
+/* libnsfb clipping region test program
+ *
+ * Plots thin lines, anti-aliased ellipses and a polygon with more vertices
+ * than the plotter keeps on the stack under a clipping region of several
+ * rectangles and checks that every pixel inside the region is the
+ * same as plotting them clipped to the bounding box of the region, and
+ * that nothing is plotted outside it.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "libnsfb.h"
+#include "libnsfb_plot.h"
+#include "libnsfb_plot_util.h"
+
+#define WIDTH 640
+#define HEIGHT 480
+
+#define BACKGROUND 0xff000000
+#define LINE_COLOUR 0xff2060c0
+
+static const nsfb_bbox_t region[] = {
+    { 0, 0, 200, 200 },
+    { 300, 100, 500, 300 },
+    { 120, 320, 420, 330 },
+    { 150, 340, 160, 460 },
+};
+
+static const nsfb_bbox_t lines[] = {
+    /* inside one rectangle but across the bands of the region */
+    { 0, 0, 199, 150 },
+    { 10, 20, 190, 190 },
+    { 5, 190, 195, 7 },
+    /* between rectangles */
+    { 100, 50, 450, 250 },
+    { 480, 120, 20, 180 },
+    { 130, 470, 410, 321 },
+    { 155, 335, 158, 470 },
+    /* from outside the bounding box */
+    { -40, -30, 600, 420 },
+    { 630, 10, -5, 470 },
+    { 250, -100, 250, 600 },
+    { -100, 150, 700, 150 },
+    { -100, 325, 700, 326 },
+};
+
+static const nsfb_bbox_t ellipses[] = {
+    /* inside one rectangle but across the bands of the region */
+    { 20, 30, 190, 170 },
+    /* across several rectangles */
+    { 90, 60, 470, 350 },
+    { 140, 250, 430, 400 },
+    /* reaching outside the bounding box */
+    { -80, -60, 260, 150 },
+    { 280, 180, 700, 520 },
+};
+
+/* vertices of the star polygon, odd and above the stack limit */
+#define STAR_POINTS 45
+
+#define LINEC (int)(sizeof(lines) / sizeof(lines[0]))
+#define ELLIPSEC (int)(sizeof(ellipses) / sizeof(ellipses[0]))
+#define REGIONC (int)(sizeof(region) / sizeof(region[0]))
+
+static bool in_region(int x, int y)
+{
+    int loop;
+
+    for (loop = 0; loop < REGIONC; loop++) {
+        if ((x >= region[loop].x0) && (x < region[loop].x1) &&
+            (y >= region[loop].y0) && (y < region[loop].y1))
+            return true;
+    }
+    return false;
+}
+
+static nsfb_t *new_surface(enum nsfb_type_e fetype)
+{
+    nsfb_t *nsfb;
+
+    nsfb = nsfb_new(fetype);
+    if (nsfb == NULL)
+        return NULL;
+
+    if ((nsfb_set_geometry(nsfb, WIDTH, HEIGHT, NSFB_FMT_XRGB8888) == -1) ||
+        (nsfb_init(nsfb) == -1)) {
+        nsfb_free(nsfb);
+        return NULL;
+    }
+
+    return nsfb;
+}
+
+/* clear the whole surface and plot the lines under a clip */
+static void
+plot_lines(nsfb_t *nsfb, int clipc, const nsfb_bbox_t *clip, nsfb_plot_pen_t *pen, bool together)
+{
+    nsfb_bbox_t copy[LINEC];
+    int loop;
+
+    nsfb_plot_set_clip(nsfb, NULL);
+    nsfb_plot_clg(nsfb, BACKGROUND);
+    nsfb_plot_set_clip_region(nsfb, clipc, clip);
+
+    memcpy(copy, lines, sizeof(copy));
+    if (together) {
+        nsfb_plot_lines(nsfb, LINEC, copy, pen);
+    } else {
+        for (loop = 0; loop < LINEC; loop++)
+            nsfb_plot_line(nsfb, &copy[loop], pen);
+    }
+}
+
+/* clear the whole surface and plot the ellipses under a clip */
+static void
+plot_ellipses(nsfb_t *nsfb, int clipc, const nsfb_bbox_t *clip, bool fill)
+{
+    nsfb_bbox_t copy;
+    int loop;
+
+    nsfb_plot_set_clip(nsfb, NULL);
+    nsfb_plot_clg(nsfb, BACKGROUND);
+    nsfb_plot_set_clip_region(nsfb, clipc, clip);
+
+    for (loop = 0; loop < ELLIPSEC; loop++) {
+        copy = ellipses[loop];
+        if (fill)
+            nsfb_plot_ellipse_fill_aa(nsfb, &copy, LINE_COLOUR);
+        else
+            nsfb_plot_ellipse_aa(nsfb, &copy, LINE_COLOUR);
+    }
+}
+
+/* clear the whole surface and plot a star polygon under a clip */
+static void plot_star(nsfb_t *nsfb, int clipc, const nsfb_bbox_t *clip)
+{
+    int p[STAR_POINTS * 2];
+    double radius;
+    int loop;
+
+    nsfb_plot_set_clip(nsfb, NULL);
+    nsfb_plot_clg(nsfb, BACKGROUND);
+    nsfb_plot_set_clip_region(nsfb, clipc, clip);
+
+    for (loop = 0; loop < STAR_POINTS; loop++) {
+        radius = (loop & 1) ? 80 : 230;
+        p[loop * 2] = 250 + (int)(radius * cos(loop * 2 * M_PI / STAR_POINTS));
+        p[loop * 2 + 1] = 230 + (int)(radius * sin(loop * 2 * M_PI / STAR_POINTS));
+    }
+    nsfb_plot_polygon(nsfb, p, STAR_POINTS, LINE_COLOUR);
+}
+
+static int compare(nsfb_t *clipped, nsfb_t *bounded, const char *name)
+{
+    uint8_t *cptr, *bptr;
+    int cstride, bstride;
+    uint32_t c, b;
+    int errors = 0;
+    int x, y;
+
+    nsfb_get_buffer(clipped, &cptr, &cstride);
+    nsfb_get_buffer(bounded, &bptr, &bstride);
+
+    for (y = 0; y < HEIGHT; y++) {
+        for (x = 0; x < WIDTH; x++) {
+            c = ((uint32_t *)(void *)(cptr + y * cstride))[x] & 0xffffff;
+            b = ((uint32_t *)(void *)(bptr + y * bstride))[x] & 0xffffff;
+            if (!in_region(x, y))
+                b = BACKGROUND & 0xffffff;
+            if (c != b)
+                errors++;
+        }
+    }
+
+    if (errors != 0)
+        fprintf(stderr, "%s: %d pixels differ\n", name, errors);
+
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    const char *fename;
+    enum nsfb_type_e fetype;
+    nsfb_t *clipped;
+    nsfb_t *bounded;
+    nsfb_bbox_t box;
+    nsfb_plot_pen_t pen;
+    int errors = 0;
+    int loop;
+
+    if (argc < 2) {
+        fename = "ram";
+    } else {
+        fename = argv[1];
+    }
+
+    fetype = nsfb_type_from_name(fename);
+    if (fetype == NSFB_SURFACE_NONE) {
+        fprintf(stderr, "Unable to convert \"%s\" to nsfb surface type\n", fename);
+        return 1;
+    }
+
+    clipped = new_surface(fetype);
+    bounded = new_surface(fetype);
+    if ((clipped == NULL) || (bounded == NULL)) {
+        fprintf(stderr, "Unable to initialise \"%s\" nsfb surface\n", fename);
+        return 4;
+    }
+
+    box = region[0];
+    for (loop = 1; loop < REGIONC; loop++)
+        nsfb_plot_add_rect(&box, &region[loop], &box);
+
+    memset(&pen, 0, sizeof(pen));
+    pen.stroke_colour = LINE_COLOUR;
+    pen.stroke_width = 1;
+
+    for (loop = 0; loop < 4; loop++) {
+        pen.stroke_type = (loop & 1) ? NFSB_PLOT_OPTYPE_PATTERN : NFSB_PLOT_OPTYPE_SOLID;
+        pen.stroke_pattern = 0x33cc0f0f;
+
+        plot_lines(clipped, REGIONC, region, &pen, loop & 2);
+        plot_lines(bounded, 1, &box, &pen, loop & 2);
+
+        errors += compare(clipped, bounded,
+                          (loop & 1) ? "pattern lines" : "solid lines");
+    }
+
+    for (loop = 0; loop < 2; loop++) {
+        plot_ellipses(clipped, REGIONC, region, loop);
+        plot_ellipses(bounded, 1, &box, loop);
+
+        errors += compare(clipped, bounded,
+                          loop ? "filled ellipses" : "ellipse outlines");
+    }
+
+    plot_star(clipped, REGIONC, region);
+    plot_star(bounded, 1, &box);
+    errors += compare(clipped, bounded, "star polygon");
+
+    nsfb_free(clipped);
+    nsfb_free(bounded);
+
+    if (errors != 0)
+        return 5;
+
+    printf("PASS\n");
+
+    return 0;
+}
@@ -12,4 +12,7 @@ ${TEST_PATH}/test_path ${TEST_FRONTEND}
 ${TEST_PATH}/test_polygon ${TEST_FRONTEND}
 ${TEST_PATH}/test_polystar ${TEST_FRONTEND}
 ${TEST_PATH}/test_polystar2 ${TEST_FRONTEND}
+${TEST_PATH}/test_region ${TEST_FRONTEND}
+${TEST_PATH}/test_polylarge ${TEST_FRONTEND}
+${TEST_PATH}/test_aaclip ${TEST_FRONTEND}
 
@@ -48,6 +48,10 @@ int main(int argc, char **argv)
 
 	nsfb_bbox_t box;
 	nsfb_bbox_t box3;
+	nsfb_plot_glyph_t *run;
+	int runc;
+	nsfb_glyph_cache_t *cache;
+	nsfb_glyph_cache_stats_t stats;
 	uint8_t *fbptr;
 	int fbstride;
 	int i;
@@ -105,6 +109,66 @@ int main(int argc, char **argv)
 		nsfb_update(nsfb, &box);
 	}
 
+	/* same again plotting a row of glyphs with each call */
+	run = malloc(sizeof(nsfb_plot_glyph_t) * (box.x1 / Mglyph1.w + 1));
+	if (run == NULL) {
+		nsfb_free(nsfb);
+		return EXIT_FAILURE;
+	}
+
+	nsfb_plot_clg(nsfb, 0xffffffff);
+	for (i = 0; i < 1000; i++) {
+		for (y = 0; y + Mglyph1.h < (unsigned int)box.y1; y += Mglyph1.h) {
+			runc = 0;
+			for (x = 0; x + Mglyph1.w < (unsigned int)box.x1; x += Mglyph1.w) {
+				run[runc].loc.x0 = x;
+				run[runc].loc.y0 = y;
+				run[runc].loc.x1 = x + Mglyph1.w;
+				run[runc].loc.y1 = y + Mglyph1.h;
+				run[runc].pixel = Mglyph1.data;
+				run[runc].pitch = Mglyph1.w;
+				runc++;
+			}
+			nsfb_plot_glyph_run(nsfb, NSFB_PLOT_GLYPH_1BPP,
+					run, runc, 0xff000000);
+		}
+		nsfb_update(nsfb, &box);
+	}
+
+	free(run);
+
+	/* and again plotting the glyph from a glyph cache */
+	cache = nsfb_glyph_cache_create(64 * 1024);
+	if (cache == NULL) {
+		nsfb_free(nsfb);
+		return EXIT_FAILURE;
+	}
+
+	nsfb_plot_clg(nsfb, 0xffffffff);
+	for (i = 0; i < 1000; i++) {
+		for (y = 0; y + Mglyph1.h < (unsigned int)box.y1; y += Mglyph1.h) {
+			for (x = 0; x + Mglyph1.w < (unsigned int)box.x1; x += Mglyph1.w) {
+				if (!nsfb_plot_glyph_cached(nsfb, cache, 'M', 16,
+						x, y, 0xff000000)) {
+					nsfb_glyph_cache_add(cache, 'M', 16,
+							NSFB_PLOT_GLYPH_1BPP,
+							Mglyph1.data,
+							Mglyph1.w, Mglyph1.h,
+							Mglyph1.w, 0, 0);
+					nsfb_plot_glyph_cached(nsfb, cache, 'M',
+							16, x, y, 0xff000000);
+				}
+			}
+		}
+		nsfb_update(nsfb, &box);
+	}
+
+	nsfb_glyph_cache_stats(cache, &stats);
+	printf("glyph cache: %lu hits %lu misses %u glyphs %u bytes\n",
+			stats.hits, stats.misses, stats.count,
+			(unsigned int)stats.used);
+	nsfb_glyph_cache_destroy(cache);
+
 	nsfb_update(nsfb, &box);
 	nsfb_free(nsfb);
 